@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "TaskProfiler.h"
+#include <FS.h>
+#include <Hoymiles.h>
+#include <TaskSchedulerDeclarations.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#define ALARM_HISTORY_FILENAME "/alarms.bin"
+#define ALARM_HISTORY_FILENAME_OLD "/alarms.old"
+
+// Once the current file would exceed this size it replaces the old one,
+// so the history never needs more than twice this space
+#define ALARM_HISTORY_FILE_SIZE (32 * 1024)
+
+// The file is written by a FreeRTOS task with the priority of the main loop,
+// so it gets time sliced with it instead of blocking it
+#define ALARM_HISTORY_WRITER_STACK_SIZE 4096
+#define ALARM_HISTORY_WRITER_PRIORITY 1
+
+struct __attribute__((packed)) AlarmHistoryRecord_t {
+    uint64_t Serial;
+    uint32_t StartTime; // unix time
+    uint32_t EndTime; // unix time, 0 if the alarm did not end while it was reported
+    uint16_t MessageId;
+};
+
+struct AlarmHistoryFilter_t {
+    uint64_t Serial; // 0 matches all inverters
+    uint32_t From; // start time range, inclusive
+    uint32_t To;
+    int32_t MessageId; // -1 matches all messages
+};
+
+// Records every alarm reported by the inverters in an append only log on
+// LittleFS. New alarms are collected in memory and written in batches by a
+// separate task, started while the radios are idle. Alarms are recorded once
+// they have ended or dropped out of the inverter's event log.
+class AlarmHistoryClass {
+public:
+    AlarmHistoryClass();
+    void init(Scheduler& scheduler);
+
+    // Calls cb for the records matching filter whose sequence number is
+    // larger than after, in the order they were recorded, until it returns
+    // false. Sequence numbers start at 1 and are only valid until the next
+    // reboot.
+    void forEachRecord(const AlarmHistoryFilter_t& filter, const uint32_t after, std::function<bool(const uint32_t sequence, const AlarmHistoryRecord_t& record)> cb);
+
+    uint32_t getRecordCount();
+
+private:
+    void loop();
+    void collect(std::shared_ptr<InverterAbstract> inv);
+    static void writerTask(void* instance);
+    bool flush();
+    void loadIndex();
+    void indexRecord(const uint8_t file, const AlarmHistoryRecord_t& record);
+    bool isRecorded(const AlarmHistoryRecord_t& record);
+    bool readRecord(File& f, const uint16_t index, AlarmHistoryRecord_t& record);
+
+    static uint32_t getUnixTime(const time_t secondsOfDay, const time_t now, const time_t midnight);
+    static uint32_t getSerialMask(const uint64_t serial);
+
+    ProfiledTask _loopTask;
+    TaskHandle_t _writerTask = nullptr;
+
+    // Summary of a run of consecutive records used to skip file reads
+    struct block_t {
+        uint8_t file; // 0 = old file, 1 = current file
+        uint16_t first; // index of the first record in the file
+        uint16_t count;
+        uint32_t minTime;
+        uint32_t maxTime;
+        uint32_t serialMask;
+    };
+    std::vector<block_t> _blocks;
+    uint16_t _recordCount[2] = { 0, 0 };
+    uint32_t _sequenceBase = 1; // sequence number of the first record in the old file
+
+    struct known_alarm_t {
+        AlarmHistoryRecord_t record;
+        time_t rawStartTime; // seconds of the day without timezone offset
+        bool recorded;
+    };
+
+    struct inverter_state_t {
+        uint32_t lastUpdate = 0;
+        bool initialized = false; // compared with the file after boot
+        std::vector<known_alarm_t> alarms; // alarms of the last event log
+    };
+    std::map<uint64_t, inverter_state_t> _inverters;
+
+    std::vector<AlarmHistoryRecord_t> _pending;
+    uint32_t _pendingSince = 0;
+    bool _flushRequested = false;
+    uint32_t _lastFlushError = 0;
+    bool _flushFailed = false;
+    uint32_t _droppedCount = 0;
+
+    std::mutex _mutex;
+};
+
+extern AlarmHistoryClass AlarmHistory;
@@ -2,9 +2,23 @@
 #pragma once
 
 #include "PinMapping.h"
+#include "TaskProfiler.h"
+#include <TaskSchedulerDeclarations.h>
+#include <array>
+#include <atomic>
 #include <cstdint>
+#include <memory>
+#include <mutex>
 
 #define CONFIG_FILENAME "/config.json"
+#define CONFIG_BACKUP_FILENAME "/config.bak"
+#define CONFIG_TMP_FILENAME "/config.tmp"
+#define CONFIG_BINARY_FILENAME "/config.bin"
+
+// Requested writes are delayed until there was no further request for
+// CONFIG_WRITE_DELAY ms, but at most for CONFIG_WRITE_MAX_DELAY ms
+#define CONFIG_WRITE_DELAY 2000
+#define CONFIG_WRITE_MAX_DELAY 10000
 #define CONFIG_VERSION 0x00011c00 // 0.1.28 // make sure to clean all after change
 
 #define WIFI_MAX_SSID_STRLEN 32
@@ -159,17 +173,99 @@ struct CONFIG_T {
     char Dev_PinMapping[DEV_MAX_MAPPING_NAME_STRLEN + 1];
 };
 
+// Immutable copy of the configuration as it was published by a writer
+class ConfigSnapshot {
+public:
+    ConfigSnapshot(const CONFIG_T& config, const uint32_t generation);
+
+    const CONFIG_T& get() const;
+    const INVERTER_CONFIG_T* getInverterConfig(const uint64_t serial) const;
+
+    // Incremented with every published change
+    uint32_t getGeneration() const;
+
+private:
+    CONFIG_T _config;
+    uint32_t _generation;
+
+    // Configured inverter slots sorted by serial
+    std::array<std::pair<uint64_t, uint8_t>, INV_MAX_COUNT> _inverterIndex;
+    uint8_t _inverterCount = 0;
+};
+
+using ConfigSnapshotPtr = std::shared_ptr<const ConfigSnapshot>;
+
+struct ConfigWriteStats_t {
+    uint32_t Requests;
+    uint32_t Writes;
+    uint32_t Failures;
+    uint32_t LastTime; // ms
+    uint32_t MaxTime; // ms
+};
+
 class ConfigurationClass {
 public:
+    ConfigurationClass();
     void init();
+    void initWriteTask(Scheduler& scheduler);
     bool read();
     bool write();
     void migrate();
+
+    // Writes the configuration once the requests stop, see CONFIG_WRITE_DELAY
+    void requestWrite();
+    // Writes a requested change immediately, e.g. before a restart
+    void flush();
+    // Drops a requested change if the file system content is replaced
+    void discardPendingWrite();
+
+    // Identifies the content of the configuration file together with the
+    // save counter. Changes on every boot and whenever the file is replaced,
+    // as a replaced file may contain the same save counter.
+    uint32_t getFileGeneration() const;
+
+    ConfigWriteStats_t getWriteStats();
+
+    // The configuration being edited. Only the web API and the setup code
+    // modify it, other tasks have to read the published snapshot.
     CONFIG_T& get();
 
+    // Current configuration for readers in any task. A snapshot stays valid
+    // and unchanged as long as it is referenced.
+    ConfigSnapshotPtr getSnapshot() const;
+
+    // Removes the binary copy of the configuration, required if the JSON
+    // file is replaced without using write()
+    void removeBinary();
+
     INVERTER_CONFIG_T* getFreeInverterSlot();
     INVERTER_CONFIG_T* getInverterConfig(const uint64_t serial);
     void deleteInverterById(const uint8_t id);
+
+private:
+    void loop();
+    void publish();
+    bool persist();
+    bool persistLocked(); // _writeMutex has to be held
+    bool writeFile(const CONFIG_T& config);
+    bool readBinary();
+    void writeBinary(const CONFIG_T& config, const size_t jsonSize);
+
+    ConfigSnapshotPtr _snapshot;
+    uint32_t _generation = 0;
+
+    const uint32_t _bootId;
+    std::atomic<uint32_t> _fileReplacements = { 0 };
+
+    ProfiledTask _writeTask;
+
+    bool _writePending = false;
+    uint32_t _firstRequest = 0;
+    uint32_t _lastRequest = 0;
+    ConfigWriteStats_t _writeStats = {};
+    std::mutex _mutex; // pending state and statistics
+
+    std::mutex _writeMutex; // serializes the file accesses of write()
 };
 
 extern ConfigurationClass Configuration;
@@ -3,8 +3,11 @@
 
 #include "Display_Graphic_Diagram.h"
 #include "defaults.h"
+#include "TaskProfiler.h"
 #include <TaskSchedulerDeclarations.h>
 #include <U8g2lib.h>
+#include <atomic>
+#include <memory>
 
 #define CHART_HEIGHT 20 // chart area hight in pixels
 #define CHART_WIDTH 47 // chart area width in pixels
@@ -46,6 +49,12 @@ public:
 
     DisplayGraphicDiagramClass& Diagram();
 
+    // Time in us per second the transfers to the display needed
+    uint32_t getBusTime() const;
+
+    // Tiles (8x8 pixels) transferred since boot
+    uint32_t getTilesSent() const;
+
     bool enablePowerSafe = true;
     bool enableScreensaver = true;
 
@@ -55,8 +64,10 @@ private:
     void calcLineHeights();
     void setFont(const uint8_t line);
     bool isValidDisplay();
+    void sendDirtyTiles();
+    void accountBusTime(const uint32_t start);
 
-    Task _loopTask;
+    ProfiledTask _loopTask;
 
     U8G2* _display;
     DisplayGraphicDiagramClass _diagram;
@@ -73,6 +84,16 @@ private:
     char _fmtText[32];
     bool _isLarge = false;
     uint8_t _lineOffsets[5];
+
+    // Copy of the frame buffer as it was sent to the display, only tiles
+    // which differ from it are transferred
+    std::unique_ptr<uint8_t[]> _sentBuffer;
+    int8_t _powerSave = -1; // unknown
+
+    uint32_t _busTimeSum = 0;
+    uint32_t _busTimeStart = 0;
+    std::atomic<uint32_t> _busTime = { 0 };
+    std::atomic<uint32_t> _tilesSent = { 0 };
 };
 
 extern DisplayGraphicClass Display;
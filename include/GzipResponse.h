@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ESPAsyncWebServer.h>
+#include <GzipEncoder.h>
+#include <JsonStreamWriter.h>
+#include <Print.h>
+#include <functional>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Responses smaller than this are sent uncompressed
+#define GZIP_RESPONSE_THRESHOLD 512
+
+struct GzipResponseStats_t {
+    uint32_t Responses; // compressed responses
+    uint32_t InputBytes;
+    uint32_t OutputBytes; // bytes sent over the network
+    uint32_t Time; // us spent compressing
+};
+
+// Fillers write the next part of the content on each call and return false
+// once the content is complete. They are called from the web server while
+// the response is sent, so everything they use has to be captured by value.
+typedef std::function<bool(Print& output)> GzipResponseFiller;
+typedef std::function<bool(JsonStreamWriter& writer)> JsonResponseFiller;
+
+// Chunked response which is compressed with gzip if the client accepts it
+// and the content exceeds GZIP_RESPONSE_THRESHOLD. The content is pulled
+// from the filler as the server needs data, so only the part which is
+// currently sent is held in memory. The filler is called until the
+// threshold is exceeded before the headers are sent, so the encoder is
+// only allocated for responses which benefit from it.
+class GzipResponse {
+public:
+    GzipResponse(AsyncWebServerRequest* request, const char* contentType);
+
+    void addHeader(const char* name, const String& value);
+
+    // Hands the response over to the server. If a JSON filler marks the
+    // writer as failed before the headers are sent, a 500 error is sent
+    // instead. Later failures truncate the response.
+    void send(GzipResponseFiller filler);
+    void sendJson(JsonResponseFiller filler);
+
+    static bool isAccepted(AsyncWebServerRequest* request);
+
+    // Statistics per URL
+    static const std::map<String, GzipResponseStats_t>& getStats();
+
+private:
+    class Content;
+
+    void send(std::shared_ptr<Content> content);
+    void sendError();
+
+    AsyncWebServerRequest* _request;
+    const char* _contentType;
+    std::vector<std::pair<String, String>> _headers;
+
+    static std::map<String, GzipResponseStats_t> _stats;
+};
@@ -0,0 +1,46 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "TaskProfiler.h"
+#include <TaskSchedulerDeclarations.h>
+#include <mutex>
+#include <vector>
+
+// Interval in seconds between two snapshots of the heap
+#define HEAP_SNAPSHOT_INTERVAL (30 * 60)
+
+// Number of snapshots kept (one day)
+#define HEAP_SNAPSHOT_COUNT 48
+
+struct HeapSnapshot_t {
+    uint32_t Uptime; // s
+    uint32_t FreeBytes;
+    uint32_t LargestFreeBlock;
+    uint32_t MinimumFreeBytes;
+    uint32_t FreeBlocks;
+};
+
+class HeapMonitorClass {
+public:
+    HeapMonitorClass();
+    void init(Scheduler& scheduler);
+
+    HeapSnapshot_t getCurrent() const;
+
+    // Oldest first
+    std::vector<HeapSnapshot_t> getSnapshots() const;
+
+    // Share of the free internal heap which is not part of the largest free block in percent
+    static float getFragmentation(const HeapSnapshot_t& snapshot);
+
+private:
+    void loop();
+
+    ProfiledTask _loopTask;
+
+    mutable std::mutex _mutex;
+    HeapSnapshot_t _snapshots[HEAP_SNAPSHOT_COUNT];
+    uint32_t _snapshotCount = 0;
+};
+
+extern HeapMonitorClass HeapMonitor;
@@ -1,11 +1,16 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "TaskProfiler.h"
 #include <TaskSchedulerDeclarations.h>
 #include <cstdint>
 
 #define INVERTER_UPDATE_SETTINGS_INTERVAL 60000l
 
+// Interval in ms of the radio loop while no command is pending. Runs on
+// every pass of the scheduler while a radio is active.
+#define INVERTER_IDLE_LOOP_INTERVAL 50
+
 class InverterSettingsClass {
 public:
     InverterSettingsClass();
@@ -15,8 +20,8 @@ private:
     void settingsLoop();
     void hoyLoop();
 
-    Task _settingsTask;
-    Task _hoyTask;
+    ProfiledTask _settingsTask;
+    ProfiledTask _hoyTask;
 };
 
 extern InverterSettingsClass InverterSettings;
@@ -2,11 +2,15 @@
 #pragma once
 
 #include "PinMapping.h"
+#include "TaskProfiler.h"
 #include <TaskSchedulerDeclarations.h>
 #include <TimeoutHelper.h>
 
 #define LEDSINGLE_UPDATE_INTERVAL 2000
 
+// Interval in ms to apply the LED states, has to be well below the blink period
+#define LEDSINGLE_OUTPUT_INTERVAL 50
+
 class LedSingleClass {
 public:
     LedSingleClass();
@@ -21,8 +25,8 @@ private:
 
     void setLed(const uint8_t ledNo, const bool ledState);
 
-    Task _setTask;
-    Task _outputTask;
+    ProfiledTask _setTask;
+    ProfiledTask _outputTask;
 
     enum class LedState_t {
         On,
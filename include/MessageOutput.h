@@ -1,14 +1,60 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "TaskProfiler.h"
 #include <AsyncWebSocket.h>
 #include <HardwareSerial.h>
 #include <Stream.h>
 #include <TaskSchedulerDeclarations.h>
-#include <mutex>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/ringbuf.h>
 
 #define BUFFER_SIZE 500
 
+// Output waiting for the serial port and the console websocket
+#define LOG_BUFFER_SIZE 4096
+
+// Output is passed to the websocket only if the serial port did not accept
+// anything for this time (e.g. USB CDC without host)
+#define LOG_SERIAL_TIMEOUT 500
+
+// The log buffer is checked for new output with this interval in ms
+#define LOG_FLUSH_INTERVAL 10
+
+enum class LogLevel : uint8_t {
+    Error = 0,
+    Warning,
+    Info,
+    Debug,
+    Verbose,
+};
+#define LOG_LEVEL_COUNT 5
+
+enum class LogTag : uint8_t {
+    Core = 0, // everything written without a tag
+    Radio,
+    Mqtt,
+    Web,
+    Config,
+};
+#define LOG_TAG_COUNT 5
+
+// Messages above this level are removed at compile time
+#ifndef LOG_LEVEL_MAX
+#define LOG_LEVEL_MAX LogLevel::Debug
+#endif
+
+// Level of all tags after boot
+#ifndef LOG_LEVEL_DEFAULT
+#define LOG_LEVEL_DEFAULT LogLevel::Info
+#endif
+
+/*
+ * Writes are copied into a ring buffer and never wait for the serial port.
+ * The buffer is drained by the main loop as fast as the serial port accepts
+ * the data. If the buffer is full, the output is dropped and counted.
+ */
 class MessageOutputClass : public Print {
 public:
     MessageOutputClass();
@@ -17,18 +63,68 @@ public:
     size_t write(const uint8_t* buffer, size_t size) override;
     void register_ws_output(AsyncWebSocket* output);
 
+    bool isEnabled(const LogTag tag, const LogLevel level) const
+    {
+        return level <= LOG_LEVEL_MAX
+            && static_cast<uint8_t>(level) <= _levels[static_cast<uint8_t>(tag)].load(std::memory_order_relaxed);
+    }
+
+    // The message is only formatted if the level is enabled for the tag
+    template <typename... Args>
+    void log(const LogTag tag, const LogLevel level, const char* format, Args... args)
+    {
+        if (!isEnabled(tag, level)) {
+            return;
+        }
+        if constexpr (sizeof...(Args) == 0) {
+            print(format);
+        } else {
+            printf(format, args...);
+        }
+    }
+
+    LogLevel getLevel(const LogTag tag) const;
+    void setLevel(const LogTag tag, const LogLevel level);
+
+    uint32_t getDroppedBytes() const;
+
+    static const char* getTagName(const LogTag tag);
+    static const char* getLevelName(const LogLevel level);
+    static bool parseLevel(const char* name, LogLevel& level);
+
 private:
     void loop();
 
-    Task _loopTask;
+    ProfiledTask _loopTask;
+
+    // Created with the first iteration of the loop, output written before
+    // (during setup) goes to the serial port directly
+    std::atomic<RingbufHandle_t> _ring = { nullptr };
+    std::atomic<uint32_t> _droppedBytes = { 0 };
+    uint32_t _reportedDroppedBytes = 0;
+    uint32_t _lastSerialWrite = 0;
+
+    std::atomic<uint8_t> _levels[LOG_TAG_COUNT];
 
     AsyncWebSocket* _ws = nullptr;
     char _buffer[BUFFER_SIZE];
     uint16_t _buff_pos = 0;
     uint32_t _lastSend = 0;
-    bool _forceSend = false;
+};
 
-    std::mutex _msgLock;
+// Print interface for libraries, everything is written with a fixed tag and
+// level
+class LogPrint : public Print {
+public:
+    LogPrint(const LogTag tag, const LogLevel level);
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+
+    bool isEnabled() const;
+
+private:
+    const LogTag _tag;
+    const LogLevel _level;
 };
 
 extern MessageOutputClass MessageOutput;
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "TaskProfiler.h"
 #include <TaskSchedulerDeclarations.h>
 #include <cstdint>
 
@@ -12,7 +13,7 @@ public:
 private:
     void loop();
 
-    Task _loopTask;
+    ProfiledTask _loopTask;
 };
 
 extern MqttHandleDtuClass MqttHandleDtu;
@@ -1,9 +1,12 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "Configuration.h"
+#include "TaskProfiler.h"
 #include <ArduinoJson.h>
 #include <Hoymiles.h>
 #include <TaskSchedulerDeclarations.h>
+#include <vector>
 
 // mqtt discovery device classes
 enum {
@@ -49,16 +52,37 @@ const byteAssign_fieldDeviceClass_t deviceFieldAssignment[] = {
 };
 #define DEVICE_CLS_ASSIGN_LIST_LEN (sizeof(deviceFieldAssignment) / sizeof(byteAssign_fieldDeviceClass_t))
 
+struct HassDiscoveryStats_t {
+    uint32_t Passes; // completed discovery passes since boot
+    uint32_t Published; // documents published during the last pass
+    uint32_t Unchanged; // documents skipped during the last pass
+    uint32_t Duration; // ms from start to end of the last pass
+    uint32_t MaxTickTime; // longest loop iteration of the last pass in us
+    uint32_t PeakHeapUsage; // bytes
+};
+
 class MqttHandleHassClass {
 public:
     MqttHandleHassClass();
     void init(Scheduler& scheduler);
+
+    // Starts a discovery pass which is spread over several loop iterations.
+    // Only documents which changed since they were published last are sent.
     void publishConfig();
     void forceUpdate();
 
+    HassDiscoveryStats_t getDiscoveryStats() const;
+
 private:
     void loop();
+    bool publishNextUnit();
+    void publishDtuConfig();
+    void publishInverterControls(std::shared_ptr<InverterAbstract> inv);
+    bool publishInverterChannel(std::shared_ptr<InverterAbstract> inv, const uint8_t pos);
+    void finishPass();
+
     void publish(const String& subtopic, const String& payload);
+    void onDiscoverySent(const String& topic, const String& payload);
     void publishDtuSensor(const char* name, const char* device_class, const char* category, const char* icon, const char* unit_of_measure, const char* subTopic);
     void publishDtuBinarySensor(const char* name, const char* device_class, const char* category, const char* payload_on, const char* payload_off, const char* subTopic = "");
     void publishInverterField(std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const byteAssign_fieldDeviceClass_t fieldType, const bool clear = false);
@@ -74,10 +98,36 @@ private:
     static String getDtuUniqueId();
     static String getDtuUrl();
 
-    Task _loopTask;
+    ProfiledTask _loopTask;
 
     bool _wasConnected = false;
     bool _updateForced = false;
+
+    // Configuration used while publishing the documents of one loop iteration
+    ConfigSnapshotPtr _config;
+
+    // Documents dropped by the publish queue are sent again by another pass
+    uint32_t _droppedDocuments = 0;
+    bool _passRepeat = false;
+
+    struct published_hash_t {
+        uint32_t topic;
+        uint32_t payload;
+    };
+    // Hashes of all documents handed over to the MQTT client, sorted by topic hash
+    std::vector<published_hash_t> _publishedHashes;
+
+    // Position of the running pass, -1 means DTU entities,
+    // unit 0 the controls and unit n the n-th channel of an inverter
+    bool _passActive = false;
+    int16_t _passInverterPos = -1;
+    uint8_t _passUnitPos = 0;
+
+    uint32_t _passStart = 0;
+    uint32_t _passHeapStart = 0;
+    uint32_t _passHeapMin = 0;
+    HassDiscoveryStats_t _pass = {};
+    HassDiscoveryStats_t _stats = {};
 };
 
 extern MqttHandleHassClass MqttHandleHass;
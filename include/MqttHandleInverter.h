@@ -2,6 +2,7 @@
 #pragma once
 
 #include "Configuration.h"
+#include "TaskProfiler.h"
 #include <Hoymiles.h>
 #include <TaskSchedulerDeclarations.h>
 #include <espMqttClient.h>
@@ -21,9 +22,10 @@ private:
     void publishField(std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId);
     void onMqttMessage(const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, const size_t len, const size_t index, const size_t total);
 
-    Task _loopTask;
+    ProfiledTask _loopTask;
 
     uint32_t _lastPublishStats[INV_MAX_COUNT] = { 0 };
+    uint8_t _nextInverterPos = 0;
 
     FieldId_t _publishFields[14] = {
         FLD_UDC,
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "TaskProfiler.h"
 #include <TaskSchedulerDeclarations.h>
 
 class MqttHandleInverterTotalClass {
@@ -11,7 +12,7 @@ public:
 private:
     void loop();
 
-    Task _loopTask;
+    ProfiledTask _loopTask;
 };
 
 extern MqttHandleInverterTotalClass MqttHandleInverterTotal;
@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <Arduino.h>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+// Lower value means higher priority
+enum class MqttPublishPriority : uint8_t {
+    Availability = 0, // LWT and reachability states
+    CommandAck, // responses to commands received via MQTT, never replaced
+    Telemetry, // regular measurement values
+    Discovery, // Home Assistant auto discovery
+};
+#define MQTT_PUBLISH_PRIORITY_COUNT 4
+
+struct MqttPublishQueueStats_t {
+    uint32_t Depth; // currently queued messages
+    uint32_t Bytes; // memory currently accounted for queued messages
+    uint32_t Budget;
+    uint32_t Enqueued;
+    uint32_t Sent;
+    uint32_t Replaced; // queued messages superseded by a newer value of the same topic
+    uint32_t Dropped; // messages discarded because of the memory budget
+    uint32_t LatencyAvg; // ms between enqueue and hand over to the client
+    uint32_t LatencyMax;
+};
+
+class MqttPublishQueue {
+public:
+    struct message_t {
+        String topic;
+        String payload;
+        bool retain;
+        uint8_t qos;
+        MqttPublishPriority priority;
+        uint32_t enqueued;
+    };
+
+    explicit MqttPublishQueue(const size_t budget);
+
+    // Returns false if the message was dropped because of the memory budget
+    bool push(const String& topic, const String& payload, const bool retain, const uint8_t qos, const MqttPublishPriority priority);
+
+    // Removes the oldest message of the highest priority class
+    bool pop(message_t& message);
+
+    // Puts a message which could not be handed over to the client back to the head of its class
+    void unpop(message_t&& message);
+
+    void markSent(const message_t& message);
+
+    void clear();
+    bool empty() const;
+    size_t getFree() const;
+    MqttPublishQueueStats_t getStats() const;
+
+    // Messages of the class discarded because of the memory budget since boot
+    uint32_t getDropped(const MqttPublishPriority priority) const;
+
+private:
+    using list_t = std::list<message_t>;
+
+    static size_t getCost(const message_t& message);
+    static uint32_t getTopicHash(const String& topic);
+
+    bool evict(const MqttPublishPriority priority, const size_t required);
+    void account(const MqttPublishPriority priority, const size_t oldCost, const size_t newCost);
+    void removeIndex(const list_t::iterator& it);
+
+    list_t _queues[MQTT_PUBLISH_PRIORITY_COUNT];
+
+    // Index of queued coalescable messages by topic hash
+    std::unordered_map<uint32_t, list_t::iterator> _index;
+
+    const size_t _budget;
+    size_t _bytes = 0;
+    size_t _classBytes[MQTT_PUBLISH_PRIORITY_COUNT] = { 0 };
+    size_t _depth = 0;
+
+    uint32_t _enqueued = 0;
+    uint32_t _sent = 0;
+    uint32_t _replaced = 0;
+    uint32_t _dropped = 0;
+    uint32_t _classDropped[MQTT_PUBLISH_PRIORITY_COUNT] = { 0 };
+    uint64_t _latencySum = 0;
+    uint32_t _latencyMax = 0;
+
+    mutable std::mutex _mutex;
+};
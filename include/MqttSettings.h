@@ -1,22 +1,40 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "Configuration.h"
+#include "MqttPublishQueue.h"
 #include "NetworkSettings.h"
+#include "TaskProfiler.h"
 #include <MqttSubscribeParser.h>
+#include <TaskSchedulerDeclarations.h>
 #include <Ticker.h>
 #include <espMqttClient.h>
+#include <functional>
 #include <mutex>
 
+typedef std::function<void(const String& topic, const String& payload)> MqttSentCallback;
+
 class MqttSettingsClass {
 public:
     MqttSettingsClass();
-    void init();
+    void init(Scheduler& scheduler);
     void performReconnect();
     bool getConnected();
-    void publish(const String& subtopic, const String& payload);
-    void publishGeneric(const String& topic, const String& payload, const bool retain, const uint8_t qos = 0);
+    void publish(const String& subtopic, const String& payload, const MqttPublishPriority priority = MqttPublishPriority::Telemetry);
+
+    // Returns false if the message was dropped
+    bool publishGeneric(const String& topic, const String& payload, const bool retain, const uint8_t qos = 0, const MqttPublishPriority priority = MqttPublishPriority::Telemetry);
+
+    // Amount of bytes which can be queued before messages get dropped
+    size_t getQueueFree() const;
+    MqttPublishQueueStats_t getQueueStats() const;
+    uint32_t getQueueDropped(const MqttPublishPriority priority) const;
 
-    void subscribe(const String& topic, const uint8_t qos, const espMqttClientTypes::OnMessageCallback& cb);
+    // Called by the loop task when a message of the class was handed over to
+    // the client. The client is locked meanwhile, cb must not access it.
+    void onSent(const MqttPublishPriority priority, const MqttSentCallback& cb);
+
+    bool subscribe(const String& topic, const uint8_t qos, const espMqttClientTypes::OnMessageCallback& cb);
     void unsubscribe(const String& topic);
 
     String getPrefix() const;
@@ -34,9 +52,16 @@ private:
 
     void createMqttClientObject();
 
+    void flushQueue();
+
+    ProfiledTask _flushTask;
+
     MqttClient* _mqttClient = nullptr;
+    ConfigSnapshotPtr _clientConfig; // referenced by the client settings
     Ticker _mqttReconnectTimer;
     MqttSubscribeParser _mqttSubscribeParser;
+    MqttPublishQueue _publishQueue;
+    MqttSentCallback _sentCallbacks[MQTT_PUBLISH_PRIORITY_COUNT];
     std::mutex _clientLock;
 };
 
@@ -1,11 +1,15 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "TaskProfiler.h"
 #include <DNSServer.h>
 #include <TaskSchedulerDeclarations.h>
 #include <WiFi.h>
 #include <vector>
 
+// Interval in ms of the network housekeeping (mode switches, DNS server of the admin AP, mDNS)
+#define NETWORK_LOOP_INTERVAL 20
+
 enum class network_mode {
     WiFi,
     Ethernet,
@@ -64,7 +68,7 @@ private:
     void setupMode();
     void NetworkEvent(const WiFiEvent_t event);
 
-    Task _loopTask;
+    ProfiledTask _loopTask;
 
     static constexpr byte DNS_PORT = 53;
 
@@ -1,13 +1,21 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "TaskProfiler.h"
+#include <TaskSchedulerDeclarations.h>
+
 class NtpSettingsClass {
 public:
     NtpSettingsClass();
-    void init();
+    void init(Scheduler& scheduler);
 
     void setServer();
     void setTimezone();
+
+private:
+    void loop();
+
+    ProfiledTask _loopTask;
 };
 
-extern NtpSettingsClass NtpSettings;
\ No newline at end of file
+extern NtpSettingsClass NtpSettings;
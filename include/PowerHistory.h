@@ -0,0 +1,94 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+#define POWER_HISTORY_LEVEL_COUNT 4
+
+// Capacity of the levels in buckets
+#define POWER_HISTORY_10S_COUNT 360 // 1 hour
+#define POWER_HISTORY_1MIN_COUNT 720 // 12 hours
+#define POWER_HISTORY_15MIN_COUNT 192 // 2 days
+#define POWER_HISTORY_1DAY_COUNT 31 // 1 month
+
+#define POWER_HISTORY_BUCKET_COUNT (POWER_HISTORY_10S_COUNT + POWER_HISTORY_1MIN_COUNT + POWER_HISTORY_15MIN_COUNT + POWER_HISTORY_1DAY_COUNT)
+
+// A bucket of an interval without any sample (e.g. because the main loop was
+// blocked) is kept as gap with Min > Max
+struct PowerHistoryBucket_t {
+    uint16_t Min; // W
+    uint16_t Max; // W
+    uint16_t Avg; // W
+    bool isGap() const { return Min > Max; }
+};
+
+struct PowerHistoryLevel_t {
+    uint32_t Interval; // s
+    uint16_t Capacity; // buckets
+};
+
+// Keeps the total AC power of all enabled inverters in ring buffers with
+// several resolutions. The first level is built from the samples of the
+// Datastore, every further level from the completed buckets of the previous
+// one. All levels advance with the elapsed time, so every bucket covers its
+// interval and intervals without samples are written as gaps. The buckets are
+// aligned to the uptime and not to the wall clock.
+class PowerHistoryClass {
+public:
+    PowerHistoryClass();
+
+    // Called by the Datastore about once per second
+    void addSample(const float power);
+
+    static const PowerHistoryLevel_t& getLevel(const uint8_t level);
+
+    // Returns the level with the given interval or -1
+    static int8_t findLevel(const uint32_t interval);
+
+    uint16_t getBucketCount(const uint8_t level);
+
+    // Calls cb for the completed buckets of level including gaps, oldest first
+    void forEachBucket(const uint8_t level, std::function<void(const PowerHistoryBucket_t& bucket)> cb);
+
+    // Last completed bucket of level, false if there is none yet or it is a gap
+    bool getLastBucket(const uint8_t level, PowerHistoryBucket_t& bucket);
+
+    // Average power of the last duration seconds resampled to at most count
+    // values, oldest first. Uses the finest level which covers the duration.
+    // Gaps are left out of the averages, a value without any data is 0.
+    // Returns less than count values while the history is shorter.
+    uint16_t getAverages(const uint32_t duration, float* values, const uint16_t count);
+
+private:
+    struct LevelState_t {
+        uint16_t Offset; // first bucket of the level in _buckets
+        uint16_t Head; // next bucket to write
+        uint16_t Count; // completed buckets
+        uint32_t Index; // number of the bucket in progress since the start
+
+        // Bucket in progress
+        uint32_t Samples;
+        float Sum;
+        uint16_t Min;
+        uint16_t Max;
+    };
+
+    void accumulate(const uint8_t level, const uint16_t min, const uint16_t max, const float avg);
+    void advance(const uint8_t level, const uint32_t index);
+    void closeBucket(const uint8_t level);
+    void writeBucket(const uint8_t level, const PowerHistoryBucket_t& bucket);
+    const PowerHistoryBucket_t& getBucket(const uint8_t level, const uint16_t index) const;
+
+    LevelState_t _levels[POWER_HISTORY_LEVEL_COUNT];
+    PowerHistoryBucket_t _buckets[POWER_HISTORY_BUCKET_COUNT];
+
+    bool _started = false;
+    uint32_t _lastSample = 0; // ms
+    uint64_t _elapsed = 0; // ms since the first sample
+
+    std::mutex _mutex;
+};
+
+extern PowerHistoryClass PowerHistory;
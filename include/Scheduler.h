@@ -2,5 +2,53 @@
 #pragma once
 
 #include <TaskSchedulerDeclarations.h>
+#include <atomic>
+#include <cstdint>
 
-extern Scheduler scheduler;
\ No newline at end of file
+// Tasks which wait for a condition (e.g. idle radios or a connected MQTT
+// broker) check it again after this time in ms instead of spinning
+#define SCHEDULER_RETRY_DELAY 50
+
+// Longest time in ms the main loop sleeps. Bounds the delay of tasks which
+// are enabled from other FreeRTOS tasks, e.g. by the web server.
+#define SCHEDULER_MAX_SLEEP 50
+
+// The idle percentage is recalculated with this interval in ms
+#define SCHEDULER_IDLE_INTERVAL 1000
+
+extern Scheduler scheduler;
+
+/*
+ * Puts the main loop to sleep until the next task is due if a pass of the
+ * scheduler did not run any task. The other FreeRTOS tasks and the idle
+ * task, which may enter light sleep, run meanwhile.
+ */
+class SchedulerIdleClass {
+public:
+    // Enables automatic light sleep if it was compiled in
+    // (SCHEDULER_LIGHT_SLEEP) and the framework supports it
+    void init();
+
+    // Has to be called after every pass of the scheduler
+    void loop(const bool idleRun);
+
+    // Percentage of the time the main loop slept during the last interval
+    float getIdle() const;
+
+    // Total time in us the main loop slept
+    uint64_t getSleepTime() const;
+
+    bool isLightSleepEnabled() const;
+
+private:
+    uint32_t getTimeUntilNextTask() const;
+
+    bool _lightSleep = false;
+
+    std::atomic<uint64_t> _sleepTime = 0;
+    uint64_t _intervalSleepTime = 0;
+    uint32_t _intervalStart = 0;
+    std::atomic<float> _idle = 0;
+};
+
+extern SchedulerIdleClass SchedulerIdle;
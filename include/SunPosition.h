@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "TaskProfiler.h"
 #include <TaskSchedulerDeclarations.h>
 #include <atomic>
 #include <sunset.h>
@@ -19,10 +20,9 @@ public:
 private:
     void loop();
     void updateSunData();
-    bool checkRecalcDayChanged() const;
     bool getSunTime(struct tm* info, const uint32_t offset) const;
 
-    Task _loopTask;
+    ProfiledTask _loopTask;
 
     bool _isSunsetAvailable = true;
     uint32_t _sunriseMinutes = 0;
@@ -30,7 +30,6 @@ private:
 
     bool _isValidInfo = false;
     std::atomic_bool _doRecalc = true;
-    uint32_t _lastSunPositionCalculatedYMD = 0;
 };
 
 extern SunPositionClass SunPosition;
@@ -0,0 +1,125 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <TaskSchedulerDeclarations.h>
+#include <atomic>
+#include <cstdint>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define TASK_PROFILER_BUCKET_COUNT 8
+
+// CPU load is recalculated with this interval in ms
+#define TASK_PROFILER_LOAD_INTERVAL 1000
+
+struct TaskProfilerStats_t {
+    uint32_t Count = 0;
+    uint64_t Time = 0; // us
+    uint32_t MaxTime = 0; // us
+    uint32_t Histogram[TASK_PROFILER_BUCKET_COUNT] = {};
+};
+
+/*
+ * Run time statistics of a piece of code which is always executed by the
+ * same task. Reading is possible from any task, a read which overlaps with
+ * an update is repeated.
+ */
+class TaskProfilerCounter {
+public:
+    void add(const uint32_t time);
+
+    // Starts a new measurement window, must be called by the writing task
+    void resetWindow();
+
+    // total: since boot, window: since the last reset
+    void read(TaskProfilerStats_t& total, TaskProfilerStats_t& window) const;
+
+private:
+    std::atomic<uint32_t> _sequence = { 0 }; // odd while an update is in progress
+    TaskProfilerStats_t _total;
+    TaskProfilerStats_t _windowStart;
+    uint32_t _windowMaxTime = 0;
+};
+
+/*
+ * Task which measures the run time of each invocation of its callback. All
+ * instances are kept in a list which is used to report the statistics.
+ */
+class ProfiledTask : public Task {
+public:
+    ProfiledTask(const char* name, const unsigned long interval, const long iterations, TaskCallback callback);
+
+    const char* getName() const;
+    const TaskProfilerCounter& getCounter() const;
+    TaskProfilerCounter& getCounter();
+
+    static ProfiledTask* getFirst();
+    ProfiledTask* getNext() const;
+
+private:
+    void run();
+
+    const char* _name;
+    TaskCallback _callback;
+    TaskProfilerCounter _counter;
+
+    ProfiledTask* _next;
+    static ProfiledTask* _first;
+};
+
+class TaskProfilerClass {
+public:
+    void init();
+
+    // Has to be called once per iteration of the main loop
+    void loop();
+
+    // Time in us the main loop slept, not counted as iteration time
+    void addIdleTime(const uint32_t time);
+
+    // Starts a new measurement window with the next iteration of the main loop
+    void requestReset();
+
+    // Time between two iterations of the main loop
+    const TaskProfilerCounter& getLoopCounter() const;
+
+    // Duration of the current measurement window in ms
+    uint32_t getWindowDuration() const;
+
+    uint8_t getCoreCount() const;
+
+    // CPU load in percent during the last TASK_PROFILER_LOAD_INTERVAL
+    float getCpuLoad(const uint8_t core) const;
+
+    // CPU load in percent during the measurement window
+    float getCpuLoadWindow(const uint8_t core) const;
+
+    // Upper bound in us of a histogram bucket, 0 for the last (unbounded) bucket
+    static uint32_t getBucketBound(const uint8_t bucket);
+    static uint8_t getBucket(const uint32_t time);
+
+private:
+    static void tickHook();
+
+    TaskProfilerCounter _loopCounter;
+    uint32_t _lastIteration = 0;
+
+    std::atomic<bool> _resetRequested = { false };
+    std::atomic<uint32_t> _windowStart = { 0 };
+
+    // Every tick interrupt samples whether the idle task of the core is
+    // running. Written by the tick interrupt of the respective core only.
+    static TaskHandle_t _idleTasks[portNUM_PROCESSORS];
+    static volatile uint32_t _ticks[portNUM_PROCESSORS];
+    static volatile uint32_t _idleTicks[portNUM_PROCESSORS];
+
+    uint32_t _lastLoadCalculation = 0;
+    uint32_t _lastTicks[portNUM_PROCESSORS] = {};
+    uint32_t _lastIdleTicks[portNUM_PROCESSORS] = {};
+    std::atomic<float> _load[portNUM_PROCESSORS] = {};
+
+    uint32_t _windowTicks[portNUM_PROCESSORS] = {};
+    uint32_t _windowIdleTicks[portNUM_PROCESSORS] = {};
+};
+
+extern TaskProfilerClass TaskProfiler;
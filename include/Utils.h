@@ -2,8 +2,11 @@
 #pragma once
 
 #include <ArduinoJson.h>
+#include <cstddef>
 #include <cstdint>
 
+#define FNV1A_INITIAL_HASH 2166136261UL
+
 class Utils {
 public:
     static uint32_t getChipId();
@@ -12,4 +15,8 @@ public:
     static void restartDtu();
     static bool checkJsonAlloc(const JsonDocument& doc, const char* function, const uint16_t line);
     static void removeAllFiles();
+
+    // FNV-1a. Pass the result of a previous call as hash to continue it.
+    static uint32_t getFnv1aHash(const void* data, const size_t len, const uint32_t hash = FNV1A_INITIAL_HASH);
+    static uint32_t getFnv1aHash(const char* str, const uint32_t hash = FNV1A_INITIAL_HASH);
 };
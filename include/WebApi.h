@@ -9,6 +9,7 @@
 #include "WebApi_eventlog.h"
 #include "WebApi_firmware.h"
 #include "WebApi_gridprofile.h"
+#include "WebApi_history.h"
 #include "WebApi_inverter.h"
 #include "WebApi_limit.h"
 #include "WebApi_maintenance.h"
@@ -25,6 +26,7 @@
 #include <AsyncJson.h>
 #include <ESPAsyncWebServer.h>
 #include <TaskSchedulerDeclarations.h>
+#include <initializer_list>
 
 class WebApiClass {
 public:
@@ -42,6 +44,18 @@ public:
     static uint64_t parseSerialFromRequest(AsyncWebServerRequest* request, String param_name = "inv");
     static bool sendJsonResponse(AsyncWebServerRequest* request, AsyncJsonResponse* response, const char* function, const uint16_t line);
 
+    WsLiveFormatStats_t getWsLiveStats(const WsLiveFormat format);
+
+    // Builds an ETag from the version counters of a resource. A weak ETag
+    // marks responses which only differ in volatile values like data_age.
+    static String getETag(std::initializer_list<uint32_t> versions, const bool weak = false);
+
+    // Answers the request with 304 if the client already has the version
+    // described by etag. Otherwise the handler has to build the response
+    // and add the ETag header to it.
+    bool checkNotModified(AsyncWebServerRequest* request, const String& etag);
+    uint32_t getNotModifiedCount() const;
+
 private:
     AsyncWebServer _server;
 
@@ -52,6 +66,7 @@ private:
     WebApiEventlogClass _webApiEventlog;
     WebApiFirmwareClass _webApiFirmware;
     WebApiGridProfileClass _webApiGridprofile;
+    WebApiHistoryClass _webApiHistory;
     WebApiInverterClass _webApiInverter;
     WebApiLimitClass _webApiLimit;
     WebApiMaintenanceClass _webApiMaintenance;
@@ -65,6 +80,8 @@ private:
     WebApiWebappClass _webApiWebapp;
     WebApiWsConsoleClass _webApiWsConsole;
     WebApiWsLiveClass _webApiWsLive;
+
+    uint32_t _notModifiedCount = 0;
 };
 
 extern WebApiClass WebApi;
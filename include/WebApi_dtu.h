@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "TaskProfiler.h"
 #include <ESPAsyncWebServer.h>
 #include <TaskSchedulerDeclarations.h>
 
@@ -12,7 +13,8 @@ public:
 private:
     void onDtuAdminGet(AsyncWebServerRequest* request);
     void onDtuAdminPost(AsyncWebServerRequest* request);
+    void onDtuRecorderGet(AsyncWebServerRequest* request);
 
-    Task _applyDataTask;
+    ProfiledTask _applyDataTask;
     void applyDataTaskCb();
 };
@@ -92,4 +92,14 @@ enum WebApiError {
 
     HardwareBase = 12000,
     HardwarePinMappingLength,
+
+    ConsoleBase = 13000,
+    ConsoleInvalidLogLevel,
+
+    TasksBase = 14000,
+    TasksResetTriggered,
+
+    HistoryBase = 15000,
+    HistoryInvalidInterval,
+    HistoryInvalidLimit,
 };
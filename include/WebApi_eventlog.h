@@ -2,12 +2,18 @@
 #pragma once
 
 #include <ESPAsyncWebServer.h>
+#include <Hoymiles.h>
 #include <TaskSchedulerDeclarations.h>
 
+#define EVENTLOG_HISTORY_PAGE_SIZE 50
+
 class WebApiEventlogClass {
 public:
     void init(AsyncWebServer& server, Scheduler& scheduler);
 
 private:
     void onEventlogStatus(AsyncWebServerRequest* request);
+    void onEventlogHistory(AsyncWebServerRequest* request);
+
+    static AlarmMessageLocale_t parseLocale(AsyncWebServerRequest* request);
 };
@@ -0,0 +1,16 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ESPAsyncWebServer.h>
+#include <TaskSchedulerDeclarations.h>
+
+// Buckets written per call of the response filler
+#define WEBAPI_HISTORY_BUCKETS_PER_FILL 60
+
+class WebApiHistoryClass {
+public:
+    void init(AsyncWebServer& server, Scheduler& scheduler);
+
+private:
+    void onPowerHistory(AsyncWebServerRequest* request);
+};
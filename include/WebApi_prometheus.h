@@ -1,10 +1,14 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "Configuration.h"
+#include "TaskProfiler.h"
 #include <ESPAsyncWebServer.h>
 #include <Hoymiles.h>
+#include <StreamString.h>
 #include <TaskSchedulerDeclarations.h>
 #include <map>
+#include <memory>
 
 class WebApiPrometheusClass {
 public:
@@ -13,9 +17,43 @@ public:
 private:
     void onPrometheusMetricsGet(AsyncWebServerRequest* request);
 
-    void addField(AsyncResponseStream* stream, const String& serial, const uint8_t idx, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId, const char* metricName, const char* channelName = nullptr);
+    void generateSystemMetrics(Print& stream);
+    void generateInverterMetrics(Print& stream, const uint8_t idx, std::shared_ptr<InverterAbstract> inv);
 
-    void addPanelInfo(AsyncResponseStream* stream, const String& serial, const uint8_t idx, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel);
+    void addField(Print& stream, const String& serial, const uint8_t idx, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId, const char* metricName, const char* channelName = nullptr);
+
+    void addHistogram(Print& stream, const char* metricName, const char* labelName, const char* labelValue, const TaskProfilerStats_t& stats);
+
+    void addPanelInfo(Print& stream, const String& serial, const uint8_t idx, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel);
+
+    // Everything the rendered metrics of an inverter depend on
+    struct inverter_version_t {
+        uint64_t serial;
+        uint32_t statsUpdate;
+        uint32_t statsUpdateInternal;
+        uint32_t limitUpdate;
+        float limitPercent;
+        uint32_t devInfoUpdate;
+        uint32_t configSaveCount;
+        bool operator==(const inverter_version_t& other) const
+        {
+            return serial == other.serial && statsUpdate == other.statsUpdate && statsUpdateInternal == other.statsUpdateInternal
+                && limitUpdate == other.limitUpdate && limitPercent == other.limitPercent && devInfoUpdate == other.devInfoUpdate
+                && configSaveCount == other.configSaveCount;
+        }
+    };
+
+    struct inverter_cache_t {
+        inverter_version_t version;
+        std::shared_ptr<const StreamString> metrics;
+    };
+
+    // Rendered metrics per inverter position. A response keeps references
+    // to the fragments it sends, so a fragment is replaced and never modified.
+    inverter_cache_t _inverterCache[INV_MAX_COUNT];
+
+    uint32_t _lastRenderTime = 0;
+    uint32_t _renderedInverters = 0;
 
     enum MetricType_t {
         NONE = 0,
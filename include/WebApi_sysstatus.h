@@ -10,4 +10,6 @@ public:
 
 private:
     void onSystemStatus(AsyncWebServerRequest* request);
+    void onSystemTasksGet(AsyncWebServerRequest* request);
+    void onSystemTasksPost(AsyncWebServerRequest* request);
 };
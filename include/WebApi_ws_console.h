@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "TaskProfiler.h"
 #include <ESPAsyncWebServer.h>
 #include <TaskSchedulerDeclarations.h>
 
@@ -10,8 +11,11 @@ public:
     void init(AsyncWebServer& server, Scheduler& scheduler);
 
 private:
+    void onConsoleAdminGet(AsyncWebServerRequest* request);
+    void onConsoleAdminPost(AsyncWebServerRequest* request);
+
     AsyncWebSocket _ws;
 
-    Task _wsCleanupTask;
+    ProfiledTask _wsCleanupTask;
     void wsCleanupTaskCb();
 };
@@ -2,36 +2,115 @@
 #pragma once
 
 #include "Configuration.h"
+#include "TaskProfiler.h"
 #include <ArduinoJson.h>
 #include <ESPAsyncWebServer.h>
 #include <Hoymiles.h>
 #include <TaskSchedulerDeclarations.h>
+#include <functional>
+#include <list>
+#include <map>
+#include <vector>
+
+enum class WsLiveFormat : uint8_t {
+    Json = 0, // complete inverter data on every update
+    Delta, // changed values since the acknowledged state
+    Binary, // schema once, then packed fixed point frames
+};
+#define WS_LIVE_FORMAT_COUNT 3
+
+struct WsLiveFormatStats_t {
+    uint32_t Frames;
+    uint32_t Bytes;
+    uint32_t BuildTime; // us spent to generate and serialize the frames
+};
 
 class WebApiWsLiveClass {
 public:
     WebApiWsLiveClass();
     void init(AsyncWebServer& server, Scheduler& scheduler);
 
+    WsLiveFormatStats_t getStats(const WsLiveFormat format);
+
 private:
     static void generateInverterCommonJsonResponse(JsonObject& root, std::shared_ptr<InverterAbstract> inv);
     static void generateInverterChannelJsonResponse(JsonObject& root, std::shared_ptr<InverterAbstract> inv);
     static void generateCommonJsonResponse(JsonVariant& root);
+    static uint8_t getHints();
 
     static void addField(JsonObject& root, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId, String topic = "");
     static void addTotalField(JsonObject& root, const String& name, const float value, const String& unit, const uint8_t digits);
 
     void onLivedataStatus(AsyncWebServerRequest* request);
+    static String getLivedataETag(const uint64_t serial);
     void onWebsocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len);
+    void onWebsocketData(AsyncWebSocketClient* client, const uint8_t* data, const size_t len);
+
+    // Hash of a single value (or value object) identified by the hash of its path
+    struct unit_hash_t {
+        uint32_t path;
+        uint32_t value;
+        bool operator==(const unit_hash_t& other) const { return path == other.path && value == other.value; }
+    };
+    using unit_hashes_t = std::vector<unit_hash_t>;
+
+    // States per inverter serial, serial 0 holds total and hints
+    using client_states_t = std::map<uint64_t, unit_hashes_t>;
+
+    // Acknowledged state followed by all sent but unacknowledged states of one serial
+    using known_states_t = std::vector<const unit_hashes_t*>;
+
+    struct pending_state_t {
+        uint32_t seq;
+        client_states_t states;
+    };
+
+    struct client_state_t {
+        uint32_t id;
+        WsLiveFormat format = WsLiveFormat::Json;
+        std::vector<uint64_t> serials; // subscribed inverters, empty means all
+        std::map<uint64_t, uint32_t> schemas; // schema ids sent to a binary client
+        uint32_t seq = 0;
+        client_states_t acked; // state acknowledged by the client
+        std::list<pending_state_t> pending; // sent but not yet acknowledged
+        JsonDocument message; // message built during the current send cycle
+        client_states_t building;
+    };
+
+    static void collectUnits(JsonObjectConst src, const uint32_t path, const uint8_t descend, unit_hashes_t& units);
+    static bool addChangedUnits(JsonObject dst, JsonObjectConst src, const uint32_t path, const uint8_t descend, const unit_hashes_t& current, const known_states_t& known);
+    static const unit_hash_t* findUnit(const unit_hashes_t& units, const uint32_t path);
+    static uint32_t getPathHash(const uint32_t parent, const char* key);
+
+    static bool isSubscribed(const client_state_t& client, const uint64_t serial);
+    static const unit_hashes_t* getAcked(const client_state_t& client, const uint64_t serial);
+    static known_states_t getKnown(const client_state_t& client, const uint64_t serial);
+    static bool isKnown(const known_states_t& known, const unit_hashes_t& units);
+    static void acknowledge(client_state_t& client, const uint32_t seq);
+
+    static void forEachLiveField(std::shared_ptr<InverterAbstract> inv, std::function<void(ChannelType_t, ChannelNum_t, FieldId_t, const char*)> cb);
+    static uint32_t getSchemaId(std::shared_ptr<InverterAbstract> inv);
+    static String generateSchema(std::shared_ptr<InverterAbstract> inv, const uint32_t schemaId);
+    static std::vector<uint8_t> generateInverterFrame(std::shared_ptr<InverterAbstract> inv, const uint32_t schemaId);
+    static std::vector<uint8_t> generateTotalFrame();
+
+    void sendLegacy(const String& buffer, const bool hasOtherClients);
+    void sendDelta(client_state_t& client);
+    void account(const WsLiveFormat format, const size_t bytes, const uint32_t start);
 
     AsyncWebSocket _ws;
 
+    std::list<client_state_t> _clients;
+
+    WsLiveFormatStats_t _stats[WS_LIVE_FORMAT_COUNT] = {};
+
     uint32_t _lastPublishStats[INV_MAX_COUNT] = { 0 };
 
     std::mutex _mutex;
 
-    Task _wsCleanupTask;
+    ProfiledTask _wsCleanupTask;
     void wsCleanupTaskCb();
 
-    Task _sendDataTask;
+    ProfiledTask _sendDataTask;
     void sendDataTaskCb();
 };
@@ -0,0 +1,234 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2024 Thomas Basler and others
+ */
+#include "GzipEncoder.h"
+#include <string.h>
+
+#define GZIP_MIN_MATCH 3
+#define GZIP_MAX_MATCH 258
+
+// RFC 1951 3.2.5
+static const uint16_t lengthBase[] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t lengthExtra[] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t distanceBase[] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145 };
+static const uint8_t distanceExtra[] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11 };
+
+static const uint32_t crcTable[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+GzipEncoder::GzipEncoder(Print& output)
+    : _output(output)
+{
+    // ID1, ID2, CM = deflate, FLG, MTIME, XFL, OS = unknown
+    static const uint8_t header[] = { 0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff };
+    for (auto byte : header) {
+        putByte(byte);
+    }
+
+    // BFINAL = 1, BTYPE = 01 (fixed Huffman codes)
+    putBits(1, 1);
+    putBits(1, 2);
+}
+
+size_t GzipEncoder::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t GzipEncoder::write(const uint8_t* buffer, size_t size)
+{
+    if (_finished) {
+        return 0;
+    }
+
+    _crc = updateCrc(_crc, buffer, size);
+    _inputSize += size;
+
+    size_t written = 0;
+    while (written < size) {
+        const size_t chunk = size - written < sizeof(_buffer) - _fill ? size - written : sizeof(_buffer) - _fill;
+        memcpy(_buffer + _fill, buffer + written, chunk);
+        _fill += chunk;
+        written += chunk;
+
+        if (_fill == sizeof(_buffer)) {
+            compress(false);
+            slide();
+        }
+    }
+
+    return size;
+}
+
+void GzipEncoder::finish()
+{
+    if (_finished) {
+        return;
+    }
+    _finished = true;
+
+    compress(true);
+
+    // End of block
+    putHuffman(0, 7);
+    if (_bitCount > 0) {
+        putByte(_bitBuffer & 0xff);
+        _bitBuffer = 0;
+        _bitCount = 0;
+    }
+
+    const uint32_t crc = ~_crc;
+    for (uint8_t i = 0; i < 4; i++) {
+        putByte((crc >> (i * 8)) & 0xff);
+    }
+    for (uint8_t i = 0; i < 4; i++) {
+        putByte((_inputSize >> (i * 8)) & 0xff);
+    }
+}
+
+uint32_t GzipEncoder::getInputSize() const
+{
+    return _inputSize;
+}
+
+uint32_t GzipEncoder::getOutputSize() const
+{
+    return _outputSize;
+}
+
+/*
+ * Encodes the buffered data. Unless flush is set, the last GZIP_MAX_MATCH
+ * bytes are kept so that a match is never cut off by the end of the buffer.
+ */
+void GzipEncoder::compress(const bool flush)
+{
+    const uint16_t end = flush ? _fill : _fill - GZIP_MAX_MATCH;
+
+    while (_pos < end) {
+        if (_fill - _pos < GZIP_MIN_MATCH) {
+            putLiteral(_buffer[_pos++]);
+            continue;
+        }
+
+        const uint16_t hash = getHash(&_buffer[_pos]);
+        const uint16_t candidate = _head[hash];
+        _head[hash] = _pos + 1;
+
+        uint16_t length = 0;
+        if (candidate > 0) {
+            const uint16_t match = candidate - 1;
+            const uint16_t maxLength = _fill - _pos < GZIP_MAX_MATCH ? _fill - _pos : GZIP_MAX_MATCH;
+            while (length < maxLength && _buffer[match + length] == _buffer[_pos + length]) {
+                length++;
+            }
+        }
+
+        if (length < GZIP_MIN_MATCH) {
+            putLiteral(_buffer[_pos++]);
+            continue;
+        }
+
+        putMatch(length, _pos - (candidate - 1));
+
+        // Make the skipped positions available for later matches
+        const uint16_t matchEnd = _pos + length;
+        for (_pos++; _pos < matchEnd; _pos++) {
+            if (_fill - _pos >= GZIP_MIN_MATCH) {
+                _head[getHash(&_buffer[_pos])] = _pos + 1;
+            }
+        }
+    }
+}
+
+/* Drops the older half of the buffer, the newer half stays as history */
+void GzipEncoder::slide()
+{
+    memmove(_buffer, _buffer + GZIP_WINDOW_SIZE, GZIP_WINDOW_SIZE);
+    _fill -= GZIP_WINDOW_SIZE;
+    _pos -= GZIP_WINDOW_SIZE;
+
+    for (auto& head : _head) {
+        head = head > GZIP_WINDOW_SIZE ? head - GZIP_WINDOW_SIZE : 0;
+    }
+}
+
+/* Deflate packs data elements starting with the least significant bit */
+void GzipEncoder::putBits(uint32_t value, const uint8_t count)
+{
+    _bitBuffer |= value << _bitCount;
+    _bitCount += count;
+    while (_bitCount >= 8) {
+        putByte(_bitBuffer & 0xff);
+        _bitBuffer >>= 8;
+        _bitCount -= 8;
+    }
+}
+
+/* Huffman codes are packed starting with the most significant bit */
+void GzipEncoder::putHuffman(const uint16_t code, const uint8_t count)
+{
+    uint16_t reversed = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        reversed |= ((code >> i) & 1) << (count - 1 - i);
+    }
+    putBits(reversed, count);
+}
+
+// RFC 1951 3.2.6
+void GzipEncoder::putLiteral(const uint8_t literal)
+{
+    if (literal < 144) {
+        putHuffman(0x30 + literal, 8);
+    } else {
+        putHuffman(0x190 + literal - 144, 9);
+    }
+}
+
+void GzipEncoder::putMatch(const uint16_t length, const uint16_t distance)
+{
+    uint8_t code = sizeof(lengthBase) / sizeof(lengthBase[0]) - 1;
+    while (lengthBase[code] > length) {
+        code--;
+    }
+
+    const uint16_t symbol = 257 + code;
+    if (symbol < 280) {
+        putHuffman(symbol - 256, 7);
+    } else {
+        putHuffman(0xc0 + symbol - 280, 8);
+    }
+    putBits(length - lengthBase[code], lengthExtra[code]);
+
+    code = sizeof(distanceBase) / sizeof(distanceBase[0]) - 1;
+    while (distanceBase[code] > distance) {
+        code--;
+    }
+    putHuffman(code, 5);
+    putBits(distance - distanceBase[code], distanceExtra[code]);
+}
+
+void GzipEncoder::putByte(const uint8_t byte)
+{
+    _output.write(byte);
+    _outputSize++;
+}
+
+uint32_t GzipEncoder::updateCrc(uint32_t crc, const uint8_t* data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        crc = (crc >> 4) ^ crcTable[crc & 0x0f];
+        crc = (crc >> 4) ^ crcTable[crc & 0x0f];
+    }
+    return crc;
+}
+
+// Multiplicative hash of the next 3 bytes, the top bits depend on all of them
+uint16_t GzipEncoder::getHash(const uint8_t* data)
+{
+    const uint32_t bytes = (static_cast<uint32_t>(data[0]) << 16) | (static_cast<uint32_t>(data[1]) << 8) | data[2];
+    return (bytes * 2654435761u) >> (32 - GZIP_HASH_BITS);
+}
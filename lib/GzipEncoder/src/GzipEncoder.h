@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <Print.h>
+#include <stdint.h>
+
+// Matches are searched within the last 2 * GZIP_WINDOW_SIZE bytes
+#define GZIP_WINDOW_SIZE 2048
+#define GZIP_HASH_BITS 10
+
+// Streaming gzip encoder. Everything written to it is compressed into a
+// single deflate block with the fixed Huffman codes and a small LZ77 window.
+// The working memory (about 6 KB) does not depend on the amount of data, so
+// the object should be allocated on the heap and not on a task stack.
+class GzipEncoder : public Print {
+public:
+    explicit GzipEncoder(Print& output);
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+
+    // Encodes the remaining data and writes the gzip trailer
+    void finish();
+
+    uint32_t getInputSize() const;
+    uint32_t getOutputSize() const;
+
+private:
+    void compress(const bool flush);
+    void slide();
+
+    void putBits(uint32_t value, const uint8_t count);
+    void putHuffman(const uint16_t code, const uint8_t count);
+    void putLiteral(const uint8_t literal);
+    void putMatch(const uint16_t length, const uint16_t distance);
+    void putByte(const uint8_t byte);
+
+    static uint32_t updateCrc(uint32_t crc, const uint8_t* data, size_t len);
+    static uint16_t getHash(const uint8_t* data);
+
+    Print& _output;
+
+    uint8_t _buffer[2 * GZIP_WINDOW_SIZE];
+    uint16_t _fill = 0; // bytes in _buffer
+    uint16_t _pos = 0; // next byte to encode
+
+    // Position + 1 of the last occurrence per hash, 0 means none
+    uint16_t _head[1 << GZIP_HASH_BITS] = {};
+
+    uint32_t _bitBuffer = 0;
+    uint8_t _bitCount = 0;
+
+    uint32_t _crc = 0xffffffff;
+    uint32_t _inputSize = 0;
+    uint32_t _outputSize = 0;
+    bool _finished = false;
+};
@@ -0,0 +1,275 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2024 Thomas Basler and others
+ */
+#include "HeapAccounting.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef ESP_PLATFORM
+#include <esp_heap_caps.h>
+#include <freertos/task.h>
+#endif
+
+static_assert(HEAP_TAG_COUNT <= 8, "The tag is stored in 3 bits");
+static_assert((HEAP_ACCOUNTING_SLOTS & (HEAP_ACCOUNTING_SLOTS - 1)) == 0, "HEAP_ACCOUNTING_SLOTS has to be a power of 2");
+
+// Linear probing gets slow if the table is almost full
+#define HEAP_ACCOUNTING_MAX_USED (HEAP_ACCOUNTING_SLOTS / 4 * 3)
+
+static const char* const tagNames[HEAP_TAG_COUNT] = { "none", "radio", "parser", "mqtt", "webapi", "websocket", "hass", "display" };
+
+// Tag of the current task, -1 until the default of the task was looked up
+static thread_local int8_t currentTag = -1;
+
+HeapAccountingClass HeapAccounting;
+
+static uint32_t slotIndex(const uintptr_t ptr)
+{
+    return (static_cast<uint32_t>(ptr >> 3) * 2654435761u) & (HEAP_ACCOUNTING_SLOTS - 1);
+}
+
+bool HeapAccountingClass::init()
+{
+#ifdef HEAP_ACCOUNTING
+    if (_slots != nullptr) {
+        return true;
+    }
+
+#ifdef ESP_PLATFORM
+    // Not routed through the wrappers
+    Slot_t* slots = static_cast<Slot_t*>(heap_caps_calloc(HEAP_ACCOUNTING_SLOTS, sizeof(Slot_t), MALLOC_CAP_SPIRAM));
+    if (slots == nullptr) {
+        slots = static_cast<Slot_t*>(heap_caps_calloc(HEAP_ACCOUNTING_SLOTS, sizeof(Slot_t), MALLOC_CAP_8BIT));
+    }
+#else
+    // Passes the wrapper but is not tracked as the table does not exist yet
+    Slot_t* slots = static_cast<Slot_t*>(calloc(HEAP_ACCOUNTING_SLOTS, sizeof(Slot_t)));
+#endif
+
+    _slots = slots;
+    return _slots != nullptr;
+#else
+    return false;
+#endif
+}
+
+bool HeapAccountingClass::isEnabled() const
+{
+    return _slots != nullptr;
+}
+
+void HeapAccountingClass::setTaskDefault(const char* taskName, const HeapTag tag)
+{
+    for (auto& taskDefault : _taskDefaults) {
+        if (taskDefault.Name == nullptr || strcmp(taskDefault.Name, taskName) == 0) {
+            taskDefault.Name = taskName;
+            taskDefault.Tag = tag;
+            return;
+        }
+    }
+}
+
+HeapTag HeapAccountingClass::getCurrentTag()
+{
+    if (currentTag < 0) {
+        currentTag = static_cast<int8_t>(HeapTag::None);
+#ifdef ESP_PLATFORM
+        const char* taskName = pcTaskGetName(nullptr);
+        for (auto& taskDefault : _taskDefaults) {
+            if (taskDefault.Name != nullptr && strcmp(taskDefault.Name, taskName) == 0) {
+                currentTag = static_cast<int8_t>(taskDefault.Tag);
+            }
+        }
+#endif
+    }
+    return static_cast<HeapTag>(currentTag);
+}
+
+void HeapAccountingClass::setCurrentTag(const HeapTag tag)
+{
+    currentTag = static_cast<int8_t>(tag);
+}
+
+void HeapAccountingClass::onAlloc(const void* ptr, const size_t size)
+{
+    if (_slots == nullptr || ptr == nullptr) {
+        return;
+    }
+
+    const HeapTag tag = getCurrentTag();
+    if (tag == HeapTag::None) {
+        return;
+    }
+
+    lock();
+
+    // The address is still known if the previous block was released without
+    // passing the wrappers
+    size_t oldSize;
+    HeapTag oldTag;
+    if (remove(reinterpret_cast<uintptr_t>(ptr), oldSize, oldTag)) {
+        _stats[static_cast<uint8_t>(oldTag)].Frees++;
+        _stats[static_cast<uint8_t>(oldTag)].LiveBytes -= oldSize;
+    }
+
+    if (_used < HEAP_ACCOUNTING_MAX_USED) {
+        insert(reinterpret_cast<uintptr_t>(ptr), size, tag);
+
+        HeapTagStats_t& stats = _stats[static_cast<uint8_t>(tag)];
+        stats.Allocations++;
+        stats.LiveBytes += size;
+        stats.PeakBytes = std::max(stats.PeakBytes, stats.LiveBytes);
+    } else {
+        _untracked++;
+    }
+
+    unlock();
+}
+
+void HeapAccountingClass::onFree(const void* ptr)
+{
+    if (_slots == nullptr || ptr == nullptr || _used == 0) {
+        return;
+    }
+
+    lock();
+
+    size_t size;
+    HeapTag tag;
+    if (remove(reinterpret_cast<uintptr_t>(ptr), size, tag)) {
+        _stats[static_cast<uint8_t>(tag)].Frees++;
+        _stats[static_cast<uint8_t>(tag)].LiveBytes -= size;
+    }
+
+    unlock();
+}
+
+void HeapAccountingClass::onRealloc(const void* oldPtr, const void* newPtr, const size_t size)
+{
+    if (oldPtr == nullptr) {
+        onAlloc(newPtr, size);
+        return;
+    }
+
+    if (newPtr == nullptr) {
+        // realloc(ptr, 0) released the block, otherwise the old block is still valid
+        if (size == 0) {
+            onFree(oldPtr);
+        }
+        return;
+    }
+
+    if (_slots == nullptr) {
+        return;
+    }
+
+    // A block keeps the tag it was allocated with
+    lock();
+    size_t oldSize;
+    HeapTag tag;
+    const bool found = remove(reinterpret_cast<uintptr_t>(oldPtr), oldSize, tag);
+    if (found) {
+        insert(reinterpret_cast<uintptr_t>(newPtr), size, tag);
+
+        HeapTagStats_t& stats = _stats[static_cast<uint8_t>(tag)];
+        stats.LiveBytes = stats.LiveBytes - oldSize + size;
+        stats.PeakBytes = std::max(stats.PeakBytes, stats.LiveBytes);
+    }
+    unlock();
+
+    if (!found) {
+        onAlloc(newPtr, size);
+    }
+}
+
+HeapTagStats_t HeapAccountingClass::getStats(const HeapTag tag) const
+{
+    lock();
+    const HeapTagStats_t stats = _stats[static_cast<uint8_t>(tag)];
+    unlock();
+    return stats;
+}
+
+uint32_t HeapAccountingClass::getUntracked() const
+{
+    return _untracked;
+}
+
+const char* HeapAccountingClass::getTagName(const HeapTag tag)
+{
+    return tagNames[static_cast<uint8_t>(tag)];
+}
+
+uint32_t HeapAccountingClass::findSlot(const uintptr_t ptr) const
+{
+    uint32_t i = slotIndex(ptr);
+    while (_slots[i].Ptr != 0) {
+        if (_slots[i].Ptr == ptr) {
+            return i;
+        }
+        i = (i + 1) & (HEAP_ACCOUNTING_SLOTS - 1);
+    }
+    return HEAP_ACCOUNTING_SLOTS;
+}
+
+void HeapAccountingClass::insert(const uintptr_t ptr, const size_t size, const HeapTag tag)
+{
+    uint32_t i = slotIndex(ptr);
+    while (_slots[i].Ptr != 0) {
+        i = (i + 1) & (HEAP_ACCOUNTING_SLOTS - 1);
+    }
+    _slots[i].Ptr = ptr;
+    _slots[i].SizeTag = static_cast<uint32_t>(size) << 3 | static_cast<uint8_t>(tag);
+    _used++;
+}
+
+bool HeapAccountingClass::remove(const uintptr_t ptr, size_t& size, HeapTag& tag)
+{
+    uint32_t i = findSlot(ptr);
+    if (i == HEAP_ACCOUNTING_SLOTS) {
+        return false;
+    }
+
+    size = _slots[i].SizeTag >> 3;
+    tag = static_cast<HeapTag>(_slots[i].SizeTag & 0x07);
+
+    // Move following entries of the probe sequence into the gap, an entry
+    // can move if its home slot is not between the gap and its position
+    uint32_t j = i;
+    while (true) {
+        j = (j + 1) & (HEAP_ACCOUNTING_SLOTS - 1);
+        if (_slots[j].Ptr == 0) {
+            break;
+        }
+        const uint32_t home = slotIndex(_slots[j].Ptr);
+        const bool keep = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+        if (!keep) {
+            _slots[i] = _slots[j];
+            i = j;
+        }
+    }
+
+    _slots[i].Ptr = 0;
+    _used--;
+    return true;
+}
+
+void HeapAccountingClass::lock() const
+{
+#ifdef ESP_PLATFORM
+    portENTER_CRITICAL(&_lock);
+#else
+    _lock.lock();
+#endif
+}
+
+void HeapAccountingClass::unlock() const
+{
+#ifdef ESP_PLATFORM
+    portEXIT_CRITICAL(&_lock);
+#else
+    _lock.unlock();
+#endif
+}
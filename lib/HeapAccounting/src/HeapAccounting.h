@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef ESP_PLATFORM
+#include <freertos/FreeRTOS.h>
+#else
+#include <mutex>
+#endif
+
+enum class HeapTag : uint8_t {
+    None = 0, // not tracked
+    Radio,
+    Parser,
+    Mqtt,
+    WebApi,
+    Websocket,
+    Hass,
+    Display,
+};
+#define HEAP_TAG_COUNT 8
+
+// Number of allocations which can be tracked at the same time, power of 2
+#ifndef HEAP_ACCOUNTING_SLOTS
+#define HEAP_ACCOUNTING_SLOTS 4096
+#endif
+
+// Tasks which get a default tag
+#define HEAP_ACCOUNTING_TASK_DEFAULTS 4
+
+struct HeapTagStats_t {
+    uint32_t Allocations;
+    uint32_t Frees;
+    uint32_t LiveBytes;
+    uint32_t PeakBytes;
+};
+
+class HeapAccountingClass {
+public:
+    // Allocates the slot table. Returns false if the accounting was not
+    // compiled in (HEAP_ACCOUNTING) or the table could not be allocated.
+    bool init();
+    bool isEnabled() const;
+
+    // Code running in a task with this name is accounted to the tag unless
+    // a scope selects another one. Has to be called before the task starts.
+    void setTaskDefault(const char* taskName, const HeapTag tag);
+
+    HeapTag getCurrentTag();
+    void setCurrentTag(const HeapTag tag);
+
+    // Called by the allocator wrappers
+    void onAlloc(const void* ptr, const size_t size);
+    void onFree(const void* ptr);
+    void onRealloc(const void* oldPtr, const void* newPtr, const size_t size);
+
+    HeapTagStats_t getStats(const HeapTag tag) const;
+
+    // Allocations which were not tracked because the slot table was full
+    uint32_t getUntracked() const;
+
+    static const char* getTagName(const HeapTag tag);
+
+private:
+    struct Slot_t {
+        uintptr_t Ptr; // 0 if the slot is free
+        uint32_t SizeTag; // size << 3 | tag
+    };
+
+    uint32_t findSlot(const uintptr_t ptr) const;
+    void insert(const uintptr_t ptr, const size_t size, const HeapTag tag);
+    bool remove(const uintptr_t ptr, size_t& size, HeapTag& tag);
+
+    void lock() const;
+    void unlock() const;
+
+    Slot_t* _slots = nullptr;
+    uint32_t _used = 0;
+    uint32_t _untracked = 0;
+    HeapTagStats_t _stats[HEAP_TAG_COUNT] = {};
+
+    struct TaskDefault_t {
+        const char* Name;
+        HeapTag Tag;
+    };
+    TaskDefault_t _taskDefaults[HEAP_ACCOUNTING_TASK_DEFAULTS] = {};
+
+#ifdef ESP_PLATFORM
+    mutable portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+#else
+    mutable std::mutex _lock;
+#endif
+};
+
+extern HeapAccountingClass HeapAccounting;
+
+/*
+ * Accounts all allocations of the current task to the tag until the scope
+ * is left. Costs nothing if the accounting is not compiled in.
+ */
+class HeapTagScope {
+public:
+#ifdef HEAP_ACCOUNTING
+    explicit HeapTagScope(const HeapTag tag)
+        : _previous(HeapAccounting.getCurrentTag())
+    {
+        HeapAccounting.setCurrentTag(tag);
+    }
+
+    ~HeapTagScope()
+    {
+        HeapAccounting.setCurrentTag(_previous);
+    }
+
+private:
+    const HeapTag _previous;
+#else
+    explicit HeapTagScope(const HeapTag)
+    {
+    }
+#endif
+
+    HeapTagScope(const HeapTagScope&) = delete;
+    HeapTagScope& operator=(const HeapTagScope&) = delete;
+};
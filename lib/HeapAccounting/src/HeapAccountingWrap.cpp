@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2024 Thomas Basler and others
+ */
+#include "HeapAccounting.h"
+#include <cstdlib>
+
+// The native tests call the accounting directly and are linked without
+// the wrap flags
+#if defined(HEAP_ACCOUNTING) && defined(ESP_PLATFORM)
+
+// Requires -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+
+void* __wrap_malloc(size_t size)
+{
+    void* ptr = __real_malloc(size);
+    HeapAccounting.onAlloc(ptr, size);
+    return ptr;
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+    void* ptr = __real_calloc(count, size);
+    HeapAccounting.onAlloc(ptr, count * size);
+    return ptr;
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+    // Another task might get the old address between the two calls, its
+    // allocation is then accounted as the moved block. This is rare and
+    // only affects the attribution.
+    void* newPtr = __real_realloc(ptr, size);
+    HeapAccounting.onRealloc(ptr, newPtr, size);
+    return newPtr;
+}
+
+void __wrap_free(void* ptr)
+{
+    // Accounted first, the address may be reused as soon as it is released
+    HeapAccounting.onFree(ptr);
+    __real_free(ptr);
+}
+}
+
+#endif
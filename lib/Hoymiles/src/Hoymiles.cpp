@@ -16,14 +16,67 @@
 #include "inverters/HM_2CH.h"
 #include "inverters/HM_4CH.h"
 #include <Arduino.h>
+#include <HeapAccounting.h>
+#include <WallClock.h>
+#include <algorithm>
+#include <frozen/unordered_map.h>
 
 HoymilesClass Hoymiles;
 
+typedef std::shared_ptr<InverterAbstract> (*createInverter_t)(HoymilesRadio_NRF* radioNrf, HoymilesRadio_CMT* radioCmt, const uint64_t serial);
+
+template <typename T>
+std::shared_ptr<InverterAbstract> createNrfInverter(HoymilesRadio_NRF* radioNrf, HoymilesRadio_CMT*, const uint64_t serial)
+{
+    return std::make_shared<T>(radioNrf, serial);
+}
+
+template <typename T>
+std::shared_ptr<InverterAbstract> createCmtInverter(HoymilesRadio_NRF*, HoymilesRadio_CMT* radioCmt, const uint64_t serial)
+{
+    return std::make_shared<T>(radioCmt, serial);
+}
+
+/*
+ * Inverter types by the first two bytes of the serial. Has to match the
+ * isValidSerial() checks of the inverter classes, the older HM series
+ * serials are only identified by the middle nibbles (see below).
+ */
+constexpr std::array<std::pair<uint16_t, createInverter_t>, 12> inverterTypeKeys = { {
+    { 0x1361, createCmtInverter<HMT_4CH> },
+    { 0x1382, createCmtInverter<HMT_6CH> },
+    { 0x1164, createCmtInverter<HMS_4CH> },
+    { 0x1144, createCmtInverter<HMS_2CH> },
+    { 0x1143, createCmtInverter<HMS_2CH> },
+    { 0x1124, createCmtInverter<HMS_1CH> },
+    { 0x1125, createCmtInverter<HMS_1CHv2> },
+    { 0x1062, createNrfInverter<HM_4CH> },
+    { 0x1042, createNrfInverter<HM_2CH> },
+    { 0x1022, createNrfInverter<HM_1CH> },
+    { 0x2821, createNrfInverter<HERF_2CH> },
+    { 0x2801, createNrfInverter<HERF_4CH> },
+} };
+static_assert(Utils::hasUniqueKeys(inverterTypeKeys), "Serial prefix defined twice");
+
+// Bits 4 to 11 of the first two bytes, only used if there is no exact match
+constexpr std::array<std::pair<uint8_t, createInverter_t>, 3> inverterTypeNibbleKeys = { {
+    { 0x16, createNrfInverter<HM_4CH> },
+    { 0x14, createNrfInverter<HM_2CH> },
+    { 0x12, createNrfInverter<HM_1CH> },
+} };
+static_assert(Utils::hasUniqueKeys(inverterTypeNibbleKeys), "Serial prefix defined twice");
+
+constexpr auto inverterTypes = frozen::make_unordered_map(inverterTypeKeys);
+constexpr auto inverterTypesNibble = frozen::make_unordered_map(inverterTypeNibbleKeys);
+
 void HoymilesClass::init()
 {
     _pollInterval = 0;
     _radioNrf.reset(new HoymilesRadio_NRF());
     _radioCmt.reset(new HoymilesRadio_CMT());
+
+    WallClock.onEvent([this](wall_clock_event) { _dayChanged = true; }, wall_clock_event::WALL_CLOCK_DAY_CHANGED);
+    WallClock.onEvent([](wall_clock_event) { AlarmLogParser::resetTimezoneOffset(); }, wall_clock_event::WALL_CLOCK_SYNCED);
 }
 
 void HoymilesClass::initNRF(SPIClass* initialisedSpiBus, const uint8_t pinCE, const uint8_t pinIRQ)
@@ -38,20 +91,20 @@ void HoymilesClass::initCMT(const int8_t pin_sdio, const int8_t pin_clk, const i
 
 void HoymilesClass::loop()
 {
-    std::lock_guard<std::mutex> lock(_mutex);
     _radioNrf->loop();
     _radioCmt->loop();
 
-    if (getNumInverters() == 0) {
+    const InverterListPtr inverters = getInverters();
+    if (inverters->empty()) {
         return;
     }
 
     if (millis() - _lastPoll > (_pollInterval * 1000)) {
         static uint8_t inverterPos = 0;
 
-        std::shared_ptr<InverterAbstract> iv = getInverterByPos(inverterPos);
+        std::shared_ptr<InverterAbstract> iv = inverterPos < inverters->size() ? (*inverters)[inverterPos] : nullptr;
         if ((iv == nullptr) || ((iv != nullptr) && (!iv->getRadio()->isInitialized()))) {
-            if (++inverterPos >= getNumInverters()) {
+            if (++inverterPos >= inverters->size()) {
                 inverterPos = 0;
             }
         }
@@ -121,32 +174,23 @@ void HoymilesClass::loop()
                 _lastPoll = millis();
             }
 
-            if (++inverterPos >= getNumInverters()) {
+            if (++inverterPos >= inverters->size()) {
                 inverterPos = 0;
             }
         }
 
         // Perform housekeeping of all inverters on day change
-        const int8_t currentWeekDay = Utils::getWeekDay();
-        static int8_t lastWeekDay = -1;
-        if (lastWeekDay == -1) {
-            lastWeekDay = currentWeekDay;
-        } else {
-            if (currentWeekDay != lastWeekDay) {
-
-                for (auto& inv : _inverters) {
-                    // Have to reset the offets first, otherwise it will
-                    // Substract the offset from zero which leads to a high value
-                    inv->Statistics()->resetYieldDayCorrection();
-                    if (inv->getZeroYieldDayOnMidnight()) {
-                        inv->Statistics()->zeroDailyData();
-                    }
-                    if (inv->getClearEventlogOnMidnight()) {
-                        inv->EventLog()->clearBuffer();
-                    }
+        if (_dayChanged.exchange(false)) {
+            for (auto& inv : *inverters) {
+                // Have to reset the offets first, otherwise it will
+                // Substract the offset from zero which leads to a high value
+                inv->Statistics()->resetYieldDayCorrection();
+                if (inv->getZeroYieldDayOnMidnight()) {
+                    inv->Statistics()->zeroDailyData();
+                }
+                if (inv->getClearEventlogOnMidnight()) {
+                    inv->EventLog()->clearBuffer();
                 }
-
-                lastWeekDay = currentWeekDay;
             }
         }
     }
@@ -154,36 +198,35 @@ void HoymilesClass::loop()
 
 std::shared_ptr<InverterAbstract> HoymilesClass::addInverter(const char* name, const uint64_t serial)
 {
+    HeapTagScope heapTag(HeapTag::Parser);
+
+    const uint16_t preSerial = (serial >> 32) & 0xffff;
+
+    createInverter_t createInverter = nullptr;
+    auto it = inverterTypes.find(preSerial);
+    if (it != inverterTypes.end()) {
+        createInverter = it->second;
+    } else {
+        auto nibble = inverterTypesNibble.find(static_cast<uint8_t>(preSerial >> 4));
+        if (nibble != inverterTypesNibble.end()) {
+            createInverter = nibble->second;
+        }
+    }
+
     std::shared_ptr<InverterAbstract> i = nullptr;
-    if (HMT_4CH::isValidSerial(serial)) {
-        i = std::make_shared<HMT_4CH>(_radioCmt.get(), serial);
-    } else if (HMT_6CH::isValidSerial(serial)) {
-        i = std::make_shared<HMT_6CH>(_radioCmt.get(), serial);
-    } else if (HMS_4CH::isValidSerial(serial)) {
-        i = std::make_shared<HMS_4CH>(_radioCmt.get(), serial);
-    } else if (HMS_2CH::isValidSerial(serial)) {
-        i = std::make_shared<HMS_2CH>(_radioCmt.get(), serial);
-    } else if (HMS_1CH::isValidSerial(serial)) {
-        i = std::make_shared<HMS_1CH>(_radioCmt.get(), serial);
-    } else if (HMS_1CHv2::isValidSerial(serial)) {
-        i = std::make_shared<HMS_1CHv2>(_radioCmt.get(), serial);
-    } else if (HM_4CH::isValidSerial(serial)) {
-        i = std::make_shared<HM_4CH>(_radioNrf.get(), serial);
-    } else if (HM_2CH::isValidSerial(serial)) {
-        i = std::make_shared<HM_2CH>(_radioNrf.get(), serial);
-    } else if (HM_1CH::isValidSerial(serial)) {
-        i = std::make_shared<HM_1CH>(_radioNrf.get(), serial);
-    } else if (HERF_2CH::isValidSerial(serial)) {
-        i = std::make_shared<HERF_2CH>(_radioNrf.get(), serial);
-    } else if (HERF_4CH::isValidSerial(serial)) {
-        i = std::make_shared<HERF_4CH>(_radioNrf.get(), serial);
+    if (createInverter != nullptr) {
+        i = createInverter(_radioNrf.get(), _radioCmt.get(), serial);
     }
 
     if (i) {
         i->setName(name);
         i->init();
-        _inverters.push_back(std::move(i));
-        return _inverters.back();
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto inverters = std::make_shared<InverterList>(*_inverters);
+        inverters->push_back(i);
+        std::atomic_store(&_inverters, InverterListPtr(std::move(inverters)));
+        return i;
     }
 
     return nullptr;
@@ -191,18 +234,20 @@ std::shared_ptr<InverterAbstract> HoymilesClass::addInverter(const char* name, c
 
 std::shared_ptr<InverterAbstract> HoymilesClass::getInverterByPos(const uint8_t pos)
 {
-    if (pos >= _inverters.size()) {
+    const InverterListPtr inverters = getInverters();
+    if (pos >= inverters->size()) {
         return nullptr;
     } else {
-        return _inverters[pos];
+        return (*inverters)[pos];
     }
 }
 
 std::shared_ptr<InverterAbstract> HoymilesClass::getInverterBySerial(const uint64_t serial)
 {
-    for (uint8_t i = 0; i < _inverters.size(); i++) {
-        if (_inverters[i]->serial() == serial) {
-            return _inverters[i];
+    const InverterListPtr inverters = getInverters();
+    for (auto& inv : *inverters) {
+        if (inv->serial() == serial) {
+            return inv;
         }
     }
     return nullptr;
@@ -214,9 +259,8 @@ std::shared_ptr<InverterAbstract> HoymilesClass::getInverterByFragment(const fra
         return nullptr;
     }
 
-    std::shared_ptr<InverterAbstract> inv;
-    for (uint8_t i = 0; i < _inverters.size(); i++) {
-        inv = _inverters[i];
+    const InverterListPtr inverters = getInverters();
+    for (auto& inv : *inverters) {
         serial_u p;
         p.u64 = inv->serial();
 
@@ -231,20 +275,34 @@ std::shared_ptr<InverterAbstract> HoymilesClass::getInverterByFragment(const fra
     return nullptr;
 }
 
+/*
+ * The inverter is deleted once the last list containing it is released.
+ * Queued commands for it are dropped as the radios do not find it anymore.
+ */
 void HoymilesClass::removeInverterBySerial(const uint64_t serial)
 {
-    for (uint8_t i = 0; i < _inverters.size(); i++) {
-        if (_inverters[i]->serial() == serial) {
-            std::lock_guard<std::mutex> lock(_mutex);
-            _inverters.erase(_inverters.begin() + i);
-            return;
-        }
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto inverters = std::make_shared<InverterList>(*_inverters);
+    auto it = std::find_if(inverters->begin(), inverters->end(), [serial](const std::shared_ptr<InverterAbstract>& inv) {
+        return inv->serial() == serial;
+    });
+    if (it == inverters->end()) {
+        return;
     }
+
+    inverters->erase(it);
+    std::atomic_store(&_inverters, InverterListPtr(std::move(inverters)));
 }
 
 size_t HoymilesClass::getNumInverters() const
 {
-    return _inverters.size();
+    return getInverters()->size();
+}
+
+InverterListPtr HoymilesClass::getInverters() const
+{
+    return std::atomic_load(&_inverters);
 }
 
 HoymilesRadio_NRF* HoymilesClass::getRadioNrf()
@@ -257,11 +315,21 @@ HoymilesRadio_CMT* HoymilesClass::getRadioCmt()
     return _radioCmt.get();
 }
 
+RadioRecorder& HoymilesClass::getRecorder()
+{
+    return _recorder;
+}
+
 bool HoymilesClass::isAllRadioIdle() const
 {
     return _radioNrf.get()->isIdle() && _radioCmt.get()->isIdle();
 }
 
+bool HoymilesClass::isAnyRadioActive() const
+{
+    return !isAllRadioIdle() || !_radioNrf->isQueueEmpty() || !_radioCmt->isQueueEmpty();
+}
+
 uint32_t HoymilesClass::PollInterval() const
 {
     return _pollInterval;
@@ -281,3 +349,13 @@ Print* HoymilesClass::getMessageOutput()
 {
     return _messageOutput;
 }
+
+void HoymilesClass::setDebugOutput(Print* output)
+{
+    _debugOutput = output;
+}
+
+Print* HoymilesClass::getDebugOutput()
+{
+    return _debugOutput;
+}
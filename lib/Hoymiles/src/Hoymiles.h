@@ -3,16 +3,22 @@
 
 #include "HoymilesRadio_CMT.h"
 #include "HoymilesRadio_NRF.h"
+#include "RadioRecorder.h"
 #include "inverters/InverterAbstract.h"
 #include "types.h"
 #include <Print.h>
 #include <SPI.h>
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #define HOY_SYSTEM_CONFIG_PARA_POLL_INTERVAL (2 * 60 * 1000) // 2 minutes
 #define HOY_SYSTEM_CONFIG_PARA_POLL_MIN_DURATION (4 * 60 * 1000) // at least 4 minutes between sending limit command and read request. Otherwise eventlog entry
 
+using InverterList = std::vector<std::shared_ptr<InverterAbstract>>;
+using InverterListPtr = std::shared_ptr<const InverterList>;
+
 class HoymilesClass {
 public:
     void init();
@@ -23,6 +29,11 @@ public:
     void setMessageOutput(Print* output);
     Print* getMessageOutput();
 
+    // Output for the dumps of all sent and received fragments, nullptr
+    // disables them. Only used by the task calling loop().
+    void setDebugOutput(Print* output);
+    Print* getDebugOutput();
+
     std::shared_ptr<InverterAbstract> addInverter(const char* name, const uint64_t serial);
     std::shared_ptr<InverterAbstract> getInverterByPos(const uint8_t pos);
     std::shared_ptr<InverterAbstract> getInverterBySerial(const uint64_t serial);
@@ -30,25 +41,38 @@ public:
     void removeInverterBySerial(const uint64_t serial);
     size_t getNumInverters() const;
 
+    // The list of inverters is never modified, adding or removing an
+    // inverter publishes a new one. Iterating a list taken once is safe in
+    // any task, the position based getters may see different lists.
+    InverterListPtr getInverters() const;
+
     HoymilesRadio_NRF* getRadioNrf();
     HoymilesRadio_CMT* getRadioCmt();
+    RadioRecorder& getRecorder();
 
     uint32_t PollInterval() const;
     void setPollInterval(const uint32_t interval);
 
     bool isAllRadioIdle() const;
 
+    // True while a radio waits for a response or has queued commands
+    bool isAnyRadioActive() const;
+
 private:
-    std::vector<std::shared_ptr<InverterAbstract>> _inverters;
+    InverterListPtr _inverters = std::make_shared<const InverterList>();
     std::unique_ptr<HoymilesRadio_NRF> _radioNrf;
     std::unique_ptr<HoymilesRadio_CMT> _radioCmt;
+    RadioRecorder _recorder;
 
-    std::mutex _mutex;
+    std::mutex _mutex; // serializes modifications of _inverters
 
     uint32_t _pollInterval = 0;
     uint32_t _lastPoll = 0;
 
+    std::atomic<bool> _dayChanged = { false };
+
     Print* _messageOutput = &Serial;
+    Print* _debugOutput = nullptr;
 };
 
 extern HoymilesClass Hoymiles;
\ No newline at end of file
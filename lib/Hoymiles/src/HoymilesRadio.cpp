@@ -60,6 +60,7 @@ void HoymilesRadio::handleReceivedPackage()
         if (nullptr != inv) {
             CommandAbstract* cmd = _commandQueue.front().get();
             uint8_t verifyResult = inv->verifyAllFragments(*cmd);
+            Hoymiles.getRecorder().record(RadioRecorderEvent::Verify, getRecorderRadio(), cmd->getTargetAddress(), 0, 0, verifyResult);
             if (verifyResult == FRAGMENT_ALL_MISSING_RESEND) {
                 Hoymiles.getMessageOutput()->println("Nothing received, resend whole request");
                 sendLastPacketAgain();
@@ -93,6 +94,7 @@ void HoymilesRadio::handleReceivedPackage()
             }
         } else {
             // If inverter was not found, assume the command is invalid
+            Hoymiles.getRecorder().record(RadioRecorderEvent::NoInverter, getRecorderRadio(), _commandQueue.front().get()->getTargetAddress(), 0, 0);
             Hoymiles.getMessageOutput()->println("RX: Invalid inverter found");
             _commandQueue.pop();
             _busyFlag = false;
@@ -107,6 +109,7 @@ void HoymilesRadio::handleReceivedPackage()
                 inv->clearRxFragmentBuffer();
                 sendEsbPacket(*cmd);
             } else {
+                Hoymiles.getRecorder().record(RadioRecorderEvent::NoInverter, getRecorderRadio(), cmd->getTargetAddress(), 0, 0);
                 Hoymiles.getMessageOutput()->println("TX: Invalid inverter found");
                 _commandQueue.pop();
             }
@@ -114,14 +117,41 @@ void HoymilesRadio::handleReceivedPackage()
     }
 }
 
-void HoymilesRadio::dumpBuf(const uint8_t buf[], const uint8_t len, const bool appendNewline)
+void HoymilesRadio::recordTx(CommandAbstract& cmd, const uint8_t channel)
 {
-    for (uint8_t i = 0; i < len; i++) {
-        Hoymiles.getMessageOutput()->printf("%02X ", buf[i]);
+    const uint8_t* payload = cmd.getDataPayload();
+    const uint8_t size = cmd.getDataSize();
+    Hoymiles.getRecorder().record(RadioRecorderEvent::Tx, getRecorderRadio(), cmd.getTargetAddress(), channel, 0,
+        payload[0], size > 9 ? payload[9] : 0, size > 10 ? payload[10] : 0, size);
+}
+
+// The first bytes of a response are the command and the sender address
+void HoymilesRadio::recordRx(const fragment_t& fragment)
+{
+    const uint32_t serial = fragment.len > 4
+        ? (static_cast<uint32_t>(fragment.fragment[1]) << 24) | (fragment.fragment[2] << 16) | (fragment.fragment[3] << 8) | fragment.fragment[4]
+        : 0;
+    Hoymiles.getRecorder().record(RadioRecorderEvent::Rx, getRecorderRadio(), serial, fragment.channel, fragment.rssi,
+        fragment.fragment[0], fragment.len > 9 ? fragment.fragment[9] : 0, fragment.len, fragment.len > 0 && checkFragmentCrc(fragment));
+}
+
+void HoymilesRadio::dumpBuf(Print* output, const uint8_t buf[], const uint8_t len, const bool appendNewline)
+{
+    static const char hex[] = "0123456789ABCDEF";
+
+    // Written at once, a fragment has at most MAX_RF_PAYLOAD_SIZE bytes
+    char text[MAX_RF_PAYLOAD_SIZE * 3 + 2];
+    uint8_t pos = 0;
+    for (uint8_t i = 0; i < len && i < MAX_RF_PAYLOAD_SIZE; i++) {
+        text[pos++] = hex[buf[i] >> 4];
+        text[pos++] = hex[buf[i] & 0x0f];
+        text[pos++] = ' ';
     }
     if (appendNewline) {
-        Hoymiles.getMessageOutput()->println("");
+        text[pos++] = '\r';
+        text[pos++] = '\n';
     }
+    output->write(reinterpret_cast<const uint8_t*>(text), pos);
 }
 
 bool HoymilesRadio::isInitialized() const
@@ -1,6 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include "RadioRecorder.h"
 #include "commands/CommandAbstract.h"
 #include "types.h"
 #include <ThreadSafeQueue.h>
@@ -29,10 +30,13 @@ public:
 
 protected:
     static serial_u convertSerialToRadioId(const serial_u serial);
-    static void dumpBuf(const uint8_t buf[], const uint8_t len, const bool appendNewline = true);
+    static void dumpBuf(Print* output, const uint8_t buf[], const uint8_t len, const bool appendNewline = true);
 
     bool checkFragmentCrc(const fragment_t& fragment) const;
     virtual void sendEsbPacket(CommandAbstract& cmd) = 0;
+    virtual RadioRecorderRadio getRecorderRadio() const = 0;
+    void recordTx(CommandAbstract& cmd, const uint8_t channel);
+    void recordRx(const fragment_t& fragment);
     void sendRetransmitPacket(const uint8_t fragment_id);
     void sendLastPacketAgain();
     void handleReceivedPackage();
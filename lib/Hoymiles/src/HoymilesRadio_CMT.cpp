@@ -140,8 +140,10 @@ void HoymilesRadio_CMT::loop()
                     f.len = MAX_RF_PAYLOAD_SIZE;
                 }
                 _radio->read(f.fragment, f.len);
+                recordRx(f);
                 _rxBuffer.push(f);
             } else {
+                Hoymiles.getRecorder().record(RadioRecorderEvent::RxOverflow, getRecorderRadio(), 0, _radio->getChannel(), 0);
                 Hoymiles.getMessageOutput()->println("CMT: Buffer full");
                 _radio->flush_rx();
             }
@@ -164,11 +166,14 @@ void HoymilesRadio_CMT::loop()
                     std::shared_ptr<InverterAbstract> inv = Hoymiles.getInverterByFragment(f);
 
                     if (nullptr != inv) {
-                        // Save packet in inverter rx buffer
-                        Hoymiles.getMessageOutput()->printf("RX %.2f MHz --> ", getFrequencyFromChannel(f.channel) / 1000000.0);
-                        dumpBuf(f.fragment, f.len, false);
-                        Hoymiles.getMessageOutput()->printf("| %d dBm\r\n", f.rssi);
+                        Print* debug = Hoymiles.getDebugOutput();
+                        if (debug != nullptr) {
+                            debug->printf("RX %.2f MHz --> ", getFrequencyFromChannel(f.channel) / 1000000.0);
+                            dumpBuf(debug, f.fragment, f.len, false);
+                            debug->printf("| %d dBm\r\n", f.rssi);
+                        }
 
+                        // Save packet in inverter rx buffer
                         inv->addRxFragment(f.fragment, f.len);
                     } else {
                         Hoymiles.getMessageOutput()->println("Inverter Not found!");
@@ -262,6 +267,11 @@ void ARDUINO_ISR_ATTR HoymilesRadio_CMT::handleInt2()
     _packetReceived = true;
 }
 
+RadioRecorderRadio HoymilesRadio_CMT::getRecorderRadio() const
+{
+    return RadioRecorderRadio::Cmt;
+}
+
 void HoymilesRadio_CMT::sendEsbPacket(CommandAbstract& cmd)
 {
     cmd.incrementSendCount();
@@ -274,9 +284,14 @@ void HoymilesRadio_CMT::sendEsbPacket(CommandAbstract& cmd)
         cmtSwitchDtuFreq(getInvBootFrequency());
     }
 
-    Hoymiles.getMessageOutput()->printf("TX %s %.2f MHz --> ",
-        cmd.getCommandName().c_str(), getFrequencyFromChannel(_radio->getChannel()) / 1000000.0);
-    cmd.dumpDataPayload(Hoymiles.getMessageOutput());
+    recordTx(cmd, _radio->getChannel());
+
+    Print* debug = Hoymiles.getDebugOutput();
+    if (debug != nullptr) {
+        debug->printf("TX %s %.2f MHz --> ",
+            cmd.getCommandName().c_str(), getFrequencyFromChannel(_radio->getChannel()) / 1000000.0);
+        dumpBuf(debug, cmd.getDataPayload(), cmd.getDataSize());
+    }
 
     if (!_radio->write(cmd.getDataPayload(), cmd.getDataSize())) {
         Hoymiles.getMessageOutput()->println("TX SPI Timeout");
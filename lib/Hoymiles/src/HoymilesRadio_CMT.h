@@ -71,6 +71,7 @@ private:
     void ARDUINO_ISR_ATTR handleInt2();
 
     void sendEsbPacket(CommandAbstract& cmd);
+    RadioRecorderRadio getRecorderRadio() const;
 
     std::unique_ptr<CMT2300A> _radio;
 
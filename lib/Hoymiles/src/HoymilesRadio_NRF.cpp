@@ -59,8 +59,10 @@ void HoymilesRadio_NRF::loop()
                 if (f.len > MAX_RF_PAYLOAD_SIZE)
                     f.len = MAX_RF_PAYLOAD_SIZE;
                 _radio->read(f.fragment, f.len);
+                recordRx(f);
                 _rxBuffer.push(f);
             } else {
+                Hoymiles.getRecorder().record(RadioRecorderEvent::RxOverflow, getRecorderRadio(), 0, _radio->getChannel(), 0);
                 Hoymiles.getMessageOutput()->println("NRF: Buffer full");
                 _radio->flush_rx();
             }
@@ -75,11 +77,14 @@ void HoymilesRadio_NRF::loop()
                 std::shared_ptr<InverterAbstract> inv = Hoymiles.getInverterByFragment(f);
 
                 if (nullptr != inv) {
-                    // Save packet in inverter rx buffer
-                    Hoymiles.getMessageOutput()->printf("RX Channel: %d --> ", f.channel);
-                    dumpBuf(f.fragment, f.len, false);
-                    Hoymiles.getMessageOutput()->printf("| %d dBm\r\n", f.rssi);
+                    Print* debug = Hoymiles.getDebugOutput();
+                    if (debug != nullptr) {
+                        debug->printf("RX Channel: %d --> ", f.channel);
+                        dumpBuf(debug, f.fragment, f.len, false);
+                        debug->printf("| %d dBm\r\n", f.rssi);
+                    }
 
+                    // Save packet in inverter rx buffer
                     inv->addRxFragment(f.fragment, f.len);
                 } else {
                     Hoymiles.getMessageOutput()->println("Inverter Not found!");
@@ -169,6 +174,11 @@ void HoymilesRadio_NRF::switchRxCh()
     _radio->startListening();
 }
 
+RadioRecorderRadio HoymilesRadio_NRF::getRecorderRadio() const
+{
+    return RadioRecorderRadio::Nrf;
+}
+
 void HoymilesRadio_NRF::sendEsbPacket(CommandAbstract& cmd)
 {
     cmd.incrementSendCount();
@@ -183,9 +193,14 @@ void HoymilesRadio_NRF::sendEsbPacket(CommandAbstract& cmd)
     openWritingPipe(s);
     _radio->setRetries(3, 15);
 
-    Hoymiles.getMessageOutput()->printf("TX %s Channel: %d --> ",
-        cmd.getCommandName().c_str(), _radio->getChannel());
-    cmd.dumpDataPayload(Hoymiles.getMessageOutput());
+    recordTx(cmd, _radio->getChannel());
+
+    Print* debug = Hoymiles.getDebugOutput();
+    if (debug != nullptr) {
+        debug->printf("TX %s Channel: %d --> ",
+            cmd.getCommandName().c_str(), _radio->getChannel());
+        dumpBuf(debug, cmd.getDataPayload(), cmd.getDataSize());
+    }
     _radio->write(cmd.getDataPayload(), cmd.getDataSize());
 
     _radio->setRetries(0, 0);
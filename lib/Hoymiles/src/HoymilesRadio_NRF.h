@@ -31,6 +31,7 @@ private:
     void openWritingPipe(const serial_u serial);
 
     void sendEsbPacket(CommandAbstract& cmd);
+    RadioRecorderRadio getRecorderRadio() const;
 
     std::unique_ptr<SPIClass> _spiPtr;
     std::unique_ptr<RF24> _radio;
@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2024 Thomas Basler and others
+ */
+#include "RadioRecorder.h"
+#include <Arduino.h>
+#include <algorithm>
+#include <new>
+#include <string.h>
+#include <time.h>
+
+void RadioRecorder::init(const uint16_t size)
+{
+    _records.reset(size > 0 ? new (std::nothrow) RadioRecord_t[size] : nullptr);
+    _size = _records ? size : 0;
+    _count = 0;
+}
+
+void RadioRecorder::record(const RadioRecorderEvent event, const RadioRecorderRadio radio, const uint32_t serial, const uint8_t channel, const int8_t rssi,
+    const uint8_t data0, const uint8_t data1, const uint8_t data2, const uint8_t data3)
+{
+    if (_size == 0) {
+        return;
+    }
+
+    const uint32_t count = _count.load(std::memory_order_relaxed);
+
+    RadioRecord_t& record = _records[count % _size];
+    record.Time = micros();
+    record.Serial = serial;
+    record.Event = event;
+    record.Radio = radio;
+    record.Channel = channel;
+    record.Rssi = rssi;
+    record.Data[0] = data0;
+    record.Data[1] = data1;
+    record.Data[2] = data2;
+    record.Data[3] = data3;
+
+    _count.store(count + 1, std::memory_order_release);
+}
+
+std::vector<uint8_t> RadioRecorder::dump() const
+{
+    const uint32_t end = _count.load(std::memory_order_acquire);
+    uint32_t first = end > _size ? end - _size : 0;
+
+    std::vector<uint8_t> buffer(sizeof(RadioRecorderHeader_t) + (end - first) * sizeof(RadioRecord_t));
+    RadioRecord_t* records = reinterpret_cast<RadioRecord_t*>(buffer.data() + sizeof(RadioRecorderHeader_t));
+    for (uint32_t i = first; i < end; i++) {
+        records[i - first] = _records[i % _size];
+    }
+
+    // Records which were written during the copy replaced the oldest ones,
+    // including the one which might have been written at the moment
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint32_t written = _count.load(std::memory_order_relaxed);
+    if (written + 1 > _size + first) {
+        const uint32_t valid = std::min(written + 1 - _size, end);
+        memmove(records, records + (valid - first), (end - valid) * sizeof(RadioRecord_t));
+        first = valid;
+        buffer.resize(sizeof(RadioRecorderHeader_t) + (end - first) * sizeof(RadioRecord_t));
+    }
+
+    RadioRecorderHeader_t header;
+    header.Magic = RADIO_RECORDER_MAGIC;
+    header.Version = RADIO_RECORDER_VERSION;
+    header.RecordSize = sizeof(RadioRecord_t);
+    header.RecordCount = end - first;
+    header.TotalCount = end;
+    header.Time = micros();
+    header.UnixTime = time(nullptr);
+    memcpy(buffer.data(), &header, sizeof(header));
+
+    return buffer;
+}
+
+uint16_t RadioRecorder::getSize() const
+{
+    return _size;
+}
@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#define RADIO_RECORDER_MAGIC 0x43524452 // "RDRC"
+#define RADIO_RECORDER_VERSION 1
+
+// Number of records kept, 16 bytes each
+#define RADIO_RECORDER_SIZE 512
+#define RADIO_RECORDER_SIZE_PSRAM 8192
+
+enum class RadioRecorderRadio : uint8_t {
+    Nrf = 0,
+    Cmt,
+};
+
+enum class RadioRecorderEvent : uint8_t {
+    Tx = 1, // Data: command, frame id, sub command, size
+    Rx, // Data: command, fragment id, size, 1 if the CRC is valid
+    RxOverflow, // fragment dropped because the receive buffer was full
+    Verify, // end of the receive period, Data[0]: result of verifyAllFragments()
+    NoInverter, // queued command for an inverter which does not exist anymore
+};
+
+struct __attribute__((packed)) RadioRecord_t {
+    uint32_t Time; // micros()
+    uint32_t Serial; // lower 4 bytes of the inverter serial
+    RadioRecorderEvent Event;
+    RadioRecorderRadio Radio;
+    uint8_t Channel;
+    int8_t Rssi; // dBm, 0 if unknown
+    uint8_t Data[4];
+};
+static_assert(sizeof(RadioRecord_t) == 16, "Record size is part of the dump format");
+
+// Followed by RecordCount records, oldest first. All values little endian.
+struct __attribute__((packed)) RadioRecorderHeader_t {
+    uint32_t Magic;
+    uint16_t Version;
+    uint16_t RecordSize;
+    uint32_t RecordCount;
+    uint32_t TotalCount; // records written since boot
+    uint32_t Time; // micros() when the dump was taken
+    uint32_t UnixTime; // time() when the dump was taken, small values mean unknown
+};
+
+/*
+ * Fixed size ring of radio events. Only the task running the radio loops
+ * records, so recording is a plain copy without locks. The ring can be
+ * dumped from any task, records overwritten during the copy are discarded.
+ */
+class RadioRecorder {
+public:
+    // Allocates the ring, a size of 0 disables recording
+    void init(const uint16_t size);
+
+    void record(const RadioRecorderEvent event, const RadioRecorderRadio radio, const uint32_t serial, const uint8_t channel, const int8_t rssi,
+        const uint8_t data0 = 0, const uint8_t data1 = 0, const uint8_t data2 = 0, const uint8_t data3 = 0);
+
+    // Header and records in the format read by tools/radio_recorder.py
+    std::vector<uint8_t> dump() const;
+
+    uint16_t getSize() const;
+
+private:
+    std::unique_ptr<RadioRecord_t[]> _records;
+    uint16_t _size = 0;
+    std::atomic<uint32_t> _count = { 0 }; // records written since boot
+};
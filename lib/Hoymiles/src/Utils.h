@@ -1,9 +1,24 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 
+#include <array>
 #include <cstdint>
+#include <utility>
 
 class Utils {
 public:
-    static uint8_t getWeekDay();
-};
\ No newline at end of file
+    // Checks the key/value pairs a compile time map is built from, the
+    // perfect hash generation of frozen does not detect duplicate keys
+    template <typename K, typename V, std::size_t N>
+    static constexpr bool hasUniqueKeys(const std::array<std::pair<K, V>, N>& items)
+    {
+        for (std::size_t i = 0; i < N; i++) {
+            for (std::size_t j = i + 1; j < N; j++) {
+                if (items[i].first == items[j].first) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+};
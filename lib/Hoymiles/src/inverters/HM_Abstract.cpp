@@ -12,6 +12,7 @@
 #include "commands/PowerControlCommand.h"
 #include "commands/RealTimeRunDataCommand.h"
 #include "commands/SystemConfigParaCommand.h"
+#include <WallClock.h>
 
 HM_Abstract::HM_Abstract(HoymilesRadio* radio, const uint64_t serial)
     : InverterAbstract(radio, serial) {};
@@ -22,13 +23,11 @@ bool HM_Abstract::sendStatsRequest()
         return false;
     }
 
-    struct tm timeinfo;
-    if (!getLocalTime(&timeinfo, 5)) {
+    if (!WallClock.isSynced()) {
         return false;
     }
 
-    time_t now;
-    time(&now);
+    const time_t now = WallClock.getEpoch();
 
     auto cmd = _radio->prepareCommand<RealTimeRunDataCommand>(this);
     cmd->setTime(now);
@@ -43,8 +42,7 @@ bool HM_Abstract::sendAlarmLogRequest(const bool force)
         return false;
     }
 
-    struct tm timeinfo;
-    if (!getLocalTime(&timeinfo, 5)) {
+    if (!WallClock.isSynced()) {
         return false;
     }
 
@@ -58,8 +56,7 @@ bool HM_Abstract::sendAlarmLogRequest(const bool force)
 
     _lastAlarmLogCnt = (uint8_t)Statistics()->getChannelFieldValue(TYPE_INV, CH0, FLD_EVT_LOG);
 
-    time_t now;
-    time(&now);
+    const time_t now = WallClock.getEpoch();
 
     auto cmd = _radio->prepareCommand<AlarmDataCommand>(this);
     cmd->setTime(now);
@@ -75,13 +72,11 @@ bool HM_Abstract::sendDevInfoRequest()
         return false;
     }
 
-    struct tm timeinfo;
-    if (!getLocalTime(&timeinfo, 5)) {
+    if (!WallClock.isSynced()) {
         return false;
     }
 
-    time_t now;
-    time(&now);
+    const time_t now = WallClock.getEpoch();
 
     auto cmdAll = _radio->prepareCommand<DevInfoAllCommand>(this);
     cmdAll->setTime(now);
@@ -100,13 +95,11 @@ bool HM_Abstract::sendSystemConfigParaRequest()
         return false;
     }
 
-    struct tm timeinfo;
-    if (!getLocalTime(&timeinfo, 5)) {
+    if (!WallClock.isSynced()) {
         return false;
     }
 
-    time_t now;
-    time(&now);
+    const time_t now = WallClock.getEpoch();
 
     auto cmd = _radio->prepareCommand<SystemConfigParaCommand>(this);
     cmd->setTime(now);
@@ -203,13 +196,11 @@ bool HM_Abstract::sendGridOnProFileParaRequest()
         return false;
     }
 
-    struct tm timeinfo;
-    if (!getLocalTime(&timeinfo, 5)) {
+    if (!WallClock.isSynced()) {
         return false;
     }
 
-    time_t now;
-    time(&now);
+    const time_t now = WallClock.getEpoch();
 
     auto cmd = _radio->prepareCommand<GridOnProFilePara>(this);
     cmd->setTime(now);
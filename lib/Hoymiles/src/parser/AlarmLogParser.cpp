@@ -24,9 +24,12 @@ ID   Source Addr   Target Addr   Idx  ?       wcode   ?       Start   End     ?
 */
 #include "AlarmLogParser.h"
 #include "../Hoymiles.h"
+#include "../Utils.h"
 #include <cstring>
+#include <frozen/unordered_map.h>
+#include <mutex>
 
-const std::array<const AlarmMessage_t, ALARM_MSG_COUNT> AlarmLogParser::_alarmMessages = { {
+constexpr std::array<const AlarmMessage_t, ALARM_MSG_COUNT> alarmMessages = { {
     { AlarmMessageType_t::ALL, 1, "Inverter start", "Wechselrichter gestartet", "L'onduleur a démarré" },
     { AlarmMessageType_t::ALL, 2, "Time calibration", "Zeitabgleich", "" },
     { AlarmMessageType_t::ALL, 3, "EEPROM reading and writing error during operation", "", "" },
@@ -190,6 +193,27 @@ const std::array<const AlarmMessage_t, ALARM_MSG_COUNT> AlarmLogParser::_alarmMe
     { AlarmMessageType_t::ALL, 9000, "Microinverter is suspected of being stolen", "", "" },
 } };
 
+constexpr uint32_t getAlarmMessageKey(const AlarmMessageType_t type, const uint16_t messageId)
+{
+    return static_cast<uint32_t>(type) << 16 | messageId;
+}
+
+constexpr std::array<std::pair<uint32_t, uint8_t>, ALARM_MSG_COUNT> makeAlarmMessageKeys()
+{
+    std::array<std::pair<uint32_t, uint8_t>, ALARM_MSG_COUNT> keys = {};
+    for (uint8_t i = 0; i < ALARM_MSG_COUNT; i++) {
+        keys[i].first = getAlarmMessageKey(alarmMessages[i].InverterType, alarmMessages[i].MessageId);
+        keys[i].second = i;
+    }
+    return keys;
+}
+
+constexpr auto alarmMessageKeys = makeAlarmMessageKeys();
+static_assert(Utils::hasUniqueKeys(alarmMessageKeys), "Alarm message defined twice for the same inverter type");
+
+// Index in alarmMessages by inverter type and message id
+constexpr auto alarmMessageIndex = frozen::make_unordered_map(alarmMessageKeys);
+
 AlarmLogParser::AlarmLogParser()
     : Parser()
 {
@@ -200,6 +224,7 @@ void AlarmLogParser::clearBuffer()
 {
     memset(_payloadAlarmLog, 0, ALARM_LOG_PAYLOAD_SIZE);
     _alarmLogLength = 0;
+    _recordCount = 0;
 }
 
 void AlarmLogParser::appendFragment(const uint8_t offset, const uint8_t* payload, const uint8_t len)
@@ -212,12 +237,17 @@ void AlarmLogParser::appendFragment(const uint8_t offset, const uint8_t* payload
     _alarmLogLength += len;
 }
 
+void AlarmLogParser::endAppendFragment()
+{
+    // Still holding the semaphore taken in beginAppendFragment
+    decodeEntries();
+
+    Parser::endAppendFragment();
+}
+
 uint8_t AlarmLogParser::getEntryCount() const
 {
-    if (_alarmLogLength < 2) {
-        return 0;
-    }
-    return (_alarmLogLength - 2) / ALARM_LOG_ENTRY_SIZE;
+    return _recordCount;
 }
 
 void AlarmLogParser::setLastAlarmRequestSuccess(const LastCommandSuccess status)
@@ -237,74 +267,143 @@ void AlarmLogParser::setMessageType(const AlarmMessageType_t type)
 
 void AlarmLogParser::getLogEntry(const uint8_t entryId, AlarmLogEntry_t& entry, const AlarmMessageLocale_t locale)
 {
-    const uint8_t entryStartOffset = 2 + entryId * ALARM_LOG_ENTRY_SIZE;
+    AlarmLogRecord_t record;
+    getLogRecord(entryId, record);
+
+    entry.MessageId = record.MessageId;
+    entry.Message = getMessage(record.MessageIndex, locale);
+    entry.StartTime = record.StartTime;
+    entry.EndTime = record.EndTime;
+}
 
-    const int timezoneOffset = getTimezoneOffset();
+void AlarmLogParser::getLogRecord(const uint8_t entryId, AlarmLogRecord_t& record, const bool withTimezoneOffset)
+{
+    const int timezoneOffset = withTimezoneOffset ? getTimezoneOffset() : 0;
 
     HOY_SEMAPHORE_TAKE();
+    const bool valid = entryId < _recordCount;
+    if (valid) {
+        record = _records[entryId];
+    } else {
+        record = { 0, ALARM_MSG_UNKNOWN, 0, 0 };
+    }
+    HOY_SEMAPHORE_GIVE();
 
-    const uint32_t wcode = (uint16_t)_payloadAlarmLog[entryStartOffset] << 8 | _payloadAlarmLog[entryStartOffset + 1];
-    uint32_t startTimeOffset = 0;
-    if (((wcode >> 13) & 0x01) == 1) {
-        startTimeOffset = 12 * 60 * 60;
+    // Applied when reading, entries decoded before the clock got
+    // synchronized would keep a wrong offset otherwise
+    if (valid && timezoneOffset != 0) {
+        record.StartTime += timezoneOffset;
+        if (record.EndTime > 0) {
+            record.EndTime += timezoneOffset;
+        }
     }
+}
 
-    uint32_t endTimeOffset = 0;
-    if (((wcode >> 12) & 0x01) == 1) {
-        endTimeOffset = 12 * 60 * 60;
+const char* AlarmLogParser::getMessage(const uint8_t messageIndex, const AlarmMessageLocale_t locale)
+{
+    if (messageIndex >= ALARM_MSG_COUNT) {
+        switch (locale) {
+        case AlarmMessageLocale_t::DE:
+            return "Unbekannt";
+        case AlarmMessageLocale_t::FR:
+            return "Inconnu";
+        default:
+            return "Unknown";
+        }
     }
 
-    entry.MessageId = _payloadAlarmLog[entryStartOffset + 1];
-    entry.StartTime = (((uint16_t)_payloadAlarmLog[entryStartOffset + 4] << 8) | ((uint16_t)_payloadAlarmLog[entryStartOffset + 5])) + startTimeOffset + timezoneOffset;
-    entry.EndTime = ((uint16_t)_payloadAlarmLog[entryStartOffset + 6] << 8) | ((uint16_t)_payloadAlarmLog[entryStartOffset + 7]);
+    const AlarmMessage_t& msg = alarmMessages[messageIndex];
 
-    HOY_SEMAPHORE_GIVE();
+    if (locale == AlarmMessageLocale_t::DE) {
+        return msg.Message_de[0] != '\0' ? msg.Message_de : msg.Message_en;
+    }
 
-    if (entry.EndTime > 0) {
-        entry.EndTime += (endTimeOffset + timezoneOffset);
+    if (locale == AlarmMessageLocale_t::FR) {
+        return msg.Message_fr[0] != '\0' ? msg.Message_fr : msg.Message_en;
     }
 
-    switch (locale) {
-    case AlarmMessageLocale_t::DE:
-        entry.Message = "Unbekannt";
-        break;
-    case AlarmMessageLocale_t::FR:
-        entry.Message = "Inconnu";
-        break;
-    default:
-        entry.Message = "Unknown";
+    return msg.Message_en;
+}
+
+/*
+ * Decodes the raw entries once when a response is complete, so reading the
+ * log does not have to parse the payload or search the message table again.
+ */
+void AlarmLogParser::decodeEntries()
+{
+    _recordCount = 0;
+    if (_alarmLogLength < 2) {
+        return;
     }
 
-    for (auto& msg : _alarmMessages) {
-        if (msg.MessageId == entry.MessageId) {
-            if (msg.InverterType == _messageType) {
-                entry.Message = getLocaleMessage(&msg, locale);
-                break;
-            } else if (msg.InverterType == AlarmMessageType_t::ALL) {
-                entry.Message = getLocaleMessage(&msg, locale);
-            }
+    const uint8_t count = (_alarmLogLength - 2) / ALARM_LOG_ENTRY_SIZE;
+
+    for (uint8_t entryId = 0; entryId < count && entryId < ALARM_LOG_ENTRY_COUNT; entryId++) {
+        const uint8_t entryStartOffset = 2 + entryId * ALARM_LOG_ENTRY_SIZE;
+
+        const uint32_t wcode = (uint16_t)_payloadAlarmLog[entryStartOffset] << 8 | _payloadAlarmLog[entryStartOffset + 1];
+        uint32_t startTimeOffset = 0;
+        if (((wcode >> 13) & 0x01) == 1) {
+            startTimeOffset = 12 * 60 * 60;
         }
+
+        uint32_t endTimeOffset = 0;
+        if (((wcode >> 12) & 0x01) == 1) {
+            endTimeOffset = 12 * 60 * 60;
+        }
+
+        AlarmLogRecord_t& record = _records[entryId];
+        record.MessageId = _payloadAlarmLog[entryStartOffset + 1];
+        record.MessageIndex = getMessageIndex(record.MessageId);
+        record.StartTime = (((uint16_t)_payloadAlarmLog[entryStartOffset + 4] << 8) | ((uint16_t)_payloadAlarmLog[entryStartOffset + 5])) + startTimeOffset;
+        record.EndTime = ((uint16_t)_payloadAlarmLog[entryStartOffset + 6] << 8) | ((uint16_t)_payloadAlarmLog[entryStartOffset + 7]);
+
+        if (record.EndTime > 0) {
+            record.EndTime += endTimeOffset;
+        }
+
+        _recordCount++;
     }
 }
 
-String AlarmLogParser::getLocaleMessage(const AlarmMessage_t* msg, const AlarmMessageLocale_t locale) const
+uint8_t AlarmLogParser::getMessageIndex(const uint16_t messageId) const
 {
-    if (locale == AlarmMessageLocale_t::DE) {
-        return msg->Message_de[0] != '\0' ? msg->Message_de : msg->Message_en;
+    // Messages specific to the inverter type take precedence
+    auto it = alarmMessageIndex.find(getAlarmMessageKey(_messageType, messageId));
+    if (it == alarmMessageIndex.end()) {
+        it = alarmMessageIndex.find(getAlarmMessageKey(AlarmMessageType_t::ALL, messageId));
     }
 
-    if (locale == AlarmMessageLocale_t::FR) {
-        return msg->Message_fr[0] != '\0' ? msg->Message_fr : msg->Message_en;
-    }
+    return it != alarmMessageIndex.end() ? it->second : ALARM_MSG_UNKNOWN;
+}
 
-    return msg->Message_en;
+/*
+ * The offset only changes with daylight saving time, which switches on full
+ * hours, or if the timezone is configured. mktime has to consult the
+ * timezone rules, so the result is reused within the same hour until
+ * resetTimezoneOffset() is called. Shared by all inverters and tasks.
+ */
+static std::mutex timezoneMutex;
+static time_t cachedHour = -1;
+static int cachedOffset = 0;
+
+void AlarmLogParser::resetTimezoneOffset()
+{
+    std::lock_guard<std::mutex> lock(timezoneMutex);
+    cachedHour = -1;
 }
 
 int AlarmLogParser::getTimezoneOffset()
 {
+    std::lock_guard<std::mutex> lock(timezoneMutex);
+
     // see: https://stackoverflow.com/questions/13804095/get-the-time-zone-gmt-offset-in-c/44063597#44063597
 
     time_t gmt, rawtime = time(NULL);
+    if (rawtime / 3600 == cachedHour) {
+        return cachedOffset;
+    }
+
     struct tm* ptm;
 
     struct tm gbuf;
@@ -314,5 +413,7 @@ int AlarmLogParser::getTimezoneOffset()
     ptm->tm_isdst = -1;
     gmt = mktime(ptm);
 
-    return static_cast<int>(difftime(rawtime, gmt));
+    cachedHour = rawtime / 3600;
+    cachedOffset = static_cast<int>(difftime(rawtime, gmt));
+    return cachedOffset;
 }
@@ -9,10 +9,19 @@
 #define ALARM_LOG_PAYLOAD_SIZE (ALARM_LOG_ENTRY_COUNT * ALARM_LOG_ENTRY_SIZE + 4)
 
 #define ALARM_MSG_COUNT 131
+#define ALARM_MSG_UNKNOWN 0xff // message index of ids which are not in the table
 
 struct AlarmLogEntry_t {
     uint16_t MessageId;
-    String Message;
+    const char* Message;
+    time_t StartTime;
+    time_t EndTime;
+};
+
+// Entry as decoded when the alarm log was received
+struct AlarmLogRecord_t {
+    uint16_t MessageId;
+    uint8_t MessageIndex; // index in the message table or ALARM_MSG_UNKNOWN
     time_t StartTime;
     time_t EndTime;
 };
@@ -41,25 +50,40 @@ public:
     AlarmLogParser();
     void clearBuffer();
     void appendFragment(const uint8_t offset, const uint8_t* payload, const uint8_t len);
+    void endAppendFragment();
 
     uint8_t getEntryCount() const;
     void getLogEntry(const uint8_t entryId, AlarmLogEntry_t& entry, const AlarmMessageLocale_t locale = AlarmMessageLocale_t::EN);
+    // Without the offset the times are the seconds of the day as reported
+    // by the inverter, which do not change with the timezone
+    void getLogRecord(const uint8_t entryId, AlarmLogRecord_t& record, const bool withTimezoneOffset = true);
+
+    // Index in the message table for the message id of this inverter type
+    uint8_t getMessageIndex(const uint16_t messageId) const;
+    static const char* getMessage(const uint8_t messageIndex, const AlarmMessageLocale_t locale);
 
     void setLastAlarmRequestSuccess(const LastCommandSuccess status);
     LastCommandSuccess getLastAlarmRequestSuccess() const;
 
     void setMessageType(const AlarmMessageType_t type);
 
-private:
+    // Has to be called when the clock got synchronized or the timezone
+    // changed, the next read applies the new offset
+    static void resetTimezoneOffset();
+
+    // Offset in seconds which is added to the times of the entries
     static int getTimezoneOffset();
-    String getLocaleMessage(const AlarmMessage_t* msg, const AlarmMessageLocale_t locale) const;
+
+private:
+    void decodeEntries();
 
     uint8_t _payloadAlarmLog[ALARM_LOG_PAYLOAD_SIZE];
     uint8_t _alarmLogLength = 0;
 
+    std::array<AlarmLogRecord_t, ALARM_LOG_ENTRY_COUNT> _records; // times without the timezone offset
+    uint8_t _recordCount = 0;
+
     LastCommandSuccess _lastAlarmRequestSuccess = CMD_NOK; // Set to NOK to fetch at startup
 
     AlarmMessageType_t _messageType = AlarmMessageType_t::ALL;
-
-    static const std::array<const AlarmMessage_t, ALARM_MSG_COUNT> _alarmMessages;
 };
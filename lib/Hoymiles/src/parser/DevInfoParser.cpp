@@ -29,7 +29,9 @@ ID   Source Addr   Target Addr   Idx  FW Version  HW Part No.   HW Version   ?
 */
 #include "DevInfoParser.h"
 #include "../Hoymiles.h"
+#include "../Utils.h"
 #include <cstring>
+#include <frozen/unordered_map.h>
 
 #define ALL 0xff
 
@@ -39,7 +41,7 @@ typedef struct {
     const char* modelName;
 } devInfo_t;
 
-const devInfo_t devInfo[] = {
+constexpr devInfo_t devInfo[] = {
     { { 0x10, 0x10, 0x10, ALL }, 300, "HM-300-1T" },
     { { 0x10, 0x10, 0x20, ALL }, 350, "HM-350-1T" },
     { { 0x10, 0x10, 0x30, ALL }, 400, "HM-400-1T" },
@@ -85,6 +87,64 @@ const devInfo_t devInfo[] = {
     { { 0xF1, 0x01, 0x22, ALL }, 1800, "HERF-1800" }, // 00
 };
 
+constexpr size_t DEV_INFO_COUNT = sizeof(devInfo) / sizeof(devInfo_t);
+
+constexpr uint32_t getHwPartKey(const uint8_t b0, const uint8_t b1, const uint8_t b2, const uint8_t b3)
+{
+    return static_cast<uint32_t>(b0) << 24 | static_cast<uint32_t>(b1) << 16 | static_cast<uint32_t>(b2) << 8 | b3;
+}
+
+constexpr bool isFirstHwPartPrefix(const size_t pos)
+{
+    for (size_t i = 0; i < pos; i++) {
+        if (devInfo[i].hwPart[0] == devInfo[pos].hwPart[0]
+            && devInfo[i].hwPart[1] == devInfo[pos].hwPart[1]
+            && devInfo[i].hwPart[2] == devInfo[pos].hwPart[2]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+constexpr size_t countDevInfo(const bool exact)
+{
+    size_t count = 0;
+    for (size_t pos = 0; pos < DEV_INFO_COUNT; pos++) {
+        if (exact ? devInfo[pos].hwPart[3] != ALL : isFirstHwPartPrefix(pos)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/*
+ * Builds the keys of the two lookup steps of getDevIdx(): all 4 bytes for
+ * the entries with a specific last byte, otherwise the first 3 bytes of the
+ * first entry with that prefix.
+ */
+template <size_t N>
+constexpr std::array<std::pair<uint32_t, uint8_t>, N> makeDevInfoKeys(const bool exact)
+{
+    std::array<std::pair<uint32_t, uint8_t>, N> keys = {};
+    size_t count = 0;
+    for (size_t pos = 0; pos < DEV_INFO_COUNT; pos++) {
+        if (exact ? devInfo[pos].hwPart[3] != ALL : isFirstHwPartPrefix(pos)) {
+            keys[count].first = getHwPartKey(devInfo[pos].hwPart[0], devInfo[pos].hwPart[1], devInfo[pos].hwPart[2], exact ? devInfo[pos].hwPart[3] : 0);
+            keys[count].second = pos;
+            count++;
+        }
+    }
+    return keys;
+}
+
+constexpr auto devInfoExactKeys = makeDevInfoKeys<countDevInfo(true)>(true);
+constexpr auto devInfoPrefixKeys = makeDevInfoKeys<countDevInfo(false)>(false);
+static_assert(Utils::hasUniqueKeys(devInfoExactKeys), "Hardware part number defined twice");
+static_assert(DEV_INFO_COUNT < 0xff, "0xff is reserved for unknown devices");
+
+constexpr auto devInfoExact = frozen::make_unordered_map(devInfoExactKeys);
+constexpr auto devInfoPrefix = frozen::make_unordered_map(devInfoPrefixKeys);
+
 DevInfoParser::DevInfoParser()
     : Parser()
 {
@@ -235,37 +295,26 @@ bool DevInfoParser::containsValidData() const
 
 uint8_t DevInfoParser::getDevIdx() const
 {
-    uint8_t ret = 0xff;
-    uint8_t pos;
-
     HOY_SEMAPHORE_TAKE();
+    const uint8_t b0 = _payloadDevInfoSimple[2];
+    const uint8_t b1 = _payloadDevInfoSimple[3];
+    const uint8_t b2 = _payloadDevInfoSimple[4];
+    const uint8_t b3 = _payloadDevInfoSimple[5];
+    HOY_SEMAPHORE_GIVE();
 
     // Check for all 4 bytes first
-    for (pos = 0; pos < sizeof(devInfo) / sizeof(devInfo_t); pos++) {
-        if (devInfo[pos].hwPart[0] == _payloadDevInfoSimple[2]
-            && devInfo[pos].hwPart[1] == _payloadDevInfoSimple[3]
-            && devInfo[pos].hwPart[2] == _payloadDevInfoSimple[4]
-            && devInfo[pos].hwPart[3] == _payloadDevInfoSimple[5]) {
-            ret = pos;
-            break;
-        }
+    auto it = devInfoExact.find(getHwPartKey(b0, b1, b2, b3));
+    if (it != devInfoExact.end()) {
+        return it->second;
     }
 
     // Then only for 3 bytes but only if not already found
-    if (ret == 0xff) {
-        for (pos = 0; pos < sizeof(devInfo) / sizeof(devInfo_t); pos++) {
-            if (devInfo[pos].hwPart[0] == _payloadDevInfoSimple[2]
-                && devInfo[pos].hwPart[1] == _payloadDevInfoSimple[3]
-                && devInfo[pos].hwPart[2] == _payloadDevInfoSimple[4]) {
-                ret = pos;
-                break;
-            }
-        }
+    it = devInfoPrefix.find(getHwPartKey(b0, b1, b2, 0));
+    if (it != devInfoPrefix.end()) {
+        return it->second;
     }
 
-    HOY_SEMAPHORE_GIVE();
-
-    return ret;
+    return 0xff;
 }
 
 /* struct tm to seconds since Unix epoch */
@@ -21,11 +21,13 @@ The number of values depends on the respective section and its version. After th
 */
 #include "GridProfileParser.h"
 #include "../Hoymiles.h"
+#include "../Utils.h"
 #include <cstring>
 #include <frozen/map.h>
 #include <frozen/string.h>
+#include <frozen/unordered_map.h>
 
-const std::array<const ProfileType_t, PROFILE_TYPE_COUNT> GridProfileParser::_profileTypes = { {
+constexpr std::array<const ProfileType_t, PROFILE_TYPE_COUNT> profileTypes = { {
     { 0x02, 0x00, "US - NA_IEEE1547_240V" },
     { 0x03, 0x00, "DE - DE_VDE4105_2018" },
     { 0x03, 0x01, "DE - DE_VDE4105_2011" },
@@ -38,6 +40,26 @@ const std::array<const ProfileType_t, PROFILE_TYPE_COUNT> GridProfileParser::_pr
     { 0x37, 0x00, "CH - CH_NA EEA-NE7-CH2020" },
 } };
 
+constexpr uint16_t getProfileTypeKey(const uint8_t lIdx, const uint8_t hIdx)
+{
+    return static_cast<uint16_t>(lIdx) << 8 | hIdx;
+}
+
+constexpr std::array<std::pair<uint16_t, uint8_t>, PROFILE_TYPE_COUNT> makeProfileTypeKeys()
+{
+    std::array<std::pair<uint16_t, uint8_t>, PROFILE_TYPE_COUNT> keys = {};
+    for (uint8_t i = 0; i < PROFILE_TYPE_COUNT; i++) {
+        keys[i].first = getProfileTypeKey(profileTypes[i].lIdx, profileTypes[i].hIdx);
+        keys[i].second = i;
+    }
+    return keys;
+}
+
+constexpr auto profileTypeKeys = makeProfileTypeKeys();
+static_assert(Utils::hasUniqueKeys(profileTypeKeys), "Grid profile type defined twice");
+
+constexpr auto profileTypeIndex = frozen::make_unordered_map(profileTypeKeys);
+
 constexpr frozen::map<uint8_t, frozen::string, 12> profileSection = {
     { 0x00, "Voltage (H/LVRT)" },
     { 0x10, "Frequency (H/LFRT)" },
@@ -134,7 +156,7 @@ constexpr frozen::map<uint8_t, GridProfileItemDefinition_t, 0x42> itemDefinition
     { 0xff, make_value("Unkown Value", "", 1) },
 };
 
-const std::array<const GridProfileValue_t, SECTION_VALUE_COUNT> GridProfileParser::_profileValues = { {
+constexpr std::array<const GridProfileValue_t, SECTION_VALUE_COUNT> profileValues = { {
     // Voltage (H/LVRT)
     // Version 0x00
     { 0x00, 0x00, 0x01 },
@@ -362,6 +384,56 @@ const std::array<const GridProfileValue_t, SECTION_VALUE_COUNT> GridProfileParse
     { 0xb0, 0x00, 0x38 },
 } };
 
+struct GridProfileSectionRange_t {
+    uint8_t Start; // index in profileValues
+    uint8_t Size;
+};
+
+constexpr uint16_t getSectionKey(const uint8_t section_id, const uint8_t section_version)
+{
+    return static_cast<uint16_t>(section_id) << 8 | section_version;
+}
+
+constexpr bool isSectionStart(const size_t pos)
+{
+    return pos == 0
+        || profileValues[pos].Section != profileValues[pos - 1].Section
+        || profileValues[pos].Version != profileValues[pos - 1].Version;
+}
+
+constexpr size_t countSections()
+{
+    size_t count = 0;
+    for (size_t pos = 0; pos < SECTION_VALUE_COUNT; pos++) {
+        if (isSectionStart(pos)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// The values of a section version have to be defined in one run
+template <size_t N>
+constexpr std::array<std::pair<uint16_t, GridProfileSectionRange_t>, N> makeSectionKeys()
+{
+    std::array<std::pair<uint16_t, GridProfileSectionRange_t>, N> keys = {};
+    size_t count = 0;
+    for (size_t pos = 0; pos < SECTION_VALUE_COUNT; pos++) {
+        if (isSectionStart(pos)) {
+            keys[count].first = getSectionKey(profileValues[pos].Section, profileValues[pos].Version);
+            keys[count].second.Start = pos;
+            count++;
+        }
+        keys[count - 1].second.Size++;
+    }
+    return keys;
+}
+
+constexpr auto sectionKeys = makeSectionKeys<countSections()>();
+static_assert(Utils::hasUniqueKeys(sectionKeys), "Grid profile section values not defined in one run");
+
+constexpr auto sectionIndex = frozen::make_unordered_map(sectionKeys);
+
 GridProfileParser::GridProfileParser()
     : Parser()
 {
@@ -372,6 +444,7 @@ void GridProfileParser::clearBuffer()
 {
     memset(_payloadGridProfile, 0, GRID_PROFILE_SIZE);
     _gridProfileLength = 0;
+    _profileDecoded = false;
 }
 
 void GridProfileParser::appendFragment(const uint8_t offset, const uint8_t* payload, const uint8_t len)
@@ -382,14 +455,14 @@ void GridProfileParser::appendFragment(const uint8_t offset, const uint8_t* payl
     }
     memcpy(&_payloadGridProfile[offset], payload, len);
     _gridProfileLength += len;
+    _profileDecoded = false;
 }
 
 String GridProfileParser::getProfileName() const
 {
-    for (auto& ptype : _profileTypes) {
-        if (ptype.lIdx == _payloadGridProfile[0] && ptype.hIdx == _payloadGridProfile[1]) {
-            return ptype.Name;
-        }
+    auto it = profileTypeIndex.find(getProfileTypeKey(_payloadGridProfile[0], _payloadGridProfile[1]));
+    if (it != profileTypeIndex.end()) {
+        return profileTypes[it->second].Name;
     }
     return "Unknown";
 }
@@ -414,53 +487,55 @@ std::vector<uint8_t> GridProfileParser::getRawData() const
     return ret;
 }
 
-std::list<GridProfileSection_t> GridProfileParser::getProfile() const
+GridProfileView GridProfileParser::getProfileView() const
 {
-    std::list<GridProfileSection_t> l;
-
-    if (_gridProfileLength > 4) {
-        uint16_t pos = 4;
-        do {
-            const uint8_t section_id = _payloadGridProfile[pos];
-            const uint8_t section_version = _payloadGridProfile[pos + 1];
-            const int16_t section_start = getSectionStart(section_id, section_version);
-            const uint8_t section_size = getSectionSize(section_id, section_version);
-            pos += 2;
-
-            GridProfileSection_t section;
-            try {
-                section.SectionName = profileSection.at(section_id).data();
-            } catch (const std::out_of_range&) {
-                section.SectionName = "Unknown";
-                break;
-            }
+    GridProfileView view;
 
-            if (section_start == -1) {
-                section.SectionName = "Unknown";
-                break;
-            }
-
-            for (uint8_t val_id = 0; val_id < section_size; val_id++) {
-                auto itemDefinition = itemDefinitions.at(_profileValues[section_start + val_id].ItemDefinition);
+    HOY_SEMAPHORE_TAKE();
+    if (!_profileDecoded) {
+        decodeProfile();
+    }
+    memcpy(view._payload, _payloadGridProfile, GRID_PROFILE_SIZE);
+    view._sections = _sections;
+    view._sectionCount = _sectionCount;
+    HOY_SEMAPHORE_GIVE();
 
-                float value = (int16_t)((_payloadGridProfile[pos] << 8) | _payloadGridProfile[pos + 1]);
-                value /= itemDefinition.Divider;
+    return view;
+}
 
-                GridProfileItem_t v;
-                v.Name = itemDefinition.Name.data();
-                v.Unit = itemDefinition.Unit.data();
-                v.Value = value;
-                section.items.push_back(v);
+/*
+ * Locates the sections in the payload. Decoding stops at the first unknown
+ * section or version as the size of its values is not known.
+ */
+void GridProfileParser::decodeProfile() const
+{
+    _sectionCount = 0;
+    _profileDecoded = true;
+
+    uint16_t pos = 4;
+    while (pos < _gridProfileLength && pos + 2 <= GRID_PROFILE_SIZE && _sectionCount < GRID_PROFILE_MAX_SECTIONS) {
+        const uint8_t section_id = _payloadGridProfile[pos];
+        const uint8_t section_version = _payloadGridProfile[pos + 1];
+        const int16_t section_start = getSectionStart(section_id, section_version);
+        const uint8_t section_size = getSectionSize(section_id, section_version);
+        pos += 2;
+
+        if (section_start == -1 || profileSection.find(section_id) == profileSection.end()) {
+            break;
+        }
 
-                pos += 2;
-            }
+        if (pos + section_size * 2 > GRID_PROFILE_SIZE) {
+            break;
+        }
 
-            l.push_back(section);
+        GridProfileSectionIndex_t& section = _sections[_sectionCount++];
+        section.SectionId = section_id;
+        section.ValueStart = section_start;
+        section.ValueCount = section_size;
+        section.PayloadPos = pos;
 
-        } while (pos < _gridProfileLength);
+        pos += section_size * 2;
     }
-
-    return l;
 }
 
 bool GridProfileParser::containsValidData() const
@@ -470,23 +545,113 @@ bool GridProfileParser::containsValidData() const
 
 uint8_t GridProfileParser::getSectionSize(const uint8_t section_id, const uint8_t section_version)
 {
-    uint8_t count = 0;
-    for (auto& values : _profileValues) {
-        if (values.Section == section_id && values.Version == section_version) {
-            count++;
-        }
-    }
-    return count;
+    auto it = sectionIndex.find(getSectionKey(section_id, section_version));
+    return it != sectionIndex.end() ? it->second.Size : 0;
 }
 
 int16_t GridProfileParser::getSectionStart(const uint8_t section_id, const uint8_t section_version)
 {
-    int16_t count = -1;
-    for (auto& values : _profileValues) {
-        count++;
-        if (values.Section == section_id && values.Version == section_version) {
-            break;
-        }
-    }
-    return count;
+    auto it = sectionIndex.find(getSectionKey(section_id, section_version));
+    return it != sectionIndex.end() ? it->second.Start : -1;
+}
+
+uint8_t GridProfileView::getSectionCount() const
+{
+    return _sectionCount;
+}
+
+GridProfileSection GridProfileView::getSection(const uint8_t sectionId) const
+{
+    return GridProfileSection(*this, _sections[sectionId]);
+}
+
+GridProfileView::Iterator GridProfileView::begin() const
+{
+    return Iterator(*this, 0);
+}
+
+GridProfileView::Iterator GridProfileView::end() const
+{
+    return Iterator(*this, _sectionCount);
+}
+
+GridProfileView::Iterator::Iterator(const GridProfileView& view, const uint8_t pos)
+    : _view(view)
+    , _pos(pos)
+{
+}
+
+GridProfileSection GridProfileView::Iterator::operator*() const
+{
+    return _view.getSection(_pos);
+}
+
+GridProfileView::Iterator& GridProfileView::Iterator::operator++()
+{
+    _pos++;
+    return *this;
+}
+
+bool GridProfileView::Iterator::operator!=(const Iterator& other) const
+{
+    return _pos != other._pos;
+}
+
+GridProfileSection::GridProfileSection(const GridProfileView& view, const GridProfileSectionIndex_t& index)
+    : _view(view)
+    , _index(index)
+{
+}
+
+const char* GridProfileSection::getName() const
+{
+    return profileSection.at(_index.SectionId).data();
+}
+
+uint8_t GridProfileSection::getItemCount() const
+{
+    return _index.ValueCount;
+}
+
+GridProfileItem_t GridProfileSection::getItem(const uint8_t itemId) const
+{
+    const auto& itemDefinition = itemDefinitions.at(profileValues[_index.ValueStart + itemId].ItemDefinition);
+    const uint8_t pos = _index.PayloadPos + itemId * 2;
+
+    float value = (int16_t)((_view._payload[pos] << 8) | _view._payload[pos + 1]);
+    value /= itemDefinition.Divider;
+
+    return { itemDefinition.Name.data(), itemDefinition.Unit.data(), value };
+}
+
+GridProfileSection::Iterator GridProfileSection::begin() const
+{
+    return Iterator(*this, 0);
+}
+
+GridProfileSection::Iterator GridProfileSection::end() const
+{
+    return Iterator(*this, _index.ValueCount);
+}
+
+GridProfileSection::Iterator::Iterator(const GridProfileSection& section, const uint8_t pos)
+    : _section(section)
+    , _pos(pos)
+{
+}
+
+GridProfileItem_t GridProfileSection::Iterator::operator*() const
+{
+    return _section.getItem(_pos);
+}
+
+GridProfileSection::Iterator& GridProfileSection::Iterator::operator++()
+{
+    _pos++;
+    return *this;
+}
+
+bool GridProfileSection::Iterator::operator!=(const Iterator& other) const
+{
+    return _pos != other._pos;
 }
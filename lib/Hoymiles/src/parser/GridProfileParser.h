@@ -1,7 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 #pragma once
 #include "Parser.h"
-#include <list>
+#include <array>
 
 #define GRID_PROFILE_SIZE 141
 #define PROFILE_TYPE_COUNT 10
@@ -19,15 +19,81 @@ struct GridProfileValue_t {
     uint8_t ItemDefinition;
 };
 
+#define GRID_PROFILE_MAX_SECTIONS 16
+
 struct GridProfileItem_t {
-    String Name;
-    String Unit;
+    const char* Name;
+    const char* Unit;
     float Value;
 };
 
-struct GridProfileSection_t {
-    String SectionName;
-    std::list<GridProfileItem_t> items;
+// Position of a section as decoded from the payload
+struct GridProfileSectionIndex_t {
+    uint8_t SectionId;
+    uint8_t ValueStart; // index of the first value definition
+    uint8_t ValueCount;
+    uint8_t PayloadPos; // offset of the first value in the payload
+};
+
+class GridProfileView;
+
+class GridProfileSection {
+public:
+    class Iterator {
+    public:
+        Iterator(const GridProfileSection& section, const uint8_t pos);
+        GridProfileItem_t operator*() const;
+        Iterator& operator++();
+        bool operator!=(const Iterator& other) const;
+
+    private:
+        const GridProfileSection& _section;
+        uint8_t _pos;
+    };
+
+    GridProfileSection(const GridProfileView& view, const GridProfileSectionIndex_t& index);
+
+    const char* getName() const;
+    uint8_t getItemCount() const;
+    GridProfileItem_t getItem(const uint8_t itemId) const;
+
+    Iterator begin() const;
+    Iterator end() const;
+
+private:
+    const GridProfileView& _view;
+    const GridProfileSectionIndex_t& _index;
+};
+
+// Copy of a decoded grid profile. Names and units point to static strings,
+// so iterating the profile does not allocate memory.
+class GridProfileView {
+public:
+    class Iterator {
+    public:
+        Iterator(const GridProfileView& view, const uint8_t pos);
+        GridProfileSection operator*() const;
+        Iterator& operator++();
+        bool operator!=(const Iterator& other) const;
+
+    private:
+        const GridProfileView& _view;
+        uint8_t _pos;
+    };
+
+    uint8_t getSectionCount() const;
+    GridProfileSection getSection(const uint8_t sectionId) const;
+
+    Iterator begin() const;
+    Iterator end() const;
+
+private:
+    friend class GridProfileParser;
+    friend class GridProfileSection;
+
+    uint8_t _payload[GRID_PROFILE_SIZE];
+    std::array<GridProfileSectionIndex_t, GRID_PROFILE_MAX_SECTIONS> _sections;
+    uint8_t _sectionCount = 0;
 };
 
 class GridProfileParser : public Parser {
@@ -41,7 +107,8 @@ public:
 
     std::vector<uint8_t> getRawData() const;
 
-    std::list<GridProfileSection_t> getProfile() const;
+    // The profile is decoded on the first call after new data was received
+    GridProfileView getProfileView() const;
 
     bool containsValidData() const;
 
@@ -49,9 +116,12 @@ private:
     static uint8_t getSectionSize(const uint8_t section_id, const uint8_t section_version);
     static int16_t getSectionStart(const uint8_t section_id, const uint8_t section_version);
 
+    void decodeProfile() const;
+
     uint8_t _payloadGridProfile[GRID_PROFILE_SIZE] = {};
     uint8_t _gridProfileLength = 0;
 
-    static const std::array<const ProfileType_t, PROFILE_TYPE_COUNT> _profileTypes;
-    static const std::array<const GridProfileValue_t, SECTION_VALUE_COUNT> _profileValues;
+    mutable std::array<GridProfileSectionIndex_t, GRID_PROFILE_MAX_SECTIONS> _sections;
+    mutable uint8_t _sectionCount = 0;
+    mutable bool _profileDecoded = false;
 };
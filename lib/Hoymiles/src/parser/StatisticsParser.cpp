@@ -4,6 +4,7 @@
  */
 #include "StatisticsParser.h"
 #include "../Hoymiles.h"
+#include <cmath>
 
 static float calcTotalYieldTotal(StatisticsParser* iv, uint8_t arg0);
 static float calcTotalYieldDay(StatisticsParser* iv, uint8_t arg0);
@@ -185,6 +186,44 @@ float StatisticsParser::getChannelFieldValue(const ChannelType_t type, const Cha
     return 0;
 }
 
+int32_t StatisticsParser::getChannelFieldFixedPoint(const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId)
+{
+    const byteAssign_t* pos = getAssignmentByChannelField(type, channel, fieldId);
+    if (pos == nullptr) {
+        return 0;
+    }
+
+    uint32_t scale = 1;
+    for (uint8_t i = 0; i < pos->digits; i++) {
+        scale *= 10;
+    }
+
+    const fieldSettings_t* setting = getSettingByChannelField(type, channel, fieldId);
+    const bool hasOffset = setting != nullptr && setting->offset != 0 && _statisticLength > 0;
+
+    // Most static values use a divisor matching their digits. Their raw
+    // value already is the fixed point representation.
+    if (pos->div == scale && !hasOffset) {
+        uint8_t ptr = pos->start;
+        const uint8_t end = ptr + pos->num;
+
+        uint32_t val = 0;
+        HOY_SEMAPHORE_TAKE();
+        do {
+            val <<= 8;
+            val |= _payloadStatistic[ptr];
+        } while (++ptr != end);
+        HOY_SEMAPHORE_GIVE();
+
+        if (pos->isSigned && pos->num == 2) {
+            return static_cast<int16_t>(val);
+        }
+        return static_cast<int32_t>(val);
+    }
+
+    return lroundf(getChannelFieldValue(type, channel, fieldId) * scale);
+}
+
 bool StatisticsParser::setChannelFieldValue(const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId, float value)
 {
     const byteAssign_t* pos = getAssignmentByChannelField(type, channel, fieldId);
@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2024 Thomas Basler and others
+ */
+#include "JsonStreamWriter.h"
+
+JsonStreamWriter::JsonStreamWriter(Print& output)
+    : _output(output)
+{
+}
+
+void JsonStreamWriter::beginObject(const char* key)
+{
+    writePrefix(key);
+    _output.write('{');
+    if (_depth < JSON_STREAM_MAX_DEPTH) {
+        _first[_depth] = true;
+    }
+    _depth++;
+}
+
+void JsonStreamWriter::endObject()
+{
+    _depth--;
+    _output.write('}');
+}
+
+void JsonStreamWriter::beginArray(const char* key)
+{
+    writePrefix(key);
+    _output.write('[');
+    if (_depth < JSON_STREAM_MAX_DEPTH) {
+        _first[_depth] = true;
+    }
+    _depth++;
+}
+
+void JsonStreamWriter::endArray()
+{
+    _depth--;
+    _output.write(']');
+}
+
+void JsonStreamWriter::add(const char* key, JsonVariantConst value)
+{
+    writePrefix(key);
+    serializeJson(value, _output);
+}
+
+void JsonStreamWriter::add(JsonVariantConst value)
+{
+    add(nullptr, value);
+}
+
+void JsonStreamWriter::addValue(const char* key, const bool value)
+{
+    writePrefix(key);
+    _output.print(value ? "true" : "false");
+}
+
+void JsonStreamWriter::addValue(const char* key, const char* value)
+{
+    writePrefix(key);
+    if (value == nullptr) {
+        _output.print("null");
+    } else {
+        writeString(value);
+    }
+}
+
+void JsonStreamWriter::addValue(const char* key, const String& value)
+{
+    addValue(key, value.c_str());
+}
+
+void JsonStreamWriter::addMembers(JsonObjectConst obj)
+{
+    for (JsonPairConst kv : obj) {
+        add(kv.key().c_str(), kv.value());
+    }
+}
+
+void JsonStreamWriter::fail()
+{
+    _failed = true;
+}
+
+bool JsonStreamWriter::hasFailed() const
+{
+    return _failed;
+}
+
+void JsonStreamWriter::writePrefix(const char* key)
+{
+    if (_depth > 0 && _depth <= JSON_STREAM_MAX_DEPTH) {
+        if (!_first[_depth - 1]) {
+            _output.write(',');
+        }
+        _first[_depth - 1] = false;
+    }
+
+    if (key != nullptr) {
+        writeString(key);
+        _output.write(':');
+    }
+}
+
+/*
+ * Escapes like ArduinoJson: quotes, backslashes and the control characters
+ * with a short escape sequence. Everything else, including UTF-8, is copied.
+ */
+void JsonStreamWriter::writeString(const char* value)
+{
+    _output.write('"');
+
+    const char* start = value;
+    for (; *value != '\0'; value++) {
+        char escaped;
+        switch (*value) {
+        case '"':
+            escaped = '"';
+            break;
+        case '\\':
+            escaped = '\\';
+            break;
+        case '\b':
+            escaped = 'b';
+            break;
+        case '\f':
+            escaped = 'f';
+            break;
+        case '\n':
+            escaped = 'n';
+            break;
+        case '\r':
+            escaped = 'r';
+            break;
+        case '\t':
+            escaped = 't';
+            break;
+        default:
+            continue;
+        }
+
+        _output.write(reinterpret_cast<const uint8_t*>(start), value - start);
+        _output.write('\\');
+        _output.write(escaped);
+        start = value + 1;
+    }
+    _output.write(reinterpret_cast<const uint8_t*>(start), value - start);
+
+    _output.write('"');
+}
+
+void JsonStreamWriter::writeInteger(uint64_t value, const bool negative)
+{
+    char buffer[21];
+    char* pos = buffer + sizeof(buffer);
+
+    do {
+        *--pos = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+
+    if (negative) {
+        *--pos = '-';
+    }
+    _output.write(reinterpret_cast<const uint8_t*>(pos), buffer + sizeof(buffer) - pos);
+}
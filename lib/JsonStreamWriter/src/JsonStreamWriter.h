@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <ArduinoJson.h>
+#include <Print.h>
+#include <WString.h>
+#include <cstdint>
+#include <type_traits>
+
+#define JSON_STREAM_MAX_DEPTH 8
+
+// Writes JSON to a Print while the data is walked instead of building the
+// whole document first. Nested values are serialized by ArduinoJson and
+// scalars are formatted the same way, so the output is identical to
+// serializing the complete document.
+class JsonStreamWriter {
+public:
+    explicit JsonStreamWriter(Print& output);
+
+    // key has to be nullptr for array elements
+    void beginObject(const char* key = nullptr);
+    void endObject();
+    void beginArray(const char* key = nullptr);
+    void endArray();
+
+    void add(const char* key, JsonVariantConst value);
+    void add(JsonVariantConst value);
+
+    // Scalars are written without a document. Floating point values have
+    // to be added as a JsonVariantConst.
+    void addValue(const char* key, const bool value);
+    void addValue(const char* key, const char* value);
+    void addValue(const char* key, const String& value);
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value>::type addValue(const char* key, const T value)
+    {
+        writePrefix(key);
+        if (std::is_signed<T>::value && static_cast<int64_t>(value) < 0) {
+            writeInteger(static_cast<uint64_t>(0) - static_cast<uint64_t>(value), true);
+        } else {
+            writeInteger(static_cast<uint64_t>(value), false);
+        }
+    }
+
+    // Adds all members of obj to the current object
+    void addMembers(JsonObjectConst obj);
+
+    // Marks the output as incomplete, for example if a document could not
+    // be allocated
+    void fail();
+    bool hasFailed() const;
+
+private:
+    void writePrefix(const char* key);
+    void writeString(const char* value);
+    void writeInteger(uint64_t value, const bool negative);
+
+    Print& _output;
+    uint8_t _depth = 0;
+    bool _first[JSON_STREAM_MAX_DEPTH] = {};
+    bool _failed = false;
+};
@@ -1,171 +1,175 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 /*
- * Copyright (C) 2022 Thomas Basler and others
+ * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "MqttSubscribeParser.h"
+#include <cstring>
 
-void MqttSubscribeParser::register_callback(const std::string& topic, uint8_t qos, const espMqttClientTypes::OnMessageCallback& cb)
+bool MqttSubscribeParser::register_callback(const std::string& topic, uint8_t qos, const espMqttClientTypes::OnMessageCallback& cb)
 {
+    if (!is_valid_filter(topic)) {
+        return false;
+    }
+
     cb_filter_t cbf;
     cbf.topic = topic;
     cbf.qos = qos;
     cbf.cb = cb;
-    _callbacks.push_back(cbf);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    topic_node_t* node = &_root;
+    std::string_view levels(topic);
+    while (true) {
+        const size_t pos = levels.find('/');
+        const std::string_view level = levels.substr(0, pos);
+
+        auto it = node->children.find(level);
+        if (it == node->children.end()) {
+            it = node->children.emplace(std::string(level), std::make_unique<topic_node_t>()).first;
+        }
+        node = it->second.get();
+
+        if (pos == std::string_view::npos) {
+            break;
+        }
+        levels.remove_prefix(pos + 1);
+    }
+
+    node->callbacks.push_back(cbf);
+    return true;
 }
 
 void MqttSubscribeParser::unregister_callback(const std::string& topic)
 {
-    for (auto it = _callbacks.begin(); it != _callbacks.end();) {
-        if ((*it).topic == topic) {
-            it = _callbacks.erase(it);
-        } else {
-            ++it;
-        }
-    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    remove_filter(_root, topic, topic);
 }
 
 void MqttSubscribeParser::handle_message(const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, size_t len, size_t index, size_t total)
 {
-    bool result = false;
-    for (const auto& cb : _callbacks) {
-        if (mosquitto_topic_matches_sub(cb.topic.c_str(), topic, &result) == MOSQ_ERR_SUCCESS) {
-            if (result) {
-                cb.cb(properties, topic, payload, len, index, total);
-            }
-        }
+    if (topic == nullptr || topic[0] == 0) {
+        return;
     }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    match_node(_root, topic, true, properties, topic, payload, len, index, total);
 }
 
 std::vector<cb_filter_t> MqttSubscribeParser::get_callbacks()
 {
-    return _callbacks;
+    std::vector<cb_filter_t> result;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    collect_callbacks(_root, result);
+    return result;
 }
 
-/* Does a topic match a subscription? */
-int MqttSubscribeParser::mosquitto_topic_matches_sub(const char* sub, const char* topic, bool* result)
+/* Checks the filter for the wildcard rules of MQTT v3.1.1 chapter 4.7 */
+bool MqttSubscribeParser::is_valid_filter(const std::string& topic)
 {
-    size_t spos;
+    if (topic.empty()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < topic.size(); i++) {
+        const char c = topic[i];
+        if (c != '+' && c != '#') {
+            continue;
+        }
 
-    if (!result)
-        return MOSQ_ERR_INVAL;
-    *result = false;
+        /* Wildcards have to occupy a whole topic level */
+        if (i > 0 && topic[i - 1] != '/') {
+            return false;
+        }
+        if (i + 1 < topic.size() && topic[i + 1] != '/') {
+            return false;
+        }
 
-    if (!sub || !topic || sub[0] == 0 || topic[0] == 0) {
-        return MOSQ_ERR_INVAL;
+        /* Multi level wildcard has to be the last character */
+        if (c == '#' && i + 1 != topic.size()) {
+            return false;
+        }
     }
 
-    if ((sub[0] == '$' && topic[0] != '$')
-        || (topic[0] == '$' && sub[0] != '$')) {
+    return true;
+}
+
+/*
+ * Walks the tree level by level. level points to the start of the current
+ * topic level or is nullptr if all levels of the topic have been consumed.
+ */
+void MqttSubscribeParser::match_node(const topic_node_t& node, const char* level, const bool is_first_level,
+    const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, size_t len, size_t index, size_t total)
+{
+    /* Wildcards at the first level must not match topics starting with $ */
+    const bool wildcards_allowed = !(is_first_level && level != nullptr && level[0] == '$');
 
-        return MOSQ_ERR_SUCCESS;
+    if (wildcards_allowed) {
+        /* "#" also matches the parent level, e.g. foo/# matches foo */
+        const auto hash = node.children.find("#");
+        if (hash != node.children.end()) {
+            for (const auto& cb : hash->second->callbacks) {
+                cb.cb(properties, topic, payload, len, index, total);
+            }
+        }
     }
 
-    spos = 0;
+    if (level == nullptr) {
+        for (const auto& cb : node.callbacks) {
+            cb.cb(properties, topic, payload, len, index, total);
+        }
+        return;
+    }
+
+    const char* level_end = strchr(level, '/');
+    const size_t level_len = level_end != nullptr ? level_end - level : strlen(level);
+    const char* next_level = level_end != nullptr ? level_end + 1 : nullptr;
+
+    const auto exact = node.children.find(std::string_view(level, level_len));
+    if (exact != node.children.end()) {
+        match_node(*exact->second, next_level, false, properties, topic, payload, len, index, total);
+    }
 
-    while (sub[0] != 0) {
-        if (topic[0] == '+' || topic[0] == '#') {
-            return MOSQ_ERR_INVAL;
+    if (wildcards_allowed) {
+        const auto plus = node.children.find("+");
+        if (plus != node.children.end()) {
+            match_node(*plus->second, next_level, false, properties, topic, payload, len, index, total);
         }
-        if (sub[0] != topic[0] || topic[0] == 0) { /* Check for wildcard matches */
-            if (sub[0] == '+') {
-                /* Check for bad "+foo" or "a/+foo" subscription */
-                if (spos > 0 && sub[-1] != '/') {
-                    return MOSQ_ERR_INVAL;
-                }
-                /* Check for bad "foo+" or "foo+/a" subscription */
-                if (sub[1] != 0 && sub[1] != '/') {
-                    return MOSQ_ERR_INVAL;
-                }
-                spos++;
-                sub++;
-                while (topic[0] != 0 && topic[0] != '/') {
-                    if (topic[0] == '+' || topic[0] == '#') {
-                        return MOSQ_ERR_INVAL;
-                    }
-                    topic++;
-                }
-                if (topic[0] == 0 && sub[0] == 0) {
-                    *result = true;
-                    return MOSQ_ERR_SUCCESS;
-                }
-            } else if (sub[0] == '#') {
-                /* Check for bad "foo#" subscription */
-                if (spos > 0 && sub[-1] != '/') {
-                    return MOSQ_ERR_INVAL;
-                }
-                /* Check for # not the final character of the sub, e.g. "#foo" */
-                if (sub[1] != 0) {
-                    return MOSQ_ERR_INVAL;
-                } else {
-                    while (topic[0] != 0) {
-                        if (topic[0] == '+' || topic[0] == '#') {
-                            return MOSQ_ERR_INVAL;
-                        }
-                        topic++;
-                    }
-                    *result = true;
-                    return MOSQ_ERR_SUCCESS;
-                }
+    }
+}
+
+void MqttSubscribeParser::remove_filter(topic_node_t& node, std::string_view levels, const std::string& topic)
+{
+    const size_t pos = levels.find('/');
+    const auto it = node.children.find(levels.substr(0, pos));
+    if (it == node.children.end()) {
+        return;
+    }
+
+    topic_node_t& child = *it->second;
+    if (pos == std::string_view::npos) {
+        for (auto cb = child.callbacks.begin(); cb != child.callbacks.end();) {
+            if ((*cb).topic == topic) {
+                cb = child.callbacks.erase(cb);
             } else {
-                /* Check for e.g. foo/bar matching foo/+/# */
-                if (topic[0] == 0
-                    && spos > 0
-                    && sub[-1] == '+'
-                    && sub[0] == '/'
-                    && sub[1] == '#') {
-                    *result = true;
-                    return MOSQ_ERR_SUCCESS;
-                }
-
-                /* There is no match at this point, but is the sub invalid? */
-                while (sub[0] != 0) {
-                    if (sub[0] == '#' && sub[1] != 0) {
-                        return MOSQ_ERR_INVAL;
-                    }
-                    spos++;
-                    sub++;
-                }
-
-                /* Valid input, but no match */
-                return MOSQ_ERR_SUCCESS;
-            }
-        } else {
-            /* sub[spos] == topic[tpos] */
-            if (topic[1] == 0) {
-                /* Check for e.g. foo matching foo/# */
-                if (sub[1] == '/'
-                    && sub[2] == '#'
-                    && sub[3] == 0) {
-                    *result = true;
-                    return MOSQ_ERR_SUCCESS;
-                }
-            }
-            spos++;
-            sub++;
-            topic++;
-            if (sub[0] == 0 && topic[0] == 0) {
-                *result = true;
-                return MOSQ_ERR_SUCCESS;
-            } else if (topic[0] == 0 && sub[0] == '+' && sub[1] == 0) {
-                if (spos > 0 && sub[-1] != '/') {
-                    return MOSQ_ERR_INVAL;
-                }
-                spos++;
-                sub++;
-                *result = true;
-                return MOSQ_ERR_SUCCESS;
+                ++cb;
             }
         }
+    } else {
+        remove_filter(child, levels.substr(pos + 1), topic);
     }
-    if ((topic[0] != 0 || sub[0] != 0)) {
-        *result = false;
-    }
-    while (topic[0] != 0) {
-        if (topic[0] == '+' || topic[0] == '#') {
-            return MOSQ_ERR_INVAL;
-        }
-        topic++;
+
+    /* Prune levels which are not used by any subscription anymore */
+    if (child.callbacks.empty() && child.children.empty()) {
+        node.children.erase(it);
     }
+}
 
-    return MOSQ_ERR_SUCCESS;
+void MqttSubscribeParser::collect_callbacks(const topic_node_t& node, std::vector<cb_filter_t>& result)
+{
+    result.insert(result.end(), node.callbacks.begin(), node.callbacks.end());
+    for (const auto& child : node.children) {
+        collect_callbacks(*child.second, result);
+    }
 }
@@ -3,7 +3,11 @@
 
 #include <cstdint>
 #include <espMqttClient.h>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <vector>
 
 struct cb_filter_t {
@@ -14,18 +18,31 @@ struct cb_filter_t {
 
 class MqttSubscribeParser {
 public:
-    void register_callback(const std::string& topic, uint8_t qos, const espMqttClientTypes::OnMessageCallback& cb);
+    // Returns false if the topic is not a valid MQTT filter
+    bool register_callback(const std::string& topic, uint8_t qos, const espMqttClientTypes::OnMessageCallback& cb);
     void unregister_callback(const std::string& topic);
+
+    // Callbacks are invoked while the subscription tree is locked.
+    // They must not (un)register subscriptions themselves.
     void handle_message(const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, size_t len, size_t index, size_t total);
     std::vector<cb_filter_t> get_callbacks();
 
+    static bool is_valid_filter(const std::string& topic);
+
 private:
-    int mosquitto_topic_matches_sub(const char* sub, const char* topic, bool* result);
+    // One node per topic level. Wildcards are stored as regular
+    // children with the level names "+" and "#".
+    struct topic_node_t {
+        std::map<std::string, std::unique_ptr<topic_node_t>, std::less<>> children;
+        std::vector<cb_filter_t> callbacks;
+    };
 
-    std::vector<cb_filter_t> _callbacks;
+    void match_node(const topic_node_t& node, const char* level, const bool is_first_level,
+        const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, size_t len, size_t index, size_t total);
 
-    enum mosq_err_t {
-        MOSQ_ERR_SUCCESS = 0,
-        MOSQ_ERR_INVAL = 3,
-    };
-};
\ No newline at end of file
+    static void remove_filter(topic_node_t& node, std::string_view levels, const std::string& topic);
+    static void collect_callbacks(const topic_node_t& node, std::vector<cb_filter_t>& result);
+
+    topic_node_t _root;
+    std::mutex _mutex;
+};
@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2024 Thomas Basler and others
+ */
+#include "WallClock.h"
+#include <sys/time.h>
+
+WallClockClass WallClock;
+
+uint32_t WallClockClass::loop()
+{
+    struct timeval now;
+    gettimeofday(&now, nullptr);
+
+    if (now.tv_sec != _lastSecond) {
+        _lastSecond = now.tv_sec;
+
+        struct tm local;
+        localtime_r(&now.tv_sec, &local);
+        const bool synced = now.tv_sec >= WALL_CLOCK_MIN_VALID_TIME;
+        const uint16_t minuteOfDay = local.tm_hour * 60 + local.tm_min;
+
+        bool wasSynced;
+        struct tm lastLocal;
+        uint16_t lastMinuteOfDay;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            wasSynced = _synced;
+            lastLocal = _local;
+            lastMinuteOfDay = _minuteOfDay;
+
+            _synced = synced;
+            _epoch = now.tv_sec;
+            _local = local;
+            _minuteOfDay = minuteOfDay;
+        }
+
+        if (synced) {
+            if (!wasSynced) {
+                raiseEvent(wall_clock_event::WALL_CLOCK_SYNCED);
+            } else if (local.tm_mday != lastLocal.tm_mday || local.tm_mon != lastLocal.tm_mon || local.tm_year != lastLocal.tm_year) {
+                raiseEvent(wall_clock_event::WALL_CLOCK_DAY_CHANGED);
+            }
+
+            if (!wasSynced || minuteOfDay != lastMinuteOfDay) {
+                raiseEvent(wall_clock_event::WALL_CLOCK_MINUTE_CHANGED);
+            }
+        }
+    }
+
+    return 1000 - now.tv_usec / 1000;
+}
+
+bool WallClockClass::isSynced() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _synced;
+}
+
+time_t WallClockClass::getEpoch() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _epoch;
+}
+
+bool WallClockClass::getLocalTime(struct tm& info) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    info = _local;
+    return _synced;
+}
+
+uint16_t WallClockClass::getMinuteOfDay() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _minuteOfDay;
+}
+
+bool WallClockClass::onEvent(WallClockEventCb cbEvent, const wall_clock_event event)
+{
+    if (!cbEvent) {
+        return false;
+    }
+    _cbEventList.push_back({ cbEvent, event });
+    return true;
+}
+
+void WallClockClass::raiseEvent(const wall_clock_event event)
+{
+    for (auto& entry : _cbEventList) {
+        if (entry.event == event || entry.event == wall_clock_event::WALL_CLOCK_EVENT_MAX) {
+            entry.cb(event);
+        }
+    }
+}
@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// Earlier times are treated as not synchronized (2017-01-01), this matches
+// the check of getLocalTime()
+#define WALL_CLOCK_MIN_VALID_TIME 1483228800
+
+enum class wall_clock_event {
+    WALL_CLOCK_SYNCED, // first valid time after boot
+    WALL_CLOCK_MINUTE_CHANGED,
+    WALL_CLOCK_DAY_CHANGED, // local midnight or a date change while synchronized
+    WALL_CLOCK_EVENT_MAX
+};
+
+typedef std::function<void(wall_clock_event event)> WallClockEventCb;
+
+typedef struct WallClockEventCbList {
+    WallClockEventCb cb;
+    wall_clock_event event;
+} WallClockEventCbList_t;
+
+/*
+ * Caches the current time and its local representation. The cache is
+ * updated once per second by loop(), so the getters neither wait for a
+ * synchronization nor convert the time. They can be used from any task.
+ */
+class WallClockClass {
+public:
+    // Updates the cache if the second changed and raises the events. Has to
+    // be called by a single task. Returns the time in ms until the next
+    // second starts.
+    uint32_t loop();
+
+    bool isSynced() const;
+
+    // Seconds since epoch, only valid if isSynced()
+    time_t getEpoch() const;
+
+    // Copies the local time to info, returns false if not synchronized
+    bool getLocalTime(struct tm& info) const;
+
+    // Minutes since local midnight, only valid if isSynced()
+    uint16_t getMinuteOfDay() const;
+
+    // Handlers are called by the task calling loop(). Have to be registered
+    // before loop() is called the first time.
+    bool onEvent(WallClockEventCb cbEvent, const wall_clock_event event = wall_clock_event::WALL_CLOCK_EVENT_MAX);
+
+private:
+    void raiseEvent(const wall_clock_event event);
+
+    time_t _lastSecond = 0;
+
+    mutable std::mutex _mutex;
+    bool _synced = false;
+    time_t _epoch = 0;
+    struct tm _local = {};
+    uint16_t _minuteOfDay = 0;
+
+    std::vector<WallClockEventCbList_t> _cbEventList;
+};
+
+extern WallClockClass WallClock;
@@ -0,0 +1,379 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2024 Thomas Basler and others
+ */
+#include "AlarmHistory.h"
+#include "MessageOutput.h"
+#include <LittleFS.h>
+#include <WallClock.h>
+#include <algorithm>
+
+// Records per index block
+#define ALARM_HISTORY_BLOCK_SIZE 32
+
+// Pending records are written once this many are collected or the oldest
+// one waited for ALARM_HISTORY_FLUSH_INTERVAL ms
+#define ALARM_HISTORY_BATCH_SIZE 16
+#define ALARM_HISTORY_FLUSH_INTERVAL (10 * 60 * 1000)
+
+// Upper limit of records kept in memory if writing fails
+#define ALARM_HISTORY_MAX_PENDING 128
+
+AlarmHistoryClass AlarmHistory;
+
+AlarmHistoryClass::AlarmHistoryClass()
+    : _loopTask("alarm_history", 1 * TASK_SECOND, TASK_FOREVER, std::bind(&AlarmHistoryClass::loop, this))
+{
+}
+
+void AlarmHistoryClass::init(Scheduler& scheduler)
+{
+    loadIndex();
+
+    if (xTaskCreate(writerTask, "alarm_history", ALARM_HISTORY_WRITER_STACK_SIZE, this, ALARM_HISTORY_WRITER_PRIORITY, &_writerTask) != pdPASS) {
+        MessageOutput.println("Alarm history: failed to start writer task");
+        return;
+    }
+
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+void AlarmHistoryClass::loop()
+{
+    // A request reading the history must not stall the main loop
+    std::unique_lock<std::mutex> lock(_mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        return;
+    }
+
+    const InverterListPtr inverters = Hoymiles.getInverters();
+    for (auto& inv : *inverters) {
+        collect(inv);
+    }
+
+    if (_pending.empty() || _flushRequested) {
+        return;
+    }
+
+    if (_pending.size() < ALARM_HISTORY_BATCH_SIZE && millis() - _pendingSince < ALARM_HISTORY_FLUSH_INTERVAL) {
+        return;
+    }
+
+    // Do not retry a failed write on every iteration
+    if (_flushFailed && millis() - _lastFlushError < ALARM_HISTORY_FLUSH_INTERVAL) {
+        return;
+    }
+
+    // Flash writes are only started between two radio transactions
+    if (!Hoymiles.isAllRadioIdle()) {
+        return;
+    }
+
+    _flushRequested = true;
+    xTaskNotifyGive(_writerTask);
+}
+
+// Does the file I/O outside of the main loop, which skips its iterations
+// while the mutex is held
+void AlarmHistoryClass::writerTask(void* instance)
+{
+    AlarmHistoryClass* history = static_cast<AlarmHistoryClass*>(instance);
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        std::lock_guard<std::mutex> lock(history->_mutex);
+        history->_flushRequested = false;
+
+        history->_flushFailed = !history->flush();
+        if (!history->_flushFailed) {
+            continue;
+        }
+
+        history->_lastFlushError = millis();
+        if (history->_pending.size() > ALARM_HISTORY_MAX_PENDING) {
+            history->_droppedCount += history->_pending.size() - ALARM_HISTORY_MAX_PENDING;
+            history->_pending.erase(history->_pending.begin(), history->_pending.end() - ALARM_HISTORY_MAX_PENDING);
+            MessageOutput.printf("Alarm history: %u records dropped\r\n", history->_droppedCount);
+        }
+    }
+}
+
+/*
+ * Compares the event log of an inverter with the one seen before. The
+ * inverter repeats its last ALARM_LOG_ENTRY_COUNT alarms on every request,
+ * so an alarm is identified by inverter, message id and start time. The
+ * start time as reported by the inverter is compared, a changed timezone
+ * offset would shift the converted times of all alarms otherwise.
+ */
+void AlarmHistoryClass::collect(std::shared_ptr<InverterAbstract> inv)
+{
+    inverter_state_t& state = _inverters[inv->serial()];
+
+    const uint32_t lastUpdate = inv->EventLog()->getLastUpdate();
+    if (lastUpdate == 0 || lastUpdate == state.lastUpdate) {
+        return;
+    }
+
+    // The event log only contains the time of day
+    struct tm timeinfo;
+    if (!WallClock.getLocalTime(timeinfo)) {
+        return;
+    }
+    const time_t now = WallClock.getEpoch();
+    timeinfo.tm_hour = 0;
+    timeinfo.tm_min = 0;
+    timeinfo.tm_sec = 0;
+    timeinfo.tm_isdst = -1;
+    const time_t midnight = mktime(&timeinfo);
+
+    state.lastUpdate = lastUpdate;
+
+    const int timezoneOffset = AlarmLogParser::getTimezoneOffset();
+
+    std::vector<known_alarm_t> alarms;
+    for (uint8_t i = 0; i < inv->EventLog()->getEntryCount(); i++) {
+        AlarmLogRecord_t entry;
+        inv->EventLog()->getLogRecord(i, entry, false);
+
+        known_alarm_t alarm;
+        alarm.record.Serial = inv->serial();
+        alarm.record.MessageId = entry.MessageId;
+        alarm.record.StartTime = getUnixTime(entry.StartTime + timezoneOffset, now, midnight);
+        alarm.record.EndTime = entry.EndTime > 0 ? getUnixTime(entry.EndTime + timezoneOffset, now, midnight) : 0;
+        alarm.rawStartTime = entry.StartTime;
+        alarm.recorded = false;
+
+        auto known = std::find_if(state.alarms.begin(), state.alarms.end(), [&alarm](const known_alarm_t& k) {
+            return k.record.MessageId == alarm.record.MessageId && k.rawStartTime == alarm.rawStartTime;
+        });
+
+        if (known != state.alarms.end()) {
+            // Keeps the start time the alarm was first seen with
+            alarm.record.StartTime = known->record.StartTime;
+            alarm.recorded = known->recorded;
+            state.alarms.erase(known);
+        } else if (!state.initialized) {
+            alarm.recorded = isRecorded(alarm.record);
+        }
+
+        if (!alarm.recorded && alarm.record.EndTime > 0) {
+            if (_pending.empty()) {
+                _pendingSince = millis();
+            }
+            _pending.push_back(alarm.record);
+            alarm.recorded = true;
+        }
+
+        alarms.push_back(alarm);
+    }
+
+    // Alarms which are not reported anymore are recorded as they were last seen
+    for (auto& alarm : state.alarms) {
+        if (!alarm.recorded) {
+            if (_pending.empty()) {
+                _pendingSince = millis();
+            }
+            _pending.push_back(alarm.record);
+        }
+    }
+
+    state.alarms = std::move(alarms);
+    state.initialized = true;
+}
+
+bool AlarmHistoryClass::flush()
+{
+    const size_t size = _pending.size() * sizeof(AlarmHistoryRecord_t);
+
+    if ((_recordCount[1] + _pending.size()) * sizeof(AlarmHistoryRecord_t) > ALARM_HISTORY_FILE_SIZE) {
+        LittleFS.remove(ALARM_HISTORY_FILENAME_OLD);
+        if (!LittleFS.rename(ALARM_HISTORY_FILENAME, ALARM_HISTORY_FILENAME_OLD)) {
+            MessageOutput.println("Alarm history: failed to rotate file");
+            return false;
+        }
+
+        _sequenceBase += _recordCount[0];
+        _recordCount[0] = _recordCount[1];
+        _recordCount[1] = 0;
+
+        _blocks.erase(std::remove_if(_blocks.begin(), _blocks.end(), [](const block_t& b) { return b.file == 0; }), _blocks.end());
+        for (auto& block : _blocks) {
+            block.file = 0;
+        }
+    }
+
+    File f = LittleFS.open(ALARM_HISTORY_FILENAME, "a");
+    if (!f) {
+        MessageOutput.println("Alarm history: failed to open file");
+        return false;
+    }
+
+    const size_t written = f.write(reinterpret_cast<const uint8_t*>(_pending.data()), size);
+    f.close();
+    if (written != size) {
+        MessageOutput.println("Alarm history: failed to write file");
+        return false;
+    }
+
+    for (auto& record : _pending) {
+        indexRecord(1, record);
+    }
+    _pending.clear();
+
+    return true;
+}
+
+void AlarmHistoryClass::loadIndex()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _blocks.clear();
+
+    const char* filenames[] = { ALARM_HISTORY_FILENAME_OLD, ALARM_HISTORY_FILENAME };
+    for (uint8_t file = 0; file < 2; file++) {
+        _recordCount[file] = 0;
+
+        File f = LittleFS.open(filenames[file], "r", false);
+        if (!f) {
+            continue;
+        }
+
+        AlarmHistoryRecord_t record;
+        while (f.read(reinterpret_cast<uint8_t*>(&record), sizeof(record)) == sizeof(record)) {
+            indexRecord(file, record);
+        }
+        f.close();
+    }
+
+    MessageOutput.printf("Alarm history: %u records\r\n", _recordCount[0] + _recordCount[1]);
+}
+
+void AlarmHistoryClass::indexRecord(const uint8_t file, const AlarmHistoryRecord_t& record)
+{
+    if (_blocks.empty() || _blocks.back().file != file || _blocks.back().count >= ALARM_HISTORY_BLOCK_SIZE) {
+        _blocks.push_back({ file, _recordCount[file], 0, UINT32_MAX, 0, 0 });
+    }
+
+    const uint32_t startTime = record.StartTime;
+
+    block_t& block = _blocks.back();
+    block.count++;
+    block.minTime = std::min(block.minTime, startTime);
+    block.maxTime = std::max(block.maxTime, startTime);
+    block.serialMask |= getSerialMask(record.Serial);
+
+    _recordCount[file]++;
+}
+
+// Called with _mutex held after boot to avoid recording alarms a second time
+bool AlarmHistoryClass::isRecorded(const AlarmHistoryRecord_t& record)
+{
+    auto equals = [&record](const AlarmHistoryRecord_t& r) {
+        return r.Serial == record.Serial && r.StartTime == record.StartTime && r.MessageId == record.MessageId;
+    };
+
+    if (std::any_of(_pending.begin(), _pending.end(), equals)) {
+        return true;
+    }
+
+    File files[2];
+    const char* filenames[] = { ALARM_HISTORY_FILENAME_OLD, ALARM_HISTORY_FILENAME };
+    for (auto& block : _blocks) {
+        if (block.maxTime < record.StartTime || block.minTime > record.StartTime || !(block.serialMask & getSerialMask(record.Serial))) {
+            continue;
+        }
+
+        if (!files[block.file]) {
+            files[block.file] = LittleFS.open(filenames[block.file], "r", false);
+        }
+
+        for (uint16_t i = block.first; i < block.first + block.count; i++) {
+            AlarmHistoryRecord_t r;
+            if (readRecord(files[block.file], i, r) && equals(r)) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool AlarmHistoryClass::readRecord(File& f, const uint16_t index, AlarmHistoryRecord_t& record)
+{
+    if (!f || !f.seek(index * sizeof(AlarmHistoryRecord_t))) {
+        return false;
+    }
+    return f.read(reinterpret_cast<uint8_t*>(&record), sizeof(record)) == sizeof(record);
+}
+
+void AlarmHistoryClass::forEachRecord(const AlarmHistoryFilter_t& filter, const uint32_t after, std::function<bool(const uint32_t sequence, const AlarmHistoryRecord_t& record)> cb)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const uint32_t serialMask = filter.Serial > 0 ? getSerialMask(filter.Serial) : UINT32_MAX;
+    auto matches = [&filter](const AlarmHistoryRecord_t& r) {
+        return (filter.Serial == 0 || r.Serial == filter.Serial)
+            && r.StartTime >= filter.From && r.StartTime <= filter.To
+            && (filter.MessageId < 0 || r.MessageId == filter.MessageId);
+    };
+
+    File files[2];
+    const char* filenames[] = { ALARM_HISTORY_FILENAME_OLD, ALARM_HISTORY_FILENAME };
+    for (auto& block : _blocks) {
+        const uint32_t firstSequence = _sequenceBase + (block.file == 1 ? _recordCount[0] : 0) + block.first;
+        if (firstSequence + block.count <= after) {
+            continue;
+        }
+        if (block.maxTime < filter.From || block.minTime > filter.To || !(block.serialMask & serialMask)) {
+            continue;
+        }
+
+        if (!files[block.file]) {
+            files[block.file] = LittleFS.open(filenames[block.file], "r", false);
+        }
+
+        for (uint16_t i = 0; i < block.count; i++) {
+            AlarmHistoryRecord_t record;
+            if (firstSequence + i <= after || !readRecord(files[block.file], block.first + i, record)) {
+                continue;
+            }
+            if (matches(record) && !cb(firstSequence + i, record)) {
+                return;
+            }
+        }
+    }
+
+    // Records which are not written yet follow the ones in the files
+    const uint32_t firstPending = _sequenceBase + _recordCount[0] + _recordCount[1];
+    for (size_t i = 0; i < _pending.size(); i++) {
+        if (firstPending + i > after && matches(_pending[i]) && !cb(firstPending + i, _pending[i])) {
+            return;
+        }
+    }
+}
+
+uint32_t AlarmHistoryClass::getRecordCount()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _recordCount[0] + _recordCount[1] + _pending.size();
+}
+
+/*
+ * Converts a time of day to unix time. Times later than now belong to
+ * the previous day, a small margin covers clock differences.
+ */
+uint32_t AlarmHistoryClass::getUnixTime(const time_t secondsOfDay, const time_t now, const time_t midnight)
+{
+    time_t t = midnight + secondsOfDay;
+    if (t > now + 3600) {
+        t -= 24 * 60 * 60;
+    }
+    return t;
+}
+
+uint32_t AlarmHistoryClass::getSerialMask(const uint64_t serial)
+{
+    return 1UL << (serial % 32);
+}
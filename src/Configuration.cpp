@@ -6,25 +6,237 @@
 #include "MessageOutput.h"
 #include "NetworkSettings.h"
 #include "Utils.h"
+#include "__compiled_constants.h"
 #include "defaults.h"
 #include <ArduinoJson.h>
 #include <LittleFS.h>
+#include <algorithm>
+#include <esp_rom_crc.h>
+#include <esp_system.h>
 #include <nvs_flash.h>
 
+#define CONFIG_BINARY_MAGIC 0x4f445443 // "ODTC"
+
+/*
+ * The binary file is a copy of CONFIG_T as it is in memory. It is only valid
+ * for the firmware that wrote it and for the JSON file it was written with.
+ */
+struct CONFIG_BINARY_HEADER_T {
+    uint32_t Magic;
+    uint32_t Version; // CONFIG_VERSION
+    uint32_t Build; // CRC of the firmware revision
+    uint32_t Size; // sizeof(CONFIG_T)
+    uint32_t JsonSize; // size of CONFIG_FILENAME
+    uint32_t Crc; // CRC of the CONFIG_T data
+};
+
 CONFIG_T config;
 
+ConfigSnapshot::ConfigSnapshot(const CONFIG_T& config, const uint32_t generation)
+    : _config(config)
+    , _generation(generation)
+{
+    for (uint8_t i = 0; i < INV_MAX_COUNT; i++) {
+        if (config.Inverter[i].Serial != 0) {
+            _inverterIndex[_inverterCount++] = { config.Inverter[i].Serial, i };
+        }
+    }
+    std::sort(_inverterIndex.begin(), _inverterIndex.begin() + _inverterCount);
+}
+
+const CONFIG_T& ConfigSnapshot::get() const
+{
+    return _config;
+}
+
+const INVERTER_CONFIG_T* ConfigSnapshot::getInverterConfig(const uint64_t serial) const
+{
+    auto end = _inverterIndex.begin() + _inverterCount;
+    auto it = std::lower_bound(_inverterIndex.begin(), end, std::make_pair(serial, static_cast<uint8_t>(0)));
+    if (it == end || it->first != serial) {
+        return nullptr;
+    }
+    return &_config.Inverter[it->second];
+}
+
+uint32_t ConfigSnapshot::getGeneration() const
+{
+    return _generation;
+}
+
+static uint32_t getBuildId()
+{
+    return esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(__COMPILED_GIT_HASH__), strlen(__COMPILED_GIT_HASH__));
+}
+
+ConfigurationClass::ConfigurationClass()
+    : _bootId(esp_random())
+    , _writeTask("config_write", 1 * TASK_SECOND, TASK_FOREVER, std::bind(&ConfigurationClass::loop, this))
+{
+}
+
 void ConfigurationClass::init()
 {
     memset(&config, 0x0, sizeof(config));
 }
 
+void ConfigurationClass::initWriteTask(Scheduler& scheduler)
+{
+    scheduler.addTask(_writeTask);
+    _writeTask.enable();
+}
+
+void ConfigurationClass::loop()
+{
+    // A flush from another task is writing, the request is checked again
+    // on the next run
+    std::unique_lock<std::mutex> writeLock(_writeMutex, std::try_to_lock);
+    if (!writeLock.owns_lock()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_writePending) {
+            return;
+        }
+
+        const uint32_t now = millis();
+        if (now - _lastRequest < CONFIG_WRITE_DELAY && now - _firstRequest < CONFIG_WRITE_MAX_DELAY) {
+            return;
+        }
+        _writePending = false;
+    }
+
+    if (!persistLocked()) {
+        MessageOutput.log(LogTag::Config, LogLevel::Error, "Failed to write configuration\r\n");
+    }
+}
+
+void ConfigurationClass::requestWrite()
+{
+    config.Cfg.SaveCount++;
+    publish();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const uint32_t now = millis();
+    if (!_writePending) {
+        _writePending = true;
+        _firstRequest = now;
+    }
+    _lastRequest = now;
+    _writeStats.Requests++;
+}
+
+void ConfigurationClass::flush()
+{
+    // The pending state is only cleared while holding the lock, so a write
+    // of the task which is in progress is complete once it is acquired
+    std::lock_guard<std::mutex> writeLock(_writeMutex);
+
+    bool pending;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        pending = _writePending;
+        _writePending = false;
+    }
+
+    if (pending && !persistLocked()) {
+        MessageOutput.log(LogTag::Config, LogLevel::Error, "Failed to write configuration\r\n");
+    }
+}
+
+void ConfigurationClass::discardPendingWrite()
+{
+    _fileReplacements++;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _writePending = false;
+}
+
+uint32_t ConfigurationClass::getFileGeneration() const
+{
+    return _bootId + _fileReplacements;
+}
+
+ConfigWriteStats_t ConfigurationClass::getWriteStats()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _writeStats;
+}
+
+/*
+ * Readers keep a reference to the snapshot they are using, so a new one is
+ * created for every change instead of modifying the current one.
+ */
+void ConfigurationClass::publish()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    ConfigSnapshot* snapshot = new (std::nothrow) ConfigSnapshot(config, _generation + 1);
+    if (snapshot == nullptr) {
+        MessageOutput.log(LogTag::Config, LogLevel::Error, "Failed to publish configuration\r\n");
+        return;
+    }
+
+    _generation++;
+    std::atomic_store(&_snapshot, ConfigSnapshotPtr(snapshot));
+}
+
+ConfigSnapshotPtr ConfigurationClass::getSnapshot() const
+{
+    return std::atomic_load(&_snapshot);
+}
+
 bool ConfigurationClass::write()
 {
-    File f = LittleFS.open(CONFIG_FILENAME, "w");
+    config.Cfg.SaveCount++;
+    publish();
+
+    return persist();
+}
+
+// Writes the published configuration
+bool ConfigurationClass::persist()
+{
+    std::lock_guard<std::mutex> writeLock(_writeMutex);
+    return persistLocked();
+}
+
+bool ConfigurationClass::persistLocked()
+{
+    const ConfigSnapshotPtr snapshot = getSnapshot();
+    if (snapshot == nullptr) {
+        return false;
+    }
+
+    const uint32_t start = millis();
+    const bool success = writeFile(snapshot->get());
+    const uint32_t duration = millis() - start;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _writeStats.Writes++;
+    if (!success) {
+        _writeStats.Failures++;
+    }
+    _writeStats.LastTime = duration;
+    _writeStats.MaxTime = std::max(_writeStats.MaxTime, duration);
+
+    return success;
+}
+
+/*
+ * The new file is written next to the current one and replaces it once it
+ * is complete. The current file is kept as backup, so there is a valid
+ * configuration at any time if the power fails during the write.
+ */
+bool ConfigurationClass::writeFile(const CONFIG_T& config)
+{
+    File f = LittleFS.open(CONFIG_TMP_FILENAME, "w");
     if (!f) {
         return false;
     }
-    config.Cfg.SaveCount++;
 
     JsonDocument doc;
 
@@ -147,25 +359,63 @@ bool ConfigurationClass::write()
     }
 
     // Serialize JSON to file
-    if (serializeJson(doc, f) == 0) {
-        MessageOutput.println("Failed to write file");
+    const size_t jsonSize = serializeJson(doc, f);
+    f.close();
+    if (jsonSize == 0) {
+        MessageOutput.log(LogTag::Config, LogLevel::Error, "Failed to write file\r\n");
+        LittleFS.remove(CONFIG_TMP_FILENAME);
         return false;
     }
 
-    f.close();
+    // The binary copy belongs to the file which is replaced now
+    removeBinary();
+
+    if (LittleFS.exists(CONFIG_FILENAME)) {
+        LittleFS.remove(CONFIG_BACKUP_FILENAME);
+        if (!LittleFS.rename(CONFIG_FILENAME, CONFIG_BACKUP_FILENAME)) {
+            MessageOutput.log(LogTag::Config, LogLevel::Error, "Failed to create backup\r\n");
+            return false;
+        }
+    }
+
+    if (!LittleFS.rename(CONFIG_TMP_FILENAME, CONFIG_FILENAME)) {
+        MessageOutput.log(LogTag::Config, LogLevel::Error, "Failed to replace file\r\n");
+        return false;
+    }
+
+    writeBinary(config, jsonSize);
     return true;
 }
 
 bool ConfigurationClass::read()
 {
+    if (readBinary()) {
+        publish();
+        return true;
+    }
+
     File f = LittleFS.open(CONFIG_FILENAME, "r", false);
 
     JsonDocument doc;
 
     // Deserialize the JSON document
-    const DeserializationError error = deserializeJson(doc, f);
+    DeserializationError error = deserializeJson(doc, f);
+
+    // The file is missing or damaged if a write was interrupted
+    bool fromBackup = false;
     if (error) {
-        MessageOutput.println("Failed to read file, using default configuration");
+        f.close();
+        f = LittleFS.open(CONFIG_BACKUP_FILENAME, "r", false);
+        if (f) {
+            error = deserializeJson(doc, f);
+            fromBackup = !error;
+        }
+    }
+
+    if (fromBackup) {
+        MessageOutput.log(LogTag::Config, LogLevel::Warning, "Failed to read file, using backup\r\n");
+    } else if (error) {
+        MessageOutput.log(LogTag::Config, LogLevel::Warning, "Failed to read file, using default configuration\r\n");
     }
 
     if (!Utils::checkJsonAlloc(doc, __FUNCTION__, __LINE__)) {
@@ -317,7 +567,20 @@ bool ConfigurationClass::read()
         }
     }
 
+    const size_t jsonSize = f ? f.size() : 0;
     f.close();
+
+    if (fromBackup) {
+        LittleFS.remove(CONFIG_FILENAME);
+        LittleFS.rename(CONFIG_BACKUP_FILENAME, CONFIG_FILENAME);
+    }
+
+    // An outdated configuration is written again after the migration
+    if (!error && config.Cfg.Version == CONFIG_VERSION) {
+        writeBinary(config, jsonSize);
+    }
+
+    publish();
     return true;
 }
 
@@ -325,7 +588,7 @@ void ConfigurationClass::migrate()
 {
     File f = LittleFS.open(CONFIG_FILENAME, "r", false);
     if (!f) {
-        MessageOutput.println("Failed to open file, cancel migration");
+        MessageOutput.log(LogTag::Config, LogLevel::Error, "Failed to open file, cancel migration\r\n");
         return;
     }
 
@@ -334,7 +597,7 @@ void ConfigurationClass::migrate()
     // Deserialize the JSON document
     const DeserializationError error = deserializeJson(doc, f);
     if (error) {
-        MessageOutput.printf("Failed to read file, cancel migration: %s\r\n", error.c_str());
+        MessageOutput.log(LogTag::Config, LogLevel::Error, "Failed to read file, cancel migration: %s\r\n", error.c_str());
         return;
     }
 
@@ -395,6 +658,74 @@ CONFIG_T& ConfigurationClass::get()
     return config;
 }
 
+bool ConfigurationClass::readBinary()
+{
+    File json = LittleFS.open(CONFIG_FILENAME, "r", false);
+    if (!json) {
+        return false;
+    }
+    const size_t jsonSize = json.size();
+    json.close();
+
+    File f = LittleFS.open(CONFIG_BINARY_FILENAME, "r", false);
+    if (!f) {
+        return false;
+    }
+
+    CONFIG_BINARY_HEADER_T header;
+    if (f.read(reinterpret_cast<uint8_t*>(&header), sizeof(header)) != sizeof(header)
+        || header.Magic != CONFIG_BINARY_MAGIC
+        || header.Version != CONFIG_VERSION
+        || header.Build != getBuildId()
+        || header.Size != sizeof(CONFIG_T)
+        || header.JsonSize != jsonSize) {
+        return false;
+    }
+
+    // Read directly into the configuration to avoid a second buffer of its size
+    const bool valid = f.read(reinterpret_cast<uint8_t*>(&config), sizeof(config)) == sizeof(config)
+        && esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(&config), sizeof(config)) == header.Crc;
+    f.close();
+
+    if (!valid) {
+        MessageOutput.log(LogTag::Config, LogLevel::Warning, "Invalid binary configuration, reading JSON file\r\n");
+        memset(&config, 0x0, sizeof(config));
+    }
+    return valid;
+}
+
+void ConfigurationClass::writeBinary(const CONFIG_T& config, const size_t jsonSize)
+{
+    CONFIG_BINARY_HEADER_T header;
+    header.Magic = CONFIG_BINARY_MAGIC;
+    header.Version = config.Cfg.Version;
+    header.Build = getBuildId();
+    header.Size = sizeof(CONFIG_T);
+    header.JsonSize = jsonSize;
+    header.Crc = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(&config), sizeof(config));
+
+    File f = LittleFS.open(CONFIG_BINARY_FILENAME, "w");
+    if (!f) {
+        return;
+    }
+
+    if (f.write(reinterpret_cast<const uint8_t*>(&header), sizeof(header)) != sizeof(header)
+        || f.write(reinterpret_cast<const uint8_t*>(&config), sizeof(config)) != sizeof(config)) {
+        // An incomplete copy would be rejected anyway, the JSON file is still valid
+        f.close();
+        removeBinary();
+        return;
+    }
+    f.close();
+}
+
+void ConfigurationClass::removeBinary()
+{
+    if (LittleFS.exists(CONFIG_BINARY_FILENAME)) {
+        LittleFS.remove(CONFIG_BINARY_FILENAME);
+    }
+}
+
 INVERTER_CONFIG_T* ConfigurationClass::getFreeInverterSlot()
 {
     for (uint8_t i = 0; i < INV_MAX_COUNT; i++) {
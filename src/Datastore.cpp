@@ -4,12 +4,14 @@
  */
 #include "Datastore.h"
 #include "Configuration.h"
+#include "PowerHistory.h"
+#include "Scheduler.h"
 #include <Hoymiles.h>
 
 DatastoreClass Datastore;
 
 DatastoreClass::DatastoreClass()
-    : _loopTask(1 * TASK_SECOND, TASK_FOREVER, std::bind(&DatastoreClass::loop, this))
+    : _loopTask("datastore", 1 * TASK_SECOND, TASK_FOREVER, std::bind(&DatastoreClass::loop, this))
 {
 }
 
@@ -22,7 +24,7 @@ void DatastoreClass::init(Scheduler& scheduler)
 void DatastoreClass::loop()
 {
     if (!Hoymiles.isAllRadioIdle()) {
-        _loopTask.forceNextIteration();
+        _loopTask.delay(SCHEDULER_RETRY_DELAY);
         return;
     }
 
@@ -32,6 +34,8 @@ void DatastoreClass::loop()
 
     std::lock_guard<std::mutex> lock(_mutex);
 
+    const ConfigSnapshotPtr config = Configuration.getSnapshot();
+
     _totalAcYieldTotalEnabled = 0;
     _totalAcYieldTotalDigits = 0;
 
@@ -50,13 +54,9 @@ void DatastoreClass::loop()
     _isAllEnabledProducing = true;
     _isAllEnabledReachable = true;
 
-    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
-        auto inv = Hoymiles.getInverterByPos(i);
-        if (inv == nullptr) {
-            continue;
-        }
-
-        auto cfg = Configuration.getInverterConfig(inv->serial());
+    const InverterListPtr inverters = Hoymiles.getInverters();
+    for (auto& inv : *inverters) {
+        auto cfg = config->getInverterConfig(inv->serial());
         if (cfg == nullptr) {
             continue;
         }
@@ -116,6 +116,8 @@ void DatastoreClass::loop()
     _isAtLeastOnePollEnabled = pollEnabledCount > 0;
 
     _totalDcIrradiation = _totalDcIrradiationInstalled > 0 ? _totalDcPowerIrradiation / _totalDcIrradiationInstalled * 100.0f : 0;
+
+    PowerHistory.addSample(_totalAcPowerEnabled);
 }
 
 float DatastoreClass::getTotalAcYieldTotalEnabled()
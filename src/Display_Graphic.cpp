@@ -4,7 +4,10 @@
  */
 #include "Display_Graphic.h"
 #include "Datastore.h"
+#include <HeapAccounting.h>
 #include <NetworkSettings.h>
+#include <WallClock.h>
+#include <cstring>
 #include <map>
 #include <time.h>
 
@@ -42,7 +45,7 @@ static const char* const i18n_yield_total_mwh[] = { "total: %.0f kWh", "Ges.: %.
 static const char* const i18n_date_format[] = { "%m/%d/%Y %H:%M", "%d.%m.%Y %H:%M", "%d/%m/%Y %H:%M" };
 
 DisplayGraphicClass::DisplayGraphicClass()
-    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&DisplayGraphicClass::loop, this))
+    : _loopTask("display", TASK_IMMEDIATE, TASK_FOREVER, std::bind(&DisplayGraphicClass::loop, this))
 {
 }
 
@@ -61,9 +64,15 @@ void DisplayGraphicClass::init(Scheduler& scheduler, const DisplayType_t type, c
             _display->setI2CAddress(0x3F << 1);
         }
         _display->begin();
+
+        // begin() cleared the display RAM
+        const size_t bufferSize = _display->getBufferTileWidth() * _display->getBufferTileHeight() * 8;
+        _sentBuffer.reset(new uint8_t[bufferSize]);
+        memset(_sentBuffer.get(), 0, bufferSize);
+
         setContrast(DISPLAY_CONTRAST);
         setStatus(true);
-        _diagram.init(scheduler, _display);
+        _diagram.init(_display);
 
         scheduler.addTask(_loopTask);
         _loopTask.setInterval(_period);
@@ -186,7 +195,7 @@ void DisplayGraphicClass::setStartupDisplay()
 
     _display->clearBuffer();
     printText("OpenDTU!", 0);
-    _display->sendBuffer();
+    sendDirtyTiles();
 }
 
 DisplayGraphicDiagramClass& DisplayGraphicClass::Diagram()
@@ -194,8 +203,69 @@ DisplayGraphicDiagramClass& DisplayGraphicClass::Diagram()
     return _diagram;
 }
 
+uint32_t DisplayGraphicClass::getBusTime() const
+{
+    return _busTime;
+}
+
+uint32_t DisplayGraphicClass::getTilesSent() const
+{
+    return _tilesSent;
+}
+
+void DisplayGraphicClass::sendDirtyTiles()
+{
+    const uint32_t start = micros();
+
+    // The buffer consists of rows of tiles, each tile are 8 consecutive bytes
+    const uint8_t tileWidth = _display->getBufferTileWidth();
+    const uint8_t tileHeight = _display->getBufferTileHeight();
+    const uint8_t* buffer = _display->getBufferPtr();
+
+    for (uint8_t ty = 0; ty < tileHeight; ty++) {
+        const size_t rowOffset = ty * tileWidth * 8;
+
+        int16_t first = -1;
+        int16_t last = -1;
+        for (uint8_t tx = 0; tx < tileWidth; tx++) {
+            const size_t offset = rowOffset + tx * 8;
+            if (memcmp(&buffer[offset], &_sentBuffer[offset], 8) != 0) {
+                if (first < 0) {
+                    first = tx;
+                }
+                last = tx;
+            }
+        }
+
+        if (first < 0) {
+            continue;
+        }
+
+        const uint8_t count = last - first + 1;
+        _display->updateDisplayArea(first, ty, count, 1);
+        memcpy(&_sentBuffer[rowOffset + first * 8], &buffer[rowOffset + first * 8], count * 8);
+        _tilesSent += count;
+    }
+
+    accountBusTime(start);
+}
+
+void DisplayGraphicClass::accountBusTime(const uint32_t start)
+{
+    const uint32_t now = micros();
+    _busTimeSum += now - start;
+
+    if (now - _busTimeStart >= 1000000) {
+        _busTime = static_cast<uint64_t>(_busTimeSum) * 1000000 / (now - _busTimeStart);
+        _busTimeSum = 0;
+        _busTimeStart = now;
+    }
+}
+
 void DisplayGraphicClass::loop()
 {
+    HeapTagScope heapTag(HeapTag::Display);
+
     _loopTask.setInterval(_period);
 
     _display->clearBuffer();
@@ -267,13 +337,15 @@ void DisplayGraphicClass::loop()
             printText(NetworkSettings.localIP().toString().c_str(), 3);
         } else {
             // Get current time
-            time_t now = time(nullptr);
-            strftime(_fmtText, sizeof(_fmtText), i18n_date_format[_display_language], localtime(&now));
+            struct tm timeinfo;
+            WallClock.getLocalTime(timeinfo);
+            strftime(_fmtText, sizeof(_fmtText), i18n_date_format[_display_language], &timeinfo);
             printText(_fmtText, 3);
         }
     }
 
-    _display->sendBuffer();
+    // Nothing is transferred if the frame did not change
+    sendDirtyTiles();
 
     _mExtra++;
 
@@ -281,7 +353,12 @@ void DisplayGraphicClass::loop()
         displayPowerSave = true;
     }
 
-    _display->setPowerSave(displayPowerSave);
+    if (_powerSave != displayPowerSave) {
+        const uint32_t start = micros();
+        _display->setPowerSave(displayPowerSave);
+        _powerSave = displayPowerSave;
+        accountBusTime(start);
+    }
 }
 
 void DisplayGraphicClass::setContrast(const uint8_t contrast)
@@ -4,64 +4,26 @@
  */
 #include "Display_Graphic_Diagram.h"
 #include "Configuration.h"
-#include "Datastore.h"
+#include "PowerHistory.h"
 #include <algorithm>
 
-DisplayGraphicDiagramClass::DisplayGraphicDiagramClass()
-    : _averageTask(1 * TASK_SECOND, TASK_FOREVER, std::bind(&DisplayGraphicDiagramClass::averageLoop, this))
-    , _dataPointTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&DisplayGraphicDiagramClass::dataPointLoop, this))
-{
-}
-
-void DisplayGraphicDiagramClass::init(Scheduler& scheduler, U8G2* display)
+void DisplayGraphicDiagramClass::init(U8G2* display)
 {
     _display = display;
-
-    scheduler.addTask(_averageTask);
-    _averageTask.enable();
-
-    scheduler.addTask(_dataPointTask);
-    updatePeriod();
-    _dataPointTask.enable();
-}
-
-void DisplayGraphicDiagramClass::averageLoop()
-{
-    const float currentWatts = Datastore.getTotalAcPowerEnabled(); // get the current AC production
-    _iRunningAverage += currentWatts;
-    _iRunningAverageCnt++;
-}
-
-void DisplayGraphicDiagramClass::dataPointLoop()
-{
-    if (_graphValuesCount >= std::size(_graphValues)) {
-        for (uint8_t i = 0; i < std::size(_graphValues) - 1; i++) {
-            _graphValues[i] = _graphValues[i + 1];
-        }
-        _graphValuesCount = std::size(_graphValues) - 1;
-    }
-    if (_iRunningAverageCnt != 0) {
-        _graphValues[_graphValuesCount++] = _iRunningAverage / _iRunningAverageCnt;
-        _iRunningAverage = 0;
-        _iRunningAverageCnt = 0;
-    }
 }
 
 uint32_t DisplayGraphicDiagramClass::getSecondsPerDot()
 {
-    return Configuration.get().Display.Diagram.Duration / _chartWidth;
-}
-
-void DisplayGraphicDiagramClass::updatePeriod()
-{
-    //  Calculate seconds per datapoint
-    _dataPointTask.setInterval(Configuration.get().Display.Diagram.Duration * TASK_SECOND / MAX_DATAPOINTS);
+    return Configuration.getSnapshot()->get().Display.Diagram.Duration / _chartWidth;
 }
 
 void DisplayGraphicDiagramClass::redraw(uint8_t screenSaverOffsetX, uint8_t xPos, uint8_t yPos, uint8_t width, uint8_t height, bool isFullscreen)
 {
     _chartWidth = width;
 
+    // A changed duration is applied to the stored history right away
+    _graphValuesCount = PowerHistory.getAverages(Configuration.getSnapshot()->get().Display.Diagram.Duration, _graphValues.data(), MAX_DATAPOINTS);
+
     // screenSaverOffsetX expected to be in range 0..6
     const uint8_t graphPosX = xPos + ((screenSaverOffsetX > 3) ? 1 : 0);
     const uint8_t graphPosY = yPos + ((screenSaverOffsetX > 3) ? 1 : 0);
@@ -83,7 +45,7 @@ void DisplayGraphicDiagramClass::redraw(uint8_t screenSaverOffsetX, uint8_t xPos
 
     // draw AC value
     char fmtText[7];
-    const float maxWatts = *std::max_element(_graphValues.begin(), _graphValues.end());
+    const float maxWatts = _graphValuesCount > 0 ? *std::max_element(_graphValues.begin(), _graphValues.begin() + _graphValuesCount) : 0;
     if (maxWatts > 999) {
         snprintf(fmtText, sizeof(fmtText), "%2.1fkW", maxWatts / 1000);
     } else {
@@ -0,0 +1,292 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2024 Thomas Basler and others
+ */
+#include "GzipResponse.h"
+#include "MessageOutput.h"
+#include "WebApi_errors.h"
+#include <AsyncJson.h>
+#include <new>
+
+std::map<String, GzipResponseStats_t> GzipResponse::_stats;
+
+// Receives the output of the filler and holds back the first bytes until
+// the compression is decided. The result is collected until the server
+// reads it.
+class GzipResponse::Content : public Print {
+public:
+    Content(const String& url, const bool gzip);
+    ~Content();
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+
+    // Calls the filler until the compression is decided, returns false if
+    // the filler failed
+    bool prefill();
+
+    size_t read(uint8_t* buffer, size_t maxLen);
+
+    bool isCompressed() const;
+
+    GzipResponseFiller Filler;
+    std::unique_ptr<JsonStreamWriter> Writer;
+
+private:
+    class Output : public Print {
+    public:
+        size_t write(uint8_t c) override
+        {
+            return write(&c, 1);
+        }
+
+        size_t write(const uint8_t* buffer, size_t size) override
+        {
+            Data.insert(Data.end(), buffer, buffer + size);
+            return size;
+        }
+
+        std::vector<uint8_t> Data;
+        size_t Position = 0; // next byte to read
+    };
+
+    void step();
+    void startEncoder();
+    void finish();
+    bool hasFailed() const;
+
+    String _url;
+    Output _output;
+    GzipEncoder* _encoder = nullptr;
+    bool _compressed = false;
+    bool _complete = false;
+
+    bool _buffering; // gzip accepted, threshold not reached yet
+    uint8_t _pending[GZIP_RESPONSE_THRESHOLD];
+    size_t _pendingLength = 0;
+    size_t _inputSize = 0;
+
+    uint32_t _time = 0;
+};
+
+GzipResponse::Content::Content(const String& url, const bool gzip)
+    : _url(url)
+    , _buffering(gzip)
+{
+}
+
+GzipResponse::Content::~Content()
+{
+    delete _encoder;
+}
+
+size_t GzipResponse::Content::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t GzipResponse::Content::write(const uint8_t* buffer, size_t size)
+{
+    _inputSize += size;
+
+    if (_buffering) {
+        if (_pendingLength + size <= sizeof(_pending)) {
+            memcpy(_pending + _pendingLength, buffer, size);
+            _pendingLength += size;
+            return size;
+        }
+
+        _buffering = false;
+        startEncoder();
+    }
+
+    if (_encoder == nullptr) {
+        return _output.write(buffer, size);
+    }
+
+    const uint32_t start = micros();
+    _encoder->write(buffer, size);
+    _time += micros() - start;
+    return size;
+}
+
+bool GzipResponse::Content::prefill()
+{
+    while (!_complete && !hasFailed() && _inputSize <= GZIP_RESPONSE_THRESHOLD) {
+        step();
+    }
+
+    return !hasFailed();
+}
+
+size_t GzipResponse::Content::read(uint8_t* buffer, size_t maxLen)
+{
+    while (!_complete && !hasFailed() && _output.Data.size() - _output.Position < maxLen) {
+        step();
+    }
+
+    // The headers are already sent, the client sees an incomplete document
+    if (hasFailed()) {
+        MessageOutput.log(LogTag::Web, LogLevel::Error, "WebResponse truncated: %s\r\n", _url.c_str());
+        return 0;
+    }
+
+    const size_t length = std::min(maxLen, _output.Data.size() - _output.Position);
+    memcpy(buffer, _output.Data.data() + _output.Position, length);
+    _output.Position += length;
+
+    if (_output.Position == _output.Data.size()) {
+        _output.Data.clear();
+        _output.Position = 0;
+    }
+
+    return length;
+}
+
+bool GzipResponse::Content::isCompressed() const
+{
+    return _compressed;
+}
+
+void GzipResponse::Content::step()
+{
+    if (!Filler(*this) && !hasFailed()) {
+        finish();
+    }
+}
+
+void GzipResponse::Content::startEncoder()
+{
+    // Without memory for the encoder the response is sent uncompressed
+    _encoder = new (std::nothrow) GzipEncoder(_output);
+    if (_encoder == nullptr) {
+        _output.write(_pending, _pendingLength);
+        _pendingLength = 0;
+        return;
+    }
+    _compressed = true;
+
+    const uint32_t start = micros();
+    _encoder->write(_pending, _pendingLength);
+    _time += micros() - start;
+    _pendingLength = 0;
+}
+
+void GzipResponse::Content::finish()
+{
+    _complete = true;
+
+    if (_buffering) {
+        _buffering = false;
+        _output.write(_pending, _pendingLength);
+        _pendingLength = 0;
+        return;
+    }
+
+    if (_encoder == nullptr) {
+        return;
+    }
+
+    const uint32_t start = micros();
+    _encoder->finish();
+    _time += micros() - start;
+
+    GzipResponseStats_t& stats = _stats[_url];
+    stats.Responses++;
+    stats.InputBytes += _encoder->getInputSize();
+    stats.OutputBytes += _encoder->getOutputSize();
+    stats.Time += _time;
+
+    delete _encoder;
+    _encoder = nullptr;
+}
+
+bool GzipResponse::Content::hasFailed() const
+{
+    return Writer != nullptr && Writer->hasFailed();
+}
+
+GzipResponse::GzipResponse(AsyncWebServerRequest* request, const char* contentType)
+    : _request(request)
+    , _contentType(contentType)
+{
+}
+
+void GzipResponse::addHeader(const char* name, const String& value)
+{
+    _headers.emplace_back(name, value);
+}
+
+void GzipResponse::send(GzipResponseFiller filler)
+{
+    auto content = std::make_shared<Content>(_request->url(), isAccepted(_request));
+    content->Filler = filler;
+    send(content);
+}
+
+void GzipResponse::sendJson(JsonResponseFiller filler)
+{
+    auto content = std::make_shared<Content>(_request->url(), isAccepted(_request));
+    content->Writer = std::make_unique<JsonStreamWriter>(*content);
+
+    // The writer lives as long as the content which holds the filler
+    JsonStreamWriter* writer = content->Writer.get();
+    content->Filler = [filler, writer](Print&) {
+        return filler(*writer);
+    };
+    send(content);
+}
+
+bool GzipResponse::isAccepted(AsyncWebServerRequest* request)
+{
+    if (!request->hasHeader("Accept-Encoding")) {
+        return false;
+    }
+
+    return request->getHeader("Accept-Encoding")->value().indexOf("gzip") >= 0;
+}
+
+const std::map<String, GzipResponseStats_t>& GzipResponse::getStats()
+{
+    return _stats;
+}
+
+void GzipResponse::send(std::shared_ptr<Content> content)
+{
+    if (!content->prefill()) {
+        sendError();
+        return;
+    }
+
+    AsyncWebServerResponse* response = _request->beginChunkedResponse(_contentType,
+        [content](uint8_t* buffer, size_t maxLen, size_t) -> size_t {
+            return content->read(buffer, maxLen);
+        });
+
+    // The content depends on the request headers, so caches have to know
+    response->addHeader("Vary", "Accept-Encoding");
+    if (content->isCompressed()) {
+        response->addHeader("Content-Encoding", "gzip");
+    }
+    for (auto& header : _headers) {
+        response->addHeader(header.first.c_str(), header.second);
+    }
+
+    _request->send(response);
+}
+
+// Same response as WebApiClass::sendJsonResponse for an overflowed document
+void GzipResponse::sendError()
+{
+    AsyncJsonResponse* response = new AsyncJsonResponse();
+    auto& root = response->getRoot();
+
+    root["message"] = String("500 Internal Server Error: ") + _request->url();
+    root["code"] = WebApiError::GenericInternalServerError;
+    root["type"] = "danger";
+    response->setCode(500);
+    MessageOutput.log(LogTag::Web, LogLevel::Error, "WebResponse failed: %s\r\n", _request->url().c_str());
+
+    response->setLength();
+    _request->send(response);
+}
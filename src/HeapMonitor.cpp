@@ -0,0 +1,65 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2024 Thomas Basler and others
+ */
+#include "HeapMonitor.h"
+#include <Arduino.h>
+#include <esp_heap_caps.h>
+
+HeapMonitorClass HeapMonitor;
+
+HeapMonitorClass::HeapMonitorClass()
+    : _loopTask("heap_monitor", HEAP_SNAPSHOT_INTERVAL * TASK_SECOND, TASK_FOREVER, std::bind(&HeapMonitorClass::loop, this))
+{
+}
+
+void HeapMonitorClass::init(Scheduler& scheduler)
+{
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+void HeapMonitorClass::loop()
+{
+    const HeapSnapshot_t snapshot = getCurrent();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _snapshots[_snapshotCount % HEAP_SNAPSHOT_COUNT] = snapshot;
+    _snapshotCount++;
+}
+
+HeapSnapshot_t HeapMonitorClass::getCurrent() const
+{
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_INTERNAL);
+
+    HeapSnapshot_t snapshot;
+    snapshot.Uptime = esp_timer_get_time() / 1000000;
+    snapshot.FreeBytes = info.total_free_bytes;
+    snapshot.LargestFreeBlock = info.largest_free_block;
+    snapshot.MinimumFreeBytes = info.minimum_free_bytes;
+    snapshot.FreeBlocks = info.free_blocks;
+    return snapshot;
+}
+
+std::vector<HeapSnapshot_t> HeapMonitorClass::getSnapshots() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const uint32_t first = _snapshotCount > HEAP_SNAPSHOT_COUNT ? _snapshotCount - HEAP_SNAPSHOT_COUNT : 0;
+
+    std::vector<HeapSnapshot_t> snapshots;
+    snapshots.reserve(_snapshotCount - first);
+    for (uint32_t i = first; i < _snapshotCount; i++) {
+        snapshots.push_back(_snapshots[i % HEAP_SNAPSHOT_COUNT]);
+    }
+    return snapshots;
+}
+
+float HeapMonitorClass::getFragmentation(const HeapSnapshot_t& snapshot)
+{
+    if (snapshot.FreeBytes == 0) {
+        return 0;
+    }
+    return 100.0f - 100.0f * snapshot.LargestFreeBlock / snapshot.FreeBytes;
+}
@@ -7,6 +7,7 @@
 #include "MessageOutput.h"
 #include "PinMapping.h"
 #include "SunPosition.h"
+#include <HeapAccounting.h>
 #include <Hoymiles.h>
 
 // the NRF shall use the second externally usable HW SPI controller
@@ -25,9 +26,12 @@
 
 InverterSettingsClass InverterSettings;
 
+static LogPrint radioOutput(LogTag::Radio, LogLevel::Info);
+static LogPrint radioDebugOutput(LogTag::Radio, LogLevel::Debug);
+
 InverterSettingsClass::InverterSettingsClass()
-    : _settingsTask(INVERTER_UPDATE_SETTINGS_INTERVAL, TASK_FOREVER, std::bind(&InverterSettingsClass::settingsLoop, this))
-    , _hoyTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&InverterSettingsClass::hoyLoop, this))
+    : _settingsTask("inverter_settings", INVERTER_UPDATE_SETTINGS_INTERVAL, TASK_FOREVER, std::bind(&InverterSettingsClass::settingsLoop, this))
+    , _hoyTask("hoymiles", TASK_IMMEDIATE, TASK_FOREVER, std::bind(&InverterSettingsClass::hoyLoop, this))
 {
 }
 
@@ -39,8 +43,9 @@ void InverterSettingsClass::init(Scheduler& scheduler)
     // Initialize inverter communication
     MessageOutput.print("Initialize Hoymiles interface... ");
 
-    Hoymiles.setMessageOutput(&MessageOutput);
+    Hoymiles.setMessageOutput(&radioOutput);
     Hoymiles.init();
+    Hoymiles.getRecorder().init(ESP.getPsramSize() > 0 ? RADIO_RECORDER_SIZE_PSRAM : RADIO_RECORDER_SIZE);
 
     if (PinMapping.isValidNrf24Config() || PinMapping.isValidCmt2300Config()) {
         if (PinMapping.isValidNrf24Config()) {
@@ -106,7 +111,8 @@ void InverterSettingsClass::init(Scheduler& scheduler)
 
 void InverterSettingsClass::settingsLoop()
 {
-    const CONFIG_T& config = Configuration.get();
+    const ConfigSnapshotPtr snapshot = Configuration.getSnapshot();
+    const CONFIG_T& config = snapshot->get();
     const bool isDayPeriod = SunPosition.isDayPeriod();
 
     for (uint8_t i = 0; i < INV_MAX_COUNT; i++) {
@@ -126,5 +132,12 @@ void InverterSettingsClass::settingsLoop()
 
 void InverterSettingsClass::hoyLoop()
 {
+    HeapTagScope heapTag(HeapTag::Radio);
+
+    // Fragment dumps are only formatted if they are shown
+    Hoymiles.setDebugOutput(radioDebugOutput.isEnabled() ? &radioDebugOutput : nullptr);
     Hoymiles.loop();
+
+    // The NRF hops the RX channel every 4 ms while waiting for a response
+    _hoyTask.setInterval(Hoymiles.isAnyRadioActive() ? TASK_IMMEDIATE : INVERTER_IDLE_LOOP_INTERVAL * TASK_MILLISECOND);
 }
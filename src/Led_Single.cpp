@@ -9,6 +9,7 @@
 #include "NetworkSettings.h"
 #include "PinMapping.h"
 #include <Hoymiles.h>
+#include <WallClock.h>
 
 LedSingleClass LedSingle;
 
@@ -38,8 +39,8 @@ const uint8_t pwmTable[] = {
 #define LED_OFF 0
 
 LedSingleClass::LedSingleClass()
-    : _setTask(LEDSINGLE_UPDATE_INTERVAL * TASK_MILLISECOND, TASK_FOREVER, std::bind(&LedSingleClass::setLoop, this))
-    , _outputTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&LedSingleClass::outputLoop, this))
+    : _setTask("led_set", LEDSINGLE_UPDATE_INTERVAL * TASK_MILLISECOND, TASK_FOREVER, std::bind(&LedSingleClass::setLoop, this))
+    , _outputTask("led_output", LEDSINGLE_OUTPUT_INTERVAL * TASK_MILLISECOND, TASK_FOREVER, std::bind(&LedSingleClass::outputLoop, this))
 {
 }
 
@@ -74,7 +75,8 @@ void LedSingleClass::init(Scheduler& scheduler)
 void LedSingleClass::setLoop()
 {
     if (_allMode == LedState_t::On) {
-        const CONFIG_T& config = Configuration.get();
+        const ConfigSnapshotPtr snapshot = Configuration.getSnapshot();
+        const CONFIG_T& config = snapshot->get();
 
         // Update network status
         _ledMode[0] = LedState_t::Off;
@@ -83,8 +85,7 @@ void LedSingleClass::setLoop()
             _ledMode[0] = LedState_t::Blink;
         }
 
-        struct tm timeinfo;
-        if (getLocalTime(&timeinfo, 5) && (!config.Mqtt.Enabled || (config.Mqtt.Enabled && MqttSettings.getConnected()))) {
+        if (WallClock.isSynced() && (!config.Mqtt.Enabled || (config.Mqtt.Enabled && MqttSettings.getConnected()))) {
             _ledMode[0] = LedState_t::On;
         }
 
@@ -129,7 +130,8 @@ void LedSingleClass::outputLoop()
 void LedSingleClass::setLed(const uint8_t ledNo, const bool ledState)
 {
     const auto& pin = PinMapping.get();
-    const auto& config = Configuration.get();
+    const ConfigSnapshotPtr snapshot = Configuration.getSnapshot();
+    const CONFIG_T& config = snapshot->get();
 
     if (pin.led[ledNo] < 0) {
         return;
@@ -5,12 +5,20 @@
 #include "MessageOutput.h"
 
 #include <Arduino.h>
+#include <HeapAccounting.h>
+#include <algorithm>
+
+static const char* const tagNames[LOG_TAG_COUNT] = { "core", "radio", "mqtt", "web", "config" };
+static const char* const levelNames[LOG_LEVEL_COUNT] = { "error", "warning", "info", "debug", "verbose" };
 
 MessageOutputClass MessageOutput;
 
 MessageOutputClass::MessageOutputClass()
-    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&MessageOutputClass::loop, this))
+    : _loopTask("message_output", LOG_FLUSH_INTERVAL * TASK_MILLISECOND, TASK_FOREVER, std::bind(&MessageOutputClass::loop, this))
 {
+    for (auto& level : _levels) {
+        level = static_cast<uint8_t>(LOG_LEVEL_DEFAULT);
+    }
 }
 
 void MessageOutputClass::init(Scheduler& scheduler)
@@ -26,41 +34,140 @@ void MessageOutputClass::register_ws_output(AsyncWebSocket* output)
 
 size_t MessageOutputClass::write(uint8_t c)
 {
-    if (_buff_pos < BUFFER_SIZE) {
-        std::lock_guard<std::mutex> lock(_msgLock);
-        _buffer[_buff_pos] = c;
-        _buff_pos++;
-    } else {
-        _forceSend = true;
-    }
-
-    return Serial.write(c);
+    return write(&c, 1);
 }
 
 size_t MessageOutputClass::write(const uint8_t* buffer, size_t size)
 {
-    std::lock_guard<std::mutex> lock(_msgLock);
-    if (_buff_pos + size < BUFFER_SIZE) {
-        memcpy(&_buffer[_buff_pos], buffer, size);
-        _buff_pos += size;
+    RingbufHandle_t ring = _ring.load();
+    if (ring == nullptr) {
+        return Serial.write(buffer, size);
+    }
+
+    if (xRingbufferSend(ring, buffer, size, 0) != pdTRUE) {
+        _droppedBytes += size;
     }
-    _forceSend = true;
 
-    return Serial.write(buffer, size);
+    return size;
 }
 
 void MessageOutputClass::loop()
 {
+    RingbufHandle_t ring = _ring.load();
+    if (ring == nullptr) {
+        ring = xRingbufferCreate(LOG_BUFFER_SIZE, RINGBUF_TYPE_BYTEBUF);
+        if (ring == nullptr) {
+            Serial.println("Failed to allocate log buffer");
+            _loopTask.disable();
+            return;
+        }
+        _ring = ring;
+    }
+
+    const uint32_t now = millis();
+    const size_t serialFree = Serial.availableForWrite();
+    if (serialFree > 0) {
+        _lastSerialWrite = now;
+    }
+    const bool serialStalled = now - _lastSerialWrite > LOG_SERIAL_TIMEOUT;
+
+    size_t maxSize = BUFFER_SIZE - _buff_pos;
+    if (!serialStalled) {
+        maxSize = std::min(maxSize, serialFree);
+    }
+
+    size_t size = 0;
+    uint8_t* data = nullptr;
+    if (maxSize > 0) {
+        data = static_cast<uint8_t*>(xRingbufferReceiveUpTo(ring, &size, 0, maxSize));
+    }
+
+    if (data != nullptr) {
+        if (!serialStalled) {
+            Serial.write(data, size);
+        }
+        memcpy(&_buffer[_buff_pos], data, size);
+        _buff_pos += size;
+        vRingbufferReturnItem(ring, data);
+
+        // More output might be waiting
+        _loopTask.forceNextIteration();
+    } else if (_droppedBytes != _reportedDroppedBytes) {
+        _reportedDroppedBytes = _droppedBytes;
+        printf("[%u bytes of log output dropped]\r\n", _reportedDroppedBytes);
+    }
+
     // Send data via websocket if either time is over or buffer is full
-    if (_forceSend || (millis() - _lastSend > 1000)) {
-        std::lock_guard<std::mutex> lock(_msgLock);
-        if (_ws && _buff_pos > 0) {
+    if (_buff_pos > 0 && (_buff_pos == BUFFER_SIZE || now - _lastSend > 1000)) {
+        if (_ws != nullptr && _ws->count() > 0) {
+            HeapTagScope heapTag(HeapTag::Websocket);
             _ws->textAll(_buffer, _buff_pos);
-            _buff_pos = 0;
         }
-        if (_forceSend) {
-            _buff_pos = 0;
+        _buff_pos = 0;
+        _lastSend = now;
+    }
+}
+
+LogLevel MessageOutputClass::getLevel(const LogTag tag) const
+{
+    return static_cast<LogLevel>(_levels[static_cast<uint8_t>(tag)].load());
+}
+
+void MessageOutputClass::setLevel(const LogTag tag, const LogLevel level)
+{
+    _levels[static_cast<uint8_t>(tag)] = static_cast<uint8_t>(level);
+}
+
+uint32_t MessageOutputClass::getDroppedBytes() const
+{
+    return _droppedBytes;
+}
+
+const char* MessageOutputClass::getTagName(const LogTag tag)
+{
+    return tagNames[static_cast<uint8_t>(tag)];
+}
+
+const char* MessageOutputClass::getLevelName(const LogLevel level)
+{
+    return levelNames[static_cast<uint8_t>(level)];
+}
+
+bool MessageOutputClass::parseLevel(const char* name, LogLevel& level)
+{
+    if (name == nullptr) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < LOG_LEVEL_COUNT; i++) {
+        if (strcmp(name, levelNames[i]) == 0) {
+            level = static_cast<LogLevel>(i);
+            return true;
         }
-        _forceSend = false;
     }
+    return false;
+}
+
+LogPrint::LogPrint(const LogTag tag, const LogLevel level)
+    : _tag(tag)
+    , _level(level)
+{
+}
+
+size_t LogPrint::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t LogPrint::write(const uint8_t* buffer, size_t size)
+{
+    if (!isEnabled()) {
+        return size;
+    }
+    return MessageOutput.write(buffer, size);
+}
+
+bool LogPrint::isEnabled() const
+{
+    return MessageOutput.isEnabled(_tag, _level);
 }
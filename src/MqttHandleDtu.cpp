@@ -6,28 +6,32 @@
 #include "Configuration.h"
 #include "MqttSettings.h"
 #include "NetworkSettings.h"
+#include "Scheduler.h"
+#include <HeapAccounting.h>
 #include <Hoymiles.h>
 
 MqttHandleDtuClass MqttHandleDtu;
 
 MqttHandleDtuClass::MqttHandleDtuClass()
-    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&MqttHandleDtuClass::loop, this))
+    : _loopTask("mqtt_dtu", TASK_IMMEDIATE, TASK_FOREVER, std::bind(&MqttHandleDtuClass::loop, this))
 {
 }
 
 void MqttHandleDtuClass::init(Scheduler& scheduler)
 {
     scheduler.addTask(_loopTask);
-    _loopTask.setInterval(Configuration.get().Mqtt.PublishInterval * TASK_SECOND);
+    _loopTask.setInterval(Configuration.getSnapshot()->get().Mqtt.PublishInterval * TASK_SECOND);
     _loopTask.enable();
 }
 
 void MqttHandleDtuClass::loop()
 {
-    _loopTask.setInterval(Configuration.get().Mqtt.PublishInterval * TASK_SECOND);
+    HeapTagScope heapTag(HeapTag::Mqtt);
+
+    _loopTask.setInterval(Configuration.getSnapshot()->get().Mqtt.PublishInterval * TASK_SECOND);
 
     if (!MqttSettings.getConnected() || !Hoymiles.isAllRadioIdle()) {
-        _loopTask.forceNextIteration();
+        _loopTask.delay(SCHEDULER_RETRY_DELAY);
         return;
     }
 
@@ -3,41 +3,106 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "MqttHandleHass.h"
+#include "MessageOutput.h"
 #include "MqttHandleInverter.h"
 #include "MqttSettings.h"
 #include "NetworkSettings.h"
+#include "Scheduler.h"
 #include "Utils.h"
 #include "defaults.h"
 #include "__compiled_constants.h"
+#include <HeapAccounting.h>
+#include <algorithm>
+
+// Maximum time spent per loop iteration for publishing discovery documents
+#define HASS_TICK_BUDGET_US 5000
+
+// Free space in the MQTT publish queue required to publish one group of documents
+#define HASS_MIN_QUEUE_FREE (12 * 1024)
+
+// Interval in ms to check for a new connection or a forced update while no pass is active
+#define HASS_LOOP_INTERVAL 100
 
 MqttHandleHassClass MqttHandleHass;
 
 MqttHandleHassClass::MqttHandleHassClass()
-    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&MqttHandleHassClass::loop, this))
+    : _loopTask("mqtt_hass", HASS_LOOP_INTERVAL * TASK_MILLISECOND, TASK_FOREVER, std::bind(&MqttHandleHassClass::loop, this))
 {
 }
 
 void MqttHandleHassClass::init(Scheduler& scheduler)
 {
+    using std::placeholders::_1;
+    using std::placeholders::_2;
+
+    MqttSettings.onSent(MqttPublishPriority::Discovery, std::bind(&MqttHandleHassClass::onDiscoverySent, this, _1, _2));
+
     scheduler.addTask(_loopTask);
     _loopTask.enable();
 }
 
 void MqttHandleHassClass::loop()
 {
+    HeapTagScope heapTag(HeapTag::Hass);
+
     if (_updateForced) {
         publishConfig();
         _updateForced = false;
     }
 
     if (MqttSettings.getConnected() && !_wasConnected) {
-        // Connection established
+        // Connection established, the broker may have lost the retained documents
         _wasConnected = true;
+        _publishedHashes.clear();
         publishConfig();
     } else if (!MqttSettings.getConnected() && _wasConnected) {
         // Connection lost
         _wasConnected = false;
     }
+
+    const uint32_t dropped = MqttSettings.getQueueDropped(MqttPublishPriority::Discovery);
+    if (dropped != _droppedDocuments) {
+        _droppedDocuments = dropped;
+        _passRepeat = true;
+    }
+    if (_passRepeat && !_passActive && MqttSettings.getConnected()) {
+        // Documents the client already got are skipped
+        _passRepeat = false;
+        publishConfig();
+    }
+
+    if (!_passActive || !MqttSettings.getConnected()) {
+        return;
+    }
+
+    _config = Configuration.getSnapshot();
+
+    const uint32_t start = micros();
+    bool finished = false;
+    bool queueFull = false;
+    do {
+        if (MqttSettings.getQueueFree() < HASS_MIN_QUEUE_FREE) {
+            queueFull = true;
+            break;
+        }
+        if (!publishNextUnit()) {
+            finished = true;
+            break;
+        }
+    } while (micros() - start < HASS_TICK_BUDGET_US);
+
+    _config = nullptr;
+
+    _pass.MaxTickTime = max<uint32_t>(_pass.MaxTickTime, micros() - start);
+
+    if (finished) {
+        finishPass();
+    } else if (queueFull) {
+        _loopTask.delay(SCHEDULER_RETRY_DELAY);
+    } else {
+        // Budget used up, continue with the next pass of the scheduler
+        _loopTask.forceNextIteration();
+    }
 }
 
 void MqttHandleHassClass::forceUpdate()
@@ -45,58 +110,126 @@ void MqttHandleHassClass::forceUpdate()
     _updateForced = true;
 }
 
+HassDiscoveryStats_t MqttHandleHassClass::getDiscoveryStats() const
+{
+    return _stats;
+}
+
 void MqttHandleHassClass::publishConfig()
 {
-    if (!Configuration.get().Mqtt.Hass.Enabled) {
+    if (!Configuration.getSnapshot()->get().Mqtt.Hass.Enabled) {
+        _passActive = false;
+        _publishedHashes.clear();
         return;
     }
 
-    if (!MqttSettings.getConnected() && Hoymiles.isAllRadioIdle()) {
-        return;
+    // (Re)start from the beginning
+    _passActive = true;
+    _passInverterPos = -1;
+    _passUnitPos = 0;
+
+    _passStart = millis();
+    _passHeapStart = ESP.getFreeHeap();
+    _passHeapMin = _passHeapStart;
+    _pass = {};
+}
+
+void MqttHandleHassClass::finishPass()
+{
+    _passActive = false;
+
+    _pass.Passes = _stats.Passes + 1;
+    _pass.Duration = millis() - _passStart;
+    _pass.PeakHeapUsage = _passHeapStart > _passHeapMin ? _passHeapStart - _passHeapMin : 0;
+    _stats = _pass;
+
+    MessageOutput.printf("HASS discovery: %u published, %u unchanged in %u ms, max. %u us per loop, peak heap usage %u bytes\r\n",
+        _stats.Published, _stats.Unchanged, _stats.Duration, _stats.MaxTickTime, _stats.PeakHeapUsage);
+}
+
+// Publishes the next group of documents. Returns false if the pass is complete.
+bool MqttHandleHassClass::publishNextUnit()
+{
+    if (_passInverterPos < 0) {
+        publishDtuConfig();
+        _passInverterPos = 0;
+        _passUnitPos = 0;
+        return true;
+    }
+
+    // Also the end of the pass if inverters were removed in between
+    auto inv = Hoymiles.getInverterByPos(_passInverterPos);
+    if (inv == nullptr) {
+        return false;
     }
 
-    const CONFIG_T& config = Configuration.get();
+    bool unitFound = true;
+    if (_passUnitPos == 0) {
+        publishInverterControls(inv);
+    } else {
+        unitFound = publishInverterChannel(inv, _passUnitPos - 1);
+    }
+
+    if (unitFound) {
+        _passUnitPos++;
+    } else {
+        _passInverterPos++;
+        _passUnitPos = 0;
+    }
+
+    return true;
+}
+
+void MqttHandleHassClass::publishDtuConfig()
+{
+    const CONFIG_T& config = _config->get();
 
-    // publish DTU sensors
     publishDtuSensor("IP", "", "diagnostic", "mdi:network-outline", "", "");
     publishDtuSensor("WiFi Signal", "signal_strength", "diagnostic", "", "dBm", "rssi");
     publishDtuSensor("Uptime", "duration", "diagnostic", "", "s", "");
     publishDtuBinarySensor("Status", "connectivity", "diagnostic", config.Mqtt.Lwt.Value_Online, config.Mqtt.Lwt.Value_Offline, config.Mqtt.Lwt.Topic);
+}
 
-    yield();
+void MqttHandleHassClass::publishInverterControls(std::shared_ptr<InverterAbstract> inv)
+{
+    publishInverterButton(inv, "Turn Inverter Off", "mdi:power-plug-off", "config", "", "cmd/power", "0");
+    publishInverterButton(inv, "Turn Inverter On", "mdi:power-plug", "config", "", "cmd/power", "1");
+    publishInverterButton(inv, "Restart Inverter", "", "config", "restart", "cmd/restart", "1");
 
-    // Loop all inverters
-    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
-        auto inv = Hoymiles.getInverterByPos(i);
+    publishInverterNumber(inv, "Limit NonPersistent Relative", "mdi:speedometer", "config", "cmd/limit_nonpersistent_relative", "status/limit_relative", "%", 0, 100, 0.1);
+    publishInverterNumber(inv, "Limit Persistent Relative", "mdi:speedometer", "config", "cmd/limit_persistent_relative", "status/limit_relative", "%", 0, 100, 0.1);
 
-        publishInverterButton(inv, "Turn Inverter Off", "mdi:power-plug-off", "config", "", "cmd/power", "0");
-        publishInverterButton(inv, "Turn Inverter On", "mdi:power-plug", "config", "", "cmd/power", "1");
-        publishInverterButton(inv, "Restart Inverter", "", "config", "restart", "cmd/restart", "1");
+    publishInverterNumber(inv, "Limit NonPersistent Absolute", "mdi:speedometer", "config", "cmd/limit_nonpersistent_absolute", "status/limit_absolute", "W", 0, MAX_INVERTER_LIMIT);
+    publishInverterNumber(inv, "Limit Persistent Absolute", "mdi:speedometer", "config", "cmd/limit_persistent_absolute", "status/limit_absolute", "W", 0, MAX_INVERTER_LIMIT);
 
-        publishInverterNumber(inv, "Limit NonPersistent Relative", "mdi:speedometer", "config", "cmd/limit_nonpersistent_relative", "status/limit_relative", "%", 0, 100, 0.1);
-        publishInverterNumber(inv, "Limit Persistent Relative", "mdi:speedometer", "config", "cmd/limit_persistent_relative", "status/limit_relative", "%", 0, 100, 0.1);
+    publishInverterBinarySensor(inv, "Reachable", "status/reachable", "1", "0");
+    publishInverterBinarySensor(inv, "Producing", "status/producing", "1", "0");
+}
 
-        publishInverterNumber(inv, "Limit NonPersistent Absolute", "mdi:speedometer", "config", "cmd/limit_nonpersistent_absolute", "status/limit_absolute", "W", 0, MAX_INVERTER_LIMIT);
-        publishInverterNumber(inv, "Limit Persistent Absolute", "mdi:speedometer", "config", "cmd/limit_persistent_absolute", "status/limit_absolute", "W", 0, MAX_INVERTER_LIMIT);
+// Publishes all fields of the channel at position pos. Returns false if there is no such channel.
+bool MqttHandleHassClass::publishInverterChannel(std::shared_ptr<InverterAbstract> inv, const uint8_t pos)
+{
+    const CONFIG_T& config = _config->get();
 
-        publishInverterBinarySensor(inv, "Reachable", "status/reachable", "1", "0");
-        publishInverterBinarySensor(inv, "Producing", "status/producing", "1", "0");
+    uint8_t i = 0;
+    for (auto& t : inv->Statistics()->getChannelTypes()) {
+        for (auto& c : inv->Statistics()->getChannelsByType(t)) {
+            if (i++ != pos) {
+                continue;
+            }
 
-        // Loop all channels
-        for (auto& t : inv->Statistics()->getChannelTypes()) {
-            for (auto& c : inv->Statistics()->getChannelsByType(t)) {
-                for (uint8_t f = 0; f < DEVICE_CLS_ASSIGN_LIST_LEN; f++) {
-                    bool clear = false;
-                    if (t == TYPE_DC && !config.Mqtt.Hass.IndividualPanels) {
-                        clear = true;
-                    }
-                    publishInverterField(inv, t, c, deviceFieldAssignment[f], clear);
+            for (uint8_t f = 0; f < DEVICE_CLS_ASSIGN_LIST_LEN; f++) {
+                bool clear = false;
+                if (t == TYPE_DC && !config.Mqtt.Hass.IndividualPanels) {
+                    clear = true;
                 }
+                publishInverterField(inv, t, c, deviceFieldAssignment[f], clear);
             }
+            return true;
         }
-
-        yield();
     }
+
+    return false;
 }
 
 void MqttHandleHassClass::publishInverterField(std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const byteAssign_fieldDeviceClass_t fieldType, const bool clear)
@@ -151,8 +284,9 @@ void MqttHandleHassClass::publishInverterField(std::shared_ptr<InverterAbstract>
 
         createInverterInfo(root, inv);
 
-        if (Configuration.get().Mqtt.Hass.Expire) {
-            root["exp_aft"] = Hoymiles.getNumInverters() * max<uint32_t>(Hoymiles.PollInterval(), Configuration.get().Mqtt.PublishInterval) * inv->getReachableThreshold();
+        const CONFIG_T& config = _config->get();
+        if (config.Mqtt.Hass.Expire) {
+            root["exp_aft"] = Hoymiles.getNumInverters() * max<uint32_t>(Hoymiles.PollInterval(), config.Mqtt.PublishInterval) * inv->getReachableThreshold();
         }
         if (devCls != 0) {
             root["dev_cla"] = devCls;
@@ -317,9 +451,8 @@ void MqttHandleHassClass::publishDtuSensor(const char* name, const char* device_
     }
     root["stat_t"] = MqttSettings.getPrefix() + "dtu" + "/" + topic;
 
-    root["avty_t"] = MqttSettings.getPrefix() + Configuration.get().Mqtt.Lwt.Topic;
-
-    const CONFIG_T& config = Configuration.get();
+    const CONFIG_T& config = _config->get();
+    root["avty_t"] = MqttSettings.getPrefix() + config.Mqtt.Lwt.Topic;
     root["pl_avail"] = config.Mqtt.Lwt.Value_Online;
     root["pl_not_avail"] = config.Mqtt.Lwt.Value_Offline;
 
@@ -430,7 +563,38 @@ String MqttHandleHassClass::getDtuUrl()
 
 void MqttHandleHassClass::publish(const String& subtopic, const String& payload)
 {
-    String topic = Configuration.get().Mqtt.Hass.Topic;
+    const CONFIG_T& config = _config->get();
+    String topic = config.Mqtt.Hass.Topic;
     topic += subtopic;
-    MqttSettings.publishGeneric(topic, payload, Configuration.get().Mqtt.Hass.Retain);
+
+    // Document and buffer of the caller are still allocated at this point
+    _passHeapMin = min<uint32_t>(_passHeapMin, ESP.getFreeHeap());
+
+    const published_hash_t hash = { Utils::getFnv1aHash(topic.c_str()), Utils::getFnv1aHash(payload.c_str()) };
+    auto it = std::lower_bound(_publishedHashes.begin(), _publishedHashes.end(), hash,
+        [](const published_hash_t& a, const published_hash_t& b) { return a.topic < b.topic; });
+
+    if (it != _publishedHashes.end() && it->topic == hash.topic && it->payload == hash.payload) {
+        _pass.Unchanged++;
+        return;
+    }
+
+    // The hash is recorded when the client got the document. If the queue
+    // drops it, the loop starts another pass.
+    if (MqttSettings.publishGeneric(topic, payload, config.Mqtt.Hass.Retain, 0, MqttPublishPriority::Discovery)) {
+        _pass.Published++;
+    }
+}
+
+void MqttHandleHassClass::onDiscoverySent(const String& topic, const String& payload)
+{
+    const published_hash_t hash = { Utils::getFnv1aHash(topic.c_str()), Utils::getFnv1aHash(payload.c_str()) };
+    auto it = std::lower_bound(_publishedHashes.begin(), _publishedHashes.end(), hash,
+        [](const published_hash_t& a, const published_hash_t& b) { return a.topic < b.topic; });
+
+    if (it != _publishedHashes.end() && it->topic == hash.topic) {
+        it->payload = hash.payload;
+    } else {
+        _publishedHashes.insert(it, hash);
+    }
 }
@@ -5,6 +5,8 @@
 #include "MqttHandleInverter.h"
 #include "MessageOutput.h"
 #include "MqttSettings.h"
+#include "Scheduler.h"
+#include <HeapAccounting.h>
 #include <ctime>
 
 #define TOPIC_SUB_LIMIT_PERSISTENT_RELATIVE "limit_persistent_relative"
@@ -16,10 +18,13 @@
 
 #define PUBLISH_MAX_INTERVAL 60000
 
+// Free space in the MQTT publish queue required to publish the values of one inverter
+#define PUBLISH_MIN_QUEUE_FREE (12 * 1024)
+
 MqttHandleInverterClass MqttHandleInverter;
 
 MqttHandleInverterClass::MqttHandleInverterClass()
-    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&MqttHandleInverterClass::loop, this))
+    : _loopTask("mqtt_inverter", TASK_IMMEDIATE, TASK_FOREVER, std::bind(&MqttHandleInverterClass::loop, this))
 {
 }
 
@@ -28,22 +33,32 @@ void MqttHandleInverterClass::init(Scheduler& scheduler)
     subscribeTopics();
 
     scheduler.addTask(_loopTask);
-    _loopTask.setInterval(Configuration.get().Mqtt.PublishInterval * TASK_SECOND);
+    _loopTask.setInterval(Configuration.getSnapshot()->get().Mqtt.PublishInterval * TASK_SECOND);
     _loopTask.enable();
 }
 
 void MqttHandleInverterClass::loop()
 {
-    _loopTask.setInterval(Configuration.get().Mqtt.PublishInterval * TASK_SECOND);
+    HeapTagScope heapTag(HeapTag::Mqtt);
+
+    const ConfigSnapshotPtr config = Configuration.getSnapshot();
+    _loopTask.setInterval(config->get().Mqtt.PublishInterval * TASK_SECOND);
 
     if (!MqttSettings.getConnected() || !Hoymiles.isAllRadioIdle()) {
-        _loopTask.forceNextIteration();
+        _loopTask.delay(SCHEDULER_RETRY_DELAY);
         return;
     }
 
-    // Loop all inverters
-    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
-        auto inv = Hoymiles.getInverterByPos(i);
+    // Loop all inverters, continue with the last one if the queue was full
+    const InverterListPtr inverters = Hoymiles.getInverters();
+    for (uint8_t i = _nextInverterPos; i < inverters->size(); i++) {
+        if (MqttSettings.getQueueFree() < PUBLISH_MIN_QUEUE_FREE) {
+            _nextInverterPos = i;
+            _loopTask.delay(SCHEDULER_RETRY_DELAY);
+            return;
+        }
+
+        auto inv = (*inverters)[i];
 
         const String subtopic = inv->serialString();
 
@@ -77,7 +92,7 @@ void MqttHandleInverterClass::loop()
             }
         }
 
-        MqttSettings.publish(subtopic + "/status/reachable", String(inv->isReachable()));
+        MqttSettings.publish(subtopic + "/status/reachable", String(inv->isReachable()), MqttPublishPriority::Availability);
         MqttSettings.publish(subtopic + "/status/producing", String(inv->isProducing()));
 
         if (inv->Statistics()->getLastUpdate() > 0) {
@@ -94,7 +109,7 @@ void MqttHandleInverterClass::loop()
             for (auto& t : inv->Statistics()->getChannelTypes()) {
                 for (auto& c : inv->Statistics()->getChannelsByType(t)) {
                     if (t == TYPE_DC) {
-                        INVERTER_CONFIG_T* inv_cfg = Configuration.getInverterConfig(inv->serial());
+                        const INVERTER_CONFIG_T* inv_cfg = config->getInverterConfig(inv->serial());
                         if (inv_cfg != nullptr) {
                             // TODO(tbnobody)
                             MqttSettings.publish(inv->serialString() + "/" + String(static_cast<uint8_t>(c) + 1) + "/name", inv_cfg->channel[c].Name);
@@ -109,6 +124,8 @@ void MqttHandleInverterClass::loop()
 
         yield();
     }
+
+    _nextInverterPos = 0;
 }
 
 void MqttHandleInverterClass::publishField(std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId)
@@ -148,7 +165,10 @@ String MqttHandleInverterClass::getTopic(std::shared_ptr<InverterAbstract> inv,
 
 void MqttHandleInverterClass::onMqttMessage(const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, const size_t len, const size_t index, const size_t total)
 {
-    const CONFIG_T& config = Configuration.get();
+    HeapTagScope heapTag(HeapTag::Mqtt);
+
+    const ConfigSnapshotPtr snapshot = Configuration.getSnapshot();
+    const CONFIG_T& config = snapshot->get();
 
     char token_topic[MQTT_MAX_TOPIC_STRLEN + 40]; // respect all subtopics
     strncpy(token_topic, topic, MQTT_MAX_TOPIC_STRLEN + 40); // convert const char* to char*
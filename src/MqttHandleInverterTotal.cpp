@@ -6,33 +6,47 @@
 #include "Configuration.h"
 #include "Datastore.h"
 #include "MqttSettings.h"
+#include "PowerHistory.h"
+#include "Scheduler.h"
+#include <HeapAccounting.h>
 #include <Hoymiles.h>
 
 MqttHandleInverterTotalClass MqttHandleInverterTotal;
 
 MqttHandleInverterTotalClass::MqttHandleInverterTotalClass()
-    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&MqttHandleInverterTotalClass::loop, this))
+    : _loopTask("mqtt_inverter_total", TASK_IMMEDIATE, TASK_FOREVER, std::bind(&MqttHandleInverterTotalClass::loop, this))
 {
 }
 
 void MqttHandleInverterTotalClass::init(Scheduler& scheduler)
 {
     scheduler.addTask(_loopTask);
-    _loopTask.setInterval(Configuration.get().Mqtt.PublishInterval * TASK_SECOND);
+    _loopTask.setInterval(Configuration.getSnapshot()->get().Mqtt.PublishInterval * TASK_SECOND);
     _loopTask.enable();
 }
 
 void MqttHandleInverterTotalClass::loop()
 {
+    HeapTagScope heapTag(HeapTag::Mqtt);
+
     // Update interval from config
-    _loopTask.setInterval(Configuration.get().Mqtt.PublishInterval * TASK_SECOND);
+    _loopTask.setInterval(Configuration.getSnapshot()->get().Mqtt.PublishInterval * TASK_SECOND);
 
     if (!MqttSettings.getConnected() || !Hoymiles.isAllRadioIdle()) {
-        _loopTask.forceNextIteration();
+        _loopTask.delay(SCHEDULER_RETRY_DELAY);
         return;
     }
 
     MqttSettings.publish("ac/power", String(Datastore.getTotalAcPowerEnabled(), Datastore.getTotalAcPowerDigits()));
+
+    // Power during the last completed minute
+    PowerHistoryBucket_t bucket;
+    if (PowerHistory.getLastBucket(PowerHistory.findLevel(60), bucket)) {
+        MqttSettings.publish("ac/power_min", String(bucket.Min));
+        MqttSettings.publish("ac/power_max", String(bucket.Max));
+        MqttSettings.publish("ac/power_avg", String(bucket.Avg));
+    }
+
     MqttSettings.publish("ac/yieldtotal", String(Datastore.getTotalAcYieldTotalEnabled(), Datastore.getTotalAcYieldTotalDigits()));
     MqttSettings.publish("ac/yieldday", String(Datastore.getTotalAcYieldDayEnabled(), Datastore.getTotalAcYieldDayDigits()));
     MqttSettings.publish("ac/is_valid", String(Datastore.getIsAllEnabledReachable()));
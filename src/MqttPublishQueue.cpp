@@ -0,0 +1,223 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2024 Thomas Basler and others
+ */
+#include "MqttPublishQueue.h"
+#include "Utils.h"
+#include <algorithm>
+
+// Approximation of list node, index entry and String heap headers per message
+#define MQTT_QUEUE_ENTRY_OVERHEAD (sizeof(message_t) + 48)
+
+MqttPublishQueue::MqttPublishQueue(const size_t budget)
+    : _budget(budget)
+{
+}
+
+bool MqttPublishQueue::push(const String& topic, const String& payload, const bool retain, const uint8_t qos, const MqttPublishPriority priority)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const bool coalescable = priority != MqttPublishPriority::CommandAck;
+    const uint32_t hash = getTopicHash(topic);
+
+    if (coalescable) {
+        auto idx = _index.find(hash);
+        if (idx != _index.end()) {
+            message_t& queued = *idx->second;
+            if (queued.priority == priority && queued.topic == topic) {
+                // Replace the stale value but keep the position in the queue.
+                // A slightly longer payload may exceed the budget until the next pop.
+                const size_t oldCost = getCost(queued);
+                queued.payload = payload;
+                queued.retain = retain;
+                queued.qos = qos;
+                account(priority, oldCost, getCost(queued));
+                _replaced++;
+                return true;
+            }
+        }
+    }
+
+    message_t message = { topic, payload, retain, qos, priority, millis() };
+    const size_t cost = getCost(message);
+    if (!evict(priority, cost)) {
+        _dropped++;
+        _classDropped[static_cast<uint8_t>(priority)]++;
+        return false;
+    }
+
+    auto& queue = _queues[static_cast<uint8_t>(priority)];
+    queue.push_back(std::move(message));
+    if (coalescable) {
+        _index[hash] = std::prev(queue.end());
+    }
+
+    account(priority, 0, cost);
+    _depth++;
+    _enqueued++;
+    return true;
+}
+
+bool MqttPublishQueue::pop(message_t& message)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (auto& queue : _queues) {
+        if (queue.empty()) {
+            continue;
+        }
+
+        removeIndex(queue.begin());
+        account(queue.front().priority, getCost(queue.front()), 0);
+        _depth--;
+        message = std::move(queue.front());
+        queue.pop_front();
+        return true;
+    }
+
+    return false;
+}
+
+void MqttPublishQueue::unpop(message_t&& message)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // The message was accounted before, so it is put back even if this
+    // exceeds the budget for a moment
+    account(message.priority, 0, getCost(message));
+    _depth++;
+
+    auto& queue = _queues[static_cast<uint8_t>(message.priority)];
+    queue.push_front(std::move(message));
+    if (queue.front().priority != MqttPublishPriority::CommandAck) {
+        const uint32_t hash = getTopicHash(queue.front().topic);
+        if (_index.find(hash) == _index.end()) {
+            _index[hash] = queue.begin();
+        }
+    }
+}
+
+void MqttPublishQueue::markSent(const message_t& message)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const uint32_t latency = millis() - message.enqueued;
+    _latencySum += latency;
+    _latencyMax = std::max(_latencyMax, latency);
+    _sent++;
+}
+
+void MqttPublishQueue::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for (auto& queue : _queues) {
+        queue.clear();
+    }
+    _index.clear();
+    for (auto& bytes : _classBytes) {
+        bytes = 0;
+    }
+    _bytes = 0;
+    _depth = 0;
+}
+
+bool MqttPublishQueue::empty() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _depth == 0;
+}
+
+size_t MqttPublishQueue::getFree() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _bytes < _budget ? _budget - _bytes : 0;
+}
+
+MqttPublishQueueStats_t MqttPublishQueue::getStats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    MqttPublishQueueStats_t stats;
+    stats.Depth = _depth;
+    stats.Bytes = _bytes;
+    stats.Budget = _budget;
+    stats.Enqueued = _enqueued;
+    stats.Sent = _sent;
+    stats.Replaced = _replaced;
+    stats.Dropped = _dropped;
+    stats.LatencyAvg = _sent > 0 ? _latencySum / _sent : 0;
+    stats.LatencyMax = _latencyMax;
+    return stats;
+}
+
+uint32_t MqttPublishQueue::getDropped(const MqttPublishPriority priority) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _classDropped[static_cast<uint8_t>(priority)];
+}
+
+size_t MqttPublishQueue::getCost(const message_t& message)
+{
+    return message.topic.length() + message.payload.length() + MQTT_QUEUE_ENTRY_OVERHEAD;
+}
+
+uint32_t MqttPublishQueue::getTopicHash(const String& topic)
+{
+    return Utils::getFnv1aHash(topic.c_str());
+}
+
+/*
+ * Frees at least required bytes by discarding the oldest messages of the
+ * lowest priority classes, down to (and including) the class of the new
+ * message. Returns false if that is not possible.
+ */
+bool MqttPublishQueue::evict(const MqttPublishPriority priority, const size_t required)
+{
+    if (_bytes + required <= _budget) {
+        return true;
+    }
+
+    // Check first whether discarding is sufficient at all to avoid
+    // throwing away messages for nothing
+    size_t evictable = 0;
+    for (uint8_t p = static_cast<uint8_t>(priority); p < MQTT_PUBLISH_PRIORITY_COUNT; p++) {
+        evictable += _classBytes[p];
+    }
+    if (_bytes - evictable + required > _budget) {
+        return false;
+    }
+
+    for (int8_t p = MQTT_PUBLISH_PRIORITY_COUNT - 1; p >= static_cast<int8_t>(priority); p--) {
+        auto& queue = _queues[p];
+        while (_bytes + required > _budget && !queue.empty()) {
+            removeIndex(queue.begin());
+            account(queue.front().priority, getCost(queue.front()), 0);
+            _depth--;
+            _dropped++;
+            _classDropped[p]++;
+            queue.pop_front();
+        }
+    }
+
+    return true;
+}
+
+void MqttPublishQueue::account(const MqttPublishPriority priority, const size_t oldCost, const size_t newCost)
+{
+    _classBytes[static_cast<uint8_t>(priority)] += newCost - oldCost;
+    _bytes += newCost - oldCost;
+}
+
+void MqttPublishQueue::removeIndex(const list_t::iterator& it)
+{
+    if (it->priority == MqttPublishPriority::CommandAck) {
+        return;
+    }
+
+    auto idx = _index.find(getTopicHash(it->topic));
+    if (idx != _index.end() && idx->second == it) {
+        _index.erase(idx);
+    }
+}
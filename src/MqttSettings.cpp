@@ -5,8 +5,17 @@
 #include "MqttSettings.h"
 #include "Configuration.h"
 #include "MessageOutput.h"
+#include <HeapAccounting.h>
+
+// Memory which may be used by messages waiting to be handed over to the client
+#define MQTT_QUEUE_BUDGET (32 * 1024)
+
+// Maximum amount of messages in the outbox of the client
+#define MQTT_CLIENT_MAX_QUEUED 8
 
 MqttSettingsClass::MqttSettingsClass()
+    : _flushTask("mqtt_flush", 10 * TASK_MILLISECOND, TASK_FOREVER, std::bind(&MqttSettingsClass::flushQueue, this))
+    , _publishQueue(MQTT_QUEUE_BUDGET)
 {
 }
 
@@ -28,9 +37,10 @@ void MqttSettingsClass::NetworkEvent(network_event event)
 
 void MqttSettingsClass::onMqttConnect(const bool sessionPresent)
 {
-    MessageOutput.println("Connected to MQTT.");
-    const CONFIG_T& config = Configuration.get();
-    publish(config.Mqtt.Lwt.Topic, config.Mqtt.Lwt.Value_Online);
+    MessageOutput.log(LogTag::Mqtt, LogLevel::Info, "Connected to MQTT.\r\n");
+    const ConfigSnapshotPtr snapshot = Configuration.getSnapshot();
+    const CONFIG_T& config = snapshot->get();
+    publish(config.Mqtt.Lwt.Topic, config.Mqtt.Lwt.Value_Online, MqttPublishPriority::Availability);
 
     std::lock_guard<std::mutex> lock(_clientLock);
     if (_mqttClient != nullptr) {
@@ -40,13 +50,18 @@ void MqttSettingsClass::onMqttConnect(const bool sessionPresent)
     }
 }
 
-void MqttSettingsClass::subscribe(const String& topic, const uint8_t qos, const espMqttClientTypes::OnMessageCallback& cb)
+bool MqttSettingsClass::subscribe(const String& topic, const uint8_t qos, const espMqttClientTypes::OnMessageCallback& cb)
 {
-    _mqttSubscribeParser.register_callback(topic.c_str(), qos, cb);
+    if (!_mqttSubscribeParser.register_callback(topic.c_str(), qos, cb)) {
+        MessageOutput.log(LogTag::Mqtt, LogLevel::Error, "Invalid subscription filter: %s\r\n", topic.c_str());
+        return false;
+    }
+
     std::lock_guard<std::mutex> lock(_clientLock);
     if (_mqttClient != nullptr) {
         _mqttClient->subscribe(topic.c_str(), qos);
     }
+    return true;
 }
 
 void MqttSettingsClass::unsubscribe(const String& topic)
@@ -60,46 +75,47 @@ void MqttSettingsClass::unsubscribe(const String& topic)
 
 void MqttSettingsClass::onMqttDisconnect(espMqttClientTypes::DisconnectReason reason)
 {
-    MessageOutput.println("Disconnected from MQTT.");
-
-    MessageOutput.print("Disconnect reason:");
+    const char* reasonText;
     switch (reason) {
     case espMqttClientTypes::DisconnectReason::TCP_DISCONNECTED:
-        MessageOutput.println("TCP_DISCONNECTED");
+        reasonText = "TCP_DISCONNECTED";
         break;
     case espMqttClientTypes::DisconnectReason::MQTT_UNACCEPTABLE_PROTOCOL_VERSION:
-        MessageOutput.println("MQTT_UNACCEPTABLE_PROTOCOL_VERSION");
+        reasonText = "MQTT_UNACCEPTABLE_PROTOCOL_VERSION";
         break;
     case espMqttClientTypes::DisconnectReason::MQTT_IDENTIFIER_REJECTED:
-        MessageOutput.println("MQTT_IDENTIFIER_REJECTED");
+        reasonText = "MQTT_IDENTIFIER_REJECTED";
         break;
     case espMqttClientTypes::DisconnectReason::MQTT_SERVER_UNAVAILABLE:
-        MessageOutput.println("MQTT_SERVER_UNAVAILABLE");
+        reasonText = "MQTT_SERVER_UNAVAILABLE";
         break;
     case espMqttClientTypes::DisconnectReason::MQTT_MALFORMED_CREDENTIALS:
-        MessageOutput.println("MQTT_MALFORMED_CREDENTIALS");
+        reasonText = "MQTT_MALFORMED_CREDENTIALS";
         break;
     case espMqttClientTypes::DisconnectReason::MQTT_NOT_AUTHORIZED:
-        MessageOutput.println("MQTT_NOT_AUTHORIZED");
+        reasonText = "MQTT_NOT_AUTHORIZED";
         break;
     default:
-        MessageOutput.println("Unknown");
+        reasonText = "Unknown";
     }
+    MessageOutput.log(LogTag::Mqtt, LogLevel::Warning, "Disconnected from MQTT.\r\nDisconnect reason:%s\r\n", reasonText);
+
     _mqttReconnectTimer.once(
         2, +[](MqttSettingsClass* instance) { instance->performConnect(); }, this);
 }
 
 void MqttSettingsClass::onMqttMessage(const espMqttClientTypes::MessageProperties& properties, const char* topic, const uint8_t* payload, const size_t len, const size_t index, const size_t total)
 {
-    MessageOutput.print("Received MQTT message on topic: ");
-    MessageOutput.println(topic);
+    HeapTagScope heapTag(HeapTag::Mqtt);
+
+    MessageOutput.log(LogTag::Mqtt, LogLevel::Debug, "Received MQTT message on topic: %s\r\n", topic);
 
     _mqttSubscribeParser.handle_message(properties, topic, payload, len, index, total);
 }
 
 void MqttSettingsClass::performConnect()
 {
-    if (NetworkSettings.isConnected() && Configuration.get().Mqtt.Enabled) {
+    if (NetworkSettings.isConnected() && Configuration.getSnapshot()->get().Mqtt.Enabled) {
         using std::placeholders::_1;
         using std::placeholders::_2;
         using std::placeholders::_3;
@@ -112,8 +128,11 @@ void MqttSettingsClass::performConnect()
             return;
         }
 
-        MessageOutput.println("Connecting to MQTT...");
-        const CONFIG_T& config = Configuration.get();
+        MessageOutput.log(LogTag::Mqtt, LogLevel::Info, "Connecting to MQTT...\r\n");
+        // The client keeps the pointers to hostname, credentials and
+        // certificates, so the snapshot is held until the next connect
+        const ConfigSnapshotPtr snapshot = Configuration.getSnapshot();
+        const CONFIG_T& config = snapshot->get();
         const String willTopic = getPrefix() + config.Mqtt.Lwt.Topic;
         String clientId = getClientId();
         if (config.Mqtt.Tls.Enabled) {
@@ -141,18 +160,26 @@ void MqttSettingsClass::performConnect()
             static_cast<espMqttClient*>(_mqttClient)->onDisconnect(std::bind(&MqttSettingsClass::onMqttDisconnect, this, _1));
             static_cast<espMqttClient*>(_mqttClient)->onMessage(std::bind(&MqttSettingsClass::onMqttMessage, this, _1, _2, _3, _4, _5, _6));
         }
+        _clientConfig = snapshot;
         _mqttClient->connect();
     }
 }
 
 void MqttSettingsClass::performDisconnect()
 {
-    const CONFIG_T& config = Configuration.get();
-    publish(config.Mqtt.Lwt.Topic, config.Mqtt.Lwt.Value_Offline);
+    const ConfigSnapshotPtr snapshot = Configuration.getSnapshot();
+    const CONFIG_T& config = snapshot->get();
+    const String topic = getPrefix() + config.Mqtt.Lwt.Topic;
+
+    // Queued messages may belong to the old topic prefix
+    _publishQueue.clear();
+
     std::lock_guard<std::mutex> lock(_clientLock);
     if (_mqttClient == nullptr) {
         return;
     }
+    // Bypass the queue as the client is disconnected immediately
+    _mqttClient->publish(topic.c_str(), 0, config.Mqtt.Retain, config.Mqtt.Lwt.Value_Offline);
     _mqttClient->disconnect();
 }
 
@@ -177,44 +204,108 @@ bool MqttSettingsClass::getConnected()
 
 String MqttSettingsClass::getPrefix() const
 {
-    return Configuration.get().Mqtt.Topic;
+    return Configuration.getSnapshot()->get().Mqtt.Topic;
 }
 
 String MqttSettingsClass::getClientId()
 {
-    String clientId = Configuration.get().Mqtt.ClientId;
+    String clientId = Configuration.getSnapshot()->get().Mqtt.ClientId;
     if (clientId == "") {
         clientId = NetworkSettings.getApName();
     }
     return clientId;
 }
 
-void MqttSettingsClass::publish(const String& subtopic, const String& payload)
+void MqttSettingsClass::publish(const String& subtopic, const String& payload, const MqttPublishPriority priority)
 {
-    String topic = getPrefix();
+    const ConfigSnapshotPtr snapshot = Configuration.getSnapshot();
+    const CONFIG_T& config = snapshot->get();
+
+    if (!config.Mqtt.Enabled) {
+        return;
+    }
+
+    String topic = config.Mqtt.Topic;
     topic += subtopic;
 
     String value = payload;
     value.trim();
 
-    publishGeneric(topic, value, Configuration.get().Mqtt.Retain, 0);
+    _publishQueue.push(topic, value, config.Mqtt.Retain, 0, priority);
 }
 
-void MqttSettingsClass::publishGeneric(const String& topic, const String& payload, const bool retain, const uint8_t qos)
+bool MqttSettingsClass::publishGeneric(const String& topic, const String& payload, const bool retain, const uint8_t qos, const MqttPublishPriority priority)
 {
-    std::lock_guard<std::mutex> lock(_clientLock);
-    if (_mqttClient == nullptr) {
+    if (!Configuration.getSnapshot()->get().Mqtt.Enabled) {
+        return false;
+    }
+
+    return _publishQueue.push(topic, payload, retain, qos, priority);
+}
+
+size_t MqttSettingsClass::getQueueFree() const
+{
+    return _publishQueue.getFree();
+}
+
+MqttPublishQueueStats_t MqttSettingsClass::getQueueStats() const
+{
+    return _publishQueue.getStats();
+}
+
+uint32_t MqttSettingsClass::getQueueDropped(const MqttPublishPriority priority) const
+{
+    return _publishQueue.getDropped(priority);
+}
+
+void MqttSettingsClass::onSent(const MqttPublishPriority priority, const MqttSentCallback& cb)
+{
+    _sentCallbacks[static_cast<uint8_t>(priority)] = cb;
+}
+
+void MqttSettingsClass::flushQueue()
+{
+    HeapTagScope heapTag(HeapTag::Mqtt);
+
+    if (_publishQueue.empty() || !getConnected()) {
         return;
     }
-    _mqttClient->publish(topic.c_str(), qos, retain, payload.c_str());
+
+    MqttPublishQueue::message_t message;
+    while (true) {
+        std::lock_guard<std::mutex> lock(_clientLock);
+        if (_mqttClient == nullptr || _mqttClient->queueSize() >= MQTT_CLIENT_MAX_QUEUED) {
+            return;
+        }
+
+        if (!_publishQueue.pop(message)) {
+            return;
+        }
+
+        if (_mqttClient->publish(message.topic.c_str(), message.qos, message.retain, message.payload.c_str()) == 0) {
+            // Client could not allocate the packet, retry later
+            _publishQueue.unpop(std::move(message));
+            return;
+        }
+
+        _publishQueue.markSent(message);
+
+        const auto& cb = _sentCallbacks[static_cast<uint8_t>(message.priority)];
+        if (cb) {
+            cb(message.topic, message.payload);
+        }
+    }
 }
 
-void MqttSettingsClass::init()
+void MqttSettingsClass::init(Scheduler& scheduler)
 {
     using std::placeholders::_1;
     NetworkSettings.onEvent(std::bind(&MqttSettingsClass::NetworkEvent, this, _1));
 
     createMqttClientObject();
+
+    scheduler.addTask(_flushTask);
+    _flushTask.enable();
 }
 
 void MqttSettingsClass::createMqttClientObject()
@@ -224,8 +315,7 @@ void MqttSettingsClass::createMqttClientObject()
         delete _mqttClient;
         _mqttClient = nullptr;
     }
-    const CONFIG_T& config = Configuration.get();
-    if (config.Mqtt.Tls.Enabled) {
+    if (Configuration.getSnapshot()->get().Mqtt.Tls.Enabled) {
         _mqttClient = static_cast<MqttClient*>(new espMqttClientSecure);
     } else {
         _mqttClient = static_cast<MqttClient*>(new espMqttClient);
@@ -13,7 +13,7 @@
 #include "__compiled_constants.h"
 
 NetworkSettingsClass::NetworkSettingsClass()
-    : _loopTask(TASK_IMMEDIATE, TASK_FOREVER, std::bind(&NetworkSettingsClass::loop, this))
+    : _loopTask("network", NETWORK_LOOP_INTERVAL * TASK_MILLISECOND, TASK_FOREVER, std::bind(&NetworkSettingsClass::loop, this))
     , _apIp(192, 168, 4, 1)
     , _apNetmask(255, 255, 255, 0)
 {
@@ -121,7 +121,7 @@ void NetworkSettingsClass::raiseEvent(const network_event event)
 
 void NetworkSettingsClass::handleMDNS()
 {
-    const bool mdnsEnabled = Configuration.get().Mdns.Enabled;
+    const bool mdnsEnabled = Configuration.getSnapshot()->get().Mdns.Enabled;
 
     if (_lastMdnsEnabled == mdnsEnabled) {
         return;
@@ -154,7 +154,7 @@ void NetworkSettingsClass::setupMode()
         WiFi.mode(WIFI_AP_STA);
         String ssidString = getApName();
         WiFi.softAPConfig(_apIp, _apIp, _apNetmask);
-        WiFi.softAP(ssidString.c_str(), Configuration.get().Security.Password);
+        WiFi.softAP(ssidString.c_str(), Configuration.getSnapshot()->get().Security.Password);
         _dnsServer->setErrorReplyCode(DNSReplyCode::NoError);
         _dnsServer->start(DNS_PORT, "*", WiFi.softAPIP());
         _dnsServerStatus = true;
@@ -178,7 +178,7 @@ void NetworkSettingsClass::enableAdminMode()
 {
     _adminEnabled = true;
     _adminTimeoutCounter = 0;
-    _adminTimeoutCounterMax = Configuration.get().WiFi.ApTimeout * 60;
+    _adminTimeoutCounterMax = Configuration.getSnapshot()->get().WiFi.ApTimeout * 60;
     setupMode();
 }
 
@@ -263,15 +263,18 @@ void NetworkSettingsClass::loop()
 void NetworkSettingsClass::applyConfig()
 {
     setHostname();
-    if (!strcmp(Configuration.get().WiFi.Ssid, "")) {
+
+    const ConfigSnapshotPtr snapshot = Configuration.getSnapshot();
+    const CONFIG_T& config = snapshot->get();
+    if (!strcmp(config.WiFi.Ssid, "")) {
         return;
     }
     MessageOutput.print("Configuring WiFi STA using ");
-    if (strcmp(WiFi.SSID().c_str(), Configuration.get().WiFi.Ssid) || strcmp(WiFi.psk().c_str(), Configuration.get().WiFi.Password)) {
+    if (strcmp(WiFi.SSID().c_str(), config.WiFi.Ssid) || strcmp(WiFi.psk().c_str(), config.WiFi.Password)) {
         MessageOutput.print("new credentials... ");
         WiFi.begin(
-            Configuration.get().WiFi.Ssid,
-            Configuration.get().WiFi.Password,
+            config.WiFi.Ssid,
+            config.WiFi.Password,
             WIFI_ALL_CHANNEL_SCAN);
     } else {
         MessageOutput.print("existing credentials... ");
@@ -306,34 +309,37 @@ void NetworkSettingsClass::setHostname()
 
 void NetworkSettingsClass::setStaticIp()
 {
+    const ConfigSnapshotPtr snapshot = Configuration.getSnapshot();
+    const CONFIG_T& config = snapshot->get();
+
     if (_networkMode == network_mode::WiFi) {
-        if (Configuration.get().WiFi.Dhcp) {
+        if (config.WiFi.Dhcp) {
             MessageOutput.print("Configuring WiFi STA DHCP IP... ");
             WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE);
             MessageOutput.println("done");
         } else {
             MessageOutput.print("Configuring WiFi STA static IP... ");
             WiFi.config(
-                IPAddress(Configuration.get().WiFi.Ip),
-                IPAddress(Configuration.get().WiFi.Gateway),
-                IPAddress(Configuration.get().WiFi.Netmask),
-                IPAddress(Configuration.get().WiFi.Dns1),
-                IPAddress(Configuration.get().WiFi.Dns2));
+                IPAddress(config.WiFi.Ip),
+                IPAddress(config.WiFi.Gateway),
+                IPAddress(config.WiFi.Netmask),
+                IPAddress(config.WiFi.Dns1),
+                IPAddress(config.WiFi.Dns2));
             MessageOutput.println("done");
         }
     } else if (_networkMode == network_mode::Ethernet) {
-        if (Configuration.get().WiFi.Dhcp) {
+        if (config.WiFi.Dhcp) {
             MessageOutput.print("Configuring Ethernet DHCP IP... ");
             ETH.config(INADDR_NONE, INADDR_NONE, INADDR_NONE, INADDR_NONE);
             MessageOutput.println("done");
         } else {
             MessageOutput.print("Configuring Ethernet static IP... ");
             ETH.config(
-                IPAddress(Configuration.get().WiFi.Ip),
-                IPAddress(Configuration.get().WiFi.Gateway),
-                IPAddress(Configuration.get().WiFi.Netmask),
-                IPAddress(Configuration.get().WiFi.Dns1),
-                IPAddress(Configuration.get().WiFi.Dns2));
+                IPAddress(config.WiFi.Ip),
+                IPAddress(config.WiFi.Gateway),
+                IPAddress(config.WiFi.Netmask),
+                IPAddress(config.WiFi.Dns1),
+                IPAddress(config.WiFi.Dns2));
             MessageOutput.println("done");
         }
     }
@@ -411,7 +417,8 @@ String NetworkSettingsClass::macAddress() const
 
 String NetworkSettingsClass::getHostname()
 {
-    const CONFIG_T& config = Configuration.get();
+    const ConfigSnapshotPtr snapshot = Configuration.getSnapshot();
+    const CONFIG_T& config = snapshot->get();
     char preparedHostname[WIFI_MAX_HOSTNAME_STRLEN + 1];
     char resultHostname[WIFI_MAX_HOSTNAME_STRLEN + 1];
     uint8_t pos = 0;
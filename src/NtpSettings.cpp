@@ -5,16 +5,28 @@
 #include "NtpSettings.h"
 #include "Configuration.h"
 #include <Arduino.h>
+#include <Hoymiles.h>
+#include <WallClock.h>
 #include <time.h>
 
 NtpSettingsClass::NtpSettingsClass()
+    : _loopTask("wall_clock", TASK_IMMEDIATE, TASK_FOREVER, std::bind(&NtpSettingsClass::loop, this))
 {
 }
 
-void NtpSettingsClass::init()
+void NtpSettingsClass::init(Scheduler& scheduler)
 {
     setServer();
     setTimezone();
+
+    scheduler.addTask(_loopTask);
+    _loopTask.enable();
+}
+
+void NtpSettingsClass::loop()
+{
+    // Run shortly after the next second started
+    _loopTask.setInterval(WallClock.loop() + 1);
 }
 
 void NtpSettingsClass::setServer()
@@ -26,6 +38,8 @@ void NtpSettingsClass::setTimezone()
 {
     setenv("TZ", Configuration.get().Ntp.Timezone, 1);
     tzset();
+
+    AlarmLogParser::resetTimezoneOffset();
 }
 
 NtpSettingsClass NtpSettings;
\ No newline at end of file
@@ -0,0 +1,208 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2024 Thomas Basler and others
+ */
+#include "PowerHistory.h"
+#include <Arduino.h>
+#include <algorithm>
+#include <cmath>
+
+static const PowerHistoryLevel_t levels[POWER_HISTORY_LEVEL_COUNT] = {
+    { 10, POWER_HISTORY_10S_COUNT },
+    { 60, POWER_HISTORY_1MIN_COUNT },
+    { 15 * 60, POWER_HISTORY_15MIN_COUNT },
+    { 24 * 60 * 60, POWER_HISTORY_1DAY_COUNT },
+};
+
+PowerHistoryClass PowerHistory;
+
+PowerHistoryClass::PowerHistoryClass()
+{
+    uint16_t offset = 0;
+    for (uint8_t level = 0; level < POWER_HISTORY_LEVEL_COUNT; level++) {
+        _levels[level] = { offset, 0, 0, 0, 0, 0, UINT16_MAX, 0 };
+        offset += levels[level].Capacity;
+    }
+}
+
+void PowerHistoryClass::addSample(const float power)
+{
+    const uint32_t now = millis();
+    const uint16_t value = std::lround(std::clamp(power, 0.0f, static_cast<float>(UINT16_MAX)));
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (!_started) {
+        _started = true;
+    } else {
+        _elapsed += now - _lastSample;
+    }
+    _lastSample = now;
+
+    // The first level passes its buckets on, the further levels are advanced
+    // afterwards to close the buckets which did not get any data
+    const uint32_t seconds = _elapsed / 1000;
+    for (uint8_t level = 0; level < POWER_HISTORY_LEVEL_COUNT; level++) {
+        advance(level, seconds / levels[level].Interval);
+    }
+
+    accumulate(0, value, value, value);
+}
+
+const PowerHistoryLevel_t& PowerHistoryClass::getLevel(const uint8_t level)
+{
+    return levels[level];
+}
+
+int8_t PowerHistoryClass::findLevel(const uint32_t interval)
+{
+    for (uint8_t level = 0; level < POWER_HISTORY_LEVEL_COUNT; level++) {
+        if (levels[level].Interval == interval) {
+            return level;
+        }
+    }
+    return -1;
+}
+
+uint16_t PowerHistoryClass::getBucketCount(const uint8_t level)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _levels[level].Count;
+}
+
+void PowerHistoryClass::forEachBucket(const uint8_t level, std::function<void(const PowerHistoryBucket_t& bucket)> cb)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (uint16_t i = 0; i < _levels[level].Count; i++) {
+        cb(getBucket(level, i));
+    }
+}
+
+bool PowerHistoryClass::getLastBucket(const uint8_t level, PowerHistoryBucket_t& bucket)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_levels[level].Count == 0) {
+        return false;
+    }
+    bucket = getBucket(level, _levels[level].Count - 1);
+    return !bucket.isGap();
+}
+
+uint16_t PowerHistoryClass::getAverages(const uint32_t duration, float* values, const uint16_t count)
+{
+    uint8_t level = 0;
+    while (level < POWER_HISTORY_LEVEL_COUNT - 1 && levels[level].Interval * levels[level].Capacity < duration) {
+        level++;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const uint32_t interval = levels[level].Interval;
+    const uint16_t bucketCount = std::min<uint32_t>(_levels[level].Count, (duration + interval - 1) / interval);
+    if (bucketCount == 0 || count == 0) {
+        return 0;
+    }
+
+    // Less than one bucket per value if the level is coarser than requested
+    const float bucketsPerValue = static_cast<float>(duration) / interval / count;
+    const uint16_t valueCount = std::min<float>(count, bucketCount / bucketsPerValue);
+
+    // The newest bucket is always part of the last value
+    const uint16_t first = _levels[level].Count - bucketCount;
+    const float offset = bucketCount - valueCount * bucketsPerValue;
+
+    for (uint16_t v = 0; v < valueCount; v++) {
+        const uint16_t from = std::min<uint16_t>(offset + v * bucketsPerValue, bucketCount - 1);
+        const uint16_t to = std::clamp<uint16_t>(offset + (v + 1) * bucketsPerValue, from + 1, bucketCount);
+
+        float sum = 0;
+        uint16_t buckets = 0;
+        for (uint16_t i = from; i < to; i++) {
+            const PowerHistoryBucket_t& bucket = getBucket(level, first + i);
+            if (!bucket.isGap()) {
+                sum += bucket.Avg;
+                buckets++;
+            }
+        }
+        values[v] = buckets > 0 ? sum / buckets : 0;
+    }
+
+    return valueCount;
+}
+
+void PowerHistoryClass::accumulate(const uint8_t level, const uint16_t min, const uint16_t max, const float avg)
+{
+    LevelState_t& state = _levels[level];
+    state.Samples++;
+    state.Sum += avg;
+    state.Min = std::min(state.Min, min);
+    state.Max = std::max(state.Max, max);
+}
+
+// Closes the buckets of level until index is the bucket in progress
+void PowerHistoryClass::advance(const uint8_t level, const uint32_t index)
+{
+    LevelState_t& state = _levels[level];
+    if (state.Index >= index) {
+        return;
+    }
+
+    closeBucket(level);
+    state.Index++;
+
+    // More gaps than the level holds only overwrite each other
+    const uint32_t gaps = std::min<uint32_t>(index - state.Index, levels[level].Capacity);
+    for (uint32_t i = 0; i < gaps; i++) {
+        writeBucket(level, { UINT16_MAX, 0, 0 });
+    }
+    state.Index = index;
+}
+
+void PowerHistoryClass::closeBucket(const uint8_t level)
+{
+    LevelState_t& state = _levels[level];
+    if (state.Samples == 0) {
+        writeBucket(level, { UINT16_MAX, 0, 0 });
+        return;
+    }
+
+    const PowerHistoryBucket_t bucket = {
+        state.Min,
+        state.Max,
+        static_cast<uint16_t>(std::lround(state.Sum / state.Samples)),
+    };
+    writeBucket(level, bucket);
+
+    state.Samples = 0;
+    state.Sum = 0;
+    state.Min = UINT16_MAX;
+    state.Max = 0;
+
+    if (level + 1 >= POWER_HISTORY_LEVEL_COUNT) {
+        return;
+    }
+
+    // All buckets of a level cover the same time, so the average of the
+    // averages is the average of the samples
+    advance(level + 1, static_cast<uint64_t>(state.Index) * levels[level].Interval / levels[level + 1].Interval);
+    accumulate(level + 1, bucket.Min, bucket.Max, bucket.Avg);
+}
+
+void PowerHistoryClass::writeBucket(const uint8_t level, const PowerHistoryBucket_t& bucket)
+{
+    LevelState_t& state = _levels[level];
+    const uint16_t capacity = levels[level].Capacity;
+
+    _buckets[state.Offset + state.Head] = bucket;
+    state.Head = (state.Head + 1) % capacity;
+    if (state.Count < capacity) {
+        state.Count++;
+    }
+}
+
+const PowerHistoryBucket_t& PowerHistoryClass::getBucket(const uint8_t level, const uint16_t index) const
+{
+    const LevelState_t& state = _levels[level];
+    const uint16_t capacity = levels[level].Capacity;
+    return _buckets[state.Offset + (state.Head + capacity - state.Count + index) % capacity];
+}
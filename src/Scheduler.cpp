@@ -1,7 +1,90 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 /*
- * Copyright (C) 2023 Thomas Basler and others
+ * Copyright (C) 2023-2024 Thomas Basler and others
  */
 #include "Scheduler.h"
+#include "MessageOutput.h"
+#include "TaskProfiler.h"
+#include <Arduino.h>
+#include <algorithm>
+#include <esp_pm.h>
 
-Scheduler scheduler;
\ No newline at end of file
+Scheduler scheduler;
+
+SchedulerIdleClass SchedulerIdle;
+
+void SchedulerIdleClass::init()
+{
+    _intervalStart = millis();
+
+#ifdef SCHEDULER_LIGHT_SLEEP
+#if CONFIG_PM_ENABLE && CONFIG_FREERTOS_USE_TICKLESS_IDLE
+#if CONFIG_IDF_TARGET_ESP32
+    esp_pm_config_esp32_t pmConfig = {};
+#elif CONFIG_IDF_TARGET_ESP32S2
+    esp_pm_config_esp32s2_t pmConfig = {};
+#elif CONFIG_IDF_TARGET_ESP32S3
+    esp_pm_config_esp32s3_t pmConfig = {};
+#elif CONFIG_IDF_TARGET_ESP32C3
+    esp_pm_config_esp32c3_t pmConfig = {};
+#endif
+    pmConfig.max_freq_mhz = getCpuFrequencyMhz();
+    pmConfig.min_freq_mhz = getXtalFrequencyMhz();
+    pmConfig.light_sleep_enable = true;
+
+    const esp_err_t err = esp_pm_configure(&pmConfig);
+    if (err == ESP_OK) {
+        _lightSleep = true;
+    } else {
+        MessageOutput.printf("Failed to enable light sleep: %s\r\n", esp_err_to_name(err));
+    }
+#else
+    MessageOutput.println("Light sleep requires CONFIG_PM_ENABLE and CONFIG_FREERTOS_USE_TICKLESS_IDLE");
+#endif
+#endif
+}
+
+void SchedulerIdleClass::loop(const bool idleRun)
+{
+    if (idleRun) {
+        const uint32_t sleep = getTimeUntilNextTask();
+        if (sleep > 0) {
+            const uint32_t start = micros();
+            vTaskDelay(pdMS_TO_TICKS(sleep));
+            const uint32_t time = micros() - start;
+
+            _sleepTime += time;
+            _intervalSleepTime += time;
+            TaskProfiler.addIdleTime(time);
+        }
+    }
+
+    const uint32_t now = millis();
+    if (now - _intervalStart >= SCHEDULER_IDLE_INTERVAL) {
+        _idle = _intervalSleepTime / (10.0f * (now - _intervalStart));
+        _intervalSleepTime = 0;
+        _intervalStart = now;
+    }
+}
+
+uint32_t SchedulerIdleClass::getTimeUntilNextTask() const
+{
+    // Calculated by the last pass of the scheduler over all enabled tasks
+    // (_TASK_TICKLESS), so tasks which are not profiled are covered as well
+    return std::min<unsigned long>(scheduler.getNextRun(), SCHEDULER_MAX_SLEEP);
+}
+
+float SchedulerIdleClass::getIdle() const
+{
+    return _idle;
+}
+
+uint64_t SchedulerIdleClass::getSleepTime() const
+{
+    return _sleepTime;
+}
+
+bool SchedulerIdleClass::isLightSleepEnabled() const
+{
+    return _lightSleep;
+}
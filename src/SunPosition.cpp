@@ -6,23 +6,27 @@
 #include "Configuration.h"
 #include "Utils.h"
 #include <Arduino.h>
+#include <WallClock.h>
 
 SunPositionClass SunPosition;
 
 SunPositionClass::SunPositionClass()
-    : _loopTask(5 * TASK_SECOND, TASK_FOREVER, std::bind(&SunPositionClass::loop, this))
+    : _loopTask("sun_position", 5 * TASK_SECOND, TASK_FOREVER, std::bind(&SunPositionClass::loop, this))
 {
 }
 
 void SunPositionClass::init(Scheduler& scheduler)
 {
+    WallClock.onEvent([this](wall_clock_event) { setDoRecalc(true); }, wall_clock_event::WALL_CLOCK_SYNCED);
+    WallClock.onEvent([this](wall_clock_event) { setDoRecalc(true); }, wall_clock_event::WALL_CLOCK_DAY_CHANGED);
+
     scheduler.addTask(_loopTask);
     _loopTask.enable();
 }
 
 void SunPositionClass::loop()
 {
-    if (_doRecalc || checkRecalcDayChanged()) {
+    if (_doRecalc) {
         updateSunData();
     }
 }
@@ -33,9 +37,7 @@ bool SunPositionClass::isDayPeriod() const
         return true;
     }
 
-    struct tm timeinfo;
-    getLocalTime(&timeinfo, 5);
-    const uint32_t minutesPastMidnight = timeinfo.tm_hour * 60 + timeinfo.tm_min;
+    const uint32_t minutesPastMidnight = WallClock.getMinuteOfDay();
     return (minutesPastMidnight >= _sunriseMinutes) && (minutesPastMidnight < _sunsetMinutes);
 }
 
@@ -49,25 +51,11 @@ void SunPositionClass::setDoRecalc(const bool doRecalc)
     _doRecalc = doRecalc;
 }
 
-bool SunPositionClass::checkRecalcDayChanged() const
-{
-    time_t now;
-    struct tm timeinfo;
-
-    time(&now);
-    localtime_r(&now, &timeinfo); // don't use getLocalTime() as there could be a delay of 10ms
-
-    const uint32_t ymd = (timeinfo.tm_year << 9) | (timeinfo.tm_mon << 5) | timeinfo.tm_mday;
-
-    return _lastSunPositionCalculatedYMD != ymd;
-}
-
 void SunPositionClass::updateSunData()
 {
     struct tm timeinfo;
-    const bool gotLocalTime = getLocalTime(&timeinfo, 5);
+    const bool gotLocalTime = WallClock.getLocalTime(timeinfo);
 
-    _lastSunPositionCalculatedYMD = (timeinfo.tm_year << 9) | (timeinfo.tm_mon << 5) | timeinfo.tm_mday;
     setDoRecalc(false);
 
     if (!gotLocalTime) {
@@ -78,7 +66,8 @@ void SunPositionClass::updateSunData()
         return;
     }
 
-    CONFIG_T const& config = Configuration.get();
+    const ConfigSnapshotPtr snapshot = Configuration.getSnapshot();
+    CONFIG_T const& config = snapshot->get();
 
     double sunset_type;
     switch (config.Ntp.SunsetType) {
@@ -125,11 +114,10 @@ void SunPositionClass::updateSunData()
 bool SunPositionClass::getSunTime(struct tm* info, const uint32_t offset) const
 {
     // Get today's date
-    time_t aTime = time(NULL);
+    struct tm tm;
+    WallClock.getLocalTime(tm);
 
     // Set the time to midnight
-    struct tm tm;
-    localtime_r(&aTime, &tm);
     tm.tm_sec = 0;
     tm.tm_min = offset;
     tm.tm_hour = 0;
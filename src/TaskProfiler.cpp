@@ -0,0 +1,229 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2024 Thomas Basler and others
+ */
+#include "TaskProfiler.h"
+#include "MessageOutput.h"
+#include <Arduino.h>
+#include <algorithm>
+#include <esp_freertos_hooks.h>
+
+// Upper bounds of the histogram buckets in us, the last bucket is unbounded
+static const uint32_t bucketBounds[TASK_PROFILER_BUCKET_COUNT - 1] = { 10, 50, 100, 500, 1000, 5000, 20000 };
+
+TaskProfilerClass TaskProfiler;
+
+ProfiledTask* ProfiledTask::_first = nullptr;
+
+TaskHandle_t TaskProfilerClass::_idleTasks[portNUM_PROCESSORS] = {};
+volatile uint32_t TaskProfilerClass::_ticks[portNUM_PROCESSORS] = {};
+volatile uint32_t TaskProfilerClass::_idleTicks[portNUM_PROCESSORS] = {};
+
+void TaskProfilerCounter::add(const uint32_t time)
+{
+    const uint32_t sequence = _sequence.load(std::memory_order_relaxed);
+    _sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    _total.Count++;
+    _total.Time += time;
+    _total.MaxTime = std::max(_total.MaxTime, time);
+    _total.Histogram[TaskProfilerClass::getBucket(time)]++;
+    _windowMaxTime = std::max(_windowMaxTime, time);
+
+    _sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void TaskProfilerCounter::resetWindow()
+{
+    const uint32_t sequence = _sequence.load(std::memory_order_relaxed);
+    _sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    _windowStart = _total;
+    _windowMaxTime = 0;
+
+    _sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void TaskProfilerCounter::read(TaskProfilerStats_t& total, TaskProfilerStats_t& window) const
+{
+    TaskProfilerStats_t windowStart;
+    uint32_t windowMaxTime;
+
+    while (true) {
+        const uint32_t sequence = _sequence.load(std::memory_order_acquire);
+        if ((sequence & 1) == 0) {
+            total = _total;
+            windowStart = _windowStart;
+            windowMaxTime = _windowMaxTime;
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (_sequence.load(std::memory_order_relaxed) == sequence) {
+                break;
+            }
+        }
+
+        // The writer might have been interrupted by this task, give it the
+        // chance to finish the update
+        delay(1);
+    }
+
+    window.Count = total.Count - windowStart.Count;
+    window.Time = total.Time - windowStart.Time;
+    window.MaxTime = windowMaxTime;
+    for (uint8_t i = 0; i < TASK_PROFILER_BUCKET_COUNT; i++) {
+        window.Histogram[i] = total.Histogram[i] - windowStart.Histogram[i];
+    }
+}
+
+ProfiledTask::ProfiledTask(const char* name, const unsigned long interval, const long iterations, TaskCallback callback)
+    : Task(interval, iterations, std::bind(&ProfiledTask::run, this))
+    , _name(name)
+    , _callback(callback)
+    , _next(_first)
+{
+    _first = this;
+}
+
+void ProfiledTask::run()
+{
+    const uint32_t start = micros();
+    _callback();
+    _counter.add(micros() - start);
+}
+
+const char* ProfiledTask::getName() const
+{
+    return _name;
+}
+
+const TaskProfilerCounter& ProfiledTask::getCounter() const
+{
+    return _counter;
+}
+
+TaskProfilerCounter& ProfiledTask::getCounter()
+{
+    return _counter;
+}
+
+ProfiledTask* ProfiledTask::getFirst()
+{
+    return _first;
+}
+
+ProfiledTask* ProfiledTask::getNext() const
+{
+    return _next;
+}
+
+void TaskProfilerClass::init()
+{
+    for (uint8_t core = 0; core < portNUM_PROCESSORS; core++) {
+        _idleTasks[core] = xTaskGetIdleTaskHandleForCPU(core);
+        if (esp_register_freertos_tick_hook_for_cpu(&TaskProfilerClass::tickHook, core) != ESP_OK) {
+            MessageOutput.printf("Failed to register tick hook for core %d\r\n", core);
+        }
+    }
+
+    _lastIteration = micros();
+    _lastLoadCalculation = millis();
+    _windowStart = _lastLoadCalculation;
+}
+
+void IRAM_ATTR TaskProfilerClass::tickHook()
+{
+    const BaseType_t core = xPortGetCoreID();
+    _ticks[core] = _ticks[core] + 1;
+    if (xTaskGetCurrentTaskHandleForCPU(core) == _idleTasks[core]) {
+        _idleTicks[core] = _idleTicks[core] + 1;
+    }
+}
+
+void TaskProfilerClass::loop()
+{
+    const uint32_t now = micros();
+    _loopCounter.add(now - _lastIteration);
+    _lastIteration = now;
+
+    const uint32_t nowMs = millis();
+    if (nowMs - _lastLoadCalculation >= TASK_PROFILER_LOAD_INTERVAL) {
+        _lastLoadCalculation = nowMs;
+        for (uint8_t core = 0; core < portNUM_PROCESSORS; core++) {
+            const uint32_t ticks = _ticks[core];
+            const uint32_t idleTicks = _idleTicks[core];
+            if (ticks != _lastTicks[core]) {
+                _load[core] = 100.0f - 100.0f * (idleTicks - _lastIdleTicks[core]) / (ticks - _lastTicks[core]);
+            }
+            _lastTicks[core] = ticks;
+            _lastIdleTicks[core] = idleTicks;
+        }
+    }
+
+    if (_resetRequested.exchange(false)) {
+        for (ProfiledTask* task = ProfiledTask::getFirst(); task != nullptr; task = task->getNext()) {
+            task->getCounter().resetWindow();
+        }
+        _loopCounter.resetWindow();
+
+        for (uint8_t core = 0; core < portNUM_PROCESSORS; core++) {
+            _windowTicks[core] = _ticks[core];
+            _windowIdleTicks[core] = _idleTicks[core];
+        }
+        _windowStart = nowMs;
+    }
+}
+
+void TaskProfilerClass::addIdleTime(const uint32_t time)
+{
+    _lastIteration += time;
+}
+
+void TaskProfilerClass::requestReset()
+{
+    _resetRequested = true;
+}
+
+const TaskProfilerCounter& TaskProfilerClass::getLoopCounter() const
+{
+    return _loopCounter;
+}
+
+uint32_t TaskProfilerClass::getWindowDuration() const
+{
+    return millis() - _windowStart;
+}
+
+uint8_t TaskProfilerClass::getCoreCount() const
+{
+    return portNUM_PROCESSORS;
+}
+
+float TaskProfilerClass::getCpuLoad(const uint8_t core) const
+{
+    return _load[core];
+}
+
+float TaskProfilerClass::getCpuLoadWindow(const uint8_t core) const
+{
+    const uint32_t ticks = _ticks[core] - _windowTicks[core];
+    if (ticks == 0) {
+        return 0;
+    }
+    return 100.0f - 100.0f * (_idleTicks[core] - _windowIdleTicks[core]) / ticks;
+}
+
+uint32_t TaskProfilerClass::getBucketBound(const uint8_t bucket)
+{
+    return bucket < TASK_PROFILER_BUCKET_COUNT - 1 ? bucketBounds[bucket] : 0;
+}
+
+uint8_t TaskProfilerClass::getBucket(const uint32_t time)
+{
+    uint8_t bucket = 0;
+    while (bucket < TASK_PROFILER_BUCKET_COUNT - 1 && time > bucketBounds[bucket]) {
+        bucket++;
+    }
+    return bucket;
+}
@@ -4,6 +4,7 @@
  */
 
 #include "Utils.h"
+#include "Configuration.h"
 #include "Display_Graphic.h"
 #include "Led_Single.h"
 #include "MessageOutput.h"
@@ -61,6 +62,7 @@ int Utils::getTimezoneOffset()
 
 void Utils::restartDtu()
 {
+    Configuration.flush();
     LedSingle.turnAllOff();
     Display.setStatus(false);
     yield();
@@ -92,3 +94,22 @@ void Utils::removeAllFiles()
         file = root.getNextFileName();
     }
 }
+
+uint32_t Utils::getFnv1aHash(const void* data, const size_t len, uint32_t hash)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+uint32_t Utils::getFnv1aHash(const char* str, uint32_t hash)
+{
+    for (const char* c = str; *c != 0; c++) {
+        hash ^= static_cast<uint8_t>(*c);
+        hash *= 16777619UL;
+    }
+    return hash;
+}
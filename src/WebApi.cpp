@@ -5,6 +5,7 @@
 #include "WebApi.h"
 #include "Configuration.h"
 #include "MessageOutput.h"
+#include "Utils.h"
 #include "defaults.h"
 #include <AsyncJson.h>
 
@@ -22,6 +23,7 @@ void WebApiClass::init(Scheduler& scheduler)
     _webApiEventlog.init(_server, scheduler);
     _webApiFirmware.init(_server, scheduler);
     _webApiGridprofile.init(_server, scheduler);
+    _webApiHistory.init(_server, scheduler);
     _webApiInverter.init(_server, scheduler);
     _webApiLimit.init(_server, scheduler);
     _webApiMaintenance.init(_server, scheduler);
@@ -76,14 +78,12 @@ void WebApiClass::sendTooManyRequests(AsyncWebServerRequest* request)
 
 void WebApiClass::writeConfig(JsonVariant& retMsg, const WebApiError code, const String& message)
 {
-    if (!Configuration.write()) {
-        retMsg["message"] = "Write failed!";
-        retMsg["code"] = WebApiError::GenericWriteFailed;
-    } else {
-        retMsg["type"] = "success";
-        retMsg["message"] = message;
-        retMsg["code"] = code;
-    }
+    // Bursts of changes are written to flash once
+    Configuration.requestWrite();
+
+    retMsg["type"] = "success";
+    retMsg["message"] = message;
+    retMsg["code"] = code;
 }
 
 bool WebApiClass::parseRequestData(AsyncWebServerRequest* request, AsyncJsonResponse* response, JsonDocument& json_document)
@@ -131,7 +131,7 @@ bool WebApiClass::sendJsonResponse(AsyncWebServerRequest* request, AsyncJsonResp
         root["code"] = WebApiError::GenericInternalServerError;
         root["type"] = "danger";
         response->setCode(500);
-        MessageOutput.printf("WebResponse failed: %s, %d\r\n", function, line);
+        MessageOutput.log(LogTag::Web, LogLevel::Error, "WebResponse failed: %s, %d\r\n", function, line);
         ret_val = false;
     }
 
@@ -140,4 +140,48 @@ bool WebApiClass::sendJsonResponse(AsyncWebServerRequest* request, AsyncJsonResp
     return ret_val;
 }
 
+WsLiveFormatStats_t WebApiClass::getWsLiveStats(const WsLiveFormat format)
+{
+    return _webApiWsLive.getStats(format);
+}
+
+// Hash over all version counters
+String WebApiClass::getETag(std::initializer_list<uint32_t> versions, const bool weak)
+{
+    uint32_t hash = FNV1A_INITIAL_HASH;
+    for (uint32_t version : versions) {
+        hash = Utils::getFnv1aHash(&version, sizeof(version), hash);
+    }
+
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%s\"%08x\"", weak ? "W/" : "", hash);
+    return buffer;
+}
+
+bool WebApiClass::checkNotModified(AsyncWebServerRequest* request, const String& etag)
+{
+    if (!request->hasHeader("If-None-Match")) {
+        return false;
+    }
+
+    // If-None-Match uses the weak comparison, so W/ prefixes are ignored
+    const String header = request->getHeader("If-None-Match")->value();
+    const String opaque = etag.startsWith("W/") ? etag.substring(2) : etag;
+    if (header != "*" && header.indexOf(opaque) < 0) {
+        return false;
+    }
+
+    AsyncWebServerResponse* response = request->beginResponse(304);
+    response->addHeader("ETag", etag);
+    request->send(response);
+
+    _notModifiedCount++;
+    return true;
+}
+
+uint32_t WebApiClass::getNotModifiedCount() const
+{
+    return _notModifiedCount;
+}
+
 WebApiClass WebApi;
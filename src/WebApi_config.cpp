@@ -44,7 +44,22 @@ void WebApiConfigClass::onConfigGet(AsyncWebServerRequest* request)
         }
     }
 
-    request->send(LittleFS, requestFile, String(), true);
+    // Only the configuration file itself is versioned by the save counter
+    String etag;
+    if (requestFile == CONFIG_FILENAME) {
+        // The file has to contain the changes counted by the save counter
+        Configuration.flush();
+        etag = WebApi.getETag({ Configuration.getSnapshot()->get().Cfg.SaveCount, Configuration.getFileGeneration() });
+        if (WebApi.checkNotModified(request, etag)) {
+            return;
+        }
+    }
+
+    AsyncWebServerResponse* response = request->beginResponse(LittleFS, requestFile, String(), true);
+    if (etag != "") {
+        response->addHeader("ETag", etag);
+    }
+    request->send(response);
 }
 
 void WebApiConfigClass::onConfigDelete(AsyncWebServerRequest* request)
@@ -81,6 +96,7 @@ void WebApiConfigClass::onConfigDelete(AsyncWebServerRequest* request)
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 
+    Configuration.discardPendingWrite();
     Utils::removeAllFiles();
     Utils::restartDtu();
 }
@@ -140,6 +156,11 @@ void WebApiConfigClass::onConfigUpload(AsyncWebServerRequest* request, String fi
             return;
         }
         const String name = "/" + request->getParam("file")->value();
+        if (name == CONFIG_FILENAME) {
+            // Neither the binary copy nor a pending write must replace the uploaded file
+            Configuration.discardPendingWrite();
+            Configuration.removeBinary();
+        }
         request->_tempFile = LittleFS.open(name, "w");
     }
 
@@ -3,6 +3,8 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_devinfo.h"
+#include "GzipResponse.h"
+#include "Utils.h"
 #include "WebApi.h"
 #include <AsyncJson.h>
 #include <Hoymiles.h>
@@ -21,11 +23,18 @@ void WebApiDevInfoClass::onDevInfoStatus(AsyncWebServerRequest* request)
         return;
     }
 
-    AsyncJsonResponse* response = new AsyncJsonResponse();
-    auto& root = response->getRoot();
     auto serial = WebApi.parseSerialFromRequest(request);
     auto inv = Hoymiles.getInverterBySerial(serial);
 
+    const String etag = WebApi.getETag({ static_cast<uint32_t>(serial >> 32), static_cast<uint32_t>(serial),
+        inv != nullptr ? inv->DevInfo()->getLastUpdate() : 0,
+        inv != nullptr ? inv->DevInfo()->getLastUpdateAll() : 0,
+        inv != nullptr ? inv->DevInfo()->getLastUpdateSimple() : 0 });
+    if (WebApi.checkNotModified(request, etag)) {
+        return;
+    }
+
+    JsonDocument root;
     if (inv != nullptr) {
         root["valid_data"] = inv->DevInfo()->getLastUpdate() > 0;
         root["fw_bootloader_version"] = inv->DevInfo()->getFwBootloaderVersion();
@@ -36,6 +45,20 @@ void WebApiDevInfoClass::onDevInfoStatus(AsyncWebServerRequest* request)
         root["max_power"] = inv->DevInfo()->getMaxPower();
         root["fw_build_datetime"] = inv->DevInfo()->getFwBuildDateTimeStr();
     }
+    const bool allocated = Utils::checkJsonAlloc(root, __FUNCTION__, __LINE__);
+
+    // The document is small, it is only streamed to get it compressed
+    GzipResponse response(request, "application/json");
+    response.addHeader("ETag", etag);
+    response.sendJson([root = std::move(root), allocated](JsonStreamWriter& writer) {
+        if (!allocated) {
+            writer.fail();
+            return false;
+        }
 
-    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+        writer.beginObject();
+        writer.addMembers(root.as<JsonObjectConst>());
+        writer.endObject();
+        return false;
+    });
 }
@@ -8,9 +8,10 @@
 #include "WebApi_errors.h"
 #include <AsyncJson.h>
 #include <Hoymiles.h>
+#include <algorithm>
 
 WebApiDtuClass::WebApiDtuClass()
-    : _applyDataTask(TASK_IMMEDIATE, TASK_ONCE, std::bind(&WebApiDtuClass::applyDataTaskCb, this))
+    : _applyDataTask("dtu_apply", TASK_IMMEDIATE, TASK_ONCE, std::bind(&WebApiDtuClass::applyDataTaskCb, this))
 {
 }
 
@@ -20,6 +21,7 @@ void WebApiDtuClass::init(AsyncWebServer& server, Scheduler& scheduler)
 
     server.on("/api/dtu/config", HTTP_GET, std::bind(&WebApiDtuClass::onDtuAdminGet, this, _1));
     server.on("/api/dtu/config", HTTP_POST, std::bind(&WebApiDtuClass::onDtuAdminPost, this, _1));
+    server.on("/api/dtu/recorder", HTTP_GET, std::bind(&WebApiDtuClass::onDtuRecorderGet, this, _1));
 
     scheduler.addTask(_applyDataTask);
 }
@@ -169,3 +171,22 @@ void WebApiDtuClass::onDtuAdminPost(AsyncWebServerRequest* request)
     _applyDataTask.enable();
     _applyDataTask.restart();
 }
+
+// Binary dump of the radio recorder, see tools/radio_recorder.py
+void WebApiDtuClass::onDtuRecorderGet(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentials(request)) {
+        return;
+    }
+
+    auto dump = std::make_shared<std::vector<uint8_t>>(Hoymiles.getRecorder().dump());
+    auto response = request->beginResponse("application/octet-stream", dump->size(),
+        [dump](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+            const size_t len = std::min(maxLen, dump->size() - index);
+            memcpy(buffer, dump->data() + index, len);
+            return len;
+        });
+    response->addHeader("Content-Disposition", "attachment; filename=\"radio_recorder.bin\"");
+    response->addHeader("Cache-Control", "no-cache");
+    request->send(response);
+}
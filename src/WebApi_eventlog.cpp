@@ -3,7 +3,12 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_eventlog.h"
+#include "AlarmHistory.h"
+#include "GzipResponse.h"
+#include "Utils.h"
 #include "WebApi.h"
+#include "WebApi_errors.h"
+#include "helper.h"
 #include <AsyncJson.h>
 #include <Hoymiles.h>
 
@@ -12,6 +17,7 @@ void WebApiEventlogClass::init(AsyncWebServer& server, Scheduler& scheduler)
     using std::placeholders::_1;
 
     server.on("/api/eventlog/status", HTTP_GET, std::bind(&WebApiEventlogClass::onEventlogStatus, this, _1));
+    server.on("/api/eventlog/history", HTTP_GET, std::bind(&WebApiEventlogClass::onEventlogHistory, this, _1));
 }
 
 void WebApiEventlogClass::onEventlogStatus(AsyncWebServerRequest* request)
@@ -20,32 +26,42 @@ void WebApiEventlogClass::onEventlogStatus(AsyncWebServerRequest* request)
         return;
     }
 
-    AsyncJsonResponse* response = new AsyncJsonResponse();
-    auto& root = response->getRoot();
     auto serial = WebApi.parseSerialFromRequest(request);
+    const AlarmMessageLocale_t locale = parseLocale(request);
 
-    AlarmMessageLocale_t locale = AlarmMessageLocale_t::EN;
-    if (request->hasParam("locale")) {
-        String s = request->getParam("locale")->value();
-        s.toLowerCase();
-        if (s == "de") {
-            locale = AlarmMessageLocale_t::DE;
-        }
-        if (s == "fr") {
-            locale = AlarmMessageLocale_t::FR;
-        }
+    auto inv = Hoymiles.getInverterBySerial(serial);
+
+    // The entry count covers the log being cleared at midnight and the
+    // offset the times being shifted after a time sync or timezone change
+    const String etag = WebApi.getETag({ static_cast<uint32_t>(serial >> 32), static_cast<uint32_t>(serial),
+        static_cast<uint32_t>(locale),
+        static_cast<uint32_t>(AlarmLogParser::getTimezoneOffset()),
+        inv != nullptr ? inv->EventLog()->getLastUpdate() : 0,
+        inv != nullptr ? inv->EventLog()->getEntryCount() : 0u });
+    if (WebApi.checkNotModified(request, etag)) {
+        return;
     }
 
-    auto inv = Hoymiles.getInverterBySerial(serial);
+    GzipResponse response(request, "application/json");
+    response.addHeader("ETag", etag);
 
-    if (inv != nullptr) {
-        uint8_t logEntryCount = inv->EventLog()->getEntryCount();
+    // One entry per call, -1 writes the head of the document
+    const uint8_t logEntryCount = inv != nullptr ? inv->EventLog()->getEntryCount() : 0;
+    int16_t logEntry = -1;
 
-        root["count"] = logEntryCount;
-        JsonArray eventsArray = root["events"].to<JsonArray>();
+    response.sendJson([inv, locale, logEntryCount, logEntry](JsonStreamWriter& writer) mutable {
+        if (logEntry < 0) {
+            writer.beginObject();
+            if (inv == nullptr) {
+                writer.endObject();
+                return false;
+            }
 
-        for (uint8_t logEntry = 0; logEntry < logEntryCount; logEntry++) {
-            JsonObject eventsObject = eventsArray.add<JsonObject>();
+            writer.addValue("count", logEntryCount);
+            writer.beginArray("events");
+        } else if (logEntry < logEntryCount) {
+            JsonDocument eventDoc;
+            JsonObject eventsObject = eventDoc.to<JsonObject>();
 
             AlarmLogEntry_t entry;
             inv->EventLog()->getLogEntry(logEntry, entry, locale);
@@ -54,8 +70,142 @@ void WebApiEventlogClass::onEventlogStatus(AsyncWebServerRequest* request)
             eventsObject["message"] = entry.Message;
             eventsObject["start_time"] = entry.StartTime;
             eventsObject["end_time"] = entry.EndTime;
+
+            if (!Utils::checkJsonAlloc(eventDoc, __FUNCTION__, __LINE__)) {
+                writer.fail();
+                return false;
+            }
+            writer.add(eventDoc.as<JsonVariantConst>());
+        }
+
+        if (++logEntry < logEntryCount) {
+            return true;
+        }
+
+        writer.endArray();
+        writer.endObject();
+        return false;
+    });
+}
+
+void WebApiEventlogClass::onEventlogHistory(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    const AlarmMessageLocale_t locale = parseLocale(request);
+
+    AlarmHistoryFilter_t filter = { WebApi.parseSerialFromRequest(request), 0, UINT32_MAX, -1 };
+    if (request->hasParam("from")) {
+        filter.From = strtoul(request->getParam("from")->value().c_str(), NULL, 10);
+    }
+    if (request->hasParam("to")) {
+        filter.To = strtoul(request->getParam("to")->value().c_str(), NULL, 10);
+    }
+    if (request->hasParam("message_id")) {
+        filter.MessageId = request->getParam("message_id")->value().toInt();
+    }
+
+    // cursor is the sequence number of the last record of the previous page
+    uint32_t cursor = 0;
+    if (request->hasParam("cursor")) {
+        cursor = strtoul(request->getParam("cursor")->value().c_str(), NULL, 10);
+    }
+
+    // An empty page would return the cursor it was requested with as next
+    uint32_t limit = EVENTLOG_HISTORY_PAGE_SIZE;
+    if (request->hasParam("limit")) {
+        limit = std::min<uint32_t>(strtoul(request->getParam("limit")->value().c_str(), NULL, 10), EVENTLOG_HISTORY_PAGE_SIZE);
+        if (limit == 0) {
+            AsyncJsonResponse* response = new AsyncJsonResponse();
+            auto& retMsg = response->getRoot();
+            retMsg["message"] = "Limit must be between 1 and " STR(EVENTLOG_HISTORY_PAGE_SIZE) "!";
+            retMsg["code"] = WebApiError::HistoryInvalidLimit;
+            retMsg["param"]["min"] = 1;
+            retMsg["param"]["max"] = EVENTLOG_HISTORY_PAGE_SIZE;
+            response->setCode(400);
+            WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+            return;
         }
     }
 
-    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+    // The page is collected first, the records are small and the history
+    // files should not be read from the response filler
+    struct PageRecord_t {
+        uint32_t Sequence;
+        AlarmHistoryRecord_t Record;
+    };
+    auto records = std::make_shared<std::vector<PageRecord_t>>();
+    bool more = false;
+
+    AlarmHistory.forEachRecord(filter, cursor, [&](const uint32_t sequence, const AlarmHistoryRecord_t& record) {
+        if (records->size() >= limit) {
+            more = true;
+            return false;
+        }
+
+        records->push_back({ sequence, record });
+        return true;
+    });
+
+    // One record per call, the head is written with the first one
+    size_t index = 0;
+
+    GzipResponse response(request, "application/json");
+    response.sendJson([records, more, cursor, locale, index](JsonStreamWriter& writer) mutable {
+        if (index == 0) {
+            writer.beginObject();
+            writer.beginArray("records");
+        }
+
+        if (index < records->size()) {
+            const AlarmHistoryRecord_t& record = (*records)[index].Record;
+
+            auto inv = Hoymiles.getInverterBySerial(record.Serial);
+            const uint8_t messageIndex = inv != nullptr ? inv->EventLog()->getMessageIndex(record.MessageId) : ALARM_MSG_UNKNOWN;
+
+            // Inverter Serial is read as HEX
+            char buffer[sizeof(uint64_t) * 8 + 1];
+            snprintf(buffer, sizeof(buffer), "%0x%08x",
+                ((uint32_t)((record.Serial >> 32) & 0xFFFFFFFF)),
+                ((uint32_t)(record.Serial & 0xFFFFFFFF)));
+
+            writer.beginObject();
+            writer.addValue("serial", buffer);
+            writer.addValue("message_id", static_cast<uint16_t>(record.MessageId));
+            writer.addValue("message", AlarmLogParser::getMessage(messageIndex, locale));
+            writer.addValue("start_time", static_cast<uint32_t>(record.StartTime));
+            writer.addValue("end_time", static_cast<uint32_t>(record.EndTime));
+            writer.endObject();
+        }
+
+        if (++index < records->size()) {
+            return true;
+        }
+
+        writer.endArray();
+        writer.addValue("count", static_cast<uint32_t>(records->size()));
+        if (more) {
+            writer.addValue("next", records->empty() ? cursor : records->back().Sequence);
+        }
+        writer.endObject();
+        return false;
+    });
+}
+
+AlarmMessageLocale_t WebApiEventlogClass::parseLocale(AsyncWebServerRequest* request)
+{
+    AlarmMessageLocale_t locale = AlarmMessageLocale_t::EN;
+    if (request->hasParam("locale")) {
+        String s = request->getParam("locale")->value();
+        s.toLowerCase();
+        if (s == "de") {
+            locale = AlarmMessageLocale_t::DE;
+        }
+        if (s == "fr") {
+            locale = AlarmMessageLocale_t::FR;
+        }
+    }
+    return locale;
 }
@@ -3,6 +3,8 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_gridprofile.h"
+#include "GzipResponse.h"
+#include "Utils.h"
 #include "WebApi.h"
 #include <AsyncJson.h>
 #include <Hoymiles.h>
@@ -21,35 +23,73 @@ void WebApiGridProfileClass::onGridProfileStatus(AsyncWebServerRequest* request)
         return;
     }
 
-    AsyncJsonResponse* response = new AsyncJsonResponse();
-    auto& root = response->getRoot();
     auto serial = WebApi.parseSerialFromRequest(request);
     auto inv = Hoymiles.getInverterBySerial(serial);
 
-    if (inv != nullptr) {
-        root["name"] = inv->GridProfile()->getProfileName();
-        root["version"] = inv->GridProfile()->getProfileVersion();
+    const String etag = WebApi.getETag({ static_cast<uint32_t>(serial >> 32), static_cast<uint32_t>(serial),
+        inv != nullptr ? inv->GridProfile()->getLastUpdate() : 0 });
+    if (WebApi.checkNotModified(request, etag)) {
+        return;
+    }
+
+    GzipResponse response(request, "application/json");
+    response.addHeader("ETag", etag);
 
-        auto jsonSections = root["sections"].to<JsonArray>();
-        auto profSections = inv->GridProfile()->getProfile();
+    if (inv == nullptr) {
+        response.sendJson([](JsonStreamWriter& writer) {
+            writer.beginObject();
+            writer.endObject();
+            return false;
+        });
+        return;
+    }
 
-        for (auto &profSection : profSections) {
-            auto jsonSection = jsonSections.add<JsonObject>();
-            jsonSection["name"] = profSection.SectionName;
+    // One section per call, -1 writes the head of the document. The view
+    // is a copy, so the profile does not change while it is sent.
+    auto profile = std::make_shared<GridProfileView>(inv->GridProfile()->getProfileView());
+    const String name = inv->GridProfile()->getProfileName();
+    const String version = inv->GridProfile()->getProfileVersion();
+    int16_t sectionId = -1;
+
+    response.sendJson([profile, name, version, sectionId](JsonStreamWriter& writer) mutable {
+        if (sectionId < 0) {
+            writer.beginObject();
+            writer.addValue("name", name);
+            writer.addValue("version", version);
+            writer.beginArray("sections");
+        } else if (sectionId < profile->getSectionCount()) {
+            // One document per section keeps the memory usage independent of the profile size
+            auto profSection = profile->getSection(sectionId);
+
+            JsonDocument sectionDoc;
+            auto jsonSection = sectionDoc.to<JsonObject>();
+            jsonSection["name"] = profSection.getName();
 
             auto jsonItems = jsonSection["items"].to<JsonArray>();
 
-            for (auto &profItem : profSection.items) {
+            for (auto profItem : profSection) {
                 auto jsonItem = jsonItems.add<JsonObject>();
 
                 jsonItem["n"] = profItem.Name;
                 jsonItem["u"] = profItem.Unit;
                 jsonItem["v"] = profItem.Value;
             }
+
+            if (!Utils::checkJsonAlloc(sectionDoc, __FUNCTION__, __LINE__)) {
+                writer.fail();
+                return false;
+            }
+            writer.add(sectionDoc.as<JsonVariantConst>());
         }
-    }
 
-    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+        if (++sectionId < profile->getSectionCount()) {
+            return true;
+        }
+
+        writer.endArray();
+        writer.endObject();
+        return false;
+    });
 }
 
 void WebApiGridProfileClass::onGridProfileRawdata(AsyncWebServerRequest* request)
@@ -0,0 +1,92 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2024 Thomas Basler and others
+ */
+#include "WebApi_history.h"
+#include "GzipResponse.h"
+#include "PowerHistory.h"
+#include "WebApi.h"
+#include "WebApi_errors.h"
+#include <AsyncJson.h>
+
+void WebApiHistoryClass::init(AsyncWebServer& server, Scheduler& scheduler)
+{
+    using std::placeholders::_1;
+
+    server.on("/api/history/power", HTTP_GET, std::bind(&WebApiHistoryClass::onPowerHistory, this, _1));
+}
+
+void WebApiHistoryClass::onPowerHistory(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    // interval selects the resolution in seconds, the finest one by default
+    int8_t level = 0;
+    if (request->hasParam("interval")) {
+        level = PowerHistory.findLevel(strtoul(request->getParam("interval")->value().c_str(), NULL, 10));
+        if (level < 0) {
+            AsyncJsonResponse* response = new AsyncJsonResponse();
+            auto& retMsg = response->getRoot();
+            retMsg["message"] = "Unknown interval!";
+            retMsg["code"] = WebApiError::HistoryInvalidInterval;
+            response->setCode(400);
+            WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+            return;
+        }
+    }
+
+    // The buckets are copied, so the history does not move on while the
+    // response is sent
+    auto buckets = std::make_shared<std::vector<PowerHistoryBucket_t>>();
+    buckets->reserve(PowerHistory.getLevel(level).Capacity);
+    PowerHistory.forEachBucket(level, [&buckets](const PowerHistoryBucket_t& bucket) {
+        buckets->push_back(bucket);
+    });
+
+    // A batch of buckets per call, the head is written with the first one
+    size_t index = 0;
+
+    GzipResponse response(request, "application/json");
+    response.sendJson([buckets, level, index](JsonStreamWriter& writer) mutable {
+        if (index == 0) {
+            writer.beginObject();
+
+            writer.beginArray("intervals");
+            for (uint8_t i = 0; i < POWER_HISTORY_LEVEL_COUNT; i++) {
+                writer.addValue(nullptr, PowerHistory.getLevel(i).Interval);
+            }
+            writer.endArray();
+
+            writer.addValue("interval", PowerHistory.getLevel(level).Interval);
+
+            // Oldest first, each bucket as [min, max, avg] in W or null for a gap
+            writer.beginArray("buckets");
+        }
+
+        const size_t end = std::min(index + WEBAPI_HISTORY_BUCKETS_PER_FILL, buckets->size());
+        for (; index < end; index++) {
+            const PowerHistoryBucket_t& bucket = (*buckets)[index];
+            if (bucket.isGap()) {
+                writer.addValue(nullptr, static_cast<const char*>(nullptr));
+                continue;
+            }
+
+            writer.beginArray();
+            writer.addValue(nullptr, bucket.Min);
+            writer.addValue(nullptr, bucket.Max);
+            writer.addValue(nullptr, bucket.Avg);
+            writer.endArray();
+        }
+
+        if (index < buckets->size()) {
+            return true;
+        }
+
+        writer.endArray();
+        writer.addValue("count", static_cast<uint16_t>(buckets->size()));
+        writer.endObject();
+        return false;
+    });
+}
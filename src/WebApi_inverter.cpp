@@ -3,8 +3,10 @@
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
 #include "WebApi_inverter.h"
+#include "GzipResponse.h"
 #include "Configuration.h"
 #include "MqttHandleHass.h"
+#include "Utils.h"
 #include "WebApi.h"
 #include "WebApi_errors.h"
 #include "defaults.h"
@@ -29,15 +31,32 @@ void WebApiInverterClass::onInverterList(AsyncWebServerRequest* request)
         return;
     }
 
-    AsyncJsonResponse* response = new AsyncJsonResponse();
-    auto& root = response->getRoot();
-    JsonArray data = root["inverter"].to<JsonArray>();
+    // The configuration is captured, so it does not change while the
+    // response is sent
+    ConfigSnapshotPtr snapshot = Configuration.getSnapshot();
+    const CONFIG_T& config = snapshot->get();
+
+    // The inverter type and channel count depend on the created inverter objects
+    const String etag = WebApi.getETag({ config.Cfg.SaveCount, Hoymiles.getNumInverters() });
+    if (WebApi.checkNotModified(request, etag)) {
+        return;
+    }
+
+    GzipResponse response(request, "application/json");
+    response.addHeader("ETag", etag);
+
+    // One inverter slot per call, -1 writes the head of the document
+    int16_t i = -1;
 
-    const CONFIG_T& config = Configuration.get();
+    response.sendJson([snapshot, i](JsonStreamWriter& writer) mutable {
+        const CONFIG_T& config = snapshot->get();
 
-    for (uint8_t i = 0; i < INV_MAX_COUNT; i++) {
-        if (config.Inverter[i].Serial > 0) {
-            JsonObject obj = data.add<JsonObject>();
+        if (i < 0) {
+            writer.beginObject();
+            writer.beginArray("inverter");
+        } else if (config.Inverter[i].Serial > 0) {
+            JsonDocument invDoc;
+            JsonObject obj = invDoc.to<JsonObject>();
             obj["id"] = i;
             obj["name"] = String(config.Inverter[i].Name);
             obj["order"] = config.Inverter[i].Order;
@@ -75,10 +94,22 @@ void WebApiInverterClass::onInverterList(AsyncWebServerRequest* request)
                 chanData["max_power"] = config.Inverter[i].channel[c].MaxChannelPower;
                 chanData["yield_total_offset"] = config.Inverter[i].channel[c].YieldTotalOffset;
             }
+
+            if (!Utils::checkJsonAlloc(invDoc, __FUNCTION__, __LINE__)) {
+                writer.fail();
+                return false;
+            }
+            writer.add(invDoc.as<JsonVariantConst>());
         }
-    }
 
-    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+        if (++i < INV_MAX_COUNT) {
+            return true;
+        }
+
+        writer.endArray();
+        writer.endObject();
+        return false;
+    });
 }
 
 void WebApiInverterClass::onInverterAdd(AsyncWebServerRequest* request)
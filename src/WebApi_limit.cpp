@@ -27,9 +27,8 @@ void WebApiLimitClass::onLimitStatus(AsyncWebServerRequest* request)
     AsyncJsonResponse* response = new AsyncJsonResponse();
     auto& root = response->getRoot();
 
-    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
-        auto inv = Hoymiles.getInverterByPos(i);
-
+    const InverterListPtr inverters = Hoymiles.getInverters();
+    for (auto& inv : *inverters) {
         String serial = inv->serialString();
 
         root[serial]["limit_relative"] = inv->SystemConfigPara()->getLimitPercent();
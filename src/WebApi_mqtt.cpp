@@ -52,6 +52,27 @@ void WebApiMqttClass::onMqttStatus(AsyncWebServerRequest* request)
     root["mqtt_hass_topic"] = config.Mqtt.Hass.Topic;
     root["mqtt_hass_individualpanels"] = config.Mqtt.Hass.IndividualPanels;
 
+    const auto queueStats = MqttSettings.getQueueStats();
+    auto queue = root["mqtt_queue"].to<JsonObject>();
+    queue["depth"] = queueStats.Depth;
+    queue["bytes"] = queueStats.Bytes;
+    queue["budget"] = queueStats.Budget;
+    queue["enqueued"] = queueStats.Enqueued;
+    queue["sent"] = queueStats.Sent;
+    queue["replaced"] = queueStats.Replaced;
+    queue["dropped"] = queueStats.Dropped;
+    queue["latency_avg"] = queueStats.LatencyAvg;
+    queue["latency_max"] = queueStats.LatencyMax;
+
+    const auto hassStats = MqttHandleHass.getDiscoveryStats();
+    auto hass = root["mqtt_hass_discovery"].to<JsonObject>();
+    hass["passes"] = hassStats.Passes;
+    hass["published"] = hassStats.Published;
+    hass["unchanged"] = hassStats.Unchanged;
+    hass["duration"] = hassStats.Duration;
+    hass["max_tick_time"] = hassStats.MaxTickTime;
+    hass["peak_heap_usage"] = hassStats.PeakHeapUsage;
+
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
 
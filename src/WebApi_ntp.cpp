@@ -10,6 +10,7 @@
 #include "WebApi_errors.h"
 #include "helper.h"
 #include <AsyncJson.h>
+#include <WallClock.h>
 
 void WebApiNtpClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
@@ -37,11 +38,7 @@ void WebApiNtpClass::onNtpStatus(AsyncWebServerRequest* request)
     root["ntp_timezone_descr"] = config.Ntp.TimezoneDescr;
 
     struct tm timeinfo;
-    if (!getLocalTime(&timeinfo, 5)) {
-        root["ntp_status"] = false;
-    } else {
-        root["ntp_status"] = true;
-    }
+    root["ntp_status"] = WallClock.getLocalTime(timeinfo);
     char timeStringBuff[50];
     strftime(timeStringBuff, sizeof(timeStringBuff), "%A, %B %d %Y %H:%M:%S", &timeinfo);
     root["ntp_localtime"] = timeStringBuff;
@@ -163,11 +160,7 @@ void WebApiNtpClass::onNtpTimeGet(AsyncWebServerRequest* request)
     auto& root = response->getRoot();
 
     struct tm timeinfo;
-    if (!getLocalTime(&timeinfo, 5)) {
-        root["ntp_status"] = false;
-    } else {
-        root["ntp_status"] = true;
-    }
+    root["ntp_status"] = WallClock.getLocalTime(timeinfo);
 
     root["year"] = timeinfo.tm_year + 1900;
     root["month"] = timeinfo.tm_mon + 1;
@@ -25,9 +25,8 @@ void WebApiPowerClass::onPowerStatus(AsyncWebServerRequest* request)
     AsyncJsonResponse* response = new AsyncJsonResponse();
     auto& root = response->getRoot();
 
-    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
-        auto inv = Hoymiles.getInverterByPos(i);
-
+    const InverterListPtr inverters = Hoymiles.getInverters();
+    for (auto& inv : *inverters) {
         LastCommandSuccess status = inv->PowerCommand()->getLastPowerCommandSuccess();
         String limitStatus = "Unknown";
         if (status == LastCommandSuccess::CMD_OK) {
@@ -5,10 +5,19 @@
  */
 #include "WebApi_prometheus.h"
 #include "Configuration.h"
+#include "Display_Graphic.h"
+#include "GzipResponse.h"
+#include "HeapMonitor.h"
 #include "MessageOutput.h"
+#include "MqttSettings.h"
 #include "NetworkSettings.h"
+#include "Scheduler.h"
+#include "TaskProfiler.h"
 #include "WebApi.h"
+#include <HeapAccounting.h>
 #include <Hoymiles.h>
+#include <algorithm>
+#include <vector>
 #include "__compiled_constants.h"
 
 void WebApiPrometheusClass::init(AsyncWebServer& server, Scheduler& scheduler)
@@ -25,108 +34,420 @@ void WebApiPrometheusClass::onPrometheusMetricsGet(AsyncWebServerRequest* reques
     }
 
     try {
-        auto stream = request->beginResponseStream("text/plain; charset=utf-8", 40960);
+        const uint32_t start = micros();
+        uint32_t renderedInverters = 0;
 
-        stream->print("# HELP opendtu_build Build info\n");
-        stream->print("# TYPE opendtu_build gauge\n");
-        stream->printf("opendtu_build{name=\"%s\",id=\"%s\",version=\"%d.%d.%d\"} 1\n",
-            NetworkSettings.getHostname().c_str(), __COMPILED_GIT_HASH__, CONFIG_VERSION >> 24 & 0xff, CONFIG_VERSION >> 16 & 0xff, CONFIG_VERSION >> 8 & 0xff);
+        // Only the system metrics are rendered on every scrape
+        auto system = std::make_shared<StreamString>();
+        system->reserve(3072);
+        generateSystemMetrics(*system);
 
-        stream->print("# HELP opendtu_platform Platform info\n");
-        stream->print("# TYPE opendtu_platform gauge\n");
-        stream->printf("opendtu_platform{arch=\"%s\",mac=\"%s\"} 1\n", ESP.getChipModel(), NetworkSettings.macAddress().c_str());
+        std::vector<std::shared_ptr<const StreamString>> fragments;
+        fragments.push_back(system);
 
-        stream->print("# HELP opendtu_uptime Uptime in seconds\n");
-        stream->print("# TYPE opendtu_uptime counter\n");
-        stream->printf("opendtu_uptime %lld\n", esp_timer_get_time() / 1000000);
+        const uint32_t saveCount = Configuration.getSnapshot()->get().Cfg.SaveCount;
+        const InverterListPtr inverters = Hoymiles.getInverters();
+        for (uint8_t i = 0; i < inverters->size() && i < INV_MAX_COUNT; i++) {
+            auto inv = (*inverters)[i];
 
-        stream->print("# HELP opendtu_heap_size System memory size\n");
-        stream->print("# TYPE opendtu_heap_size gauge\n");
-        stream->printf("opendtu_heap_size %zu\n", ESP.getHeapSize());
+            const inverter_version_t version = {
+                inv->serial(),
+                inv->Statistics()->getLastUpdate(),
+                inv->Statistics()->getLastUpdateFromInternal(),
+                inv->SystemConfigPara()->getLastUpdate(),
+                inv->SystemConfigPara()->getLimitPercent(),
+                inv->DevInfo()->getLastUpdate(),
+                saveCount,
+            };
 
-        stream->print("# HELP opendtu_free_heap_size System free memory\n");
-        stream->print("# TYPE opendtu_free_heap_size gauge\n");
-        stream->printf("opendtu_free_heap_size %zu\n", ESP.getFreeHeap());
-
-        stream->print("# HELP opendtu_biggest_heap_block Biggest free heap block\n");
-        stream->print("# TYPE opendtu_biggest_heap_block gauge\n");
-        stream->printf("opendtu_biggest_heap_block %zu\n", ESP.getMaxAllocHeap());
-
-        stream->print("# HELP opendtu_heap_min_free Minimum free memory since boot\n");
-        stream->print("# TYPE opendtu_heap_min_free gauge\n");
-        stream->printf("opendtu_heap_min_free %zu\n", ESP.getMinFreeHeap());
-
-        stream->print("# HELP wifi_rssi WiFi RSSI\n");
-        stream->print("# TYPE wifi_rssi gauge\n");
-        stream->printf("wifi_rssi %d\n", WiFi.RSSI());
+            inverter_cache_t& cache = _inverterCache[i];
+            if (cache.metrics == nullptr || !(cache.version == version)) {
+                auto metrics = std::make_shared<StreamString>();
+                generateInverterMetrics(*metrics, i, inv);
+                cache.version = version;
+                cache.metrics = metrics;
+                renderedInverters++;
+            }
+            fragments.push_back(cache.metrics);
+        }
 
-        stream->print("# HELP wifi_station WiFi Station info\n");
-        stream->print("# TYPE wifi_station gauge\n");
-        stream->printf("wifi_station{bssid=\"%s\"} 1\n", WiFi.BSSIDstr().c_str());
+        // Fragments of inverters which were removed are not needed anymore
+        for (uint8_t i = inverters->size(); i < INV_MAX_COUNT; i++) {
+            _inverterCache[i].metrics.reset();
+        }
 
-        for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
-            auto inv = Hoymiles.getInverterByPos(i);
+        size_t length = 0;
+        for (auto& fragment : fragments) {
+            length += fragment->length();
+        }
 
-            String serial = inv->serialString();
-            const char* name = inv->name();
-            if (i == 0) {
-                stream->print("# HELP opendtu_last_update last update from inverter in s\n");
-                stream->print("# TYPE opendtu_last_update gauge\n");
-            }
-            stream->printf("opendtu_last_update{serial=\"%s\",unit=\"%d\",name=\"%s\"} %d\n",
-                serial.c_str(), i, name, inv->Statistics()->getLastUpdate() / 1000);
+        _lastRenderTime = micros() - start;
+        _renderedInverters = renderedInverters;
 
-            if (i == 0) {
-                stream->print("# HELP opendtu_inverter_limit_relative current relative limit of the inverter\n");
-                stream->print("# TYPE opendtu_inverter_limit_relative gauge\n");
-            }
-            stream->printf("opendtu_inverter_limit_relative{serial=\"%s\",unit=\"%d\",name=\"%s\"} %f\n",
-                serial.c_str(), i, name, inv->SystemConfigPara()->getLimitPercent() / 100.0);
+        if (length >= GZIP_RESPONSE_THRESHOLD && GzipResponse::isAccepted(request)) {
+            // One fragment per call
+            size_t fragment = 0;
 
-            if (inv->DevInfo()->getMaxPower() > 0) {
-                if (i == 0) {
-                    stream->print("# HELP opendtu_inverter_limit_absolute current relative limit of the inverter\n");
-                    stream->print("# TYPE opendtu_inverter_limit_absolute gauge\n");
+            GzipResponse response(request, "text/plain; charset=utf-8");
+            response.addHeader("Cache-Control", "no-cache");
+            response.send([fragments, fragment](Print& output) mutable {
+                if (fragment < fragments.size()) {
+                    output.write(reinterpret_cast<const uint8_t*>(fragments[fragment]->c_str()), fragments[fragment]->length());
+                    fragment++;
                 }
-                stream->printf("opendtu_inverter_limit_absolute{serial=\"%s\",unit=\"%d\",name=\"%s\"} %f\n",
-                    serial.c_str(), i, name, inv->SystemConfigPara()->getLimitPercent() * inv->DevInfo()->getMaxPower() / 100.0);
-            }
+                return fragment < fragments.size();
+            });
+            return;
+        }
 
-            // Loop all channels if Statistics have been updated at least once since DTU boot
-            if (inv->Statistics()->getLastUpdate() > 0) {
-                for (auto& t : inv->Statistics()->getChannelTypes()) {
-                    for (auto& c : inv->Statistics()->getChannelsByType(t)) {
-                        addPanelInfo(stream, serial, i, inv, t, c);
-                        for (uint8_t f = 0; f < sizeof(_publishFields) / sizeof(_publishFields[0]); f++) {
-                            if (t == TYPE_INV && _publishFields[f].field == FLD_PDC) {
-                                addField(stream, serial, i, inv, t, c, _publishFields[f].field, _metricTypes[_publishFields[f].type], "PowerDC");
-                            } else {
-                                addField(stream, serial, i, inv, t, c, _publishFields[f].field, _metricTypes[_publishFields[f].type]);
-                            }
-                        }
+        // The fragments are copied into the send buffer piece by piece
+        // instead of assembling the whole response in one allocation
+        auto state = std::make_shared<std::pair<size_t, size_t>>(0, 0); // fragment, offset
+        auto response = request->beginResponse("text/plain; charset=utf-8", length,
+            [fragments, state](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+                size_t written = 0;
+                while (written < maxLen && state->first < fragments.size()) {
+                    const StreamString& fragment = *fragments[state->first];
+                    const size_t chunk = std::min(maxLen - written, fragment.length() - state->second);
+                    memcpy(buffer + written, fragment.c_str() + state->second, chunk);
+                    written += chunk;
+                    state->second += chunk;
+                    if (state->second >= fragment.length()) {
+                        state->first++;
+                        state->second = 0;
                     }
                 }
-            }
-        }
-        stream->addHeader("Cache-Control", "no-cache");
-        request->send(stream);
+                return written;
+            });
+        response->addHeader("Cache-Control", "no-cache");
+        request->send(response);
 
     } catch (std::bad_alloc& bad_alloc) {
-        MessageOutput.printf("Call to /api/prometheus/metrics temporarely out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
+        MessageOutput.log(LogTag::Web, LogLevel::Error, "Call to /api/prometheus/metrics temporarely out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
 
         WebApi.sendTooManyRequests(request);
     }
 }
 
-void WebApiPrometheusClass::addField(AsyncResponseStream* stream, const String& serial, const uint8_t idx, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId, const char* metricName, const char* channelName)
+void WebApiPrometheusClass::addHistogram(Print& stream, const char* metricName, const char* labelName, const char* labelValue, const TaskProfilerStats_t& stats)
+{
+    char label[64] = "";
+    if (labelName != nullptr) {
+        snprintf(label, sizeof(label), "%s=\"%s\",", labelName, labelValue);
+    }
+
+    uint32_t count = 0;
+    for (uint8_t i = 0; i < TASK_PROFILER_BUCKET_COUNT - 1; i++) {
+        count += stats.Histogram[i];
+        stream.printf("%s_bucket{%sle=\"%u\"} %u\n", metricName, label, TaskProfiler.getBucketBound(i), count);
+    }
+    stream.printf("%s_bucket{%sle=\"+Inf\"} %u\n", metricName, label, stats.Count);
+
+    // Without label the braces are omitted
+    const size_t labelLength = strlen(label);
+    if (labelLength > 0) {
+        label[labelLength - 1] = '\0';
+        stream.printf("%s_sum{%s} %llu\n", metricName, label, stats.Time);
+        stream.printf("%s_count{%s} %u\n", metricName, label, stats.Count);
+    } else {
+        stream.printf("%s_sum %llu\n", metricName, stats.Time);
+        stream.printf("%s_count %u\n", metricName, stats.Count);
+    }
+}
+
+void WebApiPrometheusClass::generateSystemMetrics(Print& stream)
+{
+    stream.print("# HELP opendtu_build Build info\n");
+    stream.print("# TYPE opendtu_build gauge\n");
+    stream.printf("opendtu_build{name=\"%s\",id=\"%s\",version=\"%d.%d.%d\"} 1\n",
+        NetworkSettings.getHostname().c_str(), __COMPILED_GIT_HASH__, CONFIG_VERSION >> 24 & 0xff, CONFIG_VERSION >> 16 & 0xff, CONFIG_VERSION >> 8 & 0xff);
+
+    stream.print("# HELP opendtu_platform Platform info\n");
+    stream.print("# TYPE opendtu_platform gauge\n");
+    stream.printf("opendtu_platform{arch=\"%s\",mac=\"%s\"} 1\n", ESP.getChipModel(), NetworkSettings.macAddress().c_str());
+
+    stream.print("# HELP opendtu_uptime Uptime in seconds\n");
+    stream.print("# TYPE opendtu_uptime counter\n");
+    stream.printf("opendtu_uptime %lld\n", esp_timer_get_time() / 1000000);
+
+    stream.print("# HELP opendtu_heap_size System memory size\n");
+    stream.print("# TYPE opendtu_heap_size gauge\n");
+    stream.printf("opendtu_heap_size %zu\n", ESP.getHeapSize());
+
+    stream.print("# HELP opendtu_free_heap_size System free memory\n");
+    stream.print("# TYPE opendtu_free_heap_size gauge\n");
+    stream.printf("opendtu_free_heap_size %zu\n", ESP.getFreeHeap());
+
+    stream.print("# HELP opendtu_biggest_heap_block Biggest free heap block\n");
+    stream.print("# TYPE opendtu_biggest_heap_block gauge\n");
+    stream.printf("opendtu_biggest_heap_block %zu\n", ESP.getMaxAllocHeap());
+
+    stream.print("# HELP opendtu_heap_min_free Minimum free memory since boot\n");
+    stream.print("# TYPE opendtu_heap_min_free gauge\n");
+    stream.printf("opendtu_heap_min_free %zu\n", ESP.getMinFreeHeap());
+
+    stream.print("# HELP opendtu_heap_fragmentation Share of the free internal heap outside of the biggest free block in percent\n");
+    stream.print("# TYPE opendtu_heap_fragmentation gauge\n");
+    stream.printf("opendtu_heap_fragmentation %.1f\n", HeapMonitor.getFragmentation(HeapMonitor.getCurrent()));
+
+    if (HeapAccounting.isEnabled()) {
+        HeapTagStats_t tagStats[HEAP_TAG_COUNT];
+        for (uint8_t i = 1; i < HEAP_TAG_COUNT; i++) {
+            tagStats[i] = HeapAccounting.getStats(static_cast<HeapTag>(i));
+        }
+
+        stream.print("# HELP opendtu_heap_tag_allocations Heap allocations per subsystem\n");
+        stream.print("# TYPE opendtu_heap_tag_allocations counter\n");
+        for (uint8_t i = 1; i < HEAP_TAG_COUNT; i++) {
+            stream.printf("opendtu_heap_tag_allocations{tag=\"%s\"} %u\n", HeapAccounting.getTagName(static_cast<HeapTag>(i)), tagStats[i].Allocations);
+        }
+
+        stream.print("# HELP opendtu_heap_tag_frees Released heap allocations per subsystem\n");
+        stream.print("# TYPE opendtu_heap_tag_frees counter\n");
+        for (uint8_t i = 1; i < HEAP_TAG_COUNT; i++) {
+            stream.printf("opendtu_heap_tag_frees{tag=\"%s\"} %u\n", HeapAccounting.getTagName(static_cast<HeapTag>(i)), tagStats[i].Frees);
+        }
+
+        stream.print("# HELP opendtu_heap_tag_live_bytes Allocated heap per subsystem\n");
+        stream.print("# TYPE opendtu_heap_tag_live_bytes gauge\n");
+        for (uint8_t i = 1; i < HEAP_TAG_COUNT; i++) {
+            stream.printf("opendtu_heap_tag_live_bytes{tag=\"%s\"} %u\n", HeapAccounting.getTagName(static_cast<HeapTag>(i)), tagStats[i].LiveBytes);
+        }
+
+        stream.print("# HELP opendtu_heap_tag_peak_bytes Maximum allocated heap per subsystem\n");
+        stream.print("# TYPE opendtu_heap_tag_peak_bytes gauge\n");
+        for (uint8_t i = 1; i < HEAP_TAG_COUNT; i++) {
+            stream.printf("opendtu_heap_tag_peak_bytes{tag=\"%s\"} %u\n", HeapAccounting.getTagName(static_cast<HeapTag>(i)), tagStats[i].PeakBytes);
+        }
+
+        stream.print("# HELP opendtu_heap_untracked Allocations not tracked because the accounting table was full\n");
+        stream.print("# TYPE opendtu_heap_untracked counter\n");
+        stream.printf("opendtu_heap_untracked %u\n", HeapAccounting.getUntracked());
+    }
+
+    stream.print("# HELP wifi_rssi WiFi RSSI\n");
+    stream.print("# TYPE wifi_rssi gauge\n");
+    stream.printf("wifi_rssi %d\n", WiFi.RSSI());
+
+    stream.print("# HELP wifi_station WiFi Station info\n");
+    stream.print("# TYPE wifi_station gauge\n");
+    stream.printf("wifi_station{bssid=\"%s\"} 1\n", WiFi.BSSIDstr().c_str());
+
+    const auto mqttQueue = MqttSettings.getQueueStats();
+
+    stream.print("# HELP opendtu_mqtt_queue_depth Messages waiting in the MQTT publish queue\n");
+    stream.print("# TYPE opendtu_mqtt_queue_depth gauge\n");
+    stream.printf("opendtu_mqtt_queue_depth %u\n", mqttQueue.Depth);
+
+    stream.print("# HELP opendtu_mqtt_queue_bytes Memory used by the MQTT publish queue\n");
+    stream.print("# TYPE opendtu_mqtt_queue_bytes gauge\n");
+    stream.printf("opendtu_mqtt_queue_bytes %u\n", mqttQueue.Bytes);
+
+    stream.print("# HELP opendtu_mqtt_queue_sent Messages handed over to the MQTT client\n");
+    stream.print("# TYPE opendtu_mqtt_queue_sent counter\n");
+    stream.printf("opendtu_mqtt_queue_sent %u\n", mqttQueue.Sent);
+
+    stream.print("# HELP opendtu_mqtt_queue_replaced Queued messages replaced by a newer value\n");
+    stream.print("# TYPE opendtu_mqtt_queue_replaced counter\n");
+    stream.printf("opendtu_mqtt_queue_replaced %u\n", mqttQueue.Replaced);
+
+    stream.print("# HELP opendtu_mqtt_queue_dropped Messages dropped because of the queue memory budget\n");
+    stream.print("# TYPE opendtu_mqtt_queue_dropped counter\n");
+    stream.printf("opendtu_mqtt_queue_dropped %u\n", mqttQueue.Dropped);
+
+    stream.print("# HELP opendtu_mqtt_queue_latency_max Maximum time in ms a message waited in the queue\n");
+    stream.print("# TYPE opendtu_mqtt_queue_latency_max gauge\n");
+    stream.printf("opendtu_mqtt_queue_latency_max %u\n", mqttQueue.LatencyMax);
+
+    static const char* const wsLiveFormats[] = { "json", "delta", "binary" };
+
+    stream.print("# HELP opendtu_ws_live_frames Live data frames generated per websocket format\n");
+    stream.print("# TYPE opendtu_ws_live_frames counter\n");
+    for (uint8_t f = 0; f < WS_LIVE_FORMAT_COUNT; f++) {
+        stream.printf("opendtu_ws_live_frames{format=\"%s\"} %u\n", wsLiveFormats[f], WebApi.getWsLiveStats(static_cast<WsLiveFormat>(f)).Frames);
+    }
+
+    stream.print("# HELP opendtu_ws_live_bytes Live data bytes generated per websocket format\n");
+    stream.print("# TYPE opendtu_ws_live_bytes counter\n");
+    for (uint8_t f = 0; f < WS_LIVE_FORMAT_COUNT; f++) {
+        stream.printf("opendtu_ws_live_bytes{format=\"%s\"} %u\n", wsLiveFormats[f], WebApi.getWsLiveStats(static_cast<WsLiveFormat>(f)).Bytes);
+    }
+
+    stream.print("# HELP opendtu_ws_live_build_time Time in us spent generating live data per websocket format\n");
+    stream.print("# TYPE opendtu_ws_live_build_time counter\n");
+    for (uint8_t f = 0; f < WS_LIVE_FORMAT_COUNT; f++) {
+        stream.printf("opendtu_ws_live_build_time{format=\"%s\"} %u\n", wsLiveFormats[f], WebApi.getWsLiveStats(static_cast<WsLiveFormat>(f)).BuildTime);
+    }
+
+    stream.print("# HELP opendtu_http_not_modified Requests answered with 304 without running the handler\n");
+    stream.print("# TYPE opendtu_http_not_modified counter\n");
+    stream.printf("opendtu_http_not_modified %u\n", WebApi.getNotModifiedCount());
+
+    stream.print("# HELP opendtu_http_gzip_responses Responses compressed with gzip\n");
+    stream.print("# TYPE opendtu_http_gzip_responses counter\n");
+    for (auto& stats : GzipResponse::getStats()) {
+        stream.printf("opendtu_http_gzip_responses{url=\"%s\"} %u\n", stats.first.c_str(), stats.second.Responses);
+    }
+
+    stream.print("# HELP opendtu_http_gzip_input_bytes Bytes before compression\n");
+    stream.print("# TYPE opendtu_http_gzip_input_bytes counter\n");
+    for (auto& stats : GzipResponse::getStats()) {
+        stream.printf("opendtu_http_gzip_input_bytes{url=\"%s\"} %u\n", stats.first.c_str(), stats.second.InputBytes);
+    }
+
+    stream.print("# HELP opendtu_http_gzip_output_bytes Bytes sent after compression\n");
+    stream.print("# TYPE opendtu_http_gzip_output_bytes counter\n");
+    for (auto& stats : GzipResponse::getStats()) {
+        stream.printf("opendtu_http_gzip_output_bytes{url=\"%s\"} %u\n", stats.first.c_str(), stats.second.OutputBytes);
+    }
+
+    stream.print("# HELP opendtu_http_gzip_time Time in us spent compressing\n");
+    stream.print("# TYPE opendtu_http_gzip_time counter\n");
+    for (auto& stats : GzipResponse::getStats()) {
+        stream.printf("opendtu_http_gzip_time{url=\"%s\"} %u\n", stats.first.c_str(), stats.second.Time);
+    }
+
+    const ConfigWriteStats_t configStats = Configuration.getWriteStats();
+    stream.print("# HELP opendtu_config_write_requests Requested configuration changes\n");
+    stream.print("# TYPE opendtu_config_write_requests counter\n");
+    stream.printf("opendtu_config_write_requests %u\n", configStats.Requests);
+
+    stream.print("# HELP opendtu_config_writes Configuration writes to flash\n");
+    stream.print("# TYPE opendtu_config_writes counter\n");
+    stream.printf("opendtu_config_writes %u\n", configStats.Writes);
+
+    stream.print("# HELP opendtu_config_write_failures Failed configuration writes\n");
+    stream.print("# TYPE opendtu_config_write_failures counter\n");
+    stream.printf("opendtu_config_write_failures %u\n", configStats.Failures);
+
+    stream.print("# HELP opendtu_config_write_time Time in ms the last configuration write needed\n");
+    stream.print("# TYPE opendtu_config_write_time gauge\n");
+    stream.printf("opendtu_config_write_time %u\n", configStats.LastTime);
+
+    stream.print("# HELP opendtu_config_write_time_max Maximum time in ms a configuration write needed\n");
+    stream.print("# TYPE opendtu_config_write_time_max gauge\n");
+    stream.printf("opendtu_config_write_time_max %u\n", configStats.MaxTime);
+
+    stream.print("# HELP opendtu_log_dropped_bytes Log output dropped because the log buffer was full\n");
+    stream.print("# TYPE opendtu_log_dropped_bytes counter\n");
+    stream.printf("opendtu_log_dropped_bytes %u\n", MessageOutput.getDroppedBytes());
+
+    // Counters since boot, the maximum is reset with the measurement window
+    std::vector<std::pair<const char*, TaskProfilerStats_t>> taskStats;
+    TaskProfilerStats_t window;
+    for (ProfiledTask* task = ProfiledTask::getFirst(); task != nullptr; task = task->getNext()) {
+        taskStats.emplace_back(task->getName(), TaskProfilerStats_t());
+        task->getCounter().read(taskStats.back().second, window);
+        taskStats.back().second.MaxTime = window.MaxTime;
+    }
+
+    stream.print("# HELP opendtu_task_run_time Run time in us of the scheduler tasks\n");
+    stream.print("# TYPE opendtu_task_run_time histogram\n");
+    for (auto& task : taskStats) {
+        addHistogram(stream, "opendtu_task_run_time", "task", task.first, task.second);
+    }
+
+    stream.print("# HELP opendtu_task_run_time_max Maximum run time in us of the scheduler tasks in the measurement window\n");
+    stream.print("# TYPE opendtu_task_run_time_max gauge\n");
+    for (auto& task : taskStats) {
+        stream.printf("opendtu_task_run_time_max{task=\"%s\"} %u\n", task.first, task.second.MaxTime);
+    }
+
+    TaskProfilerStats_t loopStats;
+    TaskProfiler.getLoopCounter().read(loopStats, window);
+
+    stream.print("# HELP opendtu_loop_time Time in us of one iteration of the main loop\n");
+    stream.print("# TYPE opendtu_loop_time histogram\n");
+    addHistogram(stream, "opendtu_loop_time", nullptr, nullptr, loopStats);
+
+    stream.print("# HELP opendtu_loop_time_max Maximum time in us of one iteration of the main loop in the measurement window\n");
+    stream.print("# TYPE opendtu_loop_time_max gauge\n");
+    stream.printf("opendtu_loop_time_max %u\n", window.MaxTime);
+
+    stream.print("# HELP opendtu_cpu_load CPU load in percent per core\n");
+    stream.print("# TYPE opendtu_cpu_load gauge\n");
+    for (uint8_t core = 0; core < TaskProfiler.getCoreCount(); core++) {
+        stream.printf("opendtu_cpu_load{core=\"%u\"} %.1f\n", core, TaskProfiler.getCpuLoad(core));
+    }
+
+    stream.print("# HELP opendtu_scheduler_idle Time in percent the main loop slept waiting for the next task\n");
+    stream.print("# TYPE opendtu_scheduler_idle gauge\n");
+    stream.printf("opendtu_scheduler_idle %.1f\n", SchedulerIdle.getIdle());
+
+    stream.print("# HELP opendtu_scheduler_sleep_time Total time in us the main loop slept waiting for the next task\n");
+    stream.print("# TYPE opendtu_scheduler_sleep_time counter\n");
+    stream.printf("opendtu_scheduler_sleep_time %llu\n", SchedulerIdle.getSleepTime());
+
+    stream.print("# HELP opendtu_display_bus_time Time in us per second needed for transfers to the display\n");
+    stream.print("# TYPE opendtu_display_bus_time gauge\n");
+    stream.printf("opendtu_display_bus_time %u\n", Display.getBusTime());
+
+    stream.print("# HELP opendtu_display_tiles_sent Tiles of 8x8 pixels transferred to the display\n");
+    stream.print("# TYPE opendtu_display_tiles_sent counter\n");
+    stream.printf("opendtu_display_tiles_sent %u\n", Display.getTilesSent());
+
+    stream.print("# HELP opendtu_prometheus_render_time Time in us the previous scrape needed to render the metrics\n");
+    stream.print("# TYPE opendtu_prometheus_render_time gauge\n");
+    stream.printf("opendtu_prometheus_render_time %u\n", _lastRenderTime);
+
+    stream.print("# HELP opendtu_prometheus_rendered_inverters Inverters whose metrics had to be rendered again in the previous scrape\n");
+    stream.print("# TYPE opendtu_prometheus_rendered_inverters gauge\n");
+    stream.printf("opendtu_prometheus_rendered_inverters %u\n", _renderedInverters);
+}
+
+void WebApiPrometheusClass::generateInverterMetrics(Print& stream, const uint8_t idx, std::shared_ptr<InverterAbstract> inv)
+{
+    String serial = inv->serialString();
+    const char* name = inv->name();
+    if (idx == 0) {
+        stream.print("# HELP opendtu_last_update last update from inverter in s\n");
+        stream.print("# TYPE opendtu_last_update gauge\n");
+    }
+    stream.printf("opendtu_last_update{serial=\"%s\",unit=\"%d\",name=\"%s\"} %d\n",
+        serial.c_str(), idx, name, inv->Statistics()->getLastUpdate() / 1000);
+
+    if (idx == 0) {
+        stream.print("# HELP opendtu_inverter_limit_relative current relative limit of the inverter\n");
+        stream.print("# TYPE opendtu_inverter_limit_relative gauge\n");
+    }
+    stream.printf("opendtu_inverter_limit_relative{serial=\"%s\",unit=\"%d\",name=\"%s\"} %f\n",
+        serial.c_str(), idx, name, inv->SystemConfigPara()->getLimitPercent() / 100.0);
+
+    if (inv->DevInfo()->getMaxPower() > 0) {
+        if (idx == 0) {
+            stream.print("# HELP opendtu_inverter_limit_absolute current relative limit of the inverter\n");
+            stream.print("# TYPE opendtu_inverter_limit_absolute gauge\n");
+        }
+        stream.printf("opendtu_inverter_limit_absolute{serial=\"%s\",unit=\"%d\",name=\"%s\"} %f\n",
+            serial.c_str(), idx, name, inv->SystemConfigPara()->getLimitPercent() * inv->DevInfo()->getMaxPower() / 100.0);
+    }
+
+    // Loop all channels if Statistics have been updated at least once since DTU boot
+    if (inv->Statistics()->getLastUpdate() > 0) {
+        for (auto& t : inv->Statistics()->getChannelTypes()) {
+            for (auto& c : inv->Statistics()->getChannelsByType(t)) {
+                addPanelInfo(stream, serial, idx, inv, t, c);
+                for (uint8_t f = 0; f < sizeof(_publishFields) / sizeof(_publishFields[0]); f++) {
+                    if (t == TYPE_INV && _publishFields[f].field == FLD_PDC) {
+                        addField(stream, serial, idx, inv, t, c, _publishFields[f].field, _metricTypes[_publishFields[f].type], "PowerDC");
+                    } else {
+                        addField(stream, serial, idx, inv, t, c, _publishFields[f].field, _metricTypes[_publishFields[f].type]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void WebApiPrometheusClass::addField(Print& stream, const String& serial, const uint8_t idx, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId, const char* metricName, const char* channelName)
 {
     if (inv->Statistics()->hasChannelFieldValue(type, channel, fieldId)) {
         const char* chanName = (channelName == nullptr) ? inv->Statistics()->getChannelFieldName(type, channel, fieldId) : channelName;
         if (idx == 0 && type == TYPE_AC && channel == 0) {
-            stream->printf("# HELP opendtu_%s in %s\n", chanName, inv->Statistics()->getChannelFieldUnit(type, channel, fieldId));
-            stream->printf("# TYPE opendtu_%s %s\n", chanName, metricName);
+            stream.printf("# HELP opendtu_%s in %s\n", chanName, inv->Statistics()->getChannelFieldUnit(type, channel, fieldId));
+            stream.printf("# TYPE opendtu_%s %s\n", chanName, metricName);
         }
-        stream->printf("opendtu_%s{serial=\"%s\",unit=\"%d\",name=\"%s\",type=\"%s\",channel=\"%d\"} %s\n",
+        stream.printf("opendtu_%s{serial=\"%s\",unit=\"%d\",name=\"%s\",type=\"%s\",channel=\"%d\"} %s\n",
             chanName,
             serial.c_str(),
             idx,
@@ -137,20 +458,21 @@ void WebApiPrometheusClass::addField(AsyncResponseStream* stream, const String&
     }
 }
 
-void WebApiPrometheusClass::addPanelInfo(AsyncResponseStream* stream, const String& serial, const uint8_t idx, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel)
+void WebApiPrometheusClass::addPanelInfo(Print& stream, const String& serial, const uint8_t idx, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel)
 {
     if (type != TYPE_DC) {
         return;
     }
 
-    const auto& config = Configuration.getInverterConfig(inv->serial());
+    const ConfigSnapshotPtr snapshot = Configuration.getSnapshot();
+    const INVERTER_CONFIG_T* config = snapshot->getInverterConfig(inv->serial());
 
     const bool printHelp = (idx == 0 && channel == 0);
     if (printHelp) {
-        stream->print("# HELP opendtu_PanelInfo panel information\n");
-        stream->print("# TYPE opendtu_PanelInfo gauge\n");
+        stream.print("# HELP opendtu_PanelInfo panel information\n");
+        stream.print("# TYPE opendtu_PanelInfo gauge\n");
     }
-    stream->printf("opendtu_PanelInfo{serial=\"%s\",unit=\"%d\",name=\"%s\",channel=\"%d\",panelname=\"%s\"} 1\n",
+    stream.printf("opendtu_PanelInfo{serial=\"%s\",unit=\"%d\",name=\"%s\",channel=\"%d\",panelname=\"%s\"} 1\n",
         serial.c_str(),
         idx,
         inv->name(),
@@ -158,10 +480,10 @@ void WebApiPrometheusClass::addPanelInfo(AsyncResponseStream* stream, const Stri
         config->channel[channel].Name);
 
     if (printHelp) {
-        stream->print("# HELP opendtu_MaxPower panel maximum output power\n");
-        stream->print("# TYPE opendtu_MaxPower gauge\n");
+        stream.print("# HELP opendtu_MaxPower panel maximum output power\n");
+        stream.print("# TYPE opendtu_MaxPower gauge\n");
     }
-    stream->printf("opendtu_MaxPower{serial=\"%s\",unit=\"%d\",name=\"%s\",channel=\"%d\"} %d\n",
+    stream.printf("opendtu_MaxPower{serial=\"%s\",unit=\"%d\",name=\"%s\",channel=\"%d\"} %d\n",
         serial.c_str(),
         idx,
         inv->name(),
@@ -169,10 +491,10 @@ void WebApiPrometheusClass::addPanelInfo(AsyncResponseStream* stream, const Stri
         config->channel[channel].MaxChannelPower);
 
     if (printHelp) {
-        stream->print("# HELP opendtu_YieldTotalOffset panel yield offset (for used inverters)\n");
-        stream->print("# TYPE opendtu_YieldTotalOffset gauge\n");
+        stream.print("# HELP opendtu_YieldTotalOffset panel yield offset (for used inverters)\n");
+        stream.print("# TYPE opendtu_YieldTotalOffset gauge\n");
     }
-    stream->printf("opendtu_YieldTotalOffset{serial=\"%s\",unit=\"%d\",name=\"%s\",channel=\"%d\"} %f\n",
+    stream.printf("opendtu_YieldTotalOffset{serial=\"%s\",unit=\"%d\",name=\"%s\",channel=\"%d\"} %f\n",
         serial.c_str(),
         idx,
         inv->name(),
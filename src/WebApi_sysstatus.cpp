@@ -4,12 +4,17 @@
  */
 #include "WebApi_sysstatus.h"
 #include "Configuration.h"
+#include "HeapMonitor.h"
 #include "NetworkSettings.h"
 #include "PinMapping.h"
+#include "Scheduler.h"
+#include "TaskProfiler.h"
 #include "WebApi.h"
+#include "WebApi_errors.h"
 #include "__compiled_constants.h"
 #include <AsyncJson.h>
 #include <CpuTemperature.h>
+#include <HeapAccounting.h>
 #include <Hoymiles.h>
 #include <LittleFS.h>
 #include <ResetReason.h>
@@ -19,6 +24,8 @@ void WebApiSysstatusClass::init(AsyncWebServer& server, Scheduler& scheduler)
     using std::placeholders::_1;
 
     server.on("/api/system/status", HTTP_GET, std::bind(&WebApiSysstatusClass::onSystemStatus, this, _1));
+    server.on("/api/system/tasks", HTTP_GET, std::bind(&WebApiSysstatusClass::onSystemTasksGet, this, _1));
+    server.on("/api/system/tasks", HTTP_POST, std::bind(&WebApiSysstatusClass::onSystemTasksPost, this, _1));
 }
 
 void WebApiSysstatusClass::onSystemStatus(AsyncWebServerRequest* request)
@@ -40,6 +47,34 @@ void WebApiSysstatusClass::onSystemStatus(AsyncWebServerRequest* request)
     root["heap_used"] = ESP.getHeapSize() - ESP.getFreeHeap();
     root["heap_max_block"] = ESP.getMaxAllocHeap();
     root["heap_min_free"] = ESP.getMinFreeHeap();
+    root["heap_fragmentation"] = HeapMonitor.getFragmentation(HeapMonitor.getCurrent());
+
+    auto snapshots = root["heap_snapshots"].to<JsonArray>();
+    for (auto& snapshot : HeapMonitor.getSnapshots()) {
+        auto snapshotObj = snapshots.add<JsonObject>();
+        snapshotObj["uptime"] = snapshot.Uptime;
+        snapshotObj["free"] = snapshot.FreeBytes;
+        snapshotObj["max_block"] = snapshot.LargestFreeBlock;
+        snapshotObj["min_free"] = snapshot.MinimumFreeBytes;
+        snapshotObj["free_blocks"] = snapshot.FreeBlocks;
+        snapshotObj["fragmentation"] = HeapMonitor.getFragmentation(snapshot);
+    }
+
+    root["heap_accounting"] = HeapAccounting.isEnabled();
+    if (HeapAccounting.isEnabled()) {
+        auto tags = root["heap_tags"].to<JsonObject>();
+        for (uint8_t i = 1; i < HEAP_TAG_COUNT; i++) {
+            const HeapTag tag = static_cast<HeapTag>(i);
+            const HeapTagStats_t stats = HeapAccounting.getStats(tag);
+
+            auto tagObj = tags[HeapAccounting.getTagName(tag)].to<JsonObject>();
+            tagObj["allocations"] = stats.Allocations;
+            tagObj["frees"] = stats.Frees;
+            tagObj["live"] = stats.LiveBytes;
+            tagObj["peak"] = stats.PeakBytes;
+        }
+        root["heap_untracked"] = HeapAccounting.getUntracked();
+    }
     root["psram_total"] = ESP.getPsramSize();
     root["psram_used"] = ESP.getPsramSize() - ESP.getFreePsram();
     root["sketch_total"] = ESP.getFreeSketchSpace();
@@ -59,7 +94,7 @@ void WebApiSysstatusClass::onSystemStatus(AsyncWebServerRequest* request)
     reason = ResetReason::get_reset_reason_verbose(1);
     root["resetreason_1"] = reason;
 
-    root["cfgsavecount"] = Configuration.get().Cfg.SaveCount;
+    root["cfgsavecount"] = Configuration.getSnapshot()->get().Cfg.SaveCount;
 
     char version[16];
     snprintf(version, sizeof(version), "%d.%d.%d", CONFIG_VERSION >> 24 & 0xff, CONFIG_VERSION >> 16 & 0xff, CONFIG_VERSION >> 8 & 0xff);
@@ -78,3 +113,95 @@ void WebApiSysstatusClass::onSystemStatus(AsyncWebServerRequest* request)
 
     WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
+
+static void addTaskStats(JsonObject obj, const TaskProfilerStats_t& stats, const uint32_t windowDuration)
+{
+    obj["count"] = stats.Count;
+    obj["time"] = stats.Time;
+    obj["max"] = stats.MaxTime;
+    obj["avg"] = stats.Count > 0 ? static_cast<uint32_t>(stats.Time / stats.Count) : 0;
+    obj["load"] = windowDuration > 0 ? stats.Time / (windowDuration * 10.0) : 0;
+
+    auto histogram = obj["histogram"].to<JsonArray>();
+    for (uint8_t i = 0; i < TASK_PROFILER_BUCKET_COUNT; i++) {
+        histogram.add(stats.Histogram[i]);
+    }
+}
+
+void WebApiSysstatusClass::onSystemTasksGet(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentialsReadonly(request)) {
+        return;
+    }
+
+    AsyncJsonResponse* response = new AsyncJsonResponse();
+    auto& root = response->getRoot();
+
+    // All times in us, load in percent of the measurement window
+    const uint32_t windowDuration = TaskProfiler.getWindowDuration();
+    root["window"] = windowDuration;
+
+    auto buckets = root["buckets"].to<JsonArray>();
+    for (uint8_t i = 0; i < TASK_PROFILER_BUCKET_COUNT - 1; i++) {
+        buckets.add(TaskProfiler.getBucketBound(i));
+    }
+
+    auto cores = root["cores"].to<JsonArray>();
+    for (uint8_t core = 0; core < TaskProfiler.getCoreCount(); core++) {
+        auto coreObj = cores.add<JsonObject>();
+        coreObj["load"] = TaskProfiler.getCpuLoad(core);
+        coreObj["load_window"] = TaskProfiler.getCpuLoadWindow(core);
+    }
+
+    root["idle"] = SchedulerIdle.getIdle();
+    root["light_sleep"] = SchedulerIdle.isLightSleepEnabled();
+
+    TaskProfilerStats_t total;
+    TaskProfilerStats_t window;
+
+    TaskProfiler.getLoopCounter().read(total, window);
+    addTaskStats(root["loop"].to<JsonObject>(), window, windowDuration);
+
+    auto tasks = root["tasks"].to<JsonArray>();
+    for (ProfiledTask* task = ProfiledTask::getFirst(); task != nullptr; task = task->getNext()) {
+        task->getCounter().read(total, window);
+
+        auto taskObj = tasks.add<JsonObject>();
+        taskObj["name"] = task->getName();
+        taskObj["enabled"] = task->isEnabled();
+        taskObj["interval"] = task->getInterval();
+        addTaskStats(taskObj, window, windowDuration);
+    }
+
+    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+}
+
+void WebApiSysstatusClass::onSystemTasksPost(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentials(request)) {
+        return;
+    }
+
+    AsyncJsonResponse* response = new AsyncJsonResponse();
+    JsonDocument root;
+    if (!WebApi.parseRequestData(request, response, root)) {
+        return;
+    }
+
+    auto& retMsg = response->getRoot();
+
+    if (!root["reset"].as<bool>()) {
+        retMsg["message"] = "Values are missing!";
+        retMsg["code"] = WebApiError::GenericValueMissing;
+        WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+        return;
+    }
+
+    TaskProfiler.requestReset();
+
+    retMsg["type"] = "success";
+    retMsg["message"] = "Measurement window restarted!";
+    retMsg["code"] = WebApiError::TasksResetTriggered;
+
+    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+}
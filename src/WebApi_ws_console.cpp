@@ -6,16 +6,24 @@
 #include "Configuration.h"
 #include "MessageOutput.h"
 #include "WebApi.h"
+#include "WebApi_errors.h"
 #include "defaults.h"
+#include <AsyncJson.h>
+#include <HeapAccounting.h>
 
 WebApiWsConsoleClass::WebApiWsConsoleClass()
     : _ws("/console")
-    , _wsCleanupTask(1 * TASK_SECOND, TASK_FOREVER, std::bind(&WebApiWsConsoleClass::wsCleanupTaskCb, this))
+    , _wsCleanupTask("ws_console_cleanup", 1 * TASK_SECOND, TASK_FOREVER, std::bind(&WebApiWsConsoleClass::wsCleanupTaskCb, this))
 {
 }
 
 void WebApiWsConsoleClass::init(AsyncWebServer& server, Scheduler& scheduler)
 {
+    using std::placeholders::_1;
+
+    server.on("/api/console/config", HTTP_GET, std::bind(&WebApiWsConsoleClass::onConsoleAdminGet, this, _1));
+    server.on("/api/console/config", HTTP_POST, std::bind(&WebApiWsConsoleClass::onConsoleAdminPost, this, _1));
+
     server.addHandler(&_ws);
     MessageOutput.register_ws_output(&_ws);
 
@@ -25,12 +33,82 @@ void WebApiWsConsoleClass::init(AsyncWebServer& server, Scheduler& scheduler)
 
 void WebApiWsConsoleClass::wsCleanupTaskCb()
 {
+    HeapTagScope heapTag(HeapTag::Websocket);
+
     // see: https://github.com/me-no-dev/ESPAsyncWebServer#limiting-the-number-of-web-socket-clients
     _ws.cleanupClients();
 
-    if (Configuration.get().Security.AllowReadonly) {
+    const ConfigSnapshotPtr snapshot = Configuration.getSnapshot();
+    if (snapshot->get().Security.AllowReadonly) {
         _ws.setAuthentication("", "");
     } else {
-        _ws.setAuthentication(AUTH_USERNAME, Configuration.get().Security.Password);
+        _ws.setAuthentication(AUTH_USERNAME, snapshot->get().Security.Password);
+    }
+}
+
+void WebApiWsConsoleClass::onConsoleAdminGet(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentials(request)) {
+        return;
     }
+
+    AsyncJsonResponse* response = new AsyncJsonResponse();
+    auto& root = response->getRoot();
+
+    auto levels = root["levels"].to<JsonObject>();
+    for (uint8_t i = 0; i < LOG_TAG_COUNT; i++) {
+        const LogTag tag = static_cast<LogTag>(i);
+        levels[MessageOutput.getTagName(tag)] = MessageOutput.getLevelName(MessageOutput.getLevel(tag));
+    }
+    root["max_level"] = MessageOutput.getLevelName(LOG_LEVEL_MAX);
+    root["dropped_bytes"] = MessageOutput.getDroppedBytes();
+
+    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+}
+
+void WebApiWsConsoleClass::onConsoleAdminPost(AsyncWebServerRequest* request)
+{
+    if (!WebApi.checkCredentials(request)) {
+        return;
+    }
+
+    AsyncJsonResponse* response = new AsyncJsonResponse();
+    JsonDocument root;
+    if (!WebApi.parseRequestData(request, response, root)) {
+        return;
+    }
+
+    auto& retMsg = response->getRoot();
+
+    if (!root["levels"].is<JsonObject>()) {
+        retMsg["message"] = "Values are missing!";
+        retMsg["code"] = WebApiError::GenericValueMissing;
+        WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+        return;
+    }
+
+    // Validate all levels first, so an invalid request changes nothing
+    LogLevel levels[LOG_TAG_COUNT];
+    for (uint8_t i = 0; i < LOG_TAG_COUNT; i++) {
+        const LogTag tag = static_cast<LogTag>(i);
+        levels[i] = MessageOutput.getLevel(tag);
+
+        JsonVariant level = root["levels"][MessageOutput.getTagName(tag)];
+        if (!level.isNull() && !MessageOutput.parseLevel(level.as<const char*>(), levels[i])) {
+            retMsg["message"] = "Invalid log level!";
+            retMsg["code"] = WebApiError::ConsoleInvalidLogLevel;
+            WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+            return;
+        }
+    }
+
+    for (uint8_t i = 0; i < LOG_TAG_COUNT; i++) {
+        MessageOutput.setLevel(static_cast<LogTag>(i), levels[i]);
+    }
+
+    retMsg["type"] = "success";
+    retMsg["message"] = "Settings saved!";
+    retMsg["code"] = WebApiError::GenericSuccess;
+
+    WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
 }
@@ -4,16 +4,48 @@
  */
 #include "WebApi_ws_live.h"
 #include "Datastore.h"
+#include "GzipResponse.h"
 #include "MessageOutput.h"
 #include "Utils.h"
 #include "WebApi.h"
 #include "defaults.h"
 #include <AsyncJson.h>
+#include <HeapAccounting.h>
+#include <WallClock.h>
+#include <algorithm>
+
+// Unacknowledged delta states kept per client
+#define WS_LIVE_MAX_PENDING 2
+
+#define WS_LIVE_FRAME_INVERTER 1
+#define WS_LIVE_FRAME_TOTAL 2
+
+#define WS_LIVE_HINT_TIME_SYNC 0x01
+#define WS_LIVE_HINT_RADIO_PROBLEM 0x02
+#define WS_LIVE_HINT_DEFAULT_PASSWORD 0x04
+
+// Feeds the serialized JSON into a FNV-1a hash instead of a buffer
+class HashWriter {
+public:
+    size_t write(uint8_t c)
+    {
+        hash = Utils::getFnv1aHash(&c, 1, hash);
+        return 1;
+    }
+
+    size_t write(const uint8_t* s, size_t n)
+    {
+        hash = Utils::getFnv1aHash(s, n, hash);
+        return n;
+    }
+
+    uint32_t hash = FNV1A_INITIAL_HASH;
+};
 
 WebApiWsLiveClass::WebApiWsLiveClass()
     : _ws("/livedata")
-    , _wsCleanupTask(1 * TASK_SECOND, TASK_FOREVER, std::bind(&WebApiWsLiveClass::wsCleanupTaskCb, this))
-    , _sendDataTask(1 * TASK_SECOND, TASK_FOREVER, std::bind(&WebApiWsLiveClass::sendDataTaskCb, this))
+    , _wsCleanupTask("ws_live_cleanup", 1 * TASK_SECOND, TASK_FOREVER, std::bind(&WebApiWsLiveClass::wsCleanupTaskCb, this))
+    , _sendDataTask("ws_live_send", 1 * TASK_SECOND, TASK_FOREVER, std::bind(&WebApiWsLiveClass::sendDataTaskCb, this))
 {
 }
 
@@ -40,39 +72,137 @@ void WebApiWsLiveClass::init(AsyncWebServer& server, Scheduler& scheduler)
 
 void WebApiWsLiveClass::wsCleanupTaskCb()
 {
+    HeapTagScope heapTag(HeapTag::Websocket);
+
     // see: https://github.com/me-no-dev/ESPAsyncWebServer#limiting-the-number-of-web-socket-clients
     _ws.cleanupClients();
 
-    if (Configuration.get().Security.AllowReadonly) {
+    const ConfigSnapshotPtr snapshot = Configuration.getSnapshot();
+    if (snapshot->get().Security.AllowReadonly) {
         _ws.setAuthentication("", "");
     } else {
-        _ws.setAuthentication(AUTH_USERNAME, Configuration.get().Security.Password);
+        _ws.setAuthentication(AUTH_USERNAME, snapshot->get().Security.Password);
     }
 }
 
 void WebApiWsLiveClass::sendDataTaskCb()
 {
+    HeapTagScope heapTag(HeapTag::Websocket);
+
     // do nothing if no WS client is connected
     if (_ws.count() == 0) {
         return;
     }
 
-    // Loop all inverters
-    for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
-        auto inv = Hoymiles.getInverterByPos(i);
-        if (inv == nullptr) {
-            continue;
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    bool hasClients[WS_LIVE_FORMAT_COUNT] = {};
+    for (auto& client : _clients) {
+        hasClients[static_cast<uint8_t>(client.format)] = true;
+    }
+    const bool hasLegacyClients = hasClients[static_cast<uint8_t>(WsLiveFormat::Json)];
+    const bool hasDeltaClients = hasClients[static_cast<uint8_t>(WsLiveFormat::Delta)];
+    const bool hasBinaryClients = hasClients[static_cast<uint8_t>(WsLiveFormat::Binary)];
+
+    try {
+        // Total and hints are diffed like an inverter with serial 0
+        JsonDocument commonDoc;
+        unit_hashes_t commonUnits;
+        if (hasDeltaClients) {
+            const uint32_t start = micros();
+            JsonVariant commonVar = commonDoc;
+            generateCommonJsonResponse(commonVar);
+            collectUnits(commonDoc.as<JsonObjectConst>(), 0, 1, commonUnits);
+            account(WsLiveFormat::Delta, 0, start);
         }
 
-        const uint32_t lastUpdateInternal = inv->Statistics()->getLastUpdateFromInternal();
-        if (!((lastUpdateInternal > 0 && lastUpdateInternal > _lastPublishStats[i]) || (millis() - _lastPublishStats[i] > (10 * 1000)))) {
-            continue;
+        for (auto& client : _clients) {
+            if (client.format != WsLiveFormat::Delta) {
+                continue;
+            }
+
+            client.building.clear();
+            JsonObject root = client.message.to<JsonObject>();
+
+            const known_states_t known = getKnown(client, 0);
+            if (!isKnown(known, commonUnits)) {
+                addChangedUnits(root, commonDoc.as<JsonObjectConst>(), 0, 1, commonUnits, known);
+                client.building[0] = commonUnits;
+            }
         }
 
-        _lastPublishStats[i] = millis();
+        // Binary clients which received an inverter frame in this cycle
+        std::vector<uint32_t> totalReceivers;
+
+        // Loop all inverters
+        const InverterListPtr inverters = Hoymiles.getInverters();
+        for (uint8_t i = 0; i < inverters->size(); i++) {
+            auto inv = (*inverters)[i];
+
+            const uint32_t lastUpdateInternal = inv->Statistics()->getLastUpdateFromInternal();
+            const bool due = (lastUpdateInternal > 0 && lastUpdateInternal > _lastPublishStats[i]) || (millis() - _lastPublishStats[i] > (10 * 1000));
+
+            // A new subscriber gets the full state immediately
+            bool deltaRequired = false;
+            bool binaryRequired = false;
+            for (auto& client : _clients) {
+                if (!isSubscribed(client, inv->serial())) {
+                    continue;
+                }
+                if (client.format == WsLiveFormat::Delta && (due || getAcked(client, inv->serial()) == nullptr)) {
+                    deltaRequired = true;
+                }
+                if (client.format == WsLiveFormat::Binary && (due || client.schemas.count(inv->serial()) == 0)) {
+                    binaryRequired = true;
+                }
+            }
+
+            const bool legacyRequired = due && hasLegacyClients;
+            if (!legacyRequired && !deltaRequired && !binaryRequired) {
+                continue;
+            }
+
+            if (due) {
+                _lastPublishStats[i] = millis();
+            }
+
+            if (binaryRequired) {
+                const uint32_t start = micros();
+                const uint32_t schemaId = getSchemaId(inv);
+                const std::vector<uint8_t> frame = generateInverterFrame(inv, schemaId);
+                account(WsLiveFormat::Binary, frame.size(), start);
+
+                for (auto& client : _clients) {
+                    if (client.format != WsLiveFormat::Binary || !isSubscribed(client, inv->serial())) {
+                        continue;
+                    }
+                    AsyncWebSocketClient* wsClient = _ws.client(client.id);
+                    if (wsClient == nullptr) {
+                        continue;
+                    }
+
+                    auto schema = client.schemas.find(inv->serial());
+                    if (!due && schema != client.schemas.end()) {
+                        continue;
+                    }
+                    if (schema == client.schemas.end() || schema->second != schemaId) {
+                        wsClient->text(generateSchema(inv, schemaId));
+                        client.schemas[inv->serial()] = schemaId;
+                    }
+
+                    wsClient->binary(frame.data(), frame.size());
+                    if (std::find(totalReceivers.begin(), totalReceivers.end(), client.id) == totalReceivers.end()) {
+                        totalReceivers.push_back(client.id);
+                    }
+                }
+            }
+
+            if (!legacyRequired && !deltaRequired) {
+                continue;
+            }
+
+            const uint32_t start = micros();
 
-        try {
-            std::lock_guard<std::mutex> lock(_mutex);
             JsonDocument root;
             JsonVariant var = root;
 
@@ -87,17 +217,266 @@ void WebApiWsLiveClass::sendDataTaskCb()
                 continue;
             }
 
-            String buffer;
-            serializeJson(root, buffer);
+            if (legacyRequired) {
+                String buffer;
+                serializeJson(root, buffer);
+                account(WsLiveFormat::Json, buffer.length(), start);
+                sendLegacy(buffer, hasDeltaClients || hasBinaryClients);
+            }
+
+            if (!deltaRequired) {
+                continue;
+            }
+
+            const uint32_t deltaStart = micros();
+
+            // serial identifies the inverter and data_age is counted up by
+            // the client itself, both are not part of the diff
+            const String serialString = invObject["serial"];
+            const uint32_t dataAge = invObject["data_age"];
+            invObject.remove("serial");
+            invObject.remove("data_age");
+
+            unit_hashes_t invUnits;
+            collectUnits(invObject, 0, 2, invUnits);
+
+            for (auto& client : _clients) {
+                if (client.format != WsLiveFormat::Delta || !isSubscribed(client, inv->serial())) {
+                    continue;
+                }
+
+                const known_states_t known = getKnown(client, inv->serial());
+                if (isKnown(known, invUnits)) {
+                    continue;
+                }
+
+                JsonArray deltaArray = client.message["inverters"].is<JsonArray>()
+                    ? client.message["inverters"].as<JsonArray>()
+                    : client.message["inverters"].to<JsonArray>();
+                JsonObject deltaObject = deltaArray.add<JsonObject>();
+                deltaObject["serial"] = serialString;
+                deltaObject["data_age"] = dataAge;
+                addChangedUnits(deltaObject, invObject, 0, 2, invUnits, known);
+                client.building[inv->serial()] = invUnits;
+            }
+
+            // The document was generated for the delta clients only
+            account(WsLiveFormat::Delta, 0, legacyRequired ? deltaStart : start);
+        }
+
+        for (auto& client : _clients) {
+            if (client.format == WsLiveFormat::Delta && !client.building.empty()) {
+                sendDelta(client);
+            }
+        }
+
+        if (!totalReceivers.empty()) {
+            const uint32_t start = micros();
+            const std::vector<uint8_t> frame = generateTotalFrame();
+            account(WsLiveFormat::Binary, frame.size(), start);
+
+            for (auto id : totalReceivers) {
+                AsyncWebSocketClient* wsClient = _ws.client(id);
+                if (wsClient != nullptr) {
+                    wsClient->binary(frame.data(), frame.size());
+                }
+            }
+        }
+
+    } catch (const std::bad_alloc& bad_alloc) {
+        MessageOutput.log(LogTag::Web, LogLevel::Error, "Call to /api/livedata/status temporarely out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
+    } catch (const std::exception& exc) {
+        MessageOutput.log(LogTag::Web, LogLevel::Error, "Unknown exception in /api/livedata/status. Reason: \"%s\".\r\n", exc.what());
+    }
+}
+
+void WebApiWsLiveClass::sendLegacy(const String& buffer, const bool hasOtherClients)
+{
+    if (!hasOtherClients) {
+        _ws.textAll(buffer);
+        return;
+    }
+
+    for (auto& client : _clients) {
+        if (client.format != WsLiveFormat::Json) {
+            continue;
+        }
+        AsyncWebSocketClient* wsClient = _ws.client(client.id);
+        if (wsClient != nullptr) {
+            wsClient->text(buffer);
+        }
+    }
+}
+
+void WebApiWsLiveClass::sendDelta(client_state_t& client)
+{
+    AsyncWebSocketClient* wsClient = _ws.client(client.id);
+    if (wsClient == nullptr) {
+        return;
+    }
+
+    const uint32_t start = micros();
+
+    client.seq++;
+    client.message["seq"] = client.seq;
+
+    if (!Utils::checkJsonAlloc(client.message, __FUNCTION__, __LINE__)) {
+        return;
+    }
+
+    String buffer;
+    serializeJson(client.message, buffer);
+    client.message.clear();
+    account(WsLiveFormat::Delta, buffer.length(), start);
+    wsClient->text(buffer);
+
+    // Deltas contain every unit which differs from the acknowledged state or
+    // from one of the unacknowledged ones. A message which gets lost (e.g.
+    // because of a full client queue) is therefore covered by the next one and
+    // a value which returns to the acknowledged one after an unacknowledged
+    // change is sent again. Only the latest few unacknowledged states are kept,
+    // dropping older ones makes the client just receive more units.
+    client.pending.push_back({ client.seq, std::move(client.building) });
+    client.building.clear();
+    while (client.pending.size() > WS_LIVE_MAX_PENDING) {
+        client.pending.pop_front();
+    }
+}
+
+void WebApiWsLiveClass::account(const WsLiveFormat format, const size_t bytes, const uint32_t start)
+{
+    WsLiveFormatStats_t& stats = _stats[static_cast<uint8_t>(format)];
+    if (bytes > 0) {
+        stats.Frames++;
+        stats.Bytes += bytes;
+    }
+    stats.BuildTime += micros() - start;
+}
+
+WsLiveFormatStats_t WebApiWsLiveClass::getStats(const WsLiveFormat format)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats[static_cast<uint8_t>(format)];
+}
+
+bool WebApiWsLiveClass::isSubscribed(const client_state_t& client, const uint64_t serial)
+{
+    return client.serials.empty() || std::find(client.serials.begin(), client.serials.end(), serial) != client.serials.end();
+}
+
+const WebApiWsLiveClass::unit_hashes_t* WebApiWsLiveClass::getAcked(const client_state_t& client, const uint64_t serial)
+{
+    const auto it = client.acked.find(serial);
+    return it != client.acked.end() ? &it->second : nullptr;
+}
+
+WebApiWsLiveClass::known_states_t WebApiWsLiveClass::getKnown(const client_state_t& client, const uint64_t serial)
+{
+    known_states_t known;
+
+    // Without an acknowledged state the client has to receive everything
+    const unit_hashes_t* acked = getAcked(client, serial);
+    if (acked == nullptr) {
+        return known;
+    }
+    known.push_back(acked);
+
+    for (const auto& pending : client.pending) {
+        const auto it = pending.states.find(serial);
+        if (it != pending.states.end()) {
+            known.push_back(&it->second);
+        }
+    }
+
+    return known;
+}
+
+bool WebApiWsLiveClass::isKnown(const known_states_t& known, const unit_hashes_t& units)
+{
+    return !known.empty() && std::all_of(known.begin(), known.end(), [&units](const unit_hashes_t* state) { return *state == units; });
+}
+
+void WebApiWsLiveClass::acknowledge(client_state_t& client, const uint32_t seq)
+{
+    // Messages are processed in order, so an ack covers all previous messages as well
+    while (!client.pending.empty() && client.pending.front().seq <= seq) {
+        for (auto& state : client.pending.front().states) {
+            client.acked[state.first] = std::move(state.second);
+        }
+        client.pending.pop_front();
+    }
+}
+
+/*
+ * Flattens src into a list of hashed units. Objects are descended into for
+ * the given number of levels, everything below is hashed as a whole. This way
+ * a changed field is transmitted including its unit and digits.
+ */
+void WebApiWsLiveClass::collectUnits(JsonObjectConst src, const uint32_t path, const uint8_t descend, unit_hashes_t& units)
+{
+    for (JsonPairConst kv : src) {
+        const uint32_t keyPath = getPathHash(path, kv.key().c_str());
+        if (descend > 0 && kv.value().is<JsonObjectConst>()) {
+            collectUnits(kv.value().as<JsonObjectConst>(), keyPath, descend - 1, units);
+            continue;
+        }
+
+        HashWriter writer;
+        serializeJson(kv.value(), writer);
+        units.push_back({ keyPath, writer.hash });
+    }
+
+    if (path == 0) {
+        std::sort(units.begin(), units.end(), [](const unit_hash_t& a, const unit_hash_t& b) { return a.path < b.path; });
+    }
+}
 
-            _ws.textAll(buffer);
+/*
+ * Copies all units of src to dst whose value is not the same in all states
+ * the client may currently show
+ */
+bool WebApiWsLiveClass::addChangedUnits(JsonObject dst, JsonObjectConst src, const uint32_t path, const uint8_t descend, const unit_hashes_t& current, const known_states_t& known)
+{
+    bool changed = false;
+
+    for (JsonPairConst kv : src) {
+        const uint32_t keyPath = getPathHash(path, kv.key().c_str());
+        if (descend > 0 && kv.value().is<JsonObjectConst>()) {
+            JsonObject child = dst[kv.key()].to<JsonObject>();
+            if (addChangedUnits(child, kv.value().as<JsonObjectConst>(), keyPath, descend - 1, current, known)) {
+                changed = true;
+            } else {
+                dst.remove(kv.key());
+            }
+            continue;
+        }
 
-        } catch (const std::bad_alloc& bad_alloc) {
-            MessageOutput.printf("Call to /api/livedata/status temporarely out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
-        } catch (const std::exception& exc) {
-            MessageOutput.printf("Unknown exception in /api/livedata/status. Reason: \"%s\".\r\n", exc.what());
+        const unit_hash_t* now = findUnit(current, keyPath);
+        const bool unchanged = now != nullptr && !known.empty() && std::all_of(known.begin(), known.end(), [now, keyPath](const unit_hashes_t* state) {
+            const unit_hash_t* before = findUnit(*state, keyPath);
+            return before != nullptr && before->value == now->value;
+        });
+        if (unchanged) {
+            continue;
         }
+
+        dst[kv.key()] = kv.value();
+        changed = true;
     }
+
+    return changed;
+}
+
+const WebApiWsLiveClass::unit_hash_t* WebApiWsLiveClass::findUnit(const unit_hashes_t& units, const uint32_t path)
+{
+    const auto it = std::lower_bound(units.begin(), units.end(), path, [](const unit_hash_t& unit, const uint32_t p) { return unit.path < p; });
+    return (it != units.end() && it->path == path) ? &(*it) : nullptr;
+}
+
+// The levels are separated by a slash
+uint32_t WebApiWsLiveClass::getPathHash(const uint32_t parent, const char* key)
+{
+    return Utils::getFnv1aHash(key, parent == 0 ? FNV1A_INITIAL_HASH : Utils::getFnv1aHash("/", parent));
 }
 
 void WebApiWsLiveClass::generateCommonJsonResponse(JsonVariant& root)
@@ -107,16 +486,34 @@ void WebApiWsLiveClass::generateCommonJsonResponse(JsonVariant& root)
     addTotalField(totalObj, "YieldDay", Datastore.getTotalAcYieldDayEnabled(), "Wh", Datastore.getTotalAcYieldDayDigits());
     addTotalField(totalObj, "YieldTotal", Datastore.getTotalAcYieldTotalEnabled(), "kWh", Datastore.getTotalAcYieldTotalDigits());
 
+    const uint8_t hints = getHints();
     JsonObject hintObj = root["hints"].to<JsonObject>();
-    struct tm timeinfo;
-    hintObj["time_sync"] = !getLocalTime(&timeinfo, 5);
-    hintObj["radio_problem"] = (Hoymiles.getRadioNrf()->isInitialized() && (!Hoymiles.getRadioNrf()->isConnected() || !Hoymiles.getRadioNrf()->isPVariant())) || (Hoymiles.getRadioCmt()->isInitialized() && (!Hoymiles.getRadioCmt()->isConnected()));
-    hintObj["default_password"] = strcmp(Configuration.get().Security.Password, ACCESS_POINT_PASSWORD) == 0;
+    hintObj["time_sync"] = (hints & WS_LIVE_HINT_TIME_SYNC) != 0;
+    hintObj["radio_problem"] = (hints & WS_LIVE_HINT_RADIO_PROBLEM) != 0;
+    hintObj["default_password"] = (hints & WS_LIVE_HINT_DEFAULT_PASSWORD) != 0;
+}
+
+uint8_t WebApiWsLiveClass::getHints()
+{
+    uint8_t hints = 0;
+
+    if (!WallClock.isSynced()) {
+        hints |= WS_LIVE_HINT_TIME_SYNC;
+    }
+    if ((Hoymiles.getRadioNrf()->isInitialized() && (!Hoymiles.getRadioNrf()->isConnected() || !Hoymiles.getRadioNrf()->isPVariant())) || (Hoymiles.getRadioCmt()->isInitialized() && (!Hoymiles.getRadioCmt()->isConnected()))) {
+        hints |= WS_LIVE_HINT_RADIO_PROBLEM;
+    }
+    if (strcmp(Configuration.getSnapshot()->get().Security.Password, ACCESS_POINT_PASSWORD) == 0) {
+        hints |= WS_LIVE_HINT_DEFAULT_PASSWORD;
+    }
+
+    return hints;
 }
 
 void WebApiWsLiveClass::generateInverterCommonJsonResponse(JsonObject& root, std::shared_ptr<InverterAbstract> inv)
 {
-    const INVERTER_CONFIG_T* inv_cfg = Configuration.getInverterConfig(inv->serial());
+    const ConfigSnapshotPtr config = Configuration.getSnapshot();
+    const INVERTER_CONFIG_T* inv_cfg = config->getInverterConfig(inv->serial());
     if (inv_cfg == nullptr) {
         return;
     }
@@ -138,7 +535,8 @@ void WebApiWsLiveClass::generateInverterCommonJsonResponse(JsonObject& root, std
 
 void WebApiWsLiveClass::generateInverterChannelJsonResponse(JsonObject& root, std::shared_ptr<InverterAbstract> inv)
 {
-    const INVERTER_CONFIG_T* inv_cfg = Configuration.getInverterConfig(inv->serial());
+    const ConfigSnapshotPtr config = Configuration.getSnapshot();
+    const INVERTER_CONFIG_T* inv_cfg = config->getInverterConfig(inv->serial());
     if (inv_cfg == nullptr) {
         return;
     }
@@ -181,6 +579,165 @@ void WebApiWsLiveClass::generateInverterChannelJsonResponse(JsonObject& root, st
     }
 }
 
+/*
+ * The binary format consists of a JSON schema message per inverter, which is
+ * sent once per connection and whenever it changes, and little endian frames:
+ *
+ * Inverter frame (type 1):
+ *   u8 type, u8 flags (poll_enabled, reachable, producing), u16 data_age,
+ *   u32 schema id, i32 limit_relative * 10, i32 limit_absolute * 10,
+ *   i32 events, followed by one i32 per schema field (value * 10^digits)
+ *
+ * Total frame (type 2):
+ *   u8 type, u8 hints (time_sync, radio_problem, default_password),
+ *   u8 digits of Power, YieldDay and YieldTotal, 3 bytes padding,
+ *   i32 Power, YieldDay and YieldTotal (value * 10^digits)
+ */
+void WebApiWsLiveClass::forEachLiveField(std::shared_ptr<InverterAbstract> inv, std::function<void(ChannelType_t, ChannelNum_t, FieldId_t, const char*)> cb)
+{
+    // Same fields and order as generateInverterChannelJsonResponse
+    static const FieldId_t liveFields[] = { FLD_PAC, FLD_UAC, FLD_IAC, FLD_PDC, FLD_UDC, FLD_IDC, FLD_YD, FLD_YT, FLD_F, FLD_T, FLD_PF, FLD_Q, FLD_EFF, FLD_IRR };
+
+    auto stats = inv->Statistics();
+    for (auto& t : stats->getChannelTypes()) {
+        for (auto& c : stats->getChannelsByType(t)) {
+            for (auto f : liveFields) {
+                if (!stats->hasChannelFieldValue(t, c, f)) {
+                    continue;
+                }
+                if (f == FLD_IRR && !(t == TYPE_DC && stats->getStringMaxPower(c) > 0)) {
+                    continue;
+                }
+                cb(t, c, f, (t == TYPE_INV && f == FLD_PDC) ? "Power DC" : stats->getChannelFieldName(t, c, f));
+            }
+        }
+    }
+}
+
+uint32_t WebApiWsLiveClass::getSchemaId(std::shared_ptr<InverterAbstract> inv)
+{
+    const ConfigSnapshotPtr config = Configuration.getSnapshot();
+    const INVERTER_CONFIG_T* inv_cfg = config->getInverterConfig(inv->serial());
+
+    HashWriter writer;
+    auto add = [&writer](const void* data, const size_t len) { writer.write(static_cast<const uint8_t*>(data), len); };
+
+    const uint64_t serial = inv->serial();
+    add(&serial, sizeof(serial));
+    add(inv->name(), strlen(inv->name()));
+    if (inv_cfg != nullptr) {
+        add(&inv_cfg->Order, sizeof(inv_cfg->Order));
+    }
+
+    forEachLiveField(inv, [&](ChannelType_t t, ChannelNum_t c, FieldId_t f, const char* name) {
+        const uint8_t field[] = { static_cast<uint8_t>(t), static_cast<uint8_t>(c), static_cast<uint8_t>(f), inv->Statistics()->getChannelFieldDigits(t, c, f) };
+        add(field, sizeof(field));
+    });
+
+    for (auto& c : inv->Statistics()->getChannelsByType(TYPE_DC)) {
+        if (inv_cfg != nullptr) {
+            add(inv_cfg->channel[c].Name, strlen(inv_cfg->channel[c].Name));
+        }
+        const uint16_t maxPower = inv->Statistics()->getStringMaxPower(c);
+        add(&maxPower, sizeof(maxPower));
+    }
+
+    return writer.hash;
+}
+
+String WebApiWsLiveClass::generateSchema(std::shared_ptr<InverterAbstract> inv, const uint32_t schemaId)
+{
+    const ConfigSnapshotPtr config = Configuration.getSnapshot();
+    const INVERTER_CONFIG_T* inv_cfg = config->getInverterConfig(inv->serial());
+
+    JsonDocument root;
+    JsonObject schema = root["schema"].to<JsonObject>();
+    schema["serial"] = inv->serialString();
+    schema["id"] = schemaId;
+    schema["name"] = inv->name();
+    schema["order"] = inv_cfg != nullptr ? inv_cfg->Order : 0;
+
+    JsonArray fieldArray = schema["fields"].to<JsonArray>();
+    forEachLiveField(inv, [&](ChannelType_t t, ChannelNum_t c, FieldId_t f, const char* name) {
+        JsonArray field = fieldArray.add<JsonArray>();
+        field.add(inv->Statistics()->getChannelTypeName(t));
+        field.add(String(static_cast<uint8_t>(c)));
+        field.add(name);
+        field.add(inv->Statistics()->getChannelFieldUnit(t, c, f));
+        field.add(inv->Statistics()->getChannelFieldDigits(t, c, f));
+    });
+
+    JsonObject strings = schema["strings"].to<JsonObject>();
+    for (auto& c : inv->Statistics()->getChannelsByType(TYPE_DC)) {
+        JsonObject string = strings[String(static_cast<uint8_t>(c))].to<JsonObject>();
+        string["name"] = inv_cfg != nullptr ? inv_cfg->channel[c].Name : "";
+        string["max"] = inv->Statistics()->getStringMaxPower(c);
+    }
+
+    String buffer;
+    serializeJson(root, buffer);
+    return buffer;
+}
+
+static void appendInt32(std::vector<uint8_t>& frame, const int32_t value)
+{
+    const uint32_t v = static_cast<uint32_t>(value);
+    frame.push_back(v & 0xff);
+    frame.push_back((v >> 8) & 0xff);
+    frame.push_back((v >> 16) & 0xff);
+    frame.push_back((v >> 24) & 0xff);
+}
+
+std::vector<uint8_t> WebApiWsLiveClass::generateInverterFrame(std::shared_ptr<InverterAbstract> inv, const uint32_t schemaId)
+{
+    std::vector<uint8_t> frame;
+    frame.reserve(20 + 4 * 32);
+
+    const uint8_t flags = (inv->getEnablePolling() ? 0x01 : 0)
+        | (inv->isReachable() ? 0x02 : 0)
+        | (inv->isProducing() ? 0x04 : 0);
+    const uint16_t dataAge = std::min<uint32_t>((millis() - inv->Statistics()->getLastUpdate()) / 1000, UINT16_MAX);
+
+    frame.push_back(WS_LIVE_FRAME_INVERTER);
+    frame.push_back(flags);
+    frame.push_back(dataAge & 0xff);
+    frame.push_back(dataAge >> 8);
+    appendInt32(frame, static_cast<int32_t>(schemaId));
+
+    const float limitRelative = inv->SystemConfigPara()->getLimitPercent();
+    appendInt32(frame, lroundf(limitRelative * 10));
+    if (inv->DevInfo()->getMaxPower() > 0) {
+        appendInt32(frame, lroundf(limitRelative * inv->DevInfo()->getMaxPower() / 10.0));
+    } else {
+        appendInt32(frame, -10);
+    }
+
+    if (inv->Statistics()->hasChannelFieldValue(TYPE_INV, CH0, FLD_EVT_LOG)) {
+        appendInt32(frame, inv->EventLog()->getEntryCount());
+    } else {
+        appendInt32(frame, -1);
+    }
+
+    forEachLiveField(inv, [&](ChannelType_t t, ChannelNum_t c, FieldId_t f, const char* name) {
+        appendInt32(frame, inv->Statistics()->getChannelFieldFixedPoint(t, c, f));
+    });
+
+    return frame;
+}
+
+std::vector<uint8_t> WebApiWsLiveClass::generateTotalFrame()
+{
+    const uint8_t digits[] = { Datastore.getTotalAcPowerDigits(), Datastore.getTotalAcYieldDayDigits(), Datastore.getTotalAcYieldTotalDigits() };
+    const float values[] = { Datastore.getTotalAcPowerEnabled(), Datastore.getTotalAcYieldDayEnabled(), Datastore.getTotalAcYieldTotalEnabled() };
+
+    std::vector<uint8_t> frame = { WS_LIVE_FRAME_TOTAL, getHints(), digits[0], digits[1], digits[2], 0, 0, 0 };
+    for (uint8_t i = 0; i < 3; i++) {
+        appendInt32(frame, lroundf(values[i] * powf(10, digits[i])));
+    }
+
+    return frame;
+}
+
 void WebApiWsLiveClass::addField(JsonObject& root, std::shared_ptr<InverterAbstract> inv, const ChannelType_t type, const ChannelNum_t channel, const FieldId_t fieldId, String topic)
 {
     if (inv->Statistics()->hasChannelFieldValue(type, channel, fieldId)) {
@@ -207,11 +764,111 @@ void WebApiWsLiveClass::addTotalField(JsonObject& root, const String& name, cons
 
 void WebApiWsLiveClass::onWebsocketEvent(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len)
 {
+    HeapTagScope heapTag(HeapTag::Websocket);
+
     if (type == WS_EVT_CONNECT) {
-        MessageOutput.printf("Websocket: [%s][%u] connect\r\n", server->url(), client->id());
+        MessageOutput.log(LogTag::Web, LogLevel::Info, "Websocket: [%s][%u] connect\r\n", server->url(), client->id());
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _clients.emplace_back();
+        _clients.back().id = client->id();
     } else if (type == WS_EVT_DISCONNECT) {
-        MessageOutput.printf("Websocket: [%s][%u] disconnect\r\n", server->url(), client->id());
+        MessageOutput.log(LogTag::Web, LogLevel::Info, "Websocket: [%s][%u] disconnect\r\n", server->url(), client->id());
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _clients.remove_if([client](const client_state_t& c) { return c.id == client->id(); });
+    } else if (type == WS_EVT_DATA) {
+        // Control messages are small, fragmented frames are ignored
+        const AwsFrameInfo* info = static_cast<AwsFrameInfo*>(arg);
+        if (info->final && info->index == 0 && info->len == len && info->opcode == WS_TEXT) {
+            onWebsocketData(client, data, len);
+        }
+    }
+}
+
+/*
+ * Clients which send {"subscribe":["<serial>",...]} (an empty list means all
+ * inverters) receive a full snapshot followed by deltas which only contain
+ * the values changed since the state acknowledged by {"ack":<seq>}.
+ * With "format":"binary" the client receives binary frames instead.
+ * Clients which never subscribe receive the complete data of an inverter on
+ * every update as before.
+ */
+void WebApiWsLiveClass::onWebsocketData(AsyncWebSocketClient* client, const uint8_t* data, const size_t len)
+{
+    // Keep alive of the web application
+    if (len == 4 && memcmp(data, "ping", 4) == 0) {
+        return;
+    }
+
+    JsonDocument doc;
+    if (deserializeJson(doc, data, len) != DeserializationError::Ok) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto it = std::find_if(_clients.begin(), _clients.end(), [client](const client_state_t& c) { return c.id == client->id(); });
+    if (it == _clients.end()) {
+        return;
     }
+
+    if (doc["subscribe"].is<JsonArrayConst>()) {
+        it->format = doc["format"] == "binary" ? WsLiveFormat::Binary : WsLiveFormat::Delta;
+        it->serials.clear();
+        for (JsonVariantConst serial : doc["subscribe"].as<JsonArrayConst>()) {
+            it->serials.push_back(strtoll(serial.as<String>().c_str(), NULL, 16));
+        }
+        it->acked.clear();
+        it->pending.clear();
+        it->schemas.clear();
+    }
+
+    if (doc["ack"].is<uint32_t>()) {
+        acknowledge(*it, doc["ack"].as<uint32_t>());
+    }
+}
+
+/*
+ * data_age changes every second without any new data. The ETag is therefore
+ * weak and only covers the values the response is derived from.
+ */
+String WebApiWsLiveClass::getLivedataETag(const uint64_t serial)
+{
+    HashWriter writer;
+    auto add = [&writer](const uint32_t value) { writer.write(reinterpret_cast<const uint8_t*>(&value), sizeof(value)); };
+
+    add(Configuration.getSnapshot()->get().Cfg.SaveCount);
+    add(getHints());
+    add(static_cast<uint32_t>(serial >> 32));
+    add(static_cast<uint32_t>(serial));
+
+    // The totals cover all inverters and are updated by the Datastore up to
+    // a second after the statistics of an inverter
+    const uint8_t digits[] = { Datastore.getTotalAcPowerDigits(), Datastore.getTotalAcYieldDayDigits(), Datastore.getTotalAcYieldTotalDigits() };
+    const float values[] = { Datastore.getTotalAcPowerEnabled(), Datastore.getTotalAcYieldDayEnabled(), Datastore.getTotalAcYieldTotalEnabled() };
+    for (uint8_t i = 0; i < 3; i++) {
+        add(digits[i]);
+        add(lroundf(values[i] * powf(10, digits[i])));
+    }
+
+    const InverterListPtr inverters = Hoymiles.getInverters();
+    for (auto& inv : *inverters) {
+        if (serial > 0 && inv->serial() != serial) {
+            continue;
+        }
+
+        add(static_cast<uint32_t>(inv->serial()));
+        add(inv->Statistics()->getLastUpdate());
+        add(inv->Statistics()->getLastUpdateFromInternal());
+        add(inv->SystemConfigPara()->getLastUpdate());
+        add(lroundf(inv->SystemConfigPara()->getLimitPercent() * 10));
+        add(inv->DevInfo()->getMaxPower());
+        add(inv->EventLog()->getEntryCount());
+        add((inv->getEnablePolling() ? 0x01 : 0) | (inv->isReachable() ? 0x02 : 0) | (inv->isProducing() ? 0x04 : 0));
+    }
+
+    return WebApi.getETag({ writer.hash }, true);
 }
 
 void WebApiWsLiveClass::onLivedataStatus(AsyncWebServerRequest* request)
@@ -221,41 +878,87 @@ void WebApiWsLiveClass::onLivedataStatus(AsyncWebServerRequest* request)
     }
 
     try {
-        std::lock_guard<std::mutex> lock(_mutex);
-        AsyncJsonResponse* response = new AsyncJsonResponse();
-        auto& root = response->getRoot();
-        auto invArray = root["inverters"].to<JsonArray>();
         auto serial = WebApi.parseSerialFromRequest(request);
 
+        String etag;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            etag = getLivedataETag(serial);
+        }
+        if (WebApi.checkNotModified(request, etag)) {
+            return;
+        }
+
+        // A single inverter is sent with its channel data
+        InverterListPtr inverters;
         if (serial > 0) {
             auto inv = Hoymiles.getInverterBySerial(serial);
-            if (inv != nullptr) {
-                JsonObject invObject = invArray.add<JsonObject>();
-                generateInverterCommonJsonResponse(invObject, inv);
-                generateInverterChannelJsonResponse(invObject, inv);
-            }
+            inverters = std::make_shared<const InverterList>(inv != nullptr ? InverterList { inv } : InverterList {});
         } else {
-            // Loop all inverters
-            for (uint8_t i = 0; i < Hoymiles.getNumInverters(); i++) {
-                auto inv = Hoymiles.getInverterByPos(i);
-                if (inv == nullptr) {
-                    continue;
+            inverters = Hoymiles.getInverters();
+        }
+        const bool withChannels = serial > 0;
+
+        // The response is streamed inverter by inverter, so only one
+        // inverter document is held in memory at a time. -1 writes the
+        // head of the document.
+        int16_t index = -1;
+
+        GzipResponse response(request, "application/json");
+        response.addHeader("ETag", etag);
+        response.sendJson([this, inverters, withChannels, index](JsonStreamWriter& writer) mutable {
+            try {
+                std::lock_guard<std::mutex> lock(_mutex);
+
+                if (index < 0) {
+                    writer.beginObject();
+                    writer.beginArray("inverters");
+                } else if (index < static_cast<int16_t>(inverters->size())) {
+                    auto inv = (*inverters)[index];
+
+                    JsonDocument invDoc;
+                    JsonObject invObject = invDoc.to<JsonObject>();
+                    generateInverterCommonJsonResponse(invObject, inv);
+                    if (withChannels) {
+                        generateInverterChannelJsonResponse(invObject, inv);
+                    }
+                    if (!Utils::checkJsonAlloc(invDoc, __FUNCTION__, __LINE__)) {
+                        writer.fail();
+                        return false;
+                    }
+                    writer.add(invDoc.as<JsonVariantConst>());
                 }
 
-                JsonObject invObject = invArray.add<JsonObject>();
-                generateInverterCommonJsonResponse(invObject, inv);
-            }
-        }
+                if (++index < static_cast<int16_t>(inverters->size())) {
+                    return true;
+                }
 
-        generateCommonJsonResponse(root);
+                writer.endArray();
 
-        WebApi.sendJsonResponse(request, response, __FUNCTION__, __LINE__);
+                JsonDocument commonDoc;
+                JsonVariant commonVar = commonDoc;
+                generateCommonJsonResponse(commonVar);
+                if (!Utils::checkJsonAlloc(commonDoc, __FUNCTION__, __LINE__)) {
+                    writer.fail();
+                    return false;
+                }
+                writer.addMembers(commonDoc.as<JsonObjectConst>());
+
+                writer.endObject();
+                return false;
+
+            } catch (const std::bad_alloc& bad_alloc) {
+                MessageOutput.log(LogTag::Web, LogLevel::Error, "Call to /api/livedata/status temporarely out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
+                writer.fail();
+                return false;
+            }
+        });
 
     } catch (const std::bad_alloc& bad_alloc) {
-        MessageOutput.printf("Call to /api/livedata/status temporarely out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
+        MessageOutput.log(LogTag::Web, LogLevel::Error, "Call to /api/livedata/status temporarely out of resources. Reason: \"%s\".\r\n", bad_alloc.what());
         WebApi.sendTooManyRequests(request);
     } catch (const std::exception& exc) {
-        MessageOutput.printf("Unknown exception in /api/livedata/status. Reason: \"%s\".\r\n", exc.what());
+        MessageOutput.log(LogTag::Web, LogLevel::Error, "Unknown exception in /api/livedata/status. Reason: \"%s\".\r\n", exc.what());
         WebApi.sendTooManyRequests(request);
     }
 }
@@ -2,9 +2,11 @@
 /*
  * Copyright (C) 2022-2024 Thomas Basler and others
  */
+#include "AlarmHistory.h"
 #include "Configuration.h"
 #include "Datastore.h"
 #include "Display_Graphic.h"
+#include "HeapMonitor.h"
 #include "InverterSettings.h"
 #include "Led_Single.h"
 #include "MessageOutput.h"
@@ -18,10 +20,12 @@
 #include "PinMapping.h"
 #include "Scheduler.h"
 #include "SunPosition.h"
+#include "TaskProfiler.h"
 #include "Utils.h"
 #include "WebApi.h"
 #include "defaults.h"
 #include <Arduino.h>
+#include <HeapAccounting.h>
 #include <LittleFS.h>
 #include <TaskScheduler.h>
 #include <esp_heap_caps.h>
@@ -44,6 +48,17 @@ void setup()
     MessageOutput.println();
     MessageOutput.println("Starting OpenDTU");
 
+#ifdef HEAP_ACCOUNTING
+    MessageOutput.print("Initialize heap accounting... ");
+    if (HeapAccounting.init()) {
+        // The web server handles all requests in its own task
+        HeapAccounting.setTaskDefault("async_tcp", HeapTag::WebApi);
+        MessageOutput.println("done");
+    } else {
+        MessageOutput.println("failed");
+    }
+#endif
+
     // Initialize file system
     MessageOutput.print("Initialize FS... ");
     if (!LittleFS.begin(false)) { // Do not format if mount failed
@@ -73,6 +88,7 @@ void setup()
         Configuration.migrate();
     }
     auto& config = Configuration.get();
+    Configuration.initWriteTask(scheduler);
     MessageOutput.println("done");
 
     // Load PinMapping
@@ -93,7 +109,7 @@ void setup()
 
     // Initialize NTP
     MessageOutput.print("Initialize NTP... ");
-    NtpSettings.init();
+    NtpSettings.init(scheduler);
     MessageOutput.println("done");
 
     // Initialize SunPosition
@@ -103,7 +119,7 @@ void setup()
 
     // Initialize MqTT
     MessageOutput.print("Initialize MqTT... ");
-    MqttSettings.init();
+    MqttSettings.init(scheduler);
     MqttHandleDtu.init(scheduler);
     MqttHandleInverter.init(scheduler);
     MqttHandleInverterTotal.init(scheduler);
@@ -154,9 +170,18 @@ void setup()
     InverterSettings.init(scheduler);
 
     Datastore.init(scheduler);
+
+    AlarmHistory.init(scheduler);
+
+    HeapMonitor.init(scheduler);
+
+    TaskProfiler.init();
+    SchedulerIdle.init();
 }
 
 void loop()
 {
-    scheduler.execute();
+    const bool idleRun = scheduler.execute();
+    TaskProfiler.loop();
+    SchedulerIdle.loop(idleRun);
 }
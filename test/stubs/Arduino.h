@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+// Minimal stand-in for the parts of the Arduino core used by the libraries
+// which are tested on the host. Only what the tests need is implemented.
+
+#include "Print.h"
+#include "WString.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+
+#define DEC 10
+#define HEX 16
+
+#define RISING 0x01
+#define FALLING 0x02
+
+#define IRAM_ATTR
+#define ARDUINO_ISR_ATTR
+
+using std::max;
+using std::min;
+
+inline unsigned long micros()
+{
+    static const auto start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline unsigned long millis()
+{
+    return micros() / 1000;
+}
+
+inline void delay(const uint32_t ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+inline void delayMicroseconds(const uint32_t us)
+{
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+inline void yield()
+{
+    std::this_thread::yield();
+}
+
+inline void pinMode(uint8_t, uint8_t)
+{
+}
+
+inline void digitalWrite(uint8_t, uint8_t)
+{
+}
+
+inline int digitalRead(uint8_t)
+{
+    return LOW;
+}
+
+inline int digitalPinToInterrupt(const uint8_t pin)
+{
+    return pin;
+}
+
+inline void detachInterrupt(uint8_t)
+{
+}
+
+// Writes to stdout
+class HardwareSerial : public Print {
+public:
+    size_t write(const uint8_t* buffer, size_t size) override
+    {
+        return fwrite(buffer, 1, size, stdout);
+    }
+};
+
+inline HardwareSerial Serial;
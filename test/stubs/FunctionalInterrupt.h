@@ -0,0 +1,10 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+// Interrupts never fire on the host
+inline void attachInterrupt(uint8_t, std::function<void(void)>, int)
+{
+}
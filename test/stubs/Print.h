@@ -0,0 +1,67 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "WString.h"
+#include <algorithm>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+// Formatting is done with printf, derived classes only implement write()
+class Print {
+public:
+    virtual ~Print() = default;
+
+    virtual size_t write(const uint8_t* buffer, size_t size) = 0;
+
+    virtual size_t write(uint8_t c)
+    {
+        return write(&c, 1);
+    }
+
+    size_t write(const char* str)
+    {
+        return write(reinterpret_cast<const uint8_t*>(str), strlen(str));
+    }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        char buffer[512];
+        va_list args;
+        va_start(args, format);
+        const int len = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        return len > 0 ? write(reinterpret_cast<const uint8_t*>(buffer), std::min<size_t>(len, sizeof(buffer) - 1)) : 0;
+    }
+
+    size_t print(const String& s) { return write(s.c_str()); }
+    size_t print(const char* s) { return write(s); }
+    size_t print(const char c) { return write(static_cast<uint8_t>(c)); }
+    size_t print(const int n) { return print(String(n)); }
+    size_t print(const unsigned int n) { return print(String(n)); }
+    size_t print(const long n) { return print(String(n)); }
+    size_t print(const unsigned long n) { return print(String(n)); }
+    size_t print(const double n, const int digits = 2) { return print(String(n, digits)); }
+
+    size_t print(const uint64_t n, const int base)
+    {
+        char buffer[24];
+        snprintf(buffer, sizeof(buffer), base == 16 ? "%llX" : "%llu", static_cast<unsigned long long>(n));
+        return write(buffer);
+    }
+
+    size_t println() { return write("\r\n"); }
+
+    template <typename T>
+    size_t println(const T& value)
+    {
+        return print(value) + println();
+    }
+
+    template <typename T>
+    size_t println(const T& value, const int base)
+    {
+        return print(value, base) + println();
+    }
+};
@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "Arduino.h"
+#include "SPI.h"
+#include <cstdint>
+
+typedef enum {
+    RF24_PA_MIN = 0,
+    RF24_PA_LOW,
+    RF24_PA_HIGH,
+    RF24_PA_MAX,
+    RF24_PA_ERROR
+} rf24_pa_dbm_e;
+
+typedef enum {
+    RF24_1MBPS = 0,
+    RF24_2MBPS,
+    RF24_250KBPS
+} rf24_datarate_e;
+
+typedef enum {
+    RF24_CRC_DISABLED = 0,
+    RF24_CRC_8,
+    RF24_CRC_16
+} rf24_crclength_e;
+
+// Radio without a chip, nothing is ever received
+class RF24 {
+public:
+    RF24(uint16_t, uint16_t) { }
+
+    bool begin(SPIClass*) { return true; }
+    bool isChipConnected() { return false; }
+    bool isPVariant() { return true; }
+
+    void startListening() { }
+    void stopListening() { }
+    bool available() { return false; }
+    void read(void*, uint8_t) { }
+    bool write(const void*, uint8_t) { return true; }
+    void flush_rx() { }
+    bool testRPD() { return false; }
+
+    void openReadingPipe(uint8_t, uint64_t) { }
+    void openWritingPipe(uint64_t) { }
+
+    void setChannel(uint8_t channel) { _channel = channel; }
+    uint8_t getChannel() { return _channel; }
+    uint8_t getDynamicPayloadSize() { return 0; }
+
+    void setPALevel(uint8_t, bool = true) { }
+    bool setDataRate(rf24_datarate_e) { return true; }
+    void setCRCLength(rf24_crclength_e) { }
+    void setAddressWidth(uint8_t) { }
+    void setRetries(uint8_t, uint8_t) { }
+    void enableDynamicPayloads() { }
+    void maskIRQ(bool, bool, bool) { }
+
+private:
+    uint8_t _channel = 0;
+};
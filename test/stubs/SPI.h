@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <cstdint>
+
+class SPIClass {
+public:
+    explicit SPIClass(const uint8_t bus = 0)
+        : _bus(bus)
+    {
+    }
+
+    void begin(int8_t = -1, int8_t = -1, int8_t = -1, int8_t ss = -1)
+    {
+        _ss = ss;
+    }
+
+    void end()
+    {
+    }
+
+    int8_t pinSS() const
+    {
+        return _ss;
+    }
+
+private:
+    uint8_t _bus;
+    int8_t _ss = -1;
+};
@@ -0,0 +1,126 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// Arduino String on top of std::string
+class String : public std::string {
+public:
+    String() = default;
+    String(const char* s) : std::string(s != nullptr ? s : "") { }
+    String(const std::string& s) : std::string(s) { }
+    explicit String(const char c) : std::string(1, c) { }
+    String(const int n, const unsigned char base = 10) : std::string(toString(n, base)) { }
+    String(const unsigned int n, const unsigned char base = 10) : std::string(toString(n, base)) { }
+    String(const long n, const unsigned char base = 10) : std::string(toString(n, base)) { }
+    String(const unsigned long n, const unsigned char base = 10) : std::string(toString(n, base)) { }
+    String(const long long n, const unsigned char base = 10) : std::string(toString(n, base)) { }
+    String(const unsigned long long n, const unsigned char base = 10) : std::string(toString(n, base)) { }
+    String(const unsigned char n, const unsigned char base = 10) : std::string(toString(n, base)) { }
+    String(const float n, const unsigned int digits = 2) : std::string(toString(static_cast<double>(n), digits)) { }
+    String(const double n, const unsigned int digits = 2) : std::string(toString(n, digits)) { }
+
+    unsigned int length() const { return size(); }
+
+    bool equals(const String& s) const { return *this == s; }
+
+    String& concat(const String& s)
+    {
+        append(s);
+        return *this;
+    }
+
+    String substring(const unsigned int from) const { return from < size() ? String(substr(from)) : String(); }
+    String substring(const unsigned int from, const unsigned int to) const { return from < size() ? String(substr(from, to - from)) : String(); }
+
+    int indexOf(const char c, const unsigned int from = 0) const
+    {
+        const size_t pos = find(c, from);
+        return pos == npos ? -1 : static_cast<int>(pos);
+    }
+
+    int indexOf(const String& s, const unsigned int from = 0) const
+    {
+        const size_t pos = find(s, from);
+        return pos == npos ? -1 : static_cast<int>(pos);
+    }
+
+    void replace(const String& from, const String& to)
+    {
+        for (size_t pos = find(from); pos != npos && !from.empty(); pos = find(from, pos + to.size())) {
+            std::string::replace(pos, from.size(), to);
+        }
+    }
+
+    void toLowerCase()
+    {
+        for (auto& c : *this) {
+            c = std::tolower(static_cast<unsigned char>(c));
+        }
+    }
+
+    void toUpperCase()
+    {
+        for (auto& c : *this) {
+            c = std::toupper(static_cast<unsigned char>(c));
+        }
+    }
+
+    void trim()
+    {
+        const size_t first = find_first_not_of(" \t\r\n");
+        const size_t last = find_last_not_of(" \t\r\n");
+        *this = first == npos ? String() : String(substr(first, last - first + 1));
+    }
+
+    long toInt() const { return strtol(c_str(), nullptr, 10); }
+    float toFloat() const { return strtof(c_str(), nullptr); }
+
+private:
+    template <typename T>
+    static std::string toString(const T n, const unsigned char base)
+    {
+        if (base == 10) {
+            return std::to_string(n);
+        }
+        std::string s;
+        unsigned long long v = static_cast<unsigned long long>(n);
+        do {
+            const unsigned digit = v % base;
+            s.insert(s.begin(), static_cast<char>(digit < 10 ? '0' + digit : 'A' + digit - 10));
+            v /= base;
+        } while (v > 0);
+        return s;
+    }
+
+    static std::string toString(const double n, const unsigned int digits)
+    {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "%.*f", digits, n);
+        return buffer;
+    }
+};
+
+inline String operator+(const String& a, const String& b)
+{
+    String s(a);
+    s.append(b);
+    return s;
+}
+
+inline String operator+(const String& a, const char* b)
+{
+    String s(a);
+    s.append(b);
+    return s;
+}
+
+inline String operator+(const char* a, const String& b)
+{
+    String s(a);
+    s.append(b);
+    return s;
+}
@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+// Replaces lib/CMT2300a, which needs the ESP-IDF SPI driver. The interface
+// matches cmt2300wrapper.h of the library.
+
+#include <cstdint>
+
+#define CMT2300A_ONE_STEP_SIZE 2500
+#define FH_OFFSET 100
+#define CMT_SPI_SPEED 4000000
+
+#define CMT_BASE_FREQ_900 900000000
+#define CMT_BASE_FREQ_860 860000000
+
+enum FrequencyBand_t {
+    BAND_860,
+    BAND_900,
+    FrequencyBand_Max,
+};
+
+// Radio without a chip, nothing is ever received
+class CMT2300A {
+public:
+    CMT2300A(const uint8_t, const uint8_t, const uint8_t, const uint8_t, const uint32_t = CMT_SPI_SPEED) { }
+
+    bool begin(void) { return true; }
+    bool isChipConnected() { return false; }
+
+    bool startListening(void) { return true; }
+    bool stopListening(void) { return true; }
+    bool available(void) { return false; }
+    void read(void*, const uint8_t) { }
+    bool write(const uint8_t*, const uint8_t) { return true; }
+
+    void setChannel(const uint8_t channel) { _channel = channel; }
+    uint8_t getChannel(void) { return _channel; }
+    uint8_t getDynamicPayloadSize(void) { return 0; }
+    int getRssiDBm() { return -100; }
+    bool setPALevel(const int8_t) { return true; }
+    bool rxFifoAvailable() { return false; }
+
+    uint32_t getBaseFrequency() const { return getBaseFrequency(_frequencyBand); }
+    static constexpr uint32_t getBaseFrequency(FrequencyBand_t band)
+    {
+        return band == FrequencyBand_t::BAND_900 ? CMT_BASE_FREQ_900 : CMT_BASE_FREQ_860;
+    }
+
+    FrequencyBand_t getFrequencyBand() const { return _frequencyBand; }
+    void setFrequencyBand(const FrequencyBand_t mode) { _frequencyBand = mode; }
+
+    void flush_rx(void) { }
+
+private:
+    uint8_t _channel = 0;
+    FrequencyBand_t _frequencyBand = FrequencyBand_t::BAND_860;
+};
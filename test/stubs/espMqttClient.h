@@ -0,0 +1,21 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+// Types of espMqttClient used by the libraries under test
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace espMqttClientTypes {
+
+struct MessageProperties {
+    uint8_t qos;
+    bool dup;
+    bool retain;
+    uint16_t packetId;
+};
+
+typedef std::function<void(const MessageProperties& properties, const char* topic, const uint8_t* payload, size_t len, size_t index, size_t total)> OnMessageCallback;
+
+} // namespace espMqttClientTypes
@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+#include "FreeRTOS.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+// Mutex semaphores, they are never deleted. Like in FreeRTOS giving a
+// semaphore which is not taken fails.
+struct Semaphore_t {
+    std::mutex mutex;
+    std::condition_variable released;
+    bool taken = false;
+};
+typedef Semaphore_t* SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    return new Semaphore_t;
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, const TickType_t ticks)
+{
+    std::unique_lock<std::mutex> lock(semaphore->mutex);
+    const auto isFree = [semaphore]() { return !semaphore->taken; };
+    if (ticks == portMAX_DELAY) {
+        semaphore->released.wait(lock, isFree);
+    } else if (!semaphore->released.wait_for(lock, std::chrono::milliseconds(ticks), isFree)) {
+        return pdFALSE;
+    }
+    semaphore->taken = true;
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    {
+        std::lock_guard<std::mutex> lock(semaphore->mutex);
+        if (!semaphore->taken) {
+            return pdFALSE;
+        }
+        semaphore->taken = false;
+    }
+    semaphore->released.notify_one();
+    return pdTRUE;
+}
@@ -0,0 +1,4 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+// Only included next to RF24.h, the register names are not used
@@ -0,0 +1,357 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2024 Thomas Basler and others
+ */
+#include <Hoymiles.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <unity.h>
+#include <vector>
+
+struct TestEntry_t {
+    uint8_t MessageId;
+    bool StartPm;
+    bool EndPm;
+    uint16_t Start;
+    uint16_t End;
+};
+
+// Known and unknown ids, with and without an end time and the PM flags
+static const TestEntry_t testEntries[ALARM_LOG_ENTRY_COUNT] = {
+    { 1, false, false, 100, 200 },
+    { 2, true, true, 3600, 7200 },
+    { 4, false, true, 40000, 1000 },
+    { 11, true, false, 1, 0 },
+    { 12, false, false, 43199, 43199 },
+    { 47, true, true, 0, 1 },
+    { 71, false, false, 500, 0 },
+    { 95, false, false, 12000, 13000 },
+    { 121, true, true, 2000, 2100 },
+    { 124, false, false, 3000, 3100 },
+    { 125, false, false, 4000, 0 },
+    { 141, true, false, 5000, 5100 },
+    { 142, false, false, 6000, 6100 },
+    { 200, false, false, 7000, 7100 },
+    { 0, false, false, 0, 0 },
+};
+
+static uint8_t fillPayload(uint8_t* payload)
+{
+    memset(payload, 0, ALARM_LOG_PAYLOAD_SIZE);
+    for (uint8_t i = 0; i < ALARM_LOG_ENTRY_COUNT; i++) {
+        const TestEntry_t& e = testEntries[i];
+        uint8_t* entry = &payload[2 + i * ALARM_LOG_ENTRY_SIZE];
+        entry[0] = (e.StartPm ? 0x20 : 0) | (e.EndPm ? 0x10 : 0);
+        entry[1] = e.MessageId;
+        entry[4] = e.Start >> 8;
+        entry[5] = e.Start & 0xff;
+        entry[6] = e.End >> 8;
+        entry[7] = e.End & 0xff;
+    }
+    return 2 + ALARM_LOG_ENTRY_COUNT * ALARM_LOG_ENTRY_SIZE;
+}
+
+static void receive(AlarmLogParser& parser)
+{
+    uint8_t payload[ALARM_LOG_PAYLOAD_SIZE];
+    const uint8_t len = fillPayload(payload);
+    parser.clearBuffer();
+    parser.beginAppendFragment();
+    parser.appendFragment(0, payload, len);
+    parser.endAppendFragment();
+}
+
+static void setTimezone(const char* timezone)
+{
+    setenv("TZ", timezone, 1);
+    tzset();
+    AlarmLogParser::resetTimezoneOffset();
+}
+
+// Type, message id and index of every entry of the message table, in the
+// order of the table
+struct KnownMessage_t {
+    AlarmMessageType_t InverterType;
+    uint16_t MessageId;
+    uint8_t MessageIndex;
+};
+
+static std::vector<KnownMessage_t> knownMessages()
+{
+    AlarmLogParser all;
+    AlarmLogParser hmt;
+    hmt.setMessageType(AlarmMessageType_t::HMT);
+
+    std::vector<KnownMessage_t> messages;
+    for (uint32_t id = 0; id <= UINT16_MAX; id++) {
+        const uint8_t allIndex = all.getMessageIndex(id);
+        const uint8_t hmtIndex = hmt.getMessageIndex(id);
+        if (allIndex != ALARM_MSG_UNKNOWN) {
+            messages.push_back({ AlarmMessageType_t::ALL, static_cast<uint16_t>(id), allIndex });
+        }
+        if (hmtIndex != allIndex) {
+            messages.push_back({ AlarmMessageType_t::HMT, static_cast<uint16_t>(id), hmtIndex });
+        }
+    }
+    std::sort(messages.begin(), messages.end(), [](const KnownMessage_t& a, const KnownMessage_t& b) {
+        return a.MessageIndex < b.MessageIndex;
+    });
+    return messages;
+}
+
+// Search of the message table as it was done before the lookup map
+static uint8_t referenceMessageIndex(const std::vector<KnownMessage_t>& messages, const AlarmMessageType_t type, const uint16_t messageId)
+{
+    uint8_t index = ALARM_MSG_UNKNOWN;
+    for (const auto& msg : messages) {
+        if (msg.MessageId == messageId) {
+            if (msg.InverterType == type) {
+                return msg.MessageIndex;
+            } else if (msg.InverterType == AlarmMessageType_t::ALL) {
+                index = msg.MessageIndex;
+            }
+        }
+    }
+    return index;
+}
+
+// Entry as it was rendered before the entries were decoded on reception:
+// timezone lookup, payload decoding, table scan and a String per entry
+struct ReferenceEntry_t {
+    uint16_t MessageId;
+    String Message;
+    time_t StartTime;
+    time_t EndTime;
+};
+
+static void referenceLogEntry(const uint8_t* payload, const uint8_t entryId, const std::vector<KnownMessage_t>& messages, ReferenceEntry_t& entry)
+{
+    const uint8_t entryStartOffset = 2 + entryId * ALARM_LOG_ENTRY_SIZE;
+
+    time_t rawtime = time(NULL);
+    struct tm gbuf;
+    struct tm* ptm = gmtime_r(&rawtime, &gbuf);
+    ptm->tm_isdst = -1;
+    const int timezoneOffset = static_cast<int>(difftime(rawtime, mktime(ptm)));
+
+    const uint32_t wcode = (uint16_t)payload[entryStartOffset] << 8 | payload[entryStartOffset + 1];
+    const uint32_t startTimeOffset = ((wcode >> 13) & 0x01) == 1 ? 12 * 60 * 60 : 0;
+    const uint32_t endTimeOffset = ((wcode >> 12) & 0x01) == 1 ? 12 * 60 * 60 : 0;
+
+    entry.MessageId = payload[entryStartOffset + 1];
+    entry.StartTime = (((uint16_t)payload[entryStartOffset + 4] << 8) | ((uint16_t)payload[entryStartOffset + 5])) + startTimeOffset + timezoneOffset;
+    entry.EndTime = ((uint16_t)payload[entryStartOffset + 6] << 8) | ((uint16_t)payload[entryStartOffset + 7]);
+    if (entry.EndTime > 0) {
+        entry.EndTime += (endTimeOffset + timezoneOffset);
+    }
+
+    entry.Message = AlarmLogParser::getMessage(referenceMessageIndex(messages, AlarmMessageType_t::ALL, entry.MessageId), AlarmMessageLocale_t::DE);
+}
+
+void setUp(void)
+{
+    setTimezone("UTC0");
+}
+
+void tearDown(void)
+{
+}
+
+void test_entries_are_decoded(void)
+{
+    setTimezone("CET-1");
+
+    AlarmLogParser parser;
+    receive(parser);
+    TEST_ASSERT_EQUAL(ALARM_LOG_ENTRY_COUNT, parser.getEntryCount());
+
+    for (uint8_t i = 0; i < ALARM_LOG_ENTRY_COUNT; i++) {
+        const TestEntry_t& e = testEntries[i];
+        AlarmLogEntry_t entry;
+        parser.getLogEntry(i, entry, AlarmMessageLocale_t::DE);
+
+        TEST_ASSERT_EQUAL(e.MessageId, entry.MessageId);
+        TEST_ASSERT_EQUAL(e.Start + (e.StartPm ? 43200 : 0) + 3600, entry.StartTime);
+        TEST_ASSERT_EQUAL(e.End > 0 ? e.End + (e.EndPm ? 43200 : 0) + 3600 : 0, entry.EndTime);
+    }
+
+    AlarmLogEntry_t entry;
+    parser.getLogEntry(0, entry, AlarmMessageLocale_t::DE);
+    TEST_ASSERT_EQUAL_STRING("Wechselrichter gestartet", entry.Message);
+    parser.getLogEntry(13, entry, AlarmMessageLocale_t::FR);
+    TEST_ASSERT_EQUAL_STRING("Inconnu", entry.Message);
+
+    // Entries which were not received
+    parser.getLogEntry(ALARM_LOG_ENTRY_COUNT, entry);
+    TEST_ASSERT_EQUAL(0, entry.StartTime);
+    TEST_ASSERT_EQUAL_STRING("Unknown", entry.Message);
+}
+
+// The log can be received before the clock got synchronized and the
+// timezone configured, the entries have to follow the current offset
+void test_offset_follows_timezone(void)
+{
+    AlarmLogParser parser;
+    receive(parser);
+
+    AlarmLogEntry_t entry;
+    parser.getLogEntry(0, entry);
+    TEST_ASSERT_EQUAL(100, entry.StartTime);
+
+    setTimezone("EST5");
+    parser.getLogEntry(0, entry);
+    TEST_ASSERT_EQUAL(100 - 5 * 3600, entry.StartTime);
+    TEST_ASSERT_EQUAL(200 - 5 * 3600, entry.EndTime);
+
+    // The raw record keeps the time reported by the inverter
+    AlarmLogRecord_t record;
+    parser.getLogRecord(0, record, false);
+    TEST_ASSERT_EQUAL(100, record.StartTime);
+    TEST_ASSERT_EQUAL(200, record.EndTime);
+    TEST_ASSERT_EQUAL(-5 * 3600, AlarmLogParser::getTimezoneOffset());
+
+    // Without a reset the offset is kept within the hour
+    setenv("TZ", "UTC0", 1);
+    tzset();
+    parser.getLogEntry(0, entry);
+    TEST_ASSERT_EQUAL(100 - 5 * 3600, entry.StartTime);
+
+    AlarmLogParser::resetTimezoneOffset();
+    parser.getLogEntry(0, entry);
+    TEST_ASSERT_EQUAL(100, entry.StartTime);
+}
+
+// Renders the full event log with the German texts like the web API does,
+// from the decoded entries and the way it was done before
+void test_benchmark_event_log_render(void)
+{
+    setTimezone("CET-1CEST,M3.5.0,M10.5.0/3");
+
+    const std::vector<KnownMessage_t> messages = knownMessages();
+    TEST_ASSERT_EQUAL(ALARM_MSG_COUNT, messages.size());
+
+    AlarmLogParser parser;
+    receive(parser);
+    uint8_t payload[ALARM_LOG_PAYLOAD_SIZE];
+    fillPayload(payload);
+
+    // Both have to render the same log
+    for (uint8_t i = 0; i < ALARM_LOG_ENTRY_COUNT; i++) {
+        AlarmLogEntry_t entry;
+        ReferenceEntry_t reference;
+        parser.getLogEntry(i, entry, AlarmMessageLocale_t::DE);
+        referenceLogEntry(payload, i, messages, reference);
+
+        TEST_ASSERT_EQUAL(reference.MessageId, entry.MessageId);
+        TEST_ASSERT_EQUAL_STRING(reference.Message.c_str(), entry.Message);
+        TEST_ASSERT_EQUAL(reference.StartTime, entry.StartTime);
+        TEST_ASSERT_EQUAL(reference.EndTime, entry.EndTime);
+    }
+
+    const uint16_t rounds = 2000;
+    size_t length = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint16_t round = 0; round < rounds; round++) {
+        for (uint8_t i = 0; i < parser.getEntryCount(); i++) {
+            AlarmLogEntry_t entry;
+            parser.getLogEntry(i, entry, AlarmMessageLocale_t::DE);
+            length += strlen(entry.Message) + entry.StartTime;
+        }
+    }
+    const double decodedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / rounds;
+
+    size_t referenceLength = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint16_t round = 0; round < rounds; round++) {
+        for (uint8_t i = 0; i < ALARM_LOG_ENTRY_COUNT; i++) {
+            ReferenceEntry_t entry;
+            referenceLogEntry(payload, i, messages, entry);
+            referenceLength += entry.Message.length() + entry.StartTime;
+        }
+    }
+    const double referenceUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / rounds;
+
+    char msg[128];
+    snprintf(msg, sizeof(msg), "Event log render: decoded %.2f us, per entry decode %.2f us", decodedUs, referenceUs);
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_EQUAL(referenceLength, length);
+    TEST_ASSERT_TRUE(decodedUs < referenceUs);
+}
+
+void test_message_index_matches_reference(void)
+{
+    const std::vector<KnownMessage_t> messages = knownMessages();
+    TEST_ASSERT_EQUAL(ALARM_MSG_COUNT, messages.size());
+    for (uint8_t i = 0; i < ALARM_MSG_COUNT; i++) {
+        TEST_ASSERT_EQUAL(i, messages[i].MessageIndex);
+    }
+
+    for (const AlarmMessageType_t type : { AlarmMessageType_t::ALL, AlarmMessageType_t::HMT }) {
+        AlarmLogParser parser;
+        parser.setMessageType(type);
+        for (uint32_t id = 0; id < 10000; id++) {
+            TEST_ASSERT_EQUAL(referenceMessageIndex(messages, type, id), parser.getMessageIndex(id));
+        }
+    }
+}
+
+// Looks up the ids of the message table and some unknown ones for a HMT,
+// which needs the most steps in both variants
+void test_benchmark_message_index(void)
+{
+    const std::vector<KnownMessage_t> messages = knownMessages();
+
+    std::vector<uint16_t> ids;
+    for (const auto& msg : messages) {
+        ids.push_back(msg.MessageId);
+        ids.push_back(msg.MessageId + 1);
+    }
+
+    AlarmLogParser parser;
+    parser.setMessageType(AlarmMessageType_t::HMT);
+
+    const uint16_t rounds = 2000;
+    const size_t lookups = rounds * ids.size();
+
+    uint32_t sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint16_t round = 0; round < rounds; round++) {
+        for (const uint16_t id : ids) {
+            sum += parser.getMessageIndex(id);
+        }
+    }
+    const double mapNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / lookups;
+
+    uint32_t referenceSum = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint16_t round = 0; round < rounds; round++) {
+        for (const uint16_t id : ids) {
+            referenceSum += referenceMessageIndex(messages, AlarmMessageType_t::HMT, id);
+        }
+    }
+    const double scanNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / lookups;
+
+    char msg[128];
+    snprintf(msg, sizeof(msg), "Alarm message index: map %.1f ns, scan %.1f ns per lookup", mapNs, scanNs);
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_EQUAL(referenceSum, sum);
+    TEST_ASSERT_TRUE(mapNs < scanNs);
+}
+
+int main(int, char**)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_entries_are_decoded);
+    RUN_TEST(test_offset_follows_timezone);
+    RUN_TEST(test_benchmark_event_log_render);
+    RUN_TEST(test_message_index_matches_reference);
+    RUN_TEST(test_benchmark_message_index);
+    return UNITY_END();
+}
@@ -0,0 +1,188 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2024 Thomas Basler and others
+ */
+#include <Hoymiles.h>
+#include <chrono>
+#include <cstdio>
+#include <unity.h>
+#include <vector>
+
+#define ALL 0xff
+
+struct ReferenceDevInfo_t {
+    uint8_t hwPart[4];
+    uint16_t maxPower;
+    const char* modelName;
+};
+
+// Copy of the table in DevInfoParser.cpp, searched like before the lookup
+// maps were introduced. Has to be extended together with the table.
+static const ReferenceDevInfo_t referenceDevInfo[] = {
+    { { 0x10, 0x10, 0x10, ALL }, 300, "HM-300-1T" },
+    { { 0x10, 0x10, 0x20, ALL }, 350, "HM-350-1T" },
+    { { 0x10, 0x10, 0x30, ALL }, 400, "HM-400-1T" },
+    { { 0x10, 0x10, 0x40, ALL }, 400, "HM-400-1T" },
+    { { 0x10, 0x11, 0x10, ALL }, 600, "HM-600-2T" },
+    { { 0x10, 0x11, 0x20, ALL }, 700, "HM-700-2T" },
+    { { 0x10, 0x11, 0x30, ALL }, 800, "HM-800-2T" },
+    { { 0x10, 0x11, 0x40, ALL }, 800, "HM-800-2T" },
+    { { 0x10, 0x12, 0x10, ALL }, 1200, "HM-1200-4T" },
+    { { 0x10, 0x02, 0x30, ALL }, 1500, "MI-1500-4T Gen3" },
+    { { 0x10, 0x12, 0x30, ALL }, 1500, "HM-1500-4T" },
+    { { 0x10, 0x10, 0x10, 0x15 }, static_cast<uint16_t>(300 * 0.7), "HM-300-1T" },
+
+    { { 0x10, 0x20, 0x11, ALL }, 300, "HMS-300-1T" },
+    { { 0x10, 0x20, 0x21, ALL }, 350, "HMS-350-1T" },
+    { { 0x10, 0x20, 0x41, ALL }, 400, "HMS-400-1T" },
+    { { 0x10, 0x10, 0x51, ALL }, 450, "HMS-450-1T" },
+    { { 0x10, 0x20, 0x51, ALL }, 450, "HMS-450-1T" },
+    { { 0x10, 0x10, 0x71, ALL }, 500, "HMS-500-1T" },
+    { { 0x10, 0x20, 0x71, ALL }, 500, "HMS-500-1T v2" },
+    { { 0x10, 0x21, 0x11, ALL }, 600, "HMS-600-2T" },
+    { { 0x10, 0x21, 0x41, ALL }, 800, "HMS-800-2T" },
+    { { 0x10, 0x11, 0x41, ALL }, 800, "HMS-800-2T-LV" },
+    { { 0x10, 0x11, 0x51, ALL }, 900, "HMS-900-2T" },
+    { { 0x10, 0x21, 0x51, ALL }, 900, "HMS-900-2T" },
+    { { 0x10, 0x21, 0x71, ALL }, 1000, "HMS-1000-2T" },
+    { { 0x10, 0x11, 0x71, ALL }, 1000, "HMS-1000-2T" },
+    { { 0x10, 0x22, 0x41, ALL }, 1600, "HMS-1600-4T" },
+    { { 0x10, 0x12, 0x51, ALL }, 1800, "HMS-1800-4T" },
+    { { 0x10, 0x22, 0x51, ALL }, 1800, "HMS-1800-4T" },
+    { { 0x10, 0x12, 0x71, ALL }, 2000, "HMS-2000-4T" },
+    { { 0x10, 0x22, 0x71, ALL }, 2000, "HMS-2000-4T" },
+
+    { { 0x10, 0x32, 0x41, ALL }, 1600, "HMT-1600-4T" },
+    { { 0x10, 0x32, 0x51, ALL }, 1800, "HMT-1800-4T" },
+    { { 0x10, 0x32, 0x71, ALL }, 2000, "HMT-2000-4T" },
+
+    { { 0x10, 0x33, 0x11, ALL }, 1800, "HMT-1800-6T" },
+    { { 0x10, 0x33, 0x31, ALL }, 2250, "HMT-2250-6T" },
+
+    { { 0xF1, 0x01, 0x14, ALL }, 800, "HERF-800" },
+    { { 0xF1, 0x01, 0x24, ALL }, 1600, "HERF-1600" },
+    { { 0xF1, 0x01, 0x22, ALL }, 1800, "HERF-1800" },
+};
+
+static uint8_t referenceDevIdx(const uint8_t* hwPart)
+{
+    const uint8_t count = sizeof(referenceDevInfo) / sizeof(referenceDevInfo[0]);
+
+    // Check for all 4 bytes first
+    for (uint8_t pos = 0; pos < count; pos++) {
+        if (memcmp(referenceDevInfo[pos].hwPart, hwPart, 4) == 0) {
+            return pos;
+        }
+    }
+
+    // Then only for 3 bytes
+    for (uint8_t pos = 0; pos < count; pos++) {
+        if (memcmp(referenceDevInfo[pos].hwPart, hwPart, 3) == 0) {
+            return pos;
+        }
+    }
+
+    return 0xff;
+}
+
+static void setHwPart(DevInfoParser& parser, const uint8_t* hwPart)
+{
+    uint8_t payload[6] = { 0x27, 0x1c, hwPart[0], hwPart[1], hwPart[2], hwPart[3] };
+    parser.clearBufferSimple();
+    parser.appendFragmentSimple(0, payload, sizeof(payload));
+}
+
+// Part numbers of all table entries with the last byte of the other
+// entries, plus unknown ones next to them
+static std::vector<std::array<uint8_t, 4>> testHwParts()
+{
+    std::vector<std::array<uint8_t, 4>> parts;
+    for (const auto& info : referenceDevInfo) {
+        for (const uint8_t last : { 0x00, 0x01, 0x15, 0x16, 0xff }) {
+            parts.push_back({ info.hwPart[0], info.hwPart[1], info.hwPart[2], last });
+            parts.push_back({ info.hwPart[0], info.hwPart[1], static_cast<uint8_t>(info.hwPart[2] + 1), last });
+            parts.push_back({ info.hwPart[0], static_cast<uint8_t>(info.hwPart[1] + 0x10), info.hwPart[2], last });
+        }
+    }
+    return parts;
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_matches_reference_table(void)
+{
+    DevInfoParser parser;
+    for (const auto& part : testHwParts()) {
+        setHwPart(parser, part.data());
+        const uint8_t idx = referenceDevIdx(part.data());
+
+        if (idx == 0xff) {
+            TEST_ASSERT_EQUAL(0, parser.getMaxPower());
+            TEST_ASSERT_EQUAL_STRING("", parser.getHwModelName().c_str());
+        } else {
+            TEST_ASSERT_EQUAL(referenceDevInfo[idx].maxPower, parser.getMaxPower());
+            TEST_ASSERT_EQUAL_STRING(referenceDevInfo[idx].modelName, parser.getHwModelName().c_str());
+        }
+    }
+
+    // The entry with a specific last byte takes precedence
+    const uint8_t limited[] = { 0x10, 0x10, 0x10, 0x15 };
+    setHwPart(parser, limited);
+    TEST_ASSERT_EQUAL(210, parser.getMaxPower());
+}
+
+void test_benchmark_lookup(void)
+{
+    const std::vector<std::array<uint8_t, 4>> parts = testHwParts();
+    const uint16_t rounds = 2000;
+    const size_t lookups = rounds * parts.size();
+
+    // Both take a semaphore like getDevIdx() does, only the search differs
+    std::vector<DevInfoParser> parsers(parts.size());
+    SemaphoreHandle_t semaphore = xSemaphoreCreateMutex();
+    for (size_t i = 0; i < parts.size(); i++) {
+        setHwPart(parsers[i], parts[i].data());
+    }
+
+    uint32_t power = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint16_t round = 0; round < rounds; round++) {
+        for (const auto& parser : parsers) {
+            power += parser.getMaxPower();
+        }
+    }
+    const double mapNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / lookups;
+
+    uint32_t referencePower = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint16_t round = 0; round < rounds; round++) {
+        for (const auto& part : parts) {
+            xSemaphoreTake(semaphore, portMAX_DELAY);
+            const uint8_t idx = referenceDevIdx(part.data());
+            xSemaphoreGive(semaphore);
+            referencePower += idx == 0xff ? 0 : referenceDevInfo[idx].maxPower;
+        }
+    }
+    const double scanNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / lookups;
+
+    char msg[128];
+    snprintf(msg, sizeof(msg), "DevInfo max power: maps %.1f ns, scan %.1f ns per lookup", mapNs, scanNs);
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_EQUAL(referencePower, power);
+    TEST_ASSERT_TRUE(mapNs < scanNs);
+}
+
+int main(int, char**)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_matches_reference_table);
+    RUN_TEST(test_benchmark_lookup);
+    return UNITY_END();
+}
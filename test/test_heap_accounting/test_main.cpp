@@ -0,0 +1,258 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2024 Thomas Basler and others
+ */
+#include <HeapAccounting.h>
+#include <thread>
+#include <unity.h>
+#include <vector>
+
+// The accounting only looks at the addresses, so the tests pass made up
+// ones which are never dereferenced
+static const void* fakePtr(const uintptr_t address)
+{
+    return reinterpret_cast<const void*>(address);
+}
+
+// Same hash as the slot table, used to construct collisions
+static uint32_t homeSlot(const uintptr_t ptr)
+{
+    return (static_cast<uint32_t>(ptr >> 3) * 2654435761u) & (HEAP_ACCOUNTING_SLOTS - 1);
+}
+
+// Returns count addresses above start whose home slot is home
+static std::vector<uintptr_t> collidingAddresses(const uint32_t home, const size_t count, uintptr_t start)
+{
+    std::vector<uintptr_t> addresses;
+    for (uintptr_t address = start; addresses.size() < count; address += 8) {
+        if (homeSlot(address) == home) {
+            addresses.push_back(address);
+        }
+    }
+    return addresses;
+}
+
+// The statistics are not reset between the tests, so the tests compare the
+// difference to the values before
+static HeapTagStats_t diff(const HeapTagStats_t& before, const HeapTag tag)
+{
+    const HeapTagStats_t now = HeapAccounting.getStats(tag);
+    return { now.Allocations - before.Allocations, now.Frees - before.Frees, now.LiveBytes - before.LiveBytes, now.PeakBytes };
+}
+
+void setUp(void)
+{
+    TEST_ASSERT_TRUE(HeapAccounting.init());
+}
+
+void tearDown(void)
+{
+}
+
+void test_alloc_and_free_are_attributed_to_the_scope(void)
+{
+    const HeapTagStats_t radio = HeapAccounting.getStats(HeapTag::Radio);
+    const HeapTagStats_t mqtt = HeapAccounting.getStats(HeapTag::Mqtt);
+
+    {
+        HeapTagScope scope(HeapTag::Radio);
+        HeapAccounting.onAlloc(fakePtr(0x10000), 100);
+        HeapAccounting.onAlloc(fakePtr(0x10100), 50);
+
+        HeapTagScope inner(HeapTag::Mqtt);
+        HeapAccounting.onAlloc(fakePtr(0x10200), 30);
+    }
+
+    // Outside of a scope nothing is tracked
+    HeapAccounting.onAlloc(fakePtr(0x10300), 1000);
+
+    HeapTagStats_t stats = diff(radio, HeapTag::Radio);
+    TEST_ASSERT_EQUAL(2, stats.Allocations);
+    TEST_ASSERT_EQUAL(150, stats.LiveBytes);
+    TEST_ASSERT_EQUAL(30, diff(mqtt, HeapTag::Mqtt).LiveBytes);
+
+    // A block is freed from the tag it was allocated with, in any scope
+    {
+        HeapTagScope scope(HeapTag::Mqtt);
+        HeapAccounting.onFree(fakePtr(0x10000));
+    }
+    HeapAccounting.onFree(fakePtr(0x10100));
+    HeapAccounting.onFree(fakePtr(0x10200));
+    HeapAccounting.onFree(fakePtr(0x10300));
+
+    stats = diff(radio, HeapTag::Radio);
+    TEST_ASSERT_EQUAL(2, stats.Frees);
+    TEST_ASSERT_EQUAL(0, stats.LiveBytes);
+    TEST_ASSERT_GREATER_OR_EQUAL(radio.LiveBytes + 150, stats.PeakBytes);
+
+    stats = diff(mqtt, HeapTag::Mqtt);
+    TEST_ASSERT_EQUAL(1, stats.Frees);
+    TEST_ASSERT_EQUAL(0, stats.LiveBytes);
+}
+
+void test_realloc_keeps_the_tag(void)
+{
+    const HeapTagStats_t parser = HeapAccounting.getStats(HeapTag::Parser);
+    const HeapTagStats_t web = HeapAccounting.getStats(HeapTag::WebApi);
+
+    {
+        HeapTagScope scope(HeapTag::Parser);
+        HeapAccounting.onRealloc(nullptr, fakePtr(0x20000), 100);
+    }
+
+    HeapTagScope scope(HeapTag::WebApi);
+
+    // Moved and grown
+    HeapAccounting.onRealloc(fakePtr(0x20000), fakePtr(0x20400), 300);
+    HeapTagStats_t stats = diff(parser, HeapTag::Parser);
+    TEST_ASSERT_EQUAL(1, stats.Allocations);
+    TEST_ASSERT_EQUAL(0, stats.Frees);
+    TEST_ASSERT_EQUAL(300, stats.LiveBytes);
+
+    // Failed, the old block is still valid
+    HeapAccounting.onRealloc(fakePtr(0x20400), nullptr, 100000);
+    TEST_ASSERT_EQUAL(300, diff(parser, HeapTag::Parser).LiveBytes);
+
+    // Shrunk in place
+    HeapAccounting.onRealloc(fakePtr(0x20400), fakePtr(0x20400), 20);
+    TEST_ASSERT_EQUAL(20, diff(parser, HeapTag::Parser).LiveBytes);
+
+    // realloc(ptr, 0) released the block
+    HeapAccounting.onRealloc(fakePtr(0x20400), nullptr, 0);
+    stats = diff(parser, HeapTag::Parser);
+    TEST_ASSERT_EQUAL(1, stats.Frees);
+    TEST_ASSERT_EQUAL(0, stats.LiveBytes);
+
+    // A block which was not tracked is accounted to the current tag
+    HeapAccounting.onRealloc(fakePtr(0x20800), fakePtr(0x20c00), 64);
+    TEST_ASSERT_EQUAL(1, diff(web, HeapTag::WebApi).Allocations);
+    TEST_ASSERT_EQUAL(64, diff(web, HeapTag::WebApi).LiveBytes);
+    HeapAccounting.onFree(fakePtr(0x20c00));
+    TEST_ASSERT_EQUAL(0, diff(web, HeapTag::WebApi).LiveBytes);
+}
+
+// Removing an entry from a probe sequence has to move the following entries
+// back, otherwise they cannot be found anymore
+void test_remove_shifts_the_probe_sequence(void)
+{
+    // The second home slot makes the sequence wrap around the end of the table
+    for (const uint32_t home : { 100u, static_cast<uint32_t>(HEAP_ACCOUNTING_SLOTS - 2) }) {
+        const HeapTagStats_t before = HeapAccounting.getStats(HeapTag::Display);
+        HeapTagScope scope(HeapTag::Display);
+
+        // Three entries with the same home slot followed by two entries whose
+        // home slot is occupied by the first ones
+        const std::vector<uintptr_t> same = collidingAddresses(home, 3, 0x100000);
+        const std::vector<uintptr_t> next = collidingAddresses((home + 1) & (HEAP_ACCOUNTING_SLOTS - 1), 1, 0x100000);
+        const std::vector<uintptr_t> after = collidingAddresses((home + 4) & (HEAP_ACCOUNTING_SLOTS - 1), 1, 0x100000);
+
+        const std::vector<uintptr_t> all = { same[0], same[1], same[2], next[0], after[0] };
+        for (size_t i = 0; i < all.size(); i++) {
+            HeapAccounting.onAlloc(fakePtr(all[i]), 1 << i);
+        }
+        TEST_ASSERT_EQUAL(31, diff(before, HeapTag::Display).LiveBytes);
+
+        // Remove from the start and the middle of the sequence, every
+        // remaining entry still has to be found with its size
+        const size_t order[] = { 0, 3, 1, 4, 2 };
+        uint32_t live = 31;
+        for (const size_t i : order) {
+            HeapAccounting.onFree(fakePtr(all[i]));
+            live -= 1 << i;
+            TEST_ASSERT_EQUAL(live, diff(before, HeapTag::Display).LiveBytes);
+        }
+        TEST_ASSERT_EQUAL(5, diff(before, HeapTag::Display).Frees);
+
+        // Unknown addresses are ignored
+        HeapAccounting.onFree(fakePtr(all[0]));
+        TEST_ASSERT_EQUAL(5, diff(before, HeapTag::Display).Frees);
+    }
+}
+
+void test_full_table_counts_untracked(void)
+{
+    const HeapTagStats_t before = HeapAccounting.getStats(HeapTag::Hass);
+    const uint32_t untracked = HeapAccounting.getUntracked();
+
+    HeapTagScope scope(HeapTag::Hass);
+
+    // The table accepts up to 3/4 of its slots, the other tests left none
+    // of their entries behind
+    const uint32_t capacity = HEAP_ACCOUNTING_SLOTS / 4 * 3;
+    for (uint32_t i = 0; i < capacity + 10; i++) {
+        HeapAccounting.onAlloc(fakePtr(0x1000000 + i * 16), 4);
+    }
+
+    TEST_ASSERT_EQUAL(capacity, diff(before, HeapTag::Hass).Allocations);
+    TEST_ASSERT_EQUAL(capacity * 4, diff(before, HeapTag::Hass).LiveBytes);
+    TEST_ASSERT_EQUAL(untracked + 10, HeapAccounting.getUntracked());
+
+    for (uint32_t i = 0; i < capacity + 10; i++) {
+        HeapAccounting.onFree(fakePtr(0x1000000 + i * 16));
+    }
+    TEST_ASSERT_EQUAL(capacity, diff(before, HeapTag::Hass).Frees);
+    TEST_ASSERT_EQUAL(0, diff(before, HeapTag::Hass).LiveBytes);
+
+    // Space is available again
+    HeapAccounting.onAlloc(fakePtr(0x1000000), 4);
+    TEST_ASSERT_EQUAL(capacity + 1, diff(before, HeapTag::Hass).Allocations);
+    HeapAccounting.onFree(fakePtr(0x1000000));
+}
+
+// Every thread accounts to its own tag, the totals have to match exactly
+void test_concurrent_threads(void)
+{
+    static const HeapTag tags[] = { HeapTag::Radio, HeapTag::Parser, HeapTag::Mqtt, HeapTag::Websocket };
+    const uint32_t rounds = 20000;
+
+    HeapTagStats_t before[4];
+    for (uint8_t t = 0; t < 4; t++) {
+        before[t] = HeapAccounting.getStats(tags[t]);
+    }
+
+    std::vector<std::thread> threads;
+    for (uint8_t t = 0; t < 4; t++) {
+        threads.emplace_back([t, rounds]() {
+            HeapTagScope scope(tags[t]);
+            const uintptr_t base = 0x10000000 * (t + 1);
+
+            // Keeps up to 64 blocks alive, so the probe sequences of the
+            // threads interleave
+            for (uint32_t i = 0; i < rounds; i++) {
+                const uintptr_t address = base + (i % 64) * 32;
+                if (i >= 64) {
+                    HeapAccounting.onFree(fakePtr(address));
+                }
+                if (i % 3 == 0 && i >= 64) {
+                    HeapAccounting.onRealloc(nullptr, fakePtr(address), 8);
+                } else {
+                    HeapAccounting.onAlloc(fakePtr(address), 8);
+                }
+            }
+            for (uint32_t i = 0; i < 64; i++) {
+                HeapAccounting.onFree(fakePtr(base + i * 32));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (uint8_t t = 0; t < 4; t++) {
+        const HeapTagStats_t stats = diff(before[t], tags[t]);
+        TEST_ASSERT_EQUAL(rounds, stats.Allocations);
+        TEST_ASSERT_EQUAL(rounds, stats.Frees);
+        TEST_ASSERT_EQUAL(0, stats.LiveBytes);
+    }
+}
+
+int main(int, char**)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_alloc_and_free_are_attributed_to_the_scope);
+    RUN_TEST(test_realloc_keeps_the_tag);
+    RUN_TEST(test_remove_shifts_the_probe_sequence);
+    RUN_TEST(test_full_table_counts_untracked);
+    RUN_TEST(test_concurrent_threads);
+    return UNITY_END();
+}
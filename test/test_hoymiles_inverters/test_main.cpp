@@ -0,0 +1,196 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2024 Thomas Basler and others
+ */
+#include <Hoymiles.h>
+#include <atomic>
+#include <set>
+#include <thread>
+#include <unity.h>
+#include <vector>
+
+// HM-1500, HM-800 and HMS-2000 serials, the first two bytes select the type
+static const uint64_t serialBase[] = { 0x116200000000, 0x114200000000, 0x116400000000 };
+
+static uint64_t makeSerial(const uint8_t type, const uint32_t index)
+{
+    return serialBase[type % 3] + 0x10000000ULL * (1 + type) + index;
+}
+
+static void removeAll()
+{
+    const InverterListPtr inverters = Hoymiles.getInverters();
+    for (const auto& inv : *inverters) {
+        Hoymiles.removeInverterBySerial(inv->serial());
+    }
+}
+
+void setUp(void)
+{
+    Hoymiles.setMessageOutput(&Serial);
+    Hoymiles.init();
+    Hoymiles.setPollInterval(0);
+}
+
+void tearDown(void)
+{
+    removeAll();
+}
+
+void test_add_get_remove(void)
+{
+    const uint64_t first = makeSerial(0, 1);
+    const uint64_t second = makeSerial(2, 2);
+
+    TEST_ASSERT_NOT_NULL(Hoymiles.addInverter("first", first).get());
+    TEST_ASSERT_NOT_NULL(Hoymiles.addInverter("second", second).get());
+    TEST_ASSERT_NULL(Hoymiles.addInverter("unknown", 0x999900000001).get());
+    TEST_ASSERT_EQUAL(2, Hoymiles.getNumInverters());
+
+    TEST_ASSERT_TRUE(Hoymiles.getInverterByPos(0)->serial() == first);
+    TEST_ASSERT_TRUE(Hoymiles.getInverterByPos(1)->serial() == second);
+    TEST_ASSERT_NULL(Hoymiles.getInverterByPos(2).get());
+    TEST_ASSERT_TRUE(Hoymiles.getInverterBySerial(second)->serial() == second);
+
+    // A list taken before keeps its inverters alive and unchanged
+    const InverterListPtr before = Hoymiles.getInverters();
+    Hoymiles.removeInverterBySerial(first);
+    Hoymiles.removeInverterBySerial(first);
+
+    TEST_ASSERT_EQUAL(1, Hoymiles.getNumInverters());
+    TEST_ASSERT_NULL(Hoymiles.getInverterBySerial(first).get());
+    TEST_ASSERT_TRUE(Hoymiles.getInverterByPos(0)->serial() == second);
+
+    TEST_ASSERT_EQUAL(2, before->size());
+    TEST_ASSERT_TRUE((*before)[0]->serial() == first);
+    TEST_ASSERT_EQUAL_STRING("first", (*before)[0]->name());
+}
+
+// Readers iterate the list while other threads add and remove inverters.
+// Every list a reader sees has to be complete: no null entries, no
+// duplicates and the inverters which are never removed are always present.
+void test_concurrent_readers_and_mutators(void)
+{
+    const uint8_t permanentCount = 4;
+    const uint8_t mutatorCount = 2;
+    const uint8_t readerCount = 4;
+    const uint32_t rounds = 2000;
+
+    std::set<uint64_t> permanent;
+    for (uint8_t i = 0; i < permanentCount; i++) {
+        const uint64_t serial = makeSerial(i, 100000 + i);
+        TEST_ASSERT_NOT_NULL(Hoymiles.addInverter("permanent", serial).get());
+        permanent.insert(serial);
+    }
+
+    std::atomic<bool> running = { true };
+    std::atomic<uint32_t> errors = { 0 };
+
+    std::vector<std::thread> readers;
+    for (uint8_t r = 0; r < readerCount; r++) {
+        readers.emplace_back([&, r]() {
+            while (running) {
+                const InverterListPtr inverters = Hoymiles.getInverters();
+
+                std::set<uint64_t> seen;
+                for (const auto& inv : *inverters) {
+                    if (inv == nullptr || !seen.insert(inv->serial()).second) {
+                        errors++;
+                        continue;
+                    }
+                    // Touches the inverter, it must not have been deleted
+                    if (inv->name()[0] == '\0') {
+                        errors++;
+                    }
+                }
+                for (const uint64_t serial : permanent) {
+                    if (seen.count(serial) == 0 || Hoymiles.getInverterBySerial(serial) == nullptr) {
+                        errors++;
+                    }
+                }
+                if (seen.size() > permanentCount + mutatorCount) {
+                    errors++;
+                }
+
+                // The position based getters may see a different list
+                for (uint8_t pos = 0; pos < Hoymiles.getNumInverters(); pos++) {
+                    auto inv = Hoymiles.getInverterByPos(pos);
+                    if (inv != nullptr && inv->serial() == 0) {
+                        errors++;
+                    }
+                }
+
+                // One reader runs the polling of the main loop
+                if (r == 0) {
+                    Hoymiles.loop();
+                }
+            }
+        });
+    }
+
+    // Every mutator adds and removes its own inverter
+    std::vector<std::thread> mutators;
+    for (uint8_t m = 0; m < mutatorCount; m++) {
+        mutators.emplace_back([&, m]() {
+            for (uint32_t i = 0; i < rounds; i++) {
+                const uint64_t serial = makeSerial(m, i);
+                if (Hoymiles.addInverter("temporary", serial) == nullptr) {
+                    errors++;
+                }
+                Hoymiles.removeInverterBySerial(serial);
+            }
+        });
+    }
+
+    for (auto& thread : mutators) {
+        thread.join();
+    }
+    running = false;
+    for (auto& thread : readers) {
+        thread.join();
+    }
+
+    TEST_ASSERT_EQUAL(0, errors.load());
+
+    // Only the permanent inverters are left, in the order they were added
+    const InverterListPtr inverters = Hoymiles.getInverters();
+    TEST_ASSERT_EQUAL(permanentCount, inverters->size());
+    for (uint8_t i = 0; i < permanentCount; i++) {
+        TEST_ASSERT_TRUE((*inverters)[i]->serial() == makeSerial(i, 100000 + i));
+    }
+}
+
+// Concurrent additions must not lose each other's inverters
+void test_concurrent_additions(void)
+{
+    const uint8_t threadCount = 4;
+    const uint32_t perThread = 50;
+
+    std::vector<std::thread> threads;
+    for (uint8_t t = 0; t < threadCount; t++) {
+        threads.emplace_back([t]() {
+            for (uint32_t i = 0; i < perThread; i++) {
+                Hoymiles.addInverter("added", makeSerial(t, i));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    TEST_ASSERT_EQUAL(threadCount * perThread, Hoymiles.getNumInverters());
+    for (uint8_t t = 0; t < threadCount; t++) {
+        for (uint32_t i = 0; i < perThread; i++) {
+            TEST_ASSERT_NOT_NULL(Hoymiles.getInverterBySerial(makeSerial(t, i)).get());
+        }
+    }
+}
+
+int main(int, char**)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_add_get_remove);
+    RUN_TEST(test_concurrent_readers_and_mutators);
+    RUN_TEST(test_concurrent_additions);
+    return UNITY_END();
+}
@@ -0,0 +1,213 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2024 Thomas Basler and others
+ */
+#include <ArduinoJson.h>
+#include <JsonStreamWriter.h>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <unity.h>
+
+class StringPrint : public Print {
+public:
+    size_t write(const uint8_t* buffer, size_t size) override
+    {
+        Output.append(reinterpret_cast<const char*>(buffer), size);
+        return size;
+    }
+
+    std::string Output;
+};
+
+// The writer has to produce exactly what the handlers sent when they built
+// the complete document
+static void assertSameAsDocument(const JsonDocument& doc, const StringPrint& streamed)
+{
+    std::string expected;
+    serializeJson(doc, expected);
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), streamed.Output.c_str());
+}
+
+static const char* const strings[] = {
+    "",
+    "plain",
+    "quote \" and backslash \\",
+    "\b\f\n\r\t",
+    "slash / stays",
+    "Übertemperatur 50°C",
+    "\"\"\\\\",
+};
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_integers_like_document(void)
+{
+    JsonDocument doc;
+    StringPrint out;
+    JsonStreamWriter writer(out);
+    writer.beginObject();
+
+#define ADD_INTEGER(key, value) \
+    doc[key] = value;           \
+    writer.addValue(key, value);
+
+    ADD_INTEGER("zero", 0);
+    ADD_INTEGER("u8", std::numeric_limits<uint8_t>::max());
+    ADD_INTEGER("i8", std::numeric_limits<int8_t>::min());
+    ADD_INTEGER("u16", std::numeric_limits<uint16_t>::max());
+    ADD_INTEGER("i16", std::numeric_limits<int16_t>::min());
+    ADD_INTEGER("u32", std::numeric_limits<uint32_t>::max());
+    ADD_INTEGER("i32min", std::numeric_limits<int32_t>::min());
+    ADD_INTEGER("i32max", std::numeric_limits<int32_t>::max());
+    ADD_INTEGER("u64", std::numeric_limits<uint64_t>::max());
+    ADD_INTEGER("i64min", std::numeric_limits<int64_t>::min());
+    ADD_INTEGER("i64max", std::numeric_limits<int64_t>::max());
+    ADD_INTEGER("minus_one", -1);
+    ADD_INTEGER("ten", 10);
+#undef ADD_INTEGER
+
+    doc["true"] = true;
+    writer.addValue("true", true);
+    doc["false"] = false;
+    writer.addValue("false", false);
+
+    writer.endObject();
+    assertSameAsDocument(doc, out);
+}
+
+void test_strings_like_document(void)
+{
+    JsonDocument doc;
+    StringPrint out;
+    JsonStreamWriter writer(out);
+    writer.beginObject();
+
+    // Every string is used as key and as value
+    for (const char* str : strings) {
+        doc[str] = str;
+        writer.addValue(str, str);
+    }
+
+    doc["string"] = "from String";
+    writer.addValue("string", String("from String"));
+
+    doc["null"] = static_cast<const char*>(nullptr);
+    writer.addValue("null", static_cast<const char*>(nullptr));
+
+    writer.endObject();
+    assertSameAsDocument(doc, out);
+}
+
+// Same structure as the live data: an array of per element documents
+// followed by the members of a further document
+void test_nested_like_document(void)
+{
+    JsonDocument doc;
+    StringPrint out;
+    JsonStreamWriter writer(out);
+    writer.beginObject();
+    writer.beginArray("inverters");
+
+    JsonArray inverters = doc["inverters"].to<JsonArray>();
+    for (uint8_t i = 0; i < 3; i++) {
+        JsonDocument invDoc;
+        invDoc["serial"] = "11418" + std::to_string(i);
+        invDoc["reachable"] = i % 2 == 0;
+        invDoc["power"] = 123.456 * i;
+        JsonArray channels = invDoc["channels"].to<JsonArray>();
+        for (uint8_t c = 0; c < i; c++) {
+            JsonObject channel = channels.add<JsonObject>();
+            channel["name"] = "ch";
+            channel["yield"] = 0.1 * c;
+        }
+
+        inverters.add(invDoc);
+        writer.add(invDoc.as<JsonVariantConst>());
+    }
+    writer.endArray();
+
+    // Nested arrays of scalars with a null element, then an empty array
+    writer.beginArray("buckets");
+    JsonArray buckets = doc["buckets"].to<JsonArray>();
+    for (uint16_t b = 0; b < 3; b++) {
+        if (b == 1) {
+            buckets.add(nullptr);
+            writer.addValue(nullptr, static_cast<const char*>(nullptr));
+            continue;
+        }
+        JsonArray bucket = buckets.add<JsonArray>();
+        writer.beginArray();
+        for (uint16_t v = 0; v < 3; v++) {
+            bucket.add(b * 100 + v);
+            writer.addValue(nullptr, static_cast<uint16_t>(b * 100 + v));
+        }
+        writer.endArray();
+    }
+    writer.endArray();
+
+    doc["empty"].to<JsonArray>();
+    writer.beginArray("empty");
+    writer.endArray();
+
+    JsonDocument commonDoc;
+    commonDoc["total"]["Power"]["v"] = 1234.5;
+    commonDoc["total"]["Power"]["u"] = "W";
+    commonDoc["hints"]["time_sync"] = false;
+    for (JsonPairConst kv : commonDoc.as<JsonObjectConst>()) {
+        doc[kv.key()] = kv.value();
+    }
+    writer.addMembers(commonDoc.as<JsonObjectConst>());
+
+    writer.endObject();
+    assertSameAsDocument(doc, out);
+}
+
+// The top level value does not need to be an object
+void test_top_level_array(void)
+{
+    JsonDocument doc;
+    StringPrint out;
+    JsonStreamWriter writer(out);
+
+    JsonArray array = doc.to<JsonArray>();
+    writer.beginArray();
+    for (const char* str : strings) {
+        array.add(str);
+        writer.addValue(nullptr, str);
+        array.add<JsonObject>();
+        writer.beginObject();
+        writer.endObject();
+    }
+    writer.endArray();
+
+    assertSameAsDocument(doc, out);
+}
+
+void test_fail_is_reported(void)
+{
+    StringPrint out;
+    JsonStreamWriter writer(out);
+    TEST_ASSERT_FALSE(writer.hasFailed());
+
+    writer.beginObject();
+    writer.fail();
+    TEST_ASSERT_TRUE(writer.hasFailed());
+}
+
+int main(int, char**)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_integers_like_document);
+    RUN_TEST(test_strings_like_document);
+    RUN_TEST(test_nested_like_document);
+    RUN_TEST(test_top_level_array);
+    RUN_TEST(test_fail_is_reported);
+    return UNITY_END();
+}
@@ -0,0 +1,143 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+#pragma once
+
+/*
+ * Matcher of MqttSubscribeParser before the subscriptions were kept in a
+ * trie. Used as reference for the results of the trie.
+ */
+
+#include <cstddef>
+
+enum mosq_err_t {
+    MOSQ_ERR_SUCCESS = 0,
+    MOSQ_ERR_INVAL = 3,
+};
+
+/* Does a topic match a subscription? */
+inline int mosquitto_topic_matches_sub(const char* sub, const char* topic, bool* result)
+{
+    size_t spos;
+
+    if (!result)
+        return MOSQ_ERR_INVAL;
+    *result = false;
+
+    if (!sub || !topic || sub[0] == 0 || topic[0] == 0) {
+        return MOSQ_ERR_INVAL;
+    }
+
+    if ((sub[0] == '$' && topic[0] != '$')
+        || (topic[0] == '$' && sub[0] != '$')) {
+
+        return MOSQ_ERR_SUCCESS;
+    }
+
+    spos = 0;
+
+    while (sub[0] != 0) {
+        if (topic[0] == '+' || topic[0] == '#') {
+            return MOSQ_ERR_INVAL;
+        }
+        if (sub[0] != topic[0] || topic[0] == 0) { /* Check for wildcard matches */
+            if (sub[0] == '+') {
+                /* Check for bad "+foo" or "a/+foo" subscription */
+                if (spos > 0 && sub[-1] != '/') {
+                    return MOSQ_ERR_INVAL;
+                }
+                /* Check for bad "foo+" or "foo+/a" subscription */
+                if (sub[1] != 0 && sub[1] != '/') {
+                    return MOSQ_ERR_INVAL;
+                }
+                spos++;
+                sub++;
+                while (topic[0] != 0 && topic[0] != '/') {
+                    if (topic[0] == '+' || topic[0] == '#') {
+                        return MOSQ_ERR_INVAL;
+                    }
+                    topic++;
+                }
+                if (topic[0] == 0 && sub[0] == 0) {
+                    *result = true;
+                    return MOSQ_ERR_SUCCESS;
+                }
+            } else if (sub[0] == '#') {
+                /* Check for bad "foo#" subscription */
+                if (spos > 0 && sub[-1] != '/') {
+                    return MOSQ_ERR_INVAL;
+                }
+                /* Check for # not the final character of the sub, e.g. "#foo" */
+                if (sub[1] != 0) {
+                    return MOSQ_ERR_INVAL;
+                } else {
+                    while (topic[0] != 0) {
+                        if (topic[0] == '+' || topic[0] == '#') {
+                            return MOSQ_ERR_INVAL;
+                        }
+                        topic++;
+                    }
+                    *result = true;
+                    return MOSQ_ERR_SUCCESS;
+                }
+            } else {
+                /* Check for e.g. foo/bar matching foo/+/# */
+                if (topic[0] == 0
+                    && spos > 0
+                    && sub[-1] == '+'
+                    && sub[0] == '/'
+                    && sub[1] == '#') {
+                    *result = true;
+                    return MOSQ_ERR_SUCCESS;
+                }
+
+                /* There is no match at this point, but is the sub invalid? */
+                while (sub[0] != 0) {
+                    if (sub[0] == '#' && sub[1] != 0) {
+                        return MOSQ_ERR_INVAL;
+                    }
+                    spos++;
+                    sub++;
+                }
+
+                /* Valid input, but no match */
+                return MOSQ_ERR_SUCCESS;
+            }
+        } else {
+            /* sub[spos] == topic[tpos] */
+            if (topic[1] == 0) {
+                /* Check for e.g. foo matching foo/# */
+                if (sub[1] == '/'
+                    && sub[2] == '#'
+                    && sub[3] == 0) {
+                    *result = true;
+                    return MOSQ_ERR_SUCCESS;
+                }
+            }
+            spos++;
+            sub++;
+            topic++;
+            if (sub[0] == 0 && topic[0] == 0) {
+                *result = true;
+                return MOSQ_ERR_SUCCESS;
+            } else if (topic[0] == 0 && sub[0] == '+' && sub[1] == 0) {
+                if (spos > 0 && sub[-1] != '/') {
+                    return MOSQ_ERR_INVAL;
+                }
+                spos++;
+                sub++;
+                *result = true;
+                return MOSQ_ERR_SUCCESS;
+            }
+        }
+    }
+    if ((topic[0] != 0 || sub[0] != 0)) {
+        *result = false;
+    }
+    while (topic[0] != 0) {
+        if (topic[0] == '+' || topic[0] == '#') {
+            return MOSQ_ERR_INVAL;
+        }
+        topic++;
+    }
+
+    return MOSQ_ERR_SUCCESS;
+}
@@ -0,0 +1,328 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Copyright (C) 2024 Thomas Basler and others
+ */
+#include "MosquittoMatcher.h"
+#include <MqttSubscribeParser.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <unity.h>
+#include <vector>
+
+static const espMqttClientTypes::MessageProperties properties = {};
+
+// Indices of the filters whose callbacks were invoked
+static std::vector<size_t> hits;
+
+static espMqttClientTypes::OnMessageCallback recordHit(const size_t index)
+{
+    return [index](const espMqttClientTypes::MessageProperties&, const char*, const uint8_t*, size_t, size_t, size_t) {
+        hits.push_back(index);
+    };
+}
+
+static std::vector<size_t> dispatch(MqttSubscribeParser& parser, const std::string& topic)
+{
+    hits.clear();
+    parser.handle_message(properties, topic.c_str(), nullptr, 0, 0, 0);
+    std::sort(hits.begin(), hits.end());
+    return hits;
+}
+
+static std::vector<size_t> referenceMatches(const std::vector<std::string>& filters, const std::vector<bool>& registered, const std::string& topic)
+{
+    std::vector<size_t> result;
+    for (size_t i = 0; i < filters.size(); i++) {
+        bool match = false;
+        if (registered[i] && mosquitto_topic_matches_sub(filters[i].c_str(), topic.c_str(), &match) == MOSQ_ERR_SUCCESS && match) {
+            result.push_back(i);
+        }
+    }
+    return result;
+}
+
+static void assertSameMatches(MqttSubscribeParser& parser, const std::vector<std::string>& filters, const std::vector<bool>& registered, const std::string& topic)
+{
+    const std::vector<size_t> expected = referenceMatches(filters, registered, topic);
+    const std::vector<size_t> actual = dispatch(parser, topic);
+    if (expected != actual) {
+        char msg[128];
+        snprintf(msg, sizeof(msg), "Topic '%s': %zu matches expected, %zu found", topic.c_str(), expected.size(), actual.size());
+        TEST_FAIL_MESSAGE(msg);
+    }
+}
+
+static const std::vector<std::string> filters = {
+    "#",
+    "+",
+    "+/+",
+    "+/#",
+    "/#",
+    "/+",
+    "foo",
+    "foo/",
+    "foo/bar",
+    "foo/bar/baz",
+    "foo/+",
+    "foo/+/baz",
+    "foo/+/#",
+    "foo/#",
+    "foo/bar/#",
+    "+/bar/+",
+    "+/+/baz",
+    "foo//baz",
+    "$SYS/#",
+    "$SYS/broker/+",
+    "$SYS",
+    "+/broker/#",
+    "solar/+/cmd/limit_persistent_relative",
+    "solar/+/cmd/power",
+    "solar/116181234567/cmd/#",
+    "solar/dtu/#",
+};
+
+static const std::vector<std::string> topics = {
+    "foo",
+    "foo/",
+    "/foo",
+    "/",
+    "//",
+    "foo/bar",
+    "foo/bar/",
+    "foo/bar/baz",
+    "foo/bar/baz/qux",
+    "foo//baz",
+    "foo/baz",
+    "bar/bar/bar",
+    "$SYS",
+    "$SYS/broker",
+    "$SYS/broker/uptime",
+    "$SYS/broker/load/bytes",
+    "$foo/bar",
+    "solar/116181234567/cmd/power",
+    "solar/116181234567/cmd/restart",
+    "solar/116181234568/cmd/limit_persistent_relative",
+    "solar/dtu/uptime",
+    "solarx/dtu/uptime",
+};
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void test_matches_like_reference(void)
+{
+    MqttSubscribeParser parser;
+    const std::vector<bool> registered(filters.size(), true);
+    for (size_t i = 0; i < filters.size(); i++) {
+        TEST_ASSERT_TRUE(parser.register_callback(filters[i], 0, recordHit(i)));
+    }
+
+    for (const auto& topic : topics) {
+        assertSameMatches(parser, filters, registered, topic);
+    }
+}
+
+void test_unregister_like_reference(void)
+{
+    MqttSubscribeParser parser;
+    std::vector<bool> registered(filters.size(), true);
+    for (size_t i = 0; i < filters.size(); i++) {
+        parser.register_callback(filters[i], 0, recordHit(i));
+    }
+
+    // Remove every second filter, then register some of them again
+    for (size_t i = 0; i < filters.size(); i += 2) {
+        parser.unregister_callback(filters[i]);
+        registered[i] = false;
+    }
+    for (const auto& topic : topics) {
+        assertSameMatches(parser, filters, registered, topic);
+    }
+
+    for (size_t i = 0; i < filters.size(); i += 4) {
+        parser.register_callback(filters[i], 0, recordHit(i));
+        registered[i] = true;
+    }
+    for (const auto& topic : topics) {
+        assertSameMatches(parser, filters, registered, topic);
+    }
+
+    for (size_t i = 0; i < filters.size(); i++) {
+        parser.unregister_callback(filters[i]);
+    }
+    TEST_ASSERT_EQUAL(0, parser.get_callbacks().size());
+    TEST_ASSERT_EQUAL(0, dispatch(parser, "foo/bar").size());
+}
+
+void test_invalid_filters_are_rejected(void)
+{
+    static const std::vector<std::string> invalid = {
+        "",
+        "foo+",
+        "foo/bar+",
+        "+foo",
+        "foo/+bar/baz",
+        "foo#",
+        "foo/#/bar",
+        "#/foo",
+        "foo/##",
+        "++",
+    };
+
+    MqttSubscribeParser parser;
+    for (const auto& filter : invalid) {
+        TEST_ASSERT_FALSE(parser.register_callback(filter, 0, recordHit(0)));
+        TEST_ASSERT_FALSE(MqttSubscribeParser::is_valid_filter(filter));
+
+        // The reference never reported a match for these filters either
+        for (const auto& topic : topics) {
+            bool match = false;
+            mosquitto_topic_matches_sub(filter.c_str(), topic.c_str(), &match);
+            TEST_ASSERT_FALSE(match);
+        }
+    }
+    TEST_ASSERT_EQUAL(0, parser.get_callbacks().size());
+}
+
+void test_duplicate_filters_are_all_invoked(void)
+{
+    MqttSubscribeParser parser;
+    parser.register_callback("foo/+", 0, recordHit(0));
+    parser.register_callback("foo/+", 1, recordHit(1));
+
+    TEST_ASSERT_EQUAL(2, dispatch(parser, "foo/bar").size());
+    TEST_ASSERT_EQUAL(2, parser.get_callbacks().size());
+
+    // Removes all callbacks of the filter
+    parser.unregister_callback("foo/+");
+    TEST_ASSERT_EQUAL(0, dispatch(parser, "foo/bar").size());
+}
+
+// Random filters and topics built from a small set of levels, so that many
+// of them overlap
+void test_random_like_reference(void)
+{
+    static const char* const topicLevels[] = { "a", "b", "", "$x" };
+    static const char* const filterLevels[] = { "a", "b", "", "$x", "+", "#" };
+
+    std::mt19937 rng(42);
+    auto randomName = [&rng](const char* const* levels, const size_t count) {
+        std::string name;
+        const size_t depth = 1 + rng() % 4;
+        for (size_t i = 0; i < depth; i++) {
+            if (i > 0) {
+                name += '/';
+            }
+            name += levels[rng() % count];
+        }
+        return name;
+    };
+
+    for (uint8_t round = 0; round < 20; round++) {
+        std::vector<std::string> randomFilters;
+        for (uint8_t i = 0; i < 40; i++) {
+            const std::string filter = randomName(filterLevels, 6);
+            if (MqttSubscribeParser::is_valid_filter(filter)) {
+                randomFilters.push_back(filter);
+            }
+        }
+
+        MqttSubscribeParser parser;
+        std::vector<bool> registered(randomFilters.size(), true);
+        for (size_t i = 0; i < randomFilters.size(); i++) {
+            parser.register_callback(randomFilters[i], 0, recordHit(i));
+        }
+
+        for (uint8_t i = 0; i < 100; i++) {
+            assertSameMatches(parser, randomFilters, registered, randomName(topicLevels, 4));
+        }
+    }
+}
+
+// 6 command topics for 83 inverters plus 2 further subscriptions, dispatched
+// with the trie and with the previous scan over all filters
+void test_benchmark_500_subscriptions(void)
+{
+    static const char* const commands[] = {
+        "limit_persistent_relative",
+        "limit_persistent_absolute",
+        "limit_nonpersistent_relative",
+        "limit_nonpersistent_absolute",
+        "power",
+        "restart",
+    };
+
+    std::vector<std::string> benchFilters;
+    std::vector<std::string> benchTopics;
+    for (uint16_t inv = 0; inv < 83; inv++) {
+        const std::string serial = std::to_string(116180000000ULL + inv);
+        for (const char* command : commands) {
+            benchFilters.push_back("solar/" + serial + "/cmd/" + command);
+            benchTopics.push_back("solar/" + serial + "/cmd/" + command);
+        }
+    }
+    benchFilters.push_back("solar/dtu/cmd/#");
+    benchFilters.push_back("homeassistant/status");
+    TEST_ASSERT_EQUAL(500, benchFilters.size());
+
+    MqttSubscribeParser parser;
+    size_t calls = 0;
+    for (const auto& filter : benchFilters) {
+        parser.register_callback(filter, 0, [&calls](const espMqttClientTypes::MessageProperties&, const char*, const uint8_t*, size_t, size_t, size_t) {
+            calls++;
+        });
+    }
+
+    const uint8_t rounds = 20;
+    const size_t messages = rounds * benchTopics.size();
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint8_t round = 0; round < rounds; round++) {
+        for (const auto& topic : benchTopics) {
+            parser.handle_message(properties, topic.c_str(), nullptr, 0, 0, 0);
+        }
+    }
+    const double trieNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / messages;
+
+    size_t referenceCalls = 0;
+    start = std::chrono::steady_clock::now();
+    for (uint8_t round = 0; round < rounds; round++) {
+        for (const auto& topic : benchTopics) {
+            for (const auto& filter : benchFilters) {
+                bool match = false;
+                if (mosquitto_topic_matches_sub(filter.c_str(), topic.c_str(), &match) == MOSQ_ERR_SUCCESS && match) {
+                    referenceCalls++;
+                }
+            }
+        }
+    }
+    const double referenceNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / messages;
+
+    char msg[128];
+    snprintf(msg, sizeof(msg), "500 subscriptions: trie %.0f ns, scan %.0f ns per message", trieNs, referenceNs);
+    TEST_MESSAGE(msg);
+
+    TEST_ASSERT_EQUAL(messages, calls);
+    TEST_ASSERT_EQUAL(referenceCalls, calls);
+    TEST_ASSERT_TRUE(trieNs < referenceNs);
+}
+
+int main(int, char**)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_matches_like_reference);
+    RUN_TEST(test_unregister_like_reference);
+    RUN_TEST(test_invalid_filters_are_rejected);
+    RUN_TEST(test_duplicate_filters_are_all_invoked);
+    RUN_TEST(test_random_like_reference);
+    RUN_TEST(test_benchmark_500_subscriptions);
+    return UNITY_END();
+}
@@ -0,0 +1,208 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+# Copyright (C) 2024 Thomas Basler and others
+#
+"""Decodes a dump of the radio recorder into a timeline and statistics.
+
+Download the dump with
+    curl -u admin:<password> -o radio_recorder.bin http://<opendtu>/api/dtu/recorder
+and run
+    python3 radio_recorder.py radio_recorder.bin
+"""
+import argparse
+import datetime
+import struct
+import sys
+from collections import Counter, defaultdict
+
+MAGIC = 0x43524452
+VERSION = 1
+
+HEADER = struct.Struct("<IHHIIII")
+RECORD = struct.Struct("<IIBBBb4B")
+
+RADIOS = {0: "NRF", 1: "CMT"}
+
+EV_TX = 1
+EV_RX = 2
+EV_RX_OVERFLOW = 3
+EV_VERIFY = 4
+EV_NO_INVERTER = 5
+
+VERIFY_RESULTS = {
+    0: "success",
+    252: "handle error",
+    253: "retransmit timeout",
+    254: "all missing, timeout",
+    255: "all missing, resend",
+}
+
+
+def verifyText(result):
+    if result in VERIFY_RESULTS:
+        return VERIFY_RESULTS[result]
+    return "retransmit fragment %d" % result
+
+
+def readDump(filename):
+    with open(filename, "rb") as fp:
+        data = fp.read()
+
+    if len(data) < HEADER.size:
+        raise ValueError("file too short")
+
+    magic, version, recordSize, recordCount, totalCount, time, unixTime = HEADER.unpack_from(data)
+    if magic != MAGIC:
+        raise ValueError("not a radio recorder dump")
+    if version != VERSION or recordSize != RECORD.size:
+        raise ValueError("unsupported dump version %d" % version)
+    if len(data) < HEADER.size + recordCount * recordSize:
+        raise ValueError("dump is truncated")
+
+    records = []
+    for i in range(recordCount):
+        t, serial, event, radio, channel, rssi, *payload = RECORD.unpack_from(data, HEADER.size + i * recordSize)
+        records.append({
+            "time": t,
+            "serial": serial,
+            "event": event,
+            "radio": RADIOS.get(radio, str(radio)),
+            "channel": channel,
+            "rssi": rssi,
+            "data": payload,
+        })
+
+    # micros() wraps every 71 minutes, the records are in chronological order
+    # and the dump was taken after the last one
+    offset = 0
+    last = None
+    for record in records:
+        if last is not None and record["time"] < last:
+            offset += 1 << 32
+        last = record["time"]
+        record["time"] += offset
+    dumpTime = time + offset
+    if last is not None and time < last:
+        dumpTime += 1 << 32
+
+    header = {
+        "total": totalCount,
+        "time": dumpTime,
+        "unixTime": unixTime if unixTime > 1577836800 else None,  # 2020-01-01
+    }
+    return header, records
+
+
+def describe(record):
+    event = record["event"]
+    d = record["data"]
+    if event == EV_TX:
+        return "TX  cmd %02X frame %02X sub %02X, %d bytes" % (d[0], d[1], d[2], d[3])
+    if event == EV_RX:
+        return "RX  cmd %02X frag %02X, %d bytes, %s, %d dBm" % (d[0], d[1], d[2], "crc ok" if d[3] else "CRC ERROR", record["rssi"])
+    if event == EV_RX_OVERFLOW:
+        return "RX  buffer overflow"
+    if event == EV_VERIFY:
+        return "END %s" % verifyText(d[0])
+    if event == EV_NO_INVERTER:
+        return "ERR inverter not found"
+    return "unknown event %d" % event
+
+
+def printTimeline(header, records):
+    start = records[0]["time"]
+    for record in records:
+        if header["unixTime"] is not None:
+            seconds = header["unixTime"] - (header["time"] - record["time"]) / 1e6
+            stamp = datetime.datetime.fromtimestamp(seconds).strftime("%H:%M:%S.%f")[:-3]
+        else:
+            stamp = "%12.3f" % ((record["time"] - start) / 1e3)
+        print("%s  %s ch %3d  %08X  %s" % (stamp, record["radio"], record["channel"], record["serial"], describe(record)))
+
+
+def printSummary(header, records):
+    duration = (records[-1]["time"] - records[0]["time"]) / 1e6
+    print()
+    print("%d records over %.1f s, %d recorded since boot" % (len(records), duration, header["total"]))
+
+    inverters = defaultdict(lambda: {
+        "tx": Counter(),
+        "rx": 0,
+        "crc": 0,
+        "rssi": [],
+        "channels": Counter(),
+        "verify": Counter(),
+    })
+    overflows = 0
+    noInverter = 0
+    for record in records:
+        event = record["event"]
+        if event == EV_RX_OVERFLOW:
+            overflows += 1
+            continue
+        if event == EV_NO_INVERTER:
+            noInverter += 1
+            continue
+
+        inv = inverters[record["serial"]]
+        if event == EV_TX:
+            inv["tx"]["%02X/%02X" % (record["data"][0], record["data"][2])] += 1
+        elif event == EV_RX:
+            inv["rx"] += 1
+            inv["channels"][record["channel"]] += 1
+            if record["data"][3]:
+                if record["rssi"] != 0:
+                    inv["rssi"].append(record["rssi"])
+            else:
+                inv["crc"] += 1
+        elif event == EV_VERIFY:
+            result = record["data"][0]
+            inv["verify"][verifyText(result) if result in VERIFY_RESULTS else "retransmit"] += 1
+
+    for serial in sorted(inverters):
+        inv = inverters[serial]
+        requests = sum(inv["verify"].values())
+        success = inv["verify"]["success"]
+        print()
+        print("Inverter ...%08X" % serial)
+        print("  TX %d (cmd/sub: %s)" % (sum(inv["tx"].values()), ", ".join("%s x%d" % i for i in sorted(inv["tx"].items()))))
+        print("  RX %d fragments, %d CRC errors" % (inv["rx"], inv["crc"]))
+        if inv["rssi"]:
+            print("  RSSI min %d / avg %.1f / max %d dBm" % (min(inv["rssi"]), sum(inv["rssi"]) / len(inv["rssi"]), max(inv["rssi"])))
+        if inv["channels"]:
+            print("  RX channels: %s" % ", ".join("%d x%d" % i for i in sorted(inv["channels"].items())))
+        if requests > 0:
+            print("  Receive periods %d, successful %d (%.0f %%)" % (requests, success, 100.0 * success / requests))
+            for result, count in sorted(inv["verify"].items()):
+                print("    %-22s %d" % (result, count))
+
+    if overflows or noInverter:
+        print()
+        print("Receive buffer overflows: %d, commands without inverter: %d" % (overflows, noInverter))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decodes a dump of the OpenDTU radio recorder")
+    parser.add_argument("dump", help="file downloaded from /api/dtu/recorder")
+    parser.add_argument("--summary", action="store_true", help="only print the statistics")
+    args = parser.parse_args()
+
+    try:
+        header, records = readDump(args.dump)
+    except (OSError, ValueError) as e:
+        print("%s: %s" % (args.dump, e), file=sys.stderr)
+        return 1
+
+    if not records:
+        print("No records")
+        return 0
+
+    if not args.summary:
+        printTimeline(header, records)
+    printSummary(header, records)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -54,3 +54,15 @@ export interface LiveData {
     total: Total;
     hints: Hints;
 }
+
+// Type, channel, name, unit and digits of a value in a binary live data frame
+export type LiveDataSchemaField = [string, string, string, string, number];
+
+export interface LiveDataSchema {
+    serial: string;
+    id: number;
+    name: string;
+    order: number;
+    fields: LiveDataSchemaField[];
+    strings: Record<string, { name: string; max: number }>;
+}
@@ -1,3 +1,24 @@
+export interface MqttQueueStatus {
+    depth: number;
+    bytes: number;
+    budget: number;
+    enqueued: number;
+    sent: number;
+    replaced: number;
+    dropped: number;
+    latency_avg: number;
+    latency_max: number;
+}
+
+export interface MqttHassDiscoveryStatus {
+    passes: number;
+    published: number;
+    unchanged: number;
+    duration: number;
+    max_tick_time: number;
+    peak_heap_usage: number;
+}
+
 export interface MqttStatus {
     mqtt_enabled: boolean;
     mqtt_hostname: string;
@@ -18,4 +39,6 @@ export interface MqttStatus {
     mqtt_hass_retain: boolean;
     mqtt_hass_topic: string;
     mqtt_hass_individualpanels: boolean;
+    mqtt_queue: MqttQueueStatus;
+    mqtt_hass_discovery: MqttHassDiscoveryStatus;
 }